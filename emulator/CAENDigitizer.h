@@ -0,0 +1,48 @@
+/* Functions of the CAENDigitizer library (Rel. 2.6.8) implemented by the
+ * digitizer emulator (see CAENDigitizerEmulator.c). The prototypes are those
+ * of the CAEN header; only the subset used by the acquisition program is
+ * declared.
+ *
+ * 'CAENDigitizerEmulator' version: a0.1
+ */
+
+#ifndef __CAENDIGITIZER_H
+  #define __CAENDIGITIZER_H
+  #include "CAENDigitizerType.h"
+
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_OpenDigitizer(CAEN_DGTZ_ConnectionType LinkType, int LinkNum, int ConetNode, uint32_t VMEBaseAddress, int *handle);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_CloseDigitizer(int handle);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_WriteRegister(int handle, uint32_t Address, uint32_t Data);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_ReadRegister(int handle, uint32_t Address, uint32_t *Data);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_GetInfo(int handle, CAEN_DGTZ_BoardInfo_t *BoardInfo);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_Reset(int handle);
+
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetDPPAcquisitionMode(int handle, CAEN_DGTZ_DPP_AcqMode_t mode, CAEN_DGTZ_DPP_SaveParam_t param);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetAcquisitionMode(int handle, CAEN_DGTZ_AcqMode_t mode);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetIOLevel(int handle, CAEN_DGTZ_IOLevel_t level);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetExtTriggerInputMode(int handle, CAEN_DGTZ_TriggerMode_t mode);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetChannelEnableMask(int handle, uint32_t mask);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetDPPEventAggregation(int handle, int threshold, int maxsize);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetRunSynchronizationMode(int handle, CAEN_DGTZ_RunSyncMode_t mode);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetDPPParameters(int handle, uint32_t channelMask, void *params);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetRecordLength(int handle, uint32_t size, ...);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetChannelDCOffset(int handle, uint32_t channel, uint32_t Tvalue);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetDPPPreTriggerSize(int handle, int ch, uint32_t samples);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetChannelPulsePolarity(int handle, uint32_t channel, CAEN_DGTZ_PulsePolarity_t pol);
+
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_MallocReadoutBuffer(int handle, char **buffer, uint32_t *size);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_FreeReadoutBuffer(char **buffer);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_MallocDPPEvents(int handle, void **events, uint32_t *allocatedSize);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_FreeDPPEvents(int handle, void **events);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_MallocDPPWaveforms(int handle, void **waveforms, uint32_t *allocatedSize);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_FreeDPPWaveforms(int handle, void *Waveforms);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_DecodeDPPWaveforms(int handle, void *event, void *waveforms);
+
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetInterruptConfig(int handle, CAEN_DGTZ_EnaDis_t state, uint8_t level, uint32_t status_id, uint16_t event_number, CAEN_DGTZ_IRQMode_t mode);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_IRQWait(int handle, uint32_t timeout);
+
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_SWStartAcquisition(int handle);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_SWStopAcquisition(int handle);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_ReadData(int handle, CAEN_DGTZ_ReadMode_t mode, char *buffer, uint32_t *bufferSize);
+  extern CAEN_DGTZ_ErrorCode CAEN_DGTZ_GetDPPEvents(int handle, char *buffer, uint32_t buffsize, void **events, uint32_t *numEventsArray);
+#endif
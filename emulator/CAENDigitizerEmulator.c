@@ -0,0 +1,801 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * 'CAENDigitizerEmulator' stands in for libCAENDigitizer: it implements the
+ * subset of the CAENDigitizer API used by the acquisition program and emulates
+ * a DT5720 with DPP-PSD firmware, so that the whole acquisition path can be
+ * run and load-tested without a digitizer.
+ *
+ * The emulated board generates, in real time from CAEN_DGTZ_SWStartAcquisition(),
+ * the events of a TDCR counter:
+ * - a correlated source (a decay seen by the PMTs) whose events are detected
+ *   by each channel of EMU_COINC_MASK with probability EMU_EFFICIENCY, within
+ *   a few samples: they produce the double and triple coincidences. The
+ *   pulses start at any time within a sample, not on the sample boundaries,
+ *   so that their fine time can be measured on the samples;
+ * - an uncorrelated source for each enabled channel (PMT noise, background).
+ * Each channel triggers at EMU_RATE Hz on average, a fraction
+ * EMU_COINC_FRACTION of it from the correlated source. The trigger hold-off
+ * (trgho) is applied and the pile-up flag is set when an event falls inside
+ * the long gate of the previous one. The time tag counts 4 ns samples on 31
+ * bits, so it rolls over every ~8.6 s (divided by EMU_SPEED).
+ * CAEN_DGTZ_ReadData() returns the events generated so far as board/channel
+ * aggregates in the layout decoded by psdDecoder.h: while the acquisition
+ * runs only the full channel aggregates are read, the events of the
+ * partially filled ones are read after CAEN_DGTZ_SWStopAcquisition(), as on
+ * the real board. The charge is always enabled. The extras word is enabled
+ * with EMU_EXTRAS=1 or the bit 17 of the Board Configuration (register 0x8000,
+ * or its bit-set and bit-clear registers 0x8004 and 0x8008): it holds the
+ * lost/total trigger counters of the channel with the option 4 in the bits
+ * [10:8] of its register 0x1n84, the baseline x 4 and the extended time stamp
+ * otherwise. In Oscilloscope/Mixed mode the events carry the samples of the
+ * record length (a negative pulse after the pre-trigger, see pulseSample()).
+ * CAEN_DGTZ_GetDPPEvents() unpacks the events. Events that don't fit
+ * in the board memory (EMU_MEMORY_EVENTS per channel) are lost, as on the
+ * real board when the readout is too slow. CAEN_DGTZ_IRQWait() returns as
+ * soon as the board holds the number of full channel aggregates set by
+ * CAEN_DGTZ_SetInterruptConfig(), as the board raises its interrupt.
+ *
+ * The emulation is tuned with environment variables:
+ *   EMU_RATE            mean trigger rate of each channel (Hz, default 10000)
+ *   EMU_COINC_FRACTION  fraction of the rate from the correlated source (0.6)
+ *   EMU_COINC_MASK      channels that see the correlated source (0xD: A, B, C)
+ *   EMU_EFFICIENCY      detection probability of a correlated event (0.8)
+ *   EMU_SPEED           speed of the emulated clock (1 = real time)
+ *   EMU_EXTRAS          1: the events carry the extras word (0)
+ *   EMU_SEED            seed of the random generator (1)
+ *
+ * Build it as a shared library and link the program against it in place of
+ * the real one (from the repository root):
+ *
+ *   gcc -O2 -fPIC -shared -Iemulator -o emulator/libCAENDigitizer.so emulator/CAENDigitizerEmulator.c -lm
+ *   cd src && gcc -O2 -pthread -I../include -I../emulator -o ../readout *.c -L../emulator -lCAENDigitizer -lm -Wl,-rpath,'$ORIGIN/emulator'
+ *
+ * 'CAENDigitizerEmulator' version: a0.5
+ */
+
+#include "CAENDigitizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define EMU_MAX_BOARDS 8
+#define EMU_CHANNELS 4                    /* channels of a DT5720 */
+#define EMU_SAMPLE_NS 4                   /* 250 MS/s */
+#define EMU_TICKS_PER_S (1000000000.0 / EMU_SAMPLE_NS)
+#define EMU_TIMETAG_MASK 0x7FFFFFFFu
+#define EMU_READOUT_BUFFER_SIZE (4u << 20)
+#define EMU_MEMORY_EVENTS (1u << 16)      /* events stored for each channel */
+#define EMU_DEFAULT_AGGR 1024             /* events per channel aggregate with EventAggr = 0 */
+#define EMU_MAX_REGISTERS 64
+#define EMU_BASELINE 3000                 /* ADC counts (12 bit, negative pulses) */
+#define EMU_MAX_JITTER 3                  /* samples between the correlated events */
+#define EMU_DEFAULT_PRE_TRIGGER 4         /* samples before the pulse if CAEN_DGTZ_SetDPPPreTriggerSize() isn't called */
+#define EMU_PHASE_UNITS 256               /* resolution of the start of the pulses within a sample */
+#define EMU_RISE 2.0                      /* rise time of the pulses (samples) */
+#define EMU_DECAY 4.0                     /* samples for the pulse to halve after the rise */
+#define EMU_PULSE_LENGTH 64.0             /* samples of the pulse, then the baseline */
+#define EMU_IRQ_POLL_NS 100000            /* period of the interrupt checks of CAEN_DGTZ_IRQWait() */
+
+typedef struct
+{
+  uint64_t time;                          /* samples since the start */
+  uint16_t qshort, qlong;
+  uint16_t pur;
+  uint16_t phase;                         /* start of the pulse after the time tag (1/EMU_PHASE_UNITS of a sample) */
+  uint32_t triggers;                      /* [31:16] lost and [15:0] total trigger counters after its trigger */
+} emuEvent_t;
+
+typedef struct
+{
+  int open;
+  uint32_t chMask;
+  CAEN_DGTZ_DPP_AcqMode_t acqMode;
+  uint32_t recordLength;
+  uint32_t preTrigger;                    /* samples of the traces before the trigger (all the channels) */
+  int aggrThreshold;
+  int irqEnabled;
+  uint32_t irqAggregates;                 /* full aggregates that raise the interrupt */
+  CAEN_DGTZ_DPP_PSD_Params_t dpp;
+  uint32_t regAddress[EMU_MAX_REGISTERS], regData[EMU_MAX_REGISTERS];
+  int numRegisters;
+
+  /* acquisition */
+  int started;
+  uint64_t startNs;                       /* CLOCK_MONOTONIC at the start */
+  uint64_t generatedTo;                   /* events generated up to this sample */
+  uint64_t nextCorrelated, nextSingle[EMU_CHANNELS];
+  uint64_t lastTime[EMU_CHANNELS];        /* last trigger accepted (hold-off, pile-up) */
+  int hasLast[EMU_CHANNELS];
+  emuEvent_t *memory[EMU_CHANNELS];       /* ring of the events not yet read */
+  uint32_t head[EMU_CHANNELS], count[EMU_CHANNELS];
+  uint64_t lost[EMU_CHANNELS];
+  uint32_t totalTriggers[EMU_CHANNELS], lostTriggers[EMU_CHANNELS];
+  uint32_t aggrCounter;
+  uint64_t rng;
+} emuBoard_t;
+
+/* emulation settings, read from the environment on the first open */
+static struct
+{
+  int loaded;
+  double rate, coincFraction, efficiency, speed;
+  uint32_t coincMask;
+  int extras;
+  uint64_t seed;
+} settings;
+
+static emuBoard_t boards[EMU_MAX_BOARDS];
+
+static void loadSettings(void);
+static emuBoard_t *getBoard(int handle);
+static uint64_t nowNs(void);
+static double uniformRandom(emuBoard_t *bd);
+static uint64_t exponentialInterval(emuBoard_t *bd, double rate);
+static void addEvent(emuBoard_t *bd, int ch, double t);
+static uint32_t pulseSample(const emuBoard_t *bd, const emuEvent_t *ev, uint32_t s);
+static void generateEvents(emuBoard_t *bd, uint64_t to);
+static uint32_t eventWords(emuBoard_t *bd);
+static uint32_t samplesPerEvent(emuBoard_t *bd);
+static uint32_t aggregateEvents(emuBoard_t *bd);
+static uint32_t registerValue(emuBoard_t *bd, uint32_t address);
+static int extrasEnabled(emuBoard_t *bd);
+
+
+/* Reads the emulation settings from the environment.
+ */
+static void loadSettings(void){
+  char *value;
+    if (settings.loaded)
+      return;
+    settings.rate = (value = getenv("EMU_RATE")) ? atof(value) : 10000.0;
+    settings.coincFraction = (value = getenv("EMU_COINC_FRACTION")) ? atof(value) : 0.6;
+    settings.coincMask = (value = getenv("EMU_COINC_MASK")) ? (uint32_t)strtoul(value, NULL, 0) : 0xD;
+    settings.efficiency = (value = getenv("EMU_EFFICIENCY")) ? atof(value) : 0.8;
+    settings.speed = (value = getenv("EMU_SPEED")) ? atof(value) : 1.0;
+    settings.extras = (value = getenv("EMU_EXTRAS")) ? atoi(value) : 0;
+    settings.seed = (value = getenv("EMU_SEED")) ? strtoull(value, NULL, 0) : 1;
+    if (settings.rate <= 0.0)
+      settings.rate = 1.0;
+    if(  (settings.coincFraction < 0.0) || (settings.coincFraction > 1.0)  )
+      settings.coincFraction = 0.6;
+    if(  (settings.efficiency <= 0.0) || (settings.efficiency > 1.0)  )
+      settings.efficiency = 0.8;
+    if (settings.speed <= 0.0)
+      settings.speed = 1.0;
+    settings.loaded = 1;
+    fprintf(stderr, "CAENDigitizerEmulator: %.0f Hz/ch, %.0f%% correlated (mask %#x, efficiency %.2f), speed %.2f\n",
+            settings.rate, settings.coincFraction * 100.0, settings.coincMask, settings.efficiency, settings.speed);
+}
+
+/* @return the open board of 'handle' or NULL */
+static emuBoard_t *getBoard(int handle){
+    if(  (handle < 0) || (handle >= EMU_MAX_BOARDS) || !boards[handle].open  )
+      return NULL;
+  return &boards[handle];
+}
+
+/* @return the CLOCK_MONOTONIC time in nanoseconds */
+static uint64_t nowNs(void){
+  struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* @return a random number in (0, 1] (xorshift64*) */
+static double uniformRandom(emuBoard_t *bd){
+    bd->rng ^= bd->rng >> 12;
+    bd->rng ^= bd->rng << 25;
+    bd->rng ^= bd->rng >> 27;
+  return ((double)((bd->rng * 0x2545F4914F6CDD1Dull) >> 11) + 1.0) / 9007199254740992.0;
+}
+
+/* @return the samples to the next event of a Poisson process of 'rate' Hz */
+static uint64_t exponentialInterval(emuBoard_t *bd, double rate){
+  double interval = -log(uniformRandom(bd)) * EMU_TICKS_PER_S / rate;
+  return (interval < 1.0) ? 1 : (uint64_t)interval;
+}
+
+/* Triggers the channel 'ch' at the time 't' (samples, the pulse starts within
+ * the sample of the time tag): applies the hold-off, sets the pile-up flag,
+ * draws the charges and stores the event in the board memory.
+ */
+static void addEvent(emuBoard_t *bd, int ch, double time){
+  emuEvent_t *ev;
+  double u;
+  int qlong, ratio;
+  uint64_t t = (uint64_t)time;
+    if (!(bd->chMask & (1u << ch)))
+      return;
+    if (bd->hasLast[ch]){
+      if (t <= bd->lastTime[ch])
+        t = bd->lastTime[ch] + 1;           // the time tag of a channel never goes back
+      if (t - bd->lastTime[ch] < (uint64_t)bd->dpp.trgho)
+        return;                             // trigger hold-off: the event is not seen
+    }
+    bd->totalTriggers[ch]++;
+    if (bd->count[ch] == EMU_MEMORY_EVENTS){
+      bd->lost[ch]++;                       // board memory full
+      bd->lostTriggers[ch]++;
+      return;
+    }
+    ev = &bd->memory[ch][(bd->head[ch] + bd->count[ch]) % EMU_MEMORY_EVENTS];
+    bd->count[ch]++;
+    ev->time = t;
+    ev->phase = (uint16_t)((time - (double)t) * EMU_PHASE_UNITS);
+    ev->triggers = (bd->lostTriggers[ch] << 16) | (bd->totalTriggers[ch] & 0xFFFFu);
+    ev->pur = (bd->hasLast[ch] && (t - bd->lastTime[ch] < (uint64_t)bd->dpp.lgate[ch]));
+    /* beta-like spectrum for the long charge, two populations for the PSD
+       ratio (Qs/Ql) */
+    u = uniformRandom(bd);
+    qlong = 40 + (int)(u * u * 3900.0 * uniformRandom(bd));
+    ratio = (uniformRandom(bd) < 0.8) ? 85 : 65;
+    ev->qlong = (uint16_t)qlong;
+    ev->qshort = (uint16_t)((qlong * ratio) / 100);
+    bd->lastTime[ch] = t;
+    bd->hasLast[ch] = 1;
+}
+
+/* Generates the events of the board up to the sample 'to', in time order.
+ */
+static void generateEvents(emuBoard_t *bd, uint64_t to){
+  double singlesRate = settings.rate * (1.0 - settings.coincFraction);
+  double correlatedRate = settings.rate * settings.coincFraction / settings.efficiency;
+  uint64_t t;
+  int ch, next;
+    for (;;){
+      /* next event: correlated source (-1) or single of a channel */
+      next = -1;
+      t = (correlatedRate > 0.0) ? bd->nextCorrelated : UINT64_MAX;
+      for (ch = 0; ch < EMU_CHANNELS; ch++){
+        if(  (singlesRate > 0.0) && (bd->nextSingle[ch] < t)  ){
+          t = bd->nextSingle[ch];
+          next = ch;
+        }
+      }
+      if (t >= to)
+        break;
+      if (next < 0){
+        for (ch = 0; ch < EMU_CHANNELS; ch++){
+          if(  (settings.coincMask & (1u << ch)) && (uniformRandom(bd) < settings.efficiency)  )
+            addEvent(bd, ch, (double)t + uniformRandom(bd) * EMU_MAX_JITTER);
+        }
+        bd->nextCorrelated += exponentialInterval(bd, correlatedRate);
+      }
+      else{
+        addEvent(bd, next, (double)t + uniformRandom(bd));
+        bd->nextSingle[next] += exponentialInterval(bd, singlesRate);
+      }
+    }
+    bd->generatedTo = to;
+}
+
+/* @return the height of the pulse of the event 'ev' at the sample 's' of its
+ * trace (ADC counts): a linear rise over EMU_RISE samples from the
+ * pre-trigger (plus the phase of the event), then an exponential decay
+ */
+static uint32_t pulseSample(const emuBoard_t *bd, const emuEvent_t *ev, uint32_t s){
+  double x = (double)s - (double)bd->preTrigger - (double)ev->phase / EMU_PHASE_UNITS;
+  double height = (double)ev->qlong / 16.0;
+    if(  (x <= 0.0) || (x >= EMU_PULSE_LENGTH)  )
+      return 0;
+    if (x < EMU_RISE)
+      return (uint32_t)(height * x / EMU_RISE);
+  return (uint32_t)(height * exp2(-(x - EMU_RISE) / EMU_DECAY));
+}
+
+/* @return the number of samples of each event (0 in List mode) */
+static uint32_t samplesPerEvent(emuBoard_t *bd){
+    if(  (bd->acqMode == CAEN_DGTZ_DPP_ACQ_MODE_List) || (bd->recordLength == 0)  )
+      return 0;
+  return (bd->recordLength + 7) & ~7u;
+}
+
+/* @return the number of events of a full channel aggregate */
+static uint32_t aggregateEvents(emuBoard_t *bd){
+  return (bd->aggrThreshold > 0) ? (uint32_t)bd->aggrThreshold : EMU_DEFAULT_AGGR;
+}
+
+/* @return the number of 32 bit words of each event */
+static uint32_t eventWords(emuBoard_t *bd){
+  return 1 + samplesPerEvent(bd) / 2 + (extrasEnabled(bd) ? 1 : 0) + 1;
+}
+
+/* @return the value written to the register at 'address', 0 if none */
+static uint32_t registerValue(emuBoard_t *bd, uint32_t address){
+  register int i;
+    for (i = 0; i < bd->numRegisters; i++){
+      if (bd->regAddress[i] == address)
+        return bd->regData[i];
+    }
+  return 0;
+}
+
+/* @return non-zero if the events carry the extras word */
+static int extrasEnabled(emuBoard_t *bd){
+  return settings.extras || (registerValue(bd, 0x8000) & (1u << 17));
+}
+
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_OpenDigitizer(CAEN_DGTZ_ConnectionType LinkType, int LinkNum, int ConetNode, uint32_t VMEBaseAddress, int *handle){
+  register int h, ch;
+    (void)LinkType; (void)LinkNum; (void)ConetNode; (void)VMEBaseAddress;
+    loadSettings();
+    for (h = 0; h < EMU_MAX_BOARDS; h++){
+      if (!boards[h].open)
+        break;
+    }
+    if (h == EMU_MAX_BOARDS)
+      return CAEN_DGTZ_MaxDevicesError;
+    memset(&boards[h], 0, sizeof(emuBoard_t));
+    for (ch = 0; ch < EMU_CHANNELS; ch++){
+      if(  (boards[h].memory[ch] = (emuEvent_t*)malloc(EMU_MEMORY_EVENTS * sizeof(emuEvent_t))) == NULL  ){
+        while (--ch >= 0)
+          free(boards[h].memory[ch]);
+        return CAEN_DGTZ_OutOfMemory;
+      }
+    }
+    boards[h].open = 1;
+    boards[h].chMask = (1u << EMU_CHANNELS) - 1;
+    boards[h].acqMode = CAEN_DGTZ_DPP_ACQ_MODE_List;
+    boards[h].preTrigger = EMU_DEFAULT_PRE_TRIGGER;
+    boards[h].rng = settings.seed * 0x9E3779B97F4A7C15ull + (uint64_t)h + 1;
+    *handle = h;
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_CloseDigitizer(int handle){
+  emuBoard_t *bd = getBoard(handle);
+  register int ch;
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    for (ch = 0; ch < EMU_CHANNELS; ch++){
+      if (bd->lost[ch])
+        fprintf(stderr, "CAENDigitizerEmulator: board %d ch %d: %lu events lost (board memory full)\n", handle, ch, (unsigned long)bd->lost[ch]);
+      free(bd->memory[ch]);
+    }
+    bd->open = 0;
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_WriteRegister(int handle, uint32_t Address, uint32_t Data){
+  emuBoard_t *bd = getBoard(handle);
+  register int i;
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    // bit-set and bit-clear registers of the Board Configuration
+    if(  (Address == 0x8004) || (Address == 0x8008)  ){
+      Data = (Address == 0x8004) ? (registerValue(bd, 0x8000) | Data) : (registerValue(bd, 0x8000) & ~Data);
+      Address = 0x8000;
+    }
+    for (i = 0; i < bd->numRegisters; i++){
+      if (bd->regAddress[i] == Address)
+        break;
+    }
+    if (i == EMU_MAX_REGISTERS)
+      return CAEN_DGTZ_WriteDeviceRegisterFail;
+    if (i == bd->numRegisters)
+      bd->numRegisters++;
+    bd->regAddress[i] = Address;
+    bd->regData[i] = Data;
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_ReadRegister(int handle, uint32_t Address, uint32_t *Data){
+  emuBoard_t *bd = getBoard(handle);
+  register int i;
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    *Data = 0;
+    for (i = 0; i < bd->numRegisters; i++){
+      if (bd->regAddress[i] == Address)
+        *Data = bd->regData[i];
+    }
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_GetInfo(int handle, CAEN_DGTZ_BoardInfo_t *BoardInfo){
+    if (getBoard(handle) == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    memset(BoardInfo, 0, sizeof(CAEN_DGTZ_BoardInfo_t));
+    strcpy(BoardInfo->ModelName, "DT5720");
+    BoardInfo->Model = 7;
+    BoardInfo->Channels = EMU_CHANNELS;
+    BoardInfo->FormFactor = 2;
+    BoardInfo->FamilyCode = 2;
+    strcpy(BoardInfo->ROC_FirmwareRel, "04.05 - Build 1316");
+    strcpy(BoardInfo->AMC_FirmwareRel, "131.06 - Build 1522");
+    BoardInfo->SerialNumber = 0xE000 + (uint32_t)handle;
+    BoardInfo->ADC_NBits = 12;
+    BoardInfo->CommHandle = handle;
+    BoardInfo->VMEHandle = handle;
+    strcpy(BoardInfo->License, "EMULATOR");
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_Reset(int handle){
+  emuBoard_t *bd = getBoard(handle);
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    bd->started = 0;
+    bd->numRegisters = 0;
+    memset(bd->count, 0, sizeof(bd->count));
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetDPPAcquisitionMode(int handle, CAEN_DGTZ_DPP_AcqMode_t mode, CAEN_DGTZ_DPP_SaveParam_t param){
+  emuBoard_t *bd = getBoard(handle);
+    (void)param;
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    bd->acqMode = mode;
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetAcquisitionMode(int handle, CAEN_DGTZ_AcqMode_t mode){
+    (void)mode;
+  return getBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetIOLevel(int handle, CAEN_DGTZ_IOLevel_t level){
+    (void)level;
+  return getBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetExtTriggerInputMode(int handle, CAEN_DGTZ_TriggerMode_t mode){
+    (void)mode;
+  return getBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetChannelEnableMask(int handle, uint32_t mask){
+  emuBoard_t *bd = getBoard(handle);
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    bd->chMask = mask & ((1u << EMU_CHANNELS) - 1);
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetDPPEventAggregation(int handle, int threshold, int maxsize){
+  emuBoard_t *bd = getBoard(handle);
+    (void)maxsize;
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    bd->aggrThreshold = threshold;
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetRunSynchronizationMode(int handle, CAEN_DGTZ_RunSyncMode_t mode){
+    (void)mode;
+  return getBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetDPPParameters(int handle, uint32_t channelMask, void *params){
+  emuBoard_t *bd = getBoard(handle);
+    (void)channelMask;
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    if (params == NULL)
+      return CAEN_DGTZ_InvalidParam;
+    memcpy(&bd->dpp, params, sizeof(CAEN_DGTZ_DPP_PSD_Params_t));
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetRecordLength(int handle, uint32_t size, ...){
+  emuBoard_t *bd = getBoard(handle);
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    bd->recordLength = size;
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetChannelDCOffset(int handle, uint32_t channel, uint32_t Tvalue){
+    (void)channel; (void)Tvalue;
+  return getBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetDPPPreTriggerSize(int handle, int ch, uint32_t samples){
+  emuBoard_t *bd = getBoard(handle);
+    (void)ch;
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    bd->preTrigger = samples;
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetChannelPulsePolarity(int handle, uint32_t channel, CAEN_DGTZ_PulsePolarity_t pol){
+    (void)channel; (void)pol;
+  return getBoard(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_MallocReadoutBuffer(int handle, char **buffer, uint32_t *size){
+    if (getBoard(handle) == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    if(  (*buffer = (char*)malloc(EMU_READOUT_BUFFER_SIZE)) == NULL  )
+      return CAEN_DGTZ_OutOfMemory;
+    *size = EMU_READOUT_BUFFER_SIZE;
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_FreeReadoutBuffer(char **buffer){
+    free(*buffer);
+    *buffer = NULL;
+  return CAEN_DGTZ_Success;
+}
+
+/* A readout buffer holds at most EMU_READOUT_BUFFER_SIZE / 8 events (2 words
+   each): each channel of the board gets an array of that many events */
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_MallocDPPEvents(int handle, void **events, uint32_t *allocatedSize){
+  register int ch;
+  size_t size = (EMU_READOUT_BUFFER_SIZE / 8) * sizeof(CAEN_DGTZ_DPP_PSD_Event_t);
+    if (getBoard(handle) == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    for (ch = 0; ch < EMU_CHANNELS; ch++){
+      if(  (events[ch] = malloc(size)) == NULL  ){
+        while (--ch >= 0){
+          free(events[ch]);
+          events[ch] = NULL;
+        }
+        return CAEN_DGTZ_OutOfMemory;
+      }
+    }
+    *allocatedSize = (uint32_t)(size * EMU_CHANNELS);
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_FreeDPPEvents(int handle, void **events){
+  register int ch;
+    (void)handle;
+    for (ch = 0; ch < EMU_CHANNELS; ch++){
+      free(events[ch]);
+      events[ch] = NULL;
+    }
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_MallocDPPWaveforms(int handle, void **waveforms, uint32_t *allocatedSize){
+  CAEN_DGTZ_DPP_PSD_Waveforms_t *wf;
+  uint32_t ns;
+  emuBoard_t *bd = getBoard(handle);
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    ns = bd->recordLength ? ((bd->recordLength + 7) & ~7u) : 8;
+    if(  (wf = (CAEN_DGTZ_DPP_PSD_Waveforms_t*)calloc(1, sizeof(CAEN_DGTZ_DPP_PSD_Waveforms_t))) == NULL  )
+      return CAEN_DGTZ_OutOfMemory;
+    wf->Trace1 = (uint16_t*)calloc(ns, sizeof(uint16_t));
+    wf->Trace2 = (uint16_t*)calloc(ns, sizeof(uint16_t));
+    wf->DTrace1 = (uint8_t*)calloc(ns, 1);
+    wf->DTrace2 = (uint8_t*)calloc(ns, 1);
+    wf->DTrace3 = (uint8_t*)calloc(ns, 1);
+    wf->DTrace4 = (uint8_t*)calloc(ns, 1);
+    *waveforms = wf;
+    *allocatedSize = (uint32_t)(sizeof(CAEN_DGTZ_DPP_PSD_Waveforms_t) + ns * 8);
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_FreeDPPWaveforms(int handle, void *Waveforms){
+  CAEN_DGTZ_DPP_PSD_Waveforms_t *wf = (CAEN_DGTZ_DPP_PSD_Waveforms_t*)Waveforms;
+    (void)handle;
+    if (wf == NULL)
+      return CAEN_DGTZ_Success;
+    free(wf->Trace1);
+    free(wf->Trace2);
+    free(wf->DTrace1);
+    free(wf->DTrace2);
+    free(wf->DTrace3);
+    free(wf->DTrace4);
+    free(wf);
+  return CAEN_DGTZ_Success;
+}
+
+/* Only the analog trace of the input is decoded */
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_DecodeDPPWaveforms(int handle, void *event, void *waveforms){
+  CAEN_DGTZ_DPP_PSD_Event_t *ev = (CAEN_DGTZ_DPP_PSD_Event_t*)event;
+  CAEN_DGTZ_DPP_PSD_Waveforms_t *wf = (CAEN_DGTZ_DPP_PSD_Waveforms_t*)waveforms;
+  uint32_t i, ns = (ev->Format & 0xFFFF) * 8;
+    (void)handle;
+    wf->Ns = (ev->Waveforms != NULL) ? ns : 0;
+    wf->dualTrace = 0;
+    for (i = 0; i < wf->Ns; i += 2){
+      wf->Trace1[i] = (uint16_t)(ev->Waveforms[i / 2] & 0xFFF);
+      wf->Trace1[i + 1] = (uint16_t)((ev->Waveforms[i / 2] >> 16) & 0xFFF);
+    }
+  return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetInterruptConfig(int handle, CAEN_DGTZ_EnaDis_t state, uint8_t level, uint32_t status_id, uint16_t event_number, CAEN_DGTZ_IRQMode_t mode){
+  emuBoard_t *bd = getBoard(handle);
+    (void)level; (void)status_id; (void)mode;
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    bd->irqEnabled = (state == CAEN_DGTZ_ENABLE);
+    bd->irqAggregates = (event_number > 0) ? event_number : 1;
+  return CAEN_DGTZ_Success;
+}
+
+/* Waits until the board holds 'irqAggregates' full channel aggregates, or
+ * for 'timeout' milliseconds.
+ */
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_IRQWait(int handle, uint32_t timeout){
+  emuBoard_t *bd = getBoard(handle);
+  uint64_t now, deadline;
+  uint32_t aggregates;
+  struct timespec pause = { 0, EMU_IRQ_POLL_NS };
+  register int ch;
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    if (!bd->irqEnabled)
+      return CAEN_DGTZ_InterruptNotConfigured;
+    deadline = nowNs() + (uint64_t)timeout * 1000000ull;
+    for (;;){
+      now = nowNs();
+      if (bd->started)
+        generateEvents(bd, (uint64_t)((double)(now - bd->startNs) * settings.speed / EMU_SAMPLE_NS));
+      aggregates = 0;
+      for (ch = 0; ch < EMU_CHANNELS; ch++)
+        aggregates += bd->count[ch] / aggregateEvents(bd);
+      if (aggregates >= bd->irqAggregates)
+        return CAEN_DGTZ_Success;
+      if (now >= deadline)
+        return CAEN_DGTZ_Timeout;
+      nanosleep(&pause, NULL);
+    }
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SWStartAcquisition(int handle){
+  emuBoard_t *bd = getBoard(handle);
+  double singlesRate = settings.rate * (1.0 - settings.coincFraction);
+  register int ch;
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    bd->started = 1;
+    bd->startNs = nowNs();
+    bd->generatedTo = 0;
+    bd->aggrCounter = 0;
+    bd->nextCorrelated = exponentialInterval(bd, settings.rate * settings.coincFraction / settings.efficiency + 1e-9);
+    for (ch = 0; ch < EMU_CHANNELS; ch++){
+      bd->nextSingle[ch] = exponentialInterval(bd, singlesRate + 1e-9);
+      bd->hasLast[ch] = 0;
+      bd->head[ch] = bd->count[ch] = 0;
+      bd->lost[ch] = 0;
+      bd->totalTriggers[ch] = bd->lostTriggers[ch] = 0;
+    }
+  return CAEN_DGTZ_Success;
+}
+
+/* The events generated up to the stop stay in the board memory and can
+   still be read */
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SWStopAcquisition(int handle){
+  emuBoard_t *bd = getBoard(handle);
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    if (bd->started){
+      generateEvents(bd, (uint64_t)((double)(nowNs() - bd->startNs) * settings.speed / EMU_SAMPLE_NS));
+      bd->started = 0;
+    }
+  return CAEN_DGTZ_Success;
+}
+
+/* Fills 'buffer' with board aggregates of the events in the board memory, up
+ * to EMU_READOUT_BUFFER_SIZE bytes.
+ */
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_ReadData(int handle, CAEN_DGTZ_ReadMode_t mode, char *buffer, uint32_t *bufferSize){
+  emuBoard_t *bd = getBoard(handle);
+  uint32_t *w = (uint32_t*)buffer;
+  uint32_t pnt = 0, boardStart, chStart, maxWords = EMU_READOUT_BUFFER_SIZE / 4;
+  uint32_t evWords, ns, aggr, n, i, s, chMask, format, charge;
+  emuEvent_t *ev;
+  int ch, pending, extras, triggers;
+    (void)mode;
+    if (bd == NULL)
+      return CAEN_DGTZ_InvalidHandle;
+    if (bd->started)
+      generateEvents(bd, (uint64_t)((double)(nowNs() - bd->startNs) * settings.speed / EMU_SAMPLE_NS));
+
+    ns = samplesPerEvent(bd);
+    evWords = eventWords(bd);
+    aggr = aggregateEvents(bd);
+    extras = extrasEnabled(bd);
+    format = (1u << 30) | (1u << 29) | (extras ? (1u << 28) : 0) | (ns ? (1u << 27) : 0) | (ns / 8);
+    for (;;){
+      /* one board aggregate with up to 'aggr' events for each channel */
+      pending = 0;
+      chMask = 0;
+      for (ch = 0; ch < EMU_CHANNELS; ch++){
+        if(  bd->started ? (bd->count[ch] >= aggr) : (bd->count[ch] > 0)  )
+          pending = 1;
+      }
+      if(  !pending || (maxWords - pnt < 4 + 2 + evWords)  )
+        break;
+      boardStart = pnt;
+      pnt += 4;
+      for (ch = 0; ch < EMU_CHANNELS; ch++){
+        n = bd->count[ch];
+        if (n > aggr)
+          n = aggr;
+        else if(  bd->started && (n < aggr)  )
+          n = 0;
+        if (maxWords - pnt < 2 + evWords)
+          n = 0;
+        else if (n > (maxWords - pnt - 2) / evWords)
+          n = (maxWords - pnt - 2) / evWords;
+        if (n == 0)
+          continue;
+        chMask |= 1u << ch;
+        triggers = (((registerValue(bd, 0x1084 + 0x100 * (uint32_t)ch) >> 8) & 0x7) == 0x4);
+        chStart = pnt;
+        w[pnt + 1] = format;
+        pnt += 2;
+        for (i = 0; i < n; i++){
+          ev = &bd->memory[ch][bd->head[ch]];
+          bd->head[ch] = (bd->head[ch] + 1) % EMU_MEMORY_EVENTS;
+          w[pnt++] = (uint32_t)(ev->time & EMU_TIMETAG_MASK);
+          for (s = 0; s < ns; s += 2){
+            // negative pulse on the baseline from the trigger on (after the pre-trigger)
+            w[pnt++] = (EMU_BASELINE - pulseSample(bd, ev, s)) | ((uint32_t)(EMU_BASELINE - pulseSample(bd, ev, s + 1)) << 16);
+          }
+          if (extras)
+            w[pnt++] = triggers ? ev->triggers : (uint32_t)(EMU_BASELINE * 4) << 16 | (uint32_t)((ev->time >> 31) & 0xFFFF);
+          charge = ((uint32_t)ev->qlong << 16) | (ev->pur ? 0x8000u : 0) | (ev->qshort & 0x7FFFu);
+          w[pnt++] = charge;
+        }
+        bd->count[ch] -= n;
+        w[chStart] = 0x80000000u | (pnt - chStart);
+      }
+      w[boardStart] = 0xA0000000u | (pnt - boardStart);
+      w[boardStart + 1] = ((uint32_t)handle << 27) | chMask;
+      w[boardStart + 2] = bd->aggrCounter++ & 0x7FFFFF;
+      w[boardStart + 3] = (uint32_t)(bd->generatedTo & EMU_TIMETAG_MASK);
+    }
+    *bufferSize = pnt * 4;
+  return CAEN_DGTZ_Success;
+}
+
+/* Unpacks the events of the board aggregates in 'buffer' into the arrays of
+ * 'events' (one for each channel of the board).
+ */
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_GetDPPEvents(int handle, char *buffer, uint32_t buffsize, void **events, uint32_t *numEventsArray){
+  uint32_t *w = (uint32_t*)buffer;
+  uint32_t numWords = buffsize / 4, pnt = 0, boardEnd, chEnd, format, evWords, chMask;
+  CAEN_DGTZ_DPP_PSD_Event_t *ev;
+  register int ch;
+    (void)handle;
+    for (ch = 0; ch < EMU_CHANNELS; ch++)
+      numEventsArray[ch] = 0;
+    while (pnt < numWords){
+      if (((w[pnt] >> 28) & 0xF) != 0xA)
+        return CAEN_DGTZ_InvalidEvent;
+      boardEnd = pnt + (w[pnt] & 0x0FFFFFFF);
+      chMask = w[pnt + 1] & 0xFF;
+      if (boardEnd > numWords)
+        return CAEN_DGTZ_InvalidEvent;
+      pnt += 4;
+      for (ch = 0; ch < EMU_CHANNELS; ch++){
+        if (!(chMask & (1u << ch)))
+          continue;
+        chEnd = pnt + (w[pnt] & 0x003FFFFF);
+        format = w[pnt + 1];
+        evWords = 1 + (((format >> 27) & 1) ? (format & 0xFFFF) * 4 : 0) + ((format >> 28) & 1) + ((format >> 30) & 1);
+        if (chEnd > boardEnd)
+          return CAEN_DGTZ_InvalidEvent;
+        for (pnt += 2; pnt + evWords <= chEnd; pnt += evWords){
+          ev = &((CAEN_DGTZ_DPP_PSD_Event_t*)events[ch])[numEventsArray[ch]++];
+          ev->Format = format;
+          ev->TimeTag = w[pnt] & EMU_TIMETAG_MASK;
+          ev->Waveforms = ((format >> 27) & 1) ? &w[pnt + 1] : NULL;
+          ev->Extras = ((format >> 28) & 1) ? w[pnt + evWords - 1 - ((format >> 30) & 1)] : 0;
+          ev->Baseline = (int16_t)((ev->Extras >> 16) / 4);
+          if ((format >> 30) & 1){
+            ev->ChargeShort = (int16_t)(w[pnt + evWords - 1] & 0x7FFF);
+            ev->ChargeLong = (int16_t)(w[pnt + evWords - 1] >> 16);
+            ev->Pur = (int16_t)((w[pnt + evWords - 1] >> 15) & 1);
+          }
+          else
+            ev->ChargeShort = ev->ChargeLong = ev->Pur = 0;
+        }
+        pnt = chEnd;
+      }
+      pnt = boardEnd;
+    }
+  return CAEN_DGTZ_Success;
+}
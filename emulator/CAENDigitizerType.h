@@ -0,0 +1,209 @@
+/* Types of the CAENDigitizer library (Rel. 2.6.8) used by the acquisition
+ * program, as provided by the digitizer emulator (see CAENDigitizerEmulator.c).
+ * The names, the values and the layouts are those of the CAEN headers, so
+ * that the program builds unchanged against the emulator or the real library.
+ * Only the subset used by the program is defined.
+ *
+ * 'CAENDigitizerEmulator' version: a0.1
+ */
+
+#ifndef __CAENDIGITIZERTYPE_H
+  #define __CAENDIGITIZERTYPE_H
+  #include <stdint.h>
+
+  #define MAX_DPP_PSD_CHANNEL_SIZE 8
+  #define MAX_LICENSE_LENGTH 17
+
+  typedef enum CAEN_DGTZ_ErrorCode
+  {
+    CAEN_DGTZ_Success = 0,
+    CAEN_DGTZ_CommError = -1,
+    CAEN_DGTZ_GenericError = -2,
+    CAEN_DGTZ_InvalidParam = -3,
+    CAEN_DGTZ_InvalidLinkType = -4,
+    CAEN_DGTZ_InvalidHandle = -5,
+    CAEN_DGTZ_MaxDevicesError = -6,
+    CAEN_DGTZ_BadBoardType = -7,
+    CAEN_DGTZ_BadInterruptLev = -8,
+    CAEN_DGTZ_BadEventNumber = -9,
+    CAEN_DGTZ_ReadDeviceRegisterFail = -10,
+    CAEN_DGTZ_WriteDeviceRegisterFail = -11,
+    CAEN_DGTZ_InvalidChannelNumber = -13,
+    CAEN_DGTZ_ChannelBusy = -14,
+    CAEN_DGTZ_FPIOModeInvalid = -15,
+    CAEN_DGTZ_WrongAcqMode = -16,
+    CAEN_DGTZ_FunctionNotAllowed = -17,
+    CAEN_DGTZ_Timeout = -18,
+    CAEN_DGTZ_InvalidBuffer = -19,
+    CAEN_DGTZ_EventNotFound = -20,
+    CAEN_DGTZ_InvalidEvent = -21,
+    CAEN_DGTZ_OutOfMemory = -22,
+    CAEN_DGTZ_CalibrationError = -23,
+    CAEN_DGTZ_DigitizerNotFound = -24,
+    CAEN_DGTZ_DigitizerAlreadyOpen = -25,
+    CAEN_DGTZ_DigitizerNotReady = -26,
+    CAEN_DGTZ_InterruptNotConfigured = -27,
+    CAEN_DGTZ_DigitizerMemoryCorrupted = -28,
+    CAEN_DGTZ_DPPFirmwareNotSupported = -29,
+    CAEN_DGTZ_NotYetImplemented = -99
+  } CAEN_DGTZ_ErrorCode;
+
+  typedef enum
+  {
+    CAEN_DGTZ_USB = 0,
+    CAEN_DGTZ_OpticalLink = 1
+  } CAEN_DGTZ_ConnectionType;
+
+  typedef enum
+  {
+    CAEN_DGTZ_IOLevel_NIM = 0L,
+    CAEN_DGTZ_IOLevel_TTL = 1L
+  } CAEN_DGTZ_IOLevel_t;
+
+  typedef enum
+  {
+    CAEN_DGTZ_PulsePolarityPositive = 0,
+    CAEN_DGTZ_PulsePolarityNegative = 1
+  } CAEN_DGTZ_PulsePolarity_t;
+
+  typedef enum
+  {
+    CAEN_DGTZ_DPP_ACQ_MODE_Oscilloscope = 0L,
+    CAEN_DGTZ_DPP_ACQ_MODE_List = 1L,
+    CAEN_DGTZ_DPP_ACQ_MODE_Mixed = 2L
+  } CAEN_DGTZ_DPP_AcqMode_t;
+
+  typedef enum
+  {
+    CAEN_DGTZ_DPP_SAVE_PARAM_EnergyOnly = 0L,
+    CAEN_DGTZ_DPP_SAVE_PARAM_TimeOnly = 1L,
+    CAEN_DGTZ_DPP_SAVE_PARAM_EnergyAndTime = 2L,
+    CAEN_DGTZ_DPP_SAVE_PARAM_None = 3L,
+    CAEN_DGTZ_DPP_SAVE_PARAM_ChargeAndTime = 4L
+  } CAEN_DGTZ_DPP_SaveParam_t;
+
+  typedef enum
+  {
+    CAEN_DGTZ_SW_CONTROLLED = 0L,
+    CAEN_DGTZ_S_IN_CONTROLLED = 1L,
+    CAEN_DGTZ_FIRST_TRG_CONTROLLED = 2L
+  } CAEN_DGTZ_AcqMode_t;
+
+  typedef enum
+  {
+    CAEN_DGTZ_TRGMODE_DISABLED = 0,
+    CAEN_DGTZ_TRGMODE_EXTOUT_ONLY = 2,
+    CAEN_DGTZ_TRGMODE_ACQ_ONLY = 1,
+    CAEN_DGTZ_TRGMODE_ACQ_AND_EXTOUT = 3
+  } CAEN_DGTZ_TriggerMode_t;
+
+  typedef enum
+  {
+    CAEN_DGTZ_RUN_SYNC_Disabled = 0,
+    CAEN_DGTZ_RUN_SYNC_TrgOutTrgInDaisyChain = 1,
+    CAEN_DGTZ_RUN_SYNC_TrgOutSinDaisyChain = 2,
+    CAEN_DGTZ_RUN_SYNC_SinFanout = 3,
+    CAEN_DGTZ_RUN_SYNC_GpioGpioDaisyChain = 4
+  } CAEN_DGTZ_RunSyncMode_t;
+
+  typedef enum
+  {
+    CAEN_DGTZ_DPP_TriggerConfig_Peak = 0L,
+    CAEN_DGTZ_DPP_TriggerConfig_Threshold = 1L
+  } CAEN_DGTZ_DPP_TriggerConfig_t;
+
+  typedef enum
+  {
+    CAEN_DGTZ_DPP_PSD_PUR_DetectOnly = 0,
+    CAEN_DGTZ_DPP_PSD_PUR_Enabled = 1
+  } CAEN_DGTZ_DPP_PUR_t;
+
+  typedef enum
+  {
+    CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT = 0,
+    CAEN_DGTZ_SLAVE_TERMINATED_READOUT_2eVME = 1,
+    CAEN_DGTZ_SLAVE_TERMINATED_READOUT_2eSST = 2,
+    CAEN_DGTZ_POLLING_MBLT = 3,
+    CAEN_DGTZ_POLLING_2eVME = 4,
+    CAEN_DGTZ_POLLING_2eSST = 5
+  } CAEN_DGTZ_ReadMode_t;
+
+  typedef enum
+  {
+    CAEN_DGTZ_ENABLE = 1,
+    CAEN_DGTZ_DISABLE = 0
+  } CAEN_DGTZ_EnaDis_t;
+
+  typedef enum
+  {
+    CAEN_DGTZ_IRQ_MODE_RORA = 0L,
+    CAEN_DGTZ_IRQ_MODE_ROAK = 1L
+  } CAEN_DGTZ_IRQMode_t;
+
+  typedef struct
+  {
+    char ModelName[12];
+    uint32_t Model;
+    uint32_t Channels;
+    uint32_t FormFactor;
+    uint32_t FamilyCode;
+    char ROC_FirmwareRel[20];
+    char AMC_FirmwareRel[40];
+    uint32_t SerialNumber;
+    char MezzanineSerNum[4][8];
+    uint32_t PCB_Revision;
+    uint32_t ADC_NBits;
+    uint32_t SAMCorrectionDataLoaded;
+    int CommHandle;
+    int VMEHandle;
+    char License[MAX_LICENSE_LENGTH];
+  } CAEN_DGTZ_BoardInfo_t;
+
+  typedef struct
+  {
+    int blthr;
+    int bltmo;
+    int trgho;
+    int thr[MAX_DPP_PSD_CHANNEL_SIZE];
+    int selft[MAX_DPP_PSD_CHANNEL_SIZE];
+    int csens[MAX_DPP_PSD_CHANNEL_SIZE];
+    int sgate[MAX_DPP_PSD_CHANNEL_SIZE];
+    int lgate[MAX_DPP_PSD_CHANNEL_SIZE];
+    int pgate[MAX_DPP_PSD_CHANNEL_SIZE];
+    int tvaw[MAX_DPP_PSD_CHANNEL_SIZE];
+    int nsbl[MAX_DPP_PSD_CHANNEL_SIZE];
+    int discr[MAX_DPP_PSD_CHANNEL_SIZE];
+    int cfdf[MAX_DPP_PSD_CHANNEL_SIZE];
+    int cfdd[MAX_DPP_PSD_CHANNEL_SIZE];
+    CAEN_DGTZ_DPP_TriggerConfig_t trgc[MAX_DPP_PSD_CHANNEL_SIZE];
+    CAEN_DGTZ_DPP_PUR_t purh;
+    int purgap;
+  } CAEN_DGTZ_DPP_PSD_Params_t;
+
+  typedef struct
+  {
+    uint32_t Format;
+    uint32_t TimeTag;
+    int16_t ChargeShort;
+    int16_t ChargeLong;
+    int16_t Baseline;
+    int16_t Pur;
+    uint32_t *Waveforms;
+    uint32_t Extras;
+  } CAEN_DGTZ_DPP_PSD_Event_t;
+
+  typedef struct
+  {
+    uint32_t Ns;
+    uint8_t dualTrace;
+    uint8_t anlgProbe;
+    uint8_t dgtProbe1;
+    uint8_t dgtProbe2;
+    uint16_t *Trace1;
+    uint16_t *Trace2;
+    uint8_t *DTrace1;
+    uint8_t *DTrace2;
+    uint8_t *DTrace3;
+    uint8_t *DTrace4;
+  } CAEN_DGTZ_DPP_PSD_Waveforms_t;
+#endif
@@ -35,6 +35,35 @@
     #include <sys/time.h>
 #endif
 
+// Max number of connected boards (the actual number is set by the 'BoardConfigs' readout option)
+#define MAXNB   8
+// NB: the following define MUST specify the ACTUAL max allowed number of board's channels
+// it is needed for consistency inside the CAENDigitizer's functions used to allocate the memory
+#define MaxNChannels 4
+
+#define MAXNBITS 12
+// Samples of the traces before the trigger (see ProgramDigitizer)
+#define PRE_TRIGGER_SIZE 18
+// Registers of the extras word of the events (see ProgramDigitizer): the bit 17 of the Board Configuration
+// enables it, set through the bit-set register of the Board Configuration (0x8004). With the x720 DPP-PSD
+// firmware the extras word holds the baseline x 4 and the extended time stamp
+#define REG_BOARD_CONFIGURATION_SET 0x8004
+#define BOARD_CONFIGURATION_EXTRAS (1u << 17)
+// The option 4 in the bits [10:8] of the DPP Algorithm Control 2 of each channel puts the lost/total trigger
+// counters in the extras word instead. This layout comes from the DPP-PSD register map of the newer CAEN boards
+// and has not been checked against the x720 one: the option is only written on an AMC firmware release of at
+// least EXTRAS_OPTION_MIN_AMC_FW (major x 1000 + minor, e.g. 131006 for 131.6) and the TRIGGER_COUNTERS
+// 'Extras' readout option is refused otherwise. 0 (the default) refuses it on every release: define it at
+// build time once the layout is checked on the board
+#ifndef EXTRAS_OPTION_MIN_AMC_FW
+#define EXTRAS_OPTION_MIN_AMC_FW 0
+#endif
+#define REG_DPP_ALGORITHM_CONTROL2(ch) (0x1084 + 0x100 * (ch))
+#define DPP_EXTRAS_OPTION_MASK (0x7u << 8)
+#define DPP_EXTRAS_OPTION_TRIGGERS (0x4u << 8)  /* [31:16] lost triggers, [15:0] total triggers */
+// Max length of the name of a histogram file (see SaveHistogram)
+#define MAX_HISTO_FILENAME 300
+
 typedef struct
 {
     CAEN_DGTZ_ConnectionType LinkType;
@@ -72,6 +101,13 @@ int DataConsistencyCheck(uint32_t *buff32, int NumWords);
 
 int SaveHistogram(char *basename, int b, int ch, uint32_t *EHisto);
 
+/* --------------------------------------------------------------------------------------------------------- */
+/*! \fn      SaveHistogram2D(char *basename, int b, int ch, uint32_t *EHisto, int nbins)
+*   \brief   Save a 2D Histogram to output file
+*   \return  0=success; -1=error */
+/* --------------------------------------------------------------------------------------------------------- */
+int SaveHistogram2D(char *basename, int b, int ch, uint32_t *EHisto, int nbins);
+
 /* --------------------------------------------------------------------------------------------------------- */
 /*! \fn      SaveWaveforms(int b, int ch, int trace, int size, int16_t *WaveData)
 *   \brief   Save Waveforms to output file
@@ -0,0 +1,439 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ * CAEN library version: Rel. 2.6.8  - Nov 2015
+ *
+ * The module 'acqPipeline' decouples the digitizer readout from the decoding
+ * of the events and from the disk writes. The threads are chained:
+ *
+ *   readout board 0 --(raw ring 0)--+
+ *   readout board 1 --(raw ring 1)--+--> decode --(out ring)--> writer
+ *   ...                             |
+ *   readout board n --(raw ring n)--+
+ *
+ * - each board has its own readout thread, its own pool of readout buffers
+ *   and its own rings: the thread only calls CAEN_DGTZ_ReadData() on its
+ *   board into one of the pre-allocated buffers and hands the filled buffer
+ *   to the decode stage. The boards are read concurrently: a readout never
+ *   waits for the readout of another board. Between two reads the thread
+ *   waits according to the 'ReadoutPolicy' readout option: not at all
+ *   (BUSY), for a pause that grows after the empty reads and shrinks as the
+ *   reads return more data (ADAPTIVE), or for the interrupt the board raises
+ *   when 'IrqThreshold' aggregates are ready (IRQ, CAEN_DGTZ_IRQWait()).
+ *   At the end of the run each readout thread stops the acquisition of its
+ *   board and keeps reading it until it is empty (the drain): the events
+ *   stored in the board memory at the stop go through the pipeline like the
+ *   others and are counted. The drain is bounded by ACQ_DRAIN_TIMEOUT_MS;
+ * - the decode thread takes the filled buffers of the boards in turn,
+ *   unpacks the events of each buffer into psdEvent_t records with the
+ *   decoder selected by the 'Decoder' readout option (see psdDecoder.h and
+ *   readoutOptions.h), formats them into large output blocks (text lines or,
+ *   with the BINARY 'OutputFormat', the records themselves) and gives the
+ *   readout buffer back to the readout thread of its board. The records keep
+ *   the index of their board; in the text lines the channels of board b are
+ *   numbered b*8+ch (see RUN_FILE_TEXT_CHANNEL in runFile.h). With the
+ *   'MergeWindow' readout option the records of each channel are pushed into
+ *   the time merge (see timeMerge.h) instead, and the records it pops, in
+ *   time order across all the channels and boards, are formatted; at the end
+ *   of the run the records still pending are flushed. The boards are not
+ *   synchronized (CAEN_DGTZ_RUN_SYNC_Disabled, started one after the other):
+ *   the order across the boards is only right with a synchronized clock and
+ *   run start; a warning is printed when several boards are merged. With the
+ *   'CoincWindow' readout option the records popped from the merge also go
+ *   through the online coincidences of the TDCR PMTs (see tdcrCoinc.h), after
+ *   the dead time imposed by the 'DeadTime' readout options if any (see
+ *   tdcrDeadTime.h). With the 'CoincFilter' readout option only the records
+ *   of the coincidences, and one single out of 'SinglesPrescale', are
+ *   formatted (see tdcrFilter.h); the singles dropped are counted. With the
+ *   'CoincScan' readout option the coincidences are also counted for a list
+ *   of resolving times, in the same pass (see tdcrScan.h), on the same
+ *   records as the online coincidences. With the 'Histograms' readout option
+ *   the records of each channel are also added to its spectra (see
+ *   psdHisto.h). With the TRIGGER_COUNTERS 'Extras' the decoder also adds up
+ *   the lost and total triggers counted by the board (see psdDecoder.h),
+ *   copied for the other threads after each buffer.
+ *   Nothing is printed while the buffers are decoded: the rollovers of the
+ *   time tag of each channel, and those the decoder added after checking the
+ *   time against the time of the readout of the buffer (CLOCK_MONOTONIC from
+ *   the start of the readout threads, see psdDecoderSetClock()), are only
+ *   counted;
+ * - the writer thread puts the output blocks on disk through the run writer
+ *   (see runWriter.h) and gives them back to the decode thread. The output
+ *   is split into segments only between two blocks.
+ *
+ * With the 'Waveforms' readout option the samples of the events (Mixed and
+ * Oscilloscope modes) take a path of their own: the decode thread copies the
+ * samples of each event, as the buffer is decoded, into a waveform record
+ * (see runFile.h) in large wave blocks (with DECODER_LIBRARY the samples are
+ * unpacked by CAEN_DGTZ_DecodeDPPWaveforms()) and keeps the offset of each
+ * record; a wave thread puts the wave blocks on disk through a second run
+ * writer, and writes the index of the records at the end of the run. The
+ * traces are in readout order; each record carries the record of its event
+ * (board, channel, timestamp, charges). With the 'SoftwareCharge' readout
+ * option the decode thread also integrates the charges of the traces it
+ * copies, in batches of PSD_CHARGE_BATCH with the SIMD path of psdCharge.h
+ * and the gates of the DPP parameters of their channel, and compares them
+ * with the charges of the firmware (see printAcqChargeStats()). With the
+ * 'CfdDelay' readout option the fine time of the events is measured on the
+ * same batches with the CFD of psdCfd.h and set in the records of the
+ * events (see psdEvent.h) and of their traces, before the records are
+ * formatted or pushed into the time merge: the online coincidences use it.
+ *
+ * With the RAW 'OutputFormat' there is no decode stage: the writer thread
+ * takes the readout buffers from the raw rings and writes each of them
+ * verbatim in a frame tagged with its board (see runFile.h); only the
+ * aggregate headers are read to count the events of each channel.
+ *
+ * Every hand-over goes through a single-producer/single-consumer lock-free
+ * ring (see spscRing.h): each buffer travels on a 'full' ring towards the next
+ * stage and comes back on a 'free' ring. A disk stall therefore only fills the
+ * rings: the readout thread keeps servicing the board until the whole pool
+ * of its board is in use.
+ * For each stage the module keeps the number of blocks and bytes processed,
+ * the number of stalls (the stage had to wait for a free block) and the number
+ * of idle polls (the input ring was empty); for each readout stage also the
+ * number of waits, the CPU time of its thread and the longest time between
+ * two reads that returned data, that bounds how long the data waited in the
+ * board. Together with the occupancy and the high-water mark of the rings
+ * they are displayed by printAcqPipelineStats().
+ * The duration of each step of a buffer is timed with CLOCK_MONOTONIC and
+ * recorded into a latency histogram (see latencyHisto.h) by the thread of the
+ * step: the CAEN_DGTZ_ReadData() calls that returned data (one histogram for
+ * each board), the decoding, the filling of the spectra, the time merge and
+ * the formatting of the records ("format"), the software charges and fine
+ * times ("charge", timed apart from "decode") and the writes of the output
+ * blocks or frames (with the rotation of the segments). Their percentiles are
+ * printed by printAcqPipelineLatency().
+ * The spectra are filled by the decode thread only: the main thread asks for
+ * a snapshot (requestAcqHistoSnapshot()), the decode thread copies the
+ * spectra into their snapshot between two readout buffers and hands it over
+ * (acqHistoSnapshotReady()); the main thread saves the snapshot then gives
+ * it back (releaseAcqHistoSnapshot()).
+ * With the 'DecoderCheck' readout option each buffer is decoded by all the
+ * decoders and the records of the in-tree decoders are compared with those
+ * converted from CAEN_DGTZ_GetDPPEvents(); the buffers that don't match are
+ * counted and the first mismatch is described on stdout.
+ *
+ * 'acqPipeline' module version: a0.23
+ */
+
+#ifndef _ACQ_PIPELINE
+  #define _ACQ_PIPELINE
+  #include <stdio.h>
+  #include <stdint.h>
+  #include <stdatomic.h>
+  #include <pthread.h>
+  #include <CAENDigitizerType.h>
+  #include "Functions.h"
+  #include "spscRing.h"
+  #include "psdDecoder.h"
+  #include "psdCharge.h"
+  #include "psdCfd.h"
+  #include "readoutOptions.h"
+  #include "timeMerge.h"
+  #include "tdcrCoinc.h"
+  #include "tdcrDeadTime.h"
+  #include "tdcrFilter.h"
+  #include "tdcrScan.h"
+  #include "psdHisto.h"
+  #include "runWriter.h"
+  #include "latencyHisto.h"
+
+  /* number of readout buffers in the pool (power of 2) */
+  #define ACQ_RAW_BLOCKS 16
+  /* number of output blocks in the pool (power of 2) */
+  #define ACQ_OUT_BLOCKS 16
+  /* size of each output block (bytes): a multiple of the record size and of
+     RUN_FILE_HEADER_SIZE, so that the binary writes stay block aligned */
+  #define ACQ_OUT_BLOCK_SIZE (4u << 20)
+  /* number of wave blocks in the pool (power of 2), each of
+     ACQ_OUT_BLOCK_SIZE bytes */
+  #define ACQ_WAVE_BLOCKS 8
+  /* number of offsets first allocated for the index of the waveform records */
+  #define ACQ_TRACE_INDEX_INITIAL 65536
+  /* max number of records taken from the time merge at once */
+  #define ACQ_MERGE_CHUNK 65536
+  /* first pause of the ADAPTIVE readout policy after a read with data (us) */
+  #define ACQ_POLL_MIN_WAIT_US 50
+  /* longest drain of a board at the end of the run (ms) */
+  #define ACQ_DRAIN_TIMEOUT_MS 500
+  /* states of the histogram snapshot (acqPipeline_t.histoSnapshot) */
+  #define ACQ_SNAPSHOT_IDLE 0         /* owned by the decode thread */
+  #define ACQ_SNAPSHOT_REQUESTED 1    /* asked by the main thread */
+  #define ACQ_SNAPSHOT_READY 2        /* taken, owned by the main thread */
+
+  /* A buffer travelling along the pipeline */
+  typedef struct
+  {
+    char *data;
+    uint32_t size;          /* bytes filled */
+    uint32_t capacity;      /* bytes allocated */
+    int board;              /* index of the board the data comes from */
+    uint64_t stamp;         /* wall-clock time of the readout (ns since the Epoch) */
+    uint64_t readTime;      /* time of the readout (CLOCK_MONOTONIC, ns) */
+  } acqBlock_t;
+
+  /* Statistics of a pipeline stage */
+  typedef struct
+  {
+    atomic_ulong blocks;    /* blocks processed */
+    atomic_ulong bytes;     /* bytes processed */
+    atomic_ulong stalls;    /* times the stage had to wait for a free block */
+    atomic_ulong idles;     /* polls that found the input ring empty */
+  } acqStageStats_t;
+
+  struct acqPipeline_s;
+
+  /* Readout stage of a board */
+  typedef struct
+  {
+    struct acqPipeline_s *pipeline;
+    int board;                  /* index of the board in 'handle' and 'params' */
+    /* readout buffers: readout -> decode (or writer) on 'rawFull', back on
+       'rawFree' */
+    acqBlock_t rawBlocks[ACQ_RAW_BLOCKS];
+    spscRing_t rawFree, rawFull;
+    acqStageStats_t stats;
+    atomic_ulong waits;         /* pauses (ADAPTIVE) or interrupt waits (IRQ) */
+    atomic_ulong cpuNs;         /* CPU time used by the readout thread (ns) */
+    atomic_ulong maxGapNs;      /* longest time between two reads with data (ns) */
+    latencyHisto_t readLatency; /* CAEN_DGTZ_ReadData() calls that returned data */
+    atomic_ulong drainEvents;   /* events read after the stop of the board */
+    atomic_ulong drainBytes;    /* bytes read after the stop of the board */
+    atomic_int drainTimedOut;   /* the drain was cut by ACQ_DRAIN_TIMEOUT_MS */
+    atomic_int done;            /* set by the readout thread when it exits */
+    pthread_t thread;
+    int threadStarted;
+  } acqBoardReader_t;
+
+  typedef struct acqPipeline_s
+  {
+    /* configuration, set by initAcqPipeline() */
+    int numBoards;
+    int *handle;
+    DigitizerParams_t *params;
+    runWriter_t *out;           /* the output file (segments) */
+    int bitMask;
+    int decoder;                /* DECODER_LIBRARY / DECODER_SCALAR / DECODER_VECTOR */
+    int decoderCheck;
+    int outputFormat;           /* OUTPUT_TEXT / OUTPUT_BINARY / OUTPUT_RAW / OUTPUT_TEXT_NS */
+    int readoutPolicy;          /* READOUT_POLICY_BUSY / READOUT_POLICY_ADAPTIVE / READOUT_POLICY_IRQ */
+    unsigned long pollMaxWait;  /* us */
+    unsigned long irqTimeout;   /* ms */
+
+    /* readout stage of each board */
+    acqBoardReader_t readers[MAXNB];
+    /* output blocks: decode -> writer on 'outFull', back on 'outFree' */
+    acqBlock_t outBlocks[ACQ_OUT_BLOCKS];
+    spscRing_t outFree, outFull;
+
+    /* decode stage state: a decoder for each board and each decoding path
+       (indexed by DECODER_*); only the selected one is used unless
+       'decoderCheck' is set */
+    psdDecoder_t decoders[MAXNB][DECODER_COUNT];
+    CAEN_DGTZ_DPP_PSD_Event_t *events[MAXNB][MaxNChannels];   /* DECODER_LIBRARY */
+    uint32_t numEvents[MaxNChannels];
+    int extras;                 /* content of the extras word ('Extras' readout option, PSD_EXTRAS_*) */
+    /* time merge ('MergeWindow' > 0): the stream of the channel ch of the
+       board b is b*PSD_MAX_CHANNELS+ch */
+    int merge;
+    unsigned long mergeWindow;  /* us */
+    timeMerge_t timeMerge;
+    psdEvent_t *mergeOut;       /* ACQ_MERGE_CHUNK records popped from the merge */
+    /* TDCR coincidences ('CoincWindow' > 0, only with the time merge) */
+    int coincidence;
+    tdcrCoinc_t coinc;
+    /* dead time imposed before the coincidences ('DeadTime' readout options) */
+    int deadTime;
+    tdcrDeadTime_t dead;
+    psdEvent_t *deadOut;        /* the records of 'mergeOut' that pass the dead time */
+    /* write filter of the coincidences ('CoincFilter' readout option) */
+    int coincFilter;
+    tdcrFilter_t filter;
+    /* coincidences for a list of resolving times ('CoincScan' readout option) */
+    int coincScan;
+    tdcrScan_t scan;
+    /* spectra of each enabled channel ('Histograms' readout option) */
+    int histograms;
+    psdHisto_t histos[MAXNB][MaxNChannels];
+    /* waveforms ('Waveforms' readout option): decode -> wave thread on
+       'waveFull', back on 'waveFree' */
+    int waveforms;
+    runWriter_t *waveOut;       /* the waveform file */
+    CAEN_DGTZ_DPP_PSD_Waveforms_t *waves[MAXNB];  /* DECODER_LIBRARY */
+    acqBlock_t waveBlocks[ACQ_WAVE_BLOCKS];
+    spscRing_t waveFree, waveFull;
+    acqBlock_t *waveBlock;      /* the wave block being filled (decode thread) */
+    uint64_t *traceIndex;       /* offset of each waveform record */
+    uint64_t numTraces, traceCapacity;
+    uint64_t traceOffset;       /* offset of the next waveform record */
+    /* software charges ('SoftwareCharge' readout option) and fine times
+       ('CfdDelay' > 0): the traces of the channel 'chargeChannel' of the
+       board 'chargeBoard' waiting to be integrated, their event records in
+       the decoder and in the wave block, and the comparison with the
+       firmware of each channel */
+    int softwareCharge;
+    int cfd;
+    psdChargeGates_t chargeGates[MAXNB][MaxNChannels];
+    psdCfd_t cfds[MAXNB][MaxNChannels];
+    psdChargeTrace_t chargeTraces[PSD_CHARGE_BATCH];
+    psdEvent_t *chargeEvents[PSD_CHARGE_BATCH];
+    psdEvent_t *chargeRecords[PSD_CHARGE_BATCH];
+    psdCharge_t charges[PSD_CHARGE_BATCH];
+    int16_t fineTimes[PSD_CHARGE_BATCH];
+    uint32_t numCharges;
+    int chargeBoard, chargeChannel;
+    uint64_t chargeNs;          /* time spent on the charges of the current buffer */
+    psdChargeStats_t chargeStats[MAXNB][MaxNChannels];
+
+    /* statistics */
+    acqStageStats_t decodeStats, writerStats, waveStats;
+    atomic_ulong traces;        /* waveform records */
+    atomic_ulong fineEvents;    /* events with a fine time */
+    /* duration of the steps of each buffer (decode thread) and of each write
+       (writer thread) */
+    latencyHisto_t decodeLatency, histoLatency, formatLatency, writeLatency, chargeLatency;
+    atomic_ulong recordedEvents[MAXNB][MaxNChannels];
+    atomic_ulong boardTriggers[MAXNB][MaxNChannels];      /* triggers counted by the board (PSD_EXTRAS_TRIGGERS) */
+    atomic_ulong boardLostTriggers[MAXNB][MaxNChannels];  /* triggers the board couldn't store (PSD_EXTRAS_TRIGGERS) */
+    atomic_ulong rollovers[MAXNB][MaxNChannels];          /* rollovers of the time tag */
+    atomic_ulong missedRollovers[MAXNB][MaxNChannels];    /* rollovers added by the wall-clock check */
+    atomic_ulong decoderMismatches;     /* buffers with different records (decoderCheck) */
+    atomic_ulong mergePending, mergeMaxPending, mergeLate;    /* copies of the timeMerge_t counters */
+    atomic_ulong coincCounts[TDCR_NUM_COUNTS];                /* copies of the tdcrCoinc_t counters */
+    atomic_ulong deadRejected[TDCR_DEAD_STAGES];              /* copies of the tdcrDeadStage_t counters */
+    atomic_ulong deadLiveNs[TDCR_DEAD_STAGES];                /* live time of the dead time stages */
+    atomic_ulong filterCoincident[PSD_MAX_CHANNELS];          /* copies of the tdcrFilter_t counters */
+    atomic_ulong filterPrescaled[PSD_MAX_CHANNELS];
+    atomic_ulong filterSuppressed[PSD_MAX_CHANNELS];
+    atomic_ulong scanCounts[TDCR_SCAN_MAX_WINDOWS][TDCR_NUM_COUNTS];  /* counts of each resolving time of the scan */
+
+    /* control */
+    atomic_int stopReadout;     /* set by the main thread */
+    atomic_int drain;           /* set by the main thread at the end of the run */
+    atomic_int decodeDone;      /* set by the decode thread when it exits */
+    atomic_int error;           /* set by any stage on a fatal error */
+    atomic_int histoSnapshot;   /* ACQ_SNAPSHOT_* */
+    pthread_t decodeThread, writerThread, waveThread;
+    int threadsStarted;
+    int waveThreadStarted;
+    uint64_t startTime;         /* start of the readout threads (CLOCK_MONOTONIC, ns) */
+  } acqPipeline_t;
+
+  /* Allocates the readout buffers of each board
+   * (CAEN_DGTZ_MallocReadoutBuffer()), the decoders, the output blocks and the
+   * rings and, with the IRQ 'ReadoutPolicy', enables the interrupt of each
+   * board. Must be called after the digitizers are programmed.
+   *
+   * @param p the pipeline to initialize
+   * @param numBoards the number of boards in 'handle' and 'params'
+   * @param handle the handles of the opened digitizers
+   * @param params the parameters the digitizers were programmed with
+   * @param dppParams the DPP parameters the digitizers were programmed with
+   * (the gates of the software charges, the threshold of the CFD)
+   * @param options the readout options (see readoutOptions.h)
+   * @param out the already opened output file (see runWriter.h)
+   * @param waveOut the already opened waveform file (a run file of
+   * RUN_FILE_CONTENT_TRACES, see runFile.h), NULL if the samples are not
+   * written
+   * @param bitMask the mask applied to the charges written to 'out'
+   * @return 0 on success, -1 in case of error (a description is printed)
+   */
+  extern int initAcqPipeline(acqPipeline_t *p, int numBoards, int *handle, DigitizerParams_t *params, const CAEN_DGTZ_DPP_PSD_Params_t *dppParams,
+                             const ReadoutOptions_t *options, runWriter_t *out, runWriter_t *waveOut, int bitMask);
+  /* Starts the writer, wave, decode and readout threads (one readout thread
+   * for each board). The acquisition must already be started on the boards.
+   *
+   * @param p the pipeline to start
+   * @return 0 on success, -1 if a thread can't be created
+   */
+  extern int startAcqPipeline(acqPipeline_t *p);
+  /* Asks the readout threads to stop and waits until they exit. The data
+   * already read is still processed by the decode and writer stages, the
+   * data still in the boards is lost (see drainAcqReadout()).
+   *
+   * @param p the running pipeline
+   */
+  extern void stopAcqReadout(acqPipeline_t *p);
+  /* Ends the run: each readout thread stops the acquisition of its board
+   * (CAEN_DGTZ_SWStopAcquisition()) then reads the board until it is empty,
+   * for ACQ_DRAIN_TIMEOUT_MS at most, and exits. Waits until the readout
+   * threads exit; the data is then processed by the decode and writer
+   * stages (see finishAcqPipeline()).
+   *
+   * @param p the running pipeline
+   */
+  extern void drainAcqReadout(acqPipeline_t *p);
+  /* Waits until the decode and writer stages have processed all the pending
+   * blocks, then joins their threads. drainAcqReadout() or stopAcqReadout()
+   * must be called first.
+   *
+   * @param p the pipeline
+   * @return 0 on success, -1 if a stage reported an error
+   */
+  extern int finishAcqPipeline(acqPipeline_t *p);
+  /* Returns a non-zero integer if a stage reported a fatal error.
+   *
+   * @param p the pipeline
+   * @return 0 if no errors were reported, otherwise a non-zero integer
+   */
+  extern int acqPipelineError(acqPipeline_t *p);
+  /* Returns the number of bytes read from all the boards so far.
+   *
+   * @param p the pipeline
+   * @return the bytes read by the readout stages
+   */
+  extern unsigned long acqPipelineReadoutBytes(acqPipeline_t *p);
+  /* Asks the decode stage for a snapshot of the spectra (see psdHisto.h),
+   * unless a snapshot is already requested or not yet released.
+   *
+   * @param p the pipeline
+   */
+  extern void requestAcqHistoSnapshot(acqPipeline_t *p);
+  /* Returns a non-zero integer if the snapshot of the spectra is ready: the
+   * 'snapshot' of each psdHisto_t in 'histos' can be read until
+   * releaseAcqHistoSnapshot() is called. Once the pipeline is finished (see
+   * finishAcqPipeline()) the snapshot of the final spectra is taken here.
+   *
+   * @param p the pipeline
+   * @return non-zero if the snapshot is ready, otherwise 0
+   */
+  extern int acqHistoSnapshotReady(acqPipeline_t *p);
+  /* Gives the snapshot of the spectra back to the decode stage.
+   *
+   * @param p the pipeline
+   */
+  extern void releaseAcqHistoSnapshot(acqPipeline_t *p);
+  /* Prints the occupancy, high-water mark and stall counters of each stage,
+   * the readout stages one by one with the waits and the CPU load of their
+   * thread (and the decoder mismatches if
+   * 'DecoderCheck' is set, the pending and late records of the time merge if
+   * 'MergeWindow' is set). Only atomic counters are read: it can be called
+   * by any thread while the pipeline runs.
+   *
+   * @param p the pipeline
+   * @param fp where the statistics are printed
+   */
+  extern void printAcqPipelineStats(acqPipeline_t *p, FILE *fp);
+  /* Prints a table with the count, the mean, the 50th, 99th and 99.9th
+   * percentiles and the max duration (us) of each step of the pipeline that
+   * recorded values. Can be called by any thread while the pipeline runs.
+   *
+   * @param p the pipeline
+   * @param fp where the table is printed
+   */
+  extern void printAcqPipelineLatency(acqPipeline_t *p, FILE *fp);
+  /* Prints the comparison of the software charges with those of the
+   * firmware, one line for each enabled channel (see psdCharge.h). The
+   * pipeline must be finished.
+   *
+   * @param p the pipeline
+   * @param fp where the table is printed
+   * @return 0 on success, otherwise a non-zero integer
+   */
+  extern int printAcqChargeStats(acqPipeline_t *p, FILE *fp);
+  /* Frees the memory allocated by initAcqPipeline(). The threads must be
+   * stopped.
+   *
+   * @param p the pipeline
+   */
+  extern void freeAcqPipeline(acqPipeline_t *p);
+#endif
@@ -0,0 +1,64 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'latencyHisto' records durations (nanoseconds) into a histogram
+ * with HDR-style log-linear buckets: each value below 2 *
+ * LATENCY_SUB_BUCKETS ns has a bucket of its own, then every power of 2
+ * [2^k, 2^(k+1)) is split into LATENCY_SUB_BUCKETS buckets. A value is then
+ * known within 1/LATENCY_SUB_BUCKETS of itself (1.6%) over the whole 64-bit
+ * range, with LATENCY_BUCKETS counters and no configuration.
+ *
+ * Recording a value costs a count of the leading zeros, a shift and a few
+ * relaxed atomic loads and stores: each histogram has a single writer (the
+ * thread of the stage it measures), so no read-modify-write is needed, and
+ * any other thread can compute the percentiles while the values are
+ * recorded. The percentiles are given as the highest value of the bucket
+ * they fall into (never above the max recorded).
+ *
+ * 'latencyHisto' module version: a0.1
+ */
+
+#ifndef _LATENCY_HISTO
+  #define _LATENCY_HISTO
+  #include <stdint.h>
+  #include <stdatomic.h>
+
+  #define LATENCY_SUB_BITS 6
+  #define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+  #define LATENCY_BUCKETS ((65 - LATENCY_SUB_BITS) * LATENCY_SUB_BUCKETS)
+
+  typedef struct
+  {
+    atomic_ulong counts[LATENCY_BUCKETS];
+    atomic_ulong count;         /* values recorded */
+    atomic_ulong sum;           /* sum of the values (ns) */
+    atomic_ulong max;           /* largest value (ns) */
+  } latencyHisto_t;
+
+  /* The statistics of a histogram */
+  typedef struct
+  {
+    unsigned long count;
+    double mean;                /* ns */
+    uint64_t p50, p99, p999, max;   /* ns */
+  } latencySummary_t;
+
+  /* Sets all the counters of the histogram to 0. Must not be called while a
+   * value is recorded.
+   *
+   * @param h the histogram
+   */
+  extern void clearLatencyHisto(latencyHisto_t *h);
+  /* Records a duration. Only one thread may record into a histogram.
+   *
+   * @param h the histogram
+   * @param ns the duration (nanoseconds)
+   */
+  extern void latencyHistoRecord(latencyHisto_t *h, uint64_t ns);
+  /* Computes the count, the mean, the 50th, 99th, 99.9th percentiles and the
+   * max of a histogram. Can be called by any thread.
+   *
+   * @param h the histogram
+   * @param s the statistics
+   */
+  extern void latencyHistoSummary(latencyHisto_t *h, latencySummary_t *s);
+#endif
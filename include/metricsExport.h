@@ -0,0 +1,84 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'metricsExport' publishes the state of the acquisition for a
+ * monitoring system, in the Prometheus text exposition format (version
+ * 0.0.4): events and trigger rate of each channel, triggers counted and lost
+ * by the board (TRIGGER_COUNTERS 'Extras'), rollovers of the time tag added
+ * by the wall-clock check of the decoder, bytes and rate of the
+ * readout of each board, empty reads, occupancy and high-water mark of the
+ * rings, stalls of the stages, events recovered by the drain at the end of
+ * the run, late events of the time merge, decoder mismatches, bytes given to
+ * the output writer, TDCR coincidences, pulses rejected and live time of the
+ * imposed dead time, records written and singles dropped by the coincidence
+ * filter, coincidences of each resolving time of the scan and latency
+ * percentiles of the steps of the pipeline (see acqPipeline.h).
+ *
+ * Depending on the readout options the metrics are:
+ * - 'MetricsFile': written every METRICS_PERIOD_MS to a file, atomically (a
+ *   temporary file renamed over it), for the textfile collector of
+ *   node_exporter or any other reader;
+ * - 'MetricsPort': served over HTTP on 127.0.0.1:<port> (a Prometheus scrape
+ *   target);
+ * - 'MetricsSocket': served over HTTP on a UNIX-domain socket (e.g.
+ *   curl --unix-socket <path> http://localhost/metrics).
+ *
+ * Everything is done by a thread of its own, with the lowest scheduling
+ * priority (SCHED_IDLE where available), that only reads the atomic counters
+ * of the pipeline: the readout, decode and writer threads are not touched.
+ * The rates are computed by this thread over the last METRICS_PERIOD_MS.
+ *
+ * 'metricsExport' module version: a0.7
+ */
+
+#ifndef _METRICS_EXPORT
+  #define _METRICS_EXPORT
+  #include <stdint.h>
+  #include <stdatomic.h>
+  #include <pthread.h>
+  #include "acqPipeline.h"
+  #include "readoutOptions.h"
+
+  /* period of the rates and of the file updates (milliseconds) */
+  #define METRICS_PERIOD_MS 1000
+
+  typedef struct
+  {
+    /* configuration, set by startMetricsExport() */
+    acqPipeline_t *pipeline;
+    const char *fileName;       /* 'MetricsFile', "" if not used */
+    const char *socketName;     /* 'MetricsSocket', "" if not used */
+    int tcpFd, unixFd;          /* listening sockets, -1 if not used */
+    uint64_t startTime;         /* start of the acquisition (get_time(), ms) */
+
+    /* state of the metrics thread: the rates over the last period and the
+       counters they were computed from */
+    uint64_t prevTime;
+    unsigned long prevEvents[MAXNB][MaxNChannels];
+    unsigned long prevBytes[MAXNB];
+    double triggerRate[MAXNB][MaxNChannels];    /* Hz */
+    double readoutRate[MAXNB];                  /* bytes/s */
+
+    atomic_int stop;
+    pthread_t thread;
+    int started;
+  } metricsExport_t;
+
+  /* Opens the sockets and starts the metrics thread, if at least one of the
+   * options 'MetricsFile', 'MetricsPort' and 'MetricsSocket' is set. The
+   * pipeline must be started.
+   *
+   * @param m the export
+   * @param p the running pipeline
+   * @param options the readout options
+   * @param startTime the start of the acquisition (get_time(), ms)
+   * @return 0 on success (or if the export is not enabled), -1 in case of
+   * error (a description is printed to stderr)
+   */
+  extern int startMetricsExport(metricsExport_t *m, acqPipeline_t *p, const ReadoutOptions_t *options, uint64_t startTime);
+  /* Stops the metrics thread, writes the file a last time and closes the
+   * sockets.
+   *
+   * @param m the export
+   */
+  extern void stopMetricsExport(metricsExport_t *m);
+#endif
@@ -1,6 +1,6 @@
 /* DTT version: 5720 desktop (with DPP_PSD firmware)
  * CAEN library version: Rel. 2.6.8  - Nov 2015
- * 'myCAEN_DTT_config' module version: a0.4
+ * 'myCAEN_DTT_config' module version: a0.5
  *
  * The module 'myCAEN_DTT_config' offers a series of functions and data
  * structures to fill the CAEN DTT digitizer parameters 'dttParams', the
@@ -20,6 +20,9 @@
  * The exported function 'acquireParameterValues()' returns a code to inform the
  * caller if the user asked to quit the program or if the acquisition should be
  * started.
+ * With several digitizers the parameters of each additional board are read
+ * from its own configuration file, with the same syntax as "tdcr.ini", by
+ * 'acquireBoardParameterValues()' (no interactive editing).
  */
 
 #ifndef _MYCAEN_DTT_CONFIG
@@ -39,4 +42,17 @@
    * the acquisition
    */
   extern int acquireParameterValues(void);
+  /* Parses the configuration file of an additional board (same syntax as
+   * "tdcr.ini", the acquisition time and the readout options are ignored)
+   * without interactive editing. 'dttParams', 'dppParams', 'linkNum' and
+   * 'acqTime' are left unchanged.
+   *
+   * @param fileName the configuration file of the board
+   * @param boardDttParams where the DTT parameters of the board are stored
+   * @param boardDppParams where the DPP-PSD parameters of the board are stored
+   * @param boardLinkNum where the link number of the board is stored
+   * @return 0 in case of error (a description is printed to stderr), otherwise
+   * a non-zero integer
+   */
+  extern int acquireBoardParameterValues(const char *fileName, DigitizerParams_t *boardDttParams, CAEN_DGTZ_DPP_PSD_Params_t *boardDppParams, int *boardLinkNum);
 #endif
@@ -4,9 +4,9 @@
  * The module 'paramsHeaderToFile' offers a function that prints at the
  * beginning of a given FILE pointer a brief header containing a list of the
  * CAEN DTT/DPP-PSD parameter values, the digitizer's 'Link number' and the
- * acquisition time.
+ * acquisition time. The same header can be obtained as a string.
  *
- * 'paramsHeaderToFile' module version: a0.2
+ * 'paramsHeaderToFile' module version: a0.3
  */
 
 #ifndef _PARAMS_HEADER_TO_FILE
@@ -23,4 +23,12 @@
    * error is printed to stderr.
 	 */
 	extern int printParamsHeaderToFile(FILE *fpout);
+  /* Writes the header of printParamsHeaderToFile() into a new string (it is
+   * stored in the header of the binary run files).
+   *
+   * @param size where the length of the string is stored
+   * @return the string, to be released with free(), or NULL in case of error
+   * (a description of the error is printed to stderr)
+   */
+  extern char *printParamsHeaderToString(size_t *size);
 #endif
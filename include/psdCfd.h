@@ -0,0 +1,97 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'psdCfd' measures the time of the pulses of the events on their
+ * samples with a digital constant fraction discriminator, finer than the 4 ns
+ * of the time tag (see the fine time in psdEvent.h).
+ *
+ * With the pulse p (the samples minus the baseline, inverted for the negative
+ * polarity), the CFD signal is
+ *
+ *   c[i] = fraction * p[i] - p[i - delay]
+ *
+ * It grows with the leading edge of the pulse then crosses zero when the
+ * delayed pulse reaches 'fraction' of the pulse: a time that doesn't depend
+ * on the amplitude. From the first sample of the gates (see psdCharge.h) the
+ * CFD is armed when c exceeds fraction * threshold (p above the trigger
+ * threshold); the crossing is the first sample after it where c <= 0, and
+ * its time is interpolated linearly between this sample and the previous
+ * one.
+ * The fine time is the time of the crossing minus the trigger (the
+ * pre-trigger samples of the trace) minus 'delay', in 1/PSD_EVENT_FINE_UNITS
+ * of a sample: a correction to the time tag, with the constant delay of the
+ * CFD taken out. An event whose CFD doesn't cross, or crosses out of the range
+ * of the fine time (+-8 samples), gets PSD_CFD_NO_TIME.
+ *
+ * The CFD is computed for a batch of traces at once, from their baselines
+ * computed by psdCharge.h. Two paths are available and give the same fine
+ * times:
+ * - psdCfdScalar() is the reference path;
+ * - psdCfdVector() computes c on 8 samples at a time with SSE2 (the samples
+ *   and the delayed samples are interleaved and multiplied by the fixed point
+ *   coefficients with pmaddwd) and looks for the arming and the crossing in
+ *   the comparison masks. Without SSE2 it is the scalar path.
+ * The samples must be below 0x4000, as the 12 bit samples of psdDecoder.h
+ * (PSD_SAMPLE_MASK) are.
+ *
+ * 'psdCfd' module version: a0.2
+ */
+
+#ifndef _PSD_CFD
+  #define _PSD_CFD
+  #include <stdint.h>
+  #include "psdEvent.h"
+  #include "psdCharge.h"
+
+  /* fine time of an event without a crossing (or out of range) */
+  #define PSD_CFD_NO_TIME INT16_MIN
+  /* fraction of the CFD in fixed point: 1/PSD_CFD_ONE */
+  #define PSD_CFD_ONE 256
+  /* max delay (samples) */
+  #define PSD_CFD_MAX_DELAY 64
+
+  /* The parameters of the CFD of a channel, set by initPsdCfd() */
+  typedef struct
+  {
+    uint32_t trigger;           /* sample of the trigger in the trace */
+    uint32_t start;             /* first sample searched */
+    uint32_t delay;             /* samples */
+    int32_t fraction;           /* 1/PSD_CFD_ONE */
+    int32_t arm;                /* arming level of c, x PSD_CFD_ONE */
+    int negative;
+  } psdCfd_t;
+
+  /* Sets the parameters of the CFD of a channel.
+   *
+   * @param c the CFD
+   * @param trigger the samples before the trigger (see
+   * CAEN_DGTZ_SetDPPPreTriggerSize())
+   * @param start the first sample of the gates (psdChargeGates_t.gateStart)
+   * @param delay the delay (samples, 1 to PSD_CFD_MAX_DELAY)
+   * @param fractionPercent the fraction (%, 1 to 100)
+   * @param threshold the trigger threshold (ADC counts, DPP parameter 'thr')
+   * @param negative non-zero for negative pulses
+   * @return 0 on success, -1 if a parameter is out of range (a description
+   * is printed to stderr)
+   */
+  extern int initPsdCfd(psdCfd_t *c, uint32_t trigger, uint32_t start, uint32_t delay, uint32_t fractionPercent, uint32_t threshold, int negative);
+  /* Computes the fine time of 'count' traces, reference path.
+   *
+   * @param c the CFD
+   * @param traces the traces
+   * @param charges the charges of the traces (their baselines are used)
+   * @param count the number of traces
+   * @param fine the fine time of each trace (1/PSD_EVENT_FINE_UNITS of a
+   * sample) or PSD_CFD_NO_TIME
+   */
+  extern void psdCfdScalar(const psdCfd_t *c, const psdChargeTrace_t *traces, const psdCharge_t *charges, uint32_t count, int16_t *fine);
+  /* Computes the fine time of 'count' traces, SIMD path (see above).
+   *
+   * @param c the CFD
+   * @param traces the traces
+   * @param charges the charges of the traces (their baselines are used)
+   * @param count the number of traces
+   * @param fine the fine time of each trace (1/PSD_EVENT_FINE_UNITS of a
+   * sample) or PSD_CFD_NO_TIME
+   */
+  extern void psdCfdVector(const psdCfd_t *c, const psdChargeTrace_t *traces, const psdCharge_t *charges, uint32_t count, int16_t *fine);
+#endif
@@ -0,0 +1,144 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'psdCharge' integrates the charges of the events again from
+ * their samples, with the gates of the DPP-PSD firmware: to validate the
+ * charges computed by the board and to try other gates on the waveform
+ * records of a run (see runFile.h).
+ *
+ * The gates are those of the DPP parameters (CAEN_DGTZ_DPP_PSD_Params_t), in
+ * samples from the beginning of the trace:
+ *
+ *   |<-------- preTrigger -------->|
+ *   |    | baseline  |<-- pgate -->|trigger
+ *   +----+-----------+-------------+------------------+------------+
+ *        |<- nsbl -->|<------- sgate ------->|        |
+ *                    |<--------------- lgate -------------------->|
+ *
+ * - the baseline is the mean of the 'nsbl' samples before the gates (8, 32
+ *   or 128 samples for the codes 1, 2 and 3 of CAEN_DGTZ_DPP_PSD_Params_t.nsbl;
+ *   with the code 0, the fixed baseline of the board, all the samples before
+ *   the gates). The window is cut at the beginning of the trace; without any
+ *   sample before the gates the baseline is 0;
+ * - the short and the long gate open 'pgate' samples before the trigger and
+ *   last 'sgate' and 'lgate' samples (cut at the end of the trace);
+ * - the charge of a gate is the area between the baseline and the samples
+ *   (baseline - sample with the negative polarity), in ADC counts x samples:
+ *   the firmware scales it by its charge sensitivity, so only the ratio
+ *   between the two is constant;
+ * - the PSD is (qlong - qshort) / qlong, 0 if qlong <= 0.
+ *
+ * The charges are computed for a batch of traces at once. Two paths are
+ * available and give the same charges:
+ * - psdChargeScalar() is the reference path;
+ * - psdChargeVector() adds up the samples of the windows 16 at a time with
+ *   AVX2 (when built with -mavx2 or -march=native), 8 at a time with SSE2
+ *   otherwise. Without SSE2 it is the scalar path.
+ * The samples must be below 0x8000, as the 12 bit samples of psdDecoder.h
+ * (PSD_SAMPLE_MASK) are.
+ *
+ * psdChargeStats_t compares the charges with those of the firmware, event by
+ * event: mean and standard deviation of the ratios software/firmware of the
+ * two charges and of the difference of the PSD.
+ *
+ * 'psdCharge' module version: a0.2
+ */
+
+#ifndef _PSD_CHARGE
+  #define _PSD_CHARGE
+  #include <stdio.h>
+  #include <stdint.h>
+  #include "psdEvent.h"
+
+  /* max length of a window (samples): the sums of the vector path are 32 bit */
+  #define PSD_CHARGE_MAX_WINDOW 65535
+  /* number of traces integrated at once by the acquisition (see acqPipeline.h) */
+  #define PSD_CHARGE_BATCH 256
+  /* column names of printPsdChargeStats() */
+  #define PSD_CHARGE_STATS_HEADER "#  ch          traces  no fw charge   Ql sw/fw mean        rms   Qs sw/fw mean        rms    PSD sw-fw mean        rms\n"
+
+  /* The windows of the gates, set by initPsdChargeGates() */
+  typedef struct
+  {
+    uint32_t baselineStart, baselineLength;
+    uint32_t gateStart;
+    uint32_t shortLength, longLength;
+    int negative;               /* negative pulses: the charge is baseline - sample */
+  } psdChargeGates_t;
+
+  /* A trace: 'numSamples' samples of one event */
+  typedef struct
+  {
+    const uint16_t *samples;
+    uint32_t numSamples;
+  } psdChargeTrace_t;
+
+  /* The charges of a trace */
+  typedef struct
+  {
+    float baseline;             /* ADC counts */
+    float qshort, qlong;        /* ADC counts x samples */
+    float psd;
+  } psdCharge_t;
+
+  /* Comparison with the charges of the firmware */
+  typedef struct
+  {
+    uint64_t count;             /* events compared */
+    uint64_t noCharge;          /* events with a firmware long charge of 0, not compared */
+    double sumLong, sumLong2;   /* qlong software / firmware and its square */
+    double sumShort, sumShort2; /* qshort software / firmware (firmware qshort > 0) */
+    uint64_t countShort;
+    double sumPsd, sumPsd2;     /* PSD software - firmware */
+  } psdChargeStats_t;
+
+  /* Sets the windows of the gates from the DPP parameters of a channel.
+   *
+   * @param g the gates
+   * @param preTrigger the samples before the trigger (see
+   * CAEN_DGTZ_SetDPPPreTriggerSize())
+   * @param pgate the samples of the gates before the trigger
+   * @param sgate the length of the short gate (samples)
+   * @param lgate the length of the long gate (samples)
+   * @param nsbl the code of the baseline samples (0: fixed, 1: 8, 2: 32,
+   * 3: 128)
+   * @param negative non-zero for negative pulses
+   * @return 0 on success, -1 if a parameter is out of range (a description
+   * is printed to stderr)
+   */
+  extern int initPsdChargeGates(psdChargeGates_t *g, uint32_t preTrigger, uint32_t pgate, uint32_t sgate, uint32_t lgate, int nsbl, int negative);
+  /* Computes the charges of 'count' traces, reference path.
+   *
+   * @param g the gates
+   * @param traces the traces
+   * @param count the number of traces
+   * @param out the charges of each trace
+   */
+  extern void psdChargeScalar(const psdChargeGates_t *g, const psdChargeTrace_t *traces, uint32_t count, psdCharge_t *out);
+  /* Computes the charges of 'count' traces, SIMD path (see above).
+   *
+   * @param g the gates
+   * @param traces the traces
+   * @param count the number of traces
+   * @param out the charges of each trace
+   */
+  extern void psdChargeVector(const psdChargeGates_t *g, const psdChargeTrace_t *traces, uint32_t count, psdCharge_t *out);
+  /* Compares the charges of a trace with those of its event.
+   *
+   * @param s the statistics
+   * @param ev the record of the event (firmware charges)
+   * @param q the charges computed from the samples
+   */
+  extern void psdChargeStatsAdd(psdChargeStats_t *s, const psdEvent_t *ev, const psdCharge_t *q);
+  /* Prints the statistics on one line (see PSD_CHARGE_STATS_HEADER).
+   *
+   * @param fp the stream
+   * @param channel the channel in the first column
+   * @param s the statistics
+   * @return 0 on success, otherwise a non-zero integer
+   */
+  extern int printPsdChargeStats(FILE *fp, int channel, const psdChargeStats_t *s);
+  /* @return the name of the SIMD instructions used by psdChargeVector()
+   * ("AVX2", "SSE2" or "none")
+   */
+  extern const char *psdChargeVectorName(void);
+#endif
@@ -0,0 +1,217 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'psdDecoder' unpacks the readout buffers of a x720 board with
+ * DPP-PSD firmware (the data returned by CAEN_DGTZ_ReadData()) into psdEvent_t
+ * records (see psdEvent.h), without going through CAEN_DGTZ_GetDPPEvents().
+ * The buffer is walked once; the records of each channel are appended to a
+ * per-channel array of the decoder and the time tag rollovers are tracked per
+ * channel, so that psdEvent_t.timestamp is already extended.
+ *
+ * Layout of the buffer (32 bit words), one or more board aggregates:
+ *
+ *   board aggregate header
+ *     W0  [31:28] = 0xA, [27:0] size of the board aggregate (words)
+ *     W1  [31:27] board ID, [26] board fail, [7:0] channel mask
+ *     W2  board aggregate counter
+ *     W3  board aggregate time tag
+ *   then one channel aggregate for each bit set in the channel mask (from the
+ *   lowest channel):
+ *     W0  [31] = 1, [21:0] size of the channel aggregate (words)
+ *     W1  [31] DT: dual trace, [30] EQ: charge enabled, [29] ET: time tag
+ *         enabled, [28] EE: extras enabled, [27] ES: samples enabled,
+ *         [15:0] number of samples / 8
+ *     then the events, all with the same size:
+ *       trigger time tag ([30:0])
+ *       number of samples / 2 words of samples (if ES)
+ *       extras (if EE)
+ *       [31:16] long charge, [15] pile-up, [14:0] short charge (if EQ)
+ *
+ * The same checks as DataConsistencyCheck() (see Functions.h) are done while
+ * walking the buffer: the sizes of the board aggregates must add up to the
+ * size of the buffer (event truncation) and more than 2 consecutive zero
+ * words among the header and event words (the samples are not checked) are
+ * a burst of zeroes. Besides, each header must have the right tag
+ * and a size consistent with the enclosing aggregate and with the event size.
+ * Errors are displayed on stdout as "Data Error: ...".
+ *
+ * Two decoding paths are available and produce the same records:
+ * - psdDecodeScalar() is the reference path;
+ * - psdDecodeVector() decodes 4 events at a time with SSE2 the channel
+ *   aggregates of List mode (no samples, charge enabled); the other channel
+ *   aggregates, the groups of events with a rollover or a zero word and the
+ *   tail are handled by the scalar code. Without SSE2 it is the scalar path.
+ *
+ * In Mixed and Oscilloscope mode the events also carry samples (ES). The
+ * records don't: once psdDecoderEnableSamples() is called, the decoder keeps
+ * for each record where its samples are in the readout buffer (psdSamples_t),
+ * valid as long as the buffer is. The samples are 16 bit halves of the
+ * words, two per word (the lower one first): the sample is in the lower 12
+ * bits (PSD_SAMPLE_MASK), the bits above it hold the digital probes. With the
+ * dual trace (DT) the samples of the two traces alternate.
+ *
+ * The extras word (EE) holds what the board was configured to put in it (see
+ * ProgramDigitizer()); psdDecoderSetExtras() tells the decoder how to read
+ * it:
+ * - PSD_EXTRAS_TIME: [15:0] the extended time stamp, the bits 46..31 of the
+ *   time tag. The rollovers of the channel are taken from it instead of being
+ *   counted by the decoder, so that a channel silent for more than a
+ *   rollover period (~8.6 s) keeps the right time;
+ * - PSD_EXTRAS_TRIGGERS: [31:16] the lost triggers and [15:0] the total
+ *   triggers of the channel, two 16 bit counters of the board that start at
+ *   0 with the acquisition. The triggers since the previous event (the
+ *   difference of the counters modulo 2^16)
+ *   are added to 'lostTriggers' and 'totalTriggers': the triggers the board
+ *   couldn't store, whatever the readout did. More than 65535 triggers
+ *   between two events of a channel can't be told apart from fewer.
+ * The records are the same in the two cases.
+ *
+ * Counting the rollovers misses those of a channel silent for more than a
+ * rollover period: the time tag of its next event is then one or more
+ * periods late. Unless the extended time stamp is read, the counting is
+ * cross-checked with the wall clock: psdDecoderSetClock() gives the time
+ * elapsed from the start of the acquisition to the readout of the buffer,
+ * and the board time can't be later than the latest time of the board seen
+ * so far (the last records of its busiest channel) plus the wall-clock time
+ * elapsed since, plus PSD_CLOCK_MARGIN. When this bound is more than a
+ * rollover period after the previous event of the channel, the first record
+ * of the channel in the buffer takes the latest time consistent with its
+ * time tag below the bound; the rollovers added are counted in
+ * 'missedRollovers'. The check is done once per channel and buffer, before
+ * the events are decoded, so that the scalar, the vector and the library
+ * paths still give the same records; it only ever adds rollovers: the time
+ * of each channel stays monotonic. The time is wrong only if an event waited
+ * in the board more than a rollover period minus PSD_CLOCK_MARGIN before it
+ * was read.
+ *
+ * 'psdDecoder' module version: a0.6
+ */
+
+#ifndef _PSD_DECODER
+  #define _PSD_DECODER
+  #include <stdint.h>
+  #include "psdEvent.h"
+
+  /* max number of channels of a x720 board */
+  #define PSD_MAX_CHANNELS 8
+
+  /* bits of a sample: the ADC resolution of the x720 (MAXNBITS in
+     Functions.h, that can't be included here without the CAEN headers) */
+  #define PSD_SAMPLE_BITS 12
+  /* max value of a sample */
+  #define PSD_SAMPLE_MASK ((1u << PSD_SAMPLE_BITS) - 1)
+
+  /* content of the extras word (see psdDecoderSetExtras()) */
+  #define PSD_EXTRAS_NONE     0   /* not read */
+  #define PSD_EXTRAS_TIME     1   /* [31:16] baseline x 4, [15:0] extended time stamp */
+  #define PSD_EXTRAS_TRIGGERS 2   /* [31:16] lost triggers, [15:0] total triggers */
+  #define PSD_EXTRAS_COUNT    3   /* number of contents */
+
+  /* the time of the board can be ahead of the wall clock by this much (time
+     tag units, 0.5 s): the start of the boards before the clock and the
+     drift of the two clocks */
+  #define PSD_CLOCK_MARGIN 125000000ull
+
+  /* Where the samples of a record are in the readout buffer */
+  typedef struct
+  {
+    const uint32_t *words;      /* the first word of samples, NULL if the event has none */
+    uint32_t numSamples;        /* samples of all the traces */
+    uint32_t dualTrace;         /* 1 if the samples of two traces alternate */
+  } psdSamples_t;
+
+  typedef struct
+  {
+    psdEvent_t *events[PSD_MAX_CHANNELS];     /* records of the last decoded buffer */
+    uint32_t numEvents[PSD_MAX_CHANNELS];
+    uint32_t capacity[PSD_MAX_CHANNELS];      /* records allocated in 'events' */
+    psdSamples_t *samples[PSD_MAX_CHANNELS];  /* samples of each record, NULL if not enabled */
+    uint32_t prevTimeTag[PSD_MAX_CHANNELS];   /* to detect the rollovers */
+    uint64_t rollovers[PSD_MAX_CHANNELS];
+    int extras;                               /* PSD_EXTRAS_* */
+    uint32_t prevExtras[PSD_MAX_CHANNELS];    /* extras word of the previous event (PSD_EXTRAS_TRIGGERS) */
+    uint64_t lostTriggers[PSD_MAX_CHANNELS];  /* PSD_EXTRAS_TRIGGERS */
+    uint64_t totalTriggers[PSD_MAX_CHANNELS];
+    uint64_t clock;                           /* wall-clock time of the readout of the buffer (time tag units), 0: unknown */
+    uint64_t refTime, refClock;               /* the latest time of the board seen and the clock of its buffer */
+    uint64_t missedRollovers[PSD_MAX_CHANNELS];   /* rollovers added by the wall-clock check */
+    int zeroCount;                            /* consecutive zero words */
+    uint8_t board;
+  } psdDecoder_t;
+
+  /* Initializes the decoder of the board 'board' (an index < 256).
+   *
+   * @return 0 on success, -1 if the memory can't be allocated
+   */
+  extern int initPsdDecoder(psdDecoder_t *d, int board);
+  /* Frees the memory allocated by the decoder.
+   */
+  extern void freePsdDecoder(psdDecoder_t *d);
+  /* Empties the per-channel record arrays. The rollover counters are kept.
+   */
+  extern void psdDecoderClear(psdDecoder_t *d);
+  /* Makes the decoder keep where the samples of each record are
+   * ('samples').
+   *
+   * @return 0 on success, -1 if the memory can't be allocated
+   */
+  extern int psdDecoderEnableSamples(psdDecoder_t *d);
+  /* Sets how the extras word of the events is read (see above).
+   *
+   * @param d the decoder
+   * @param extras PSD_EXTRAS_NONE, PSD_EXTRAS_TIME or PSD_EXTRAS_TRIGGERS
+   */
+  extern void psdDecoderSetExtras(psdDecoder_t *d, int extras);
+  /* Sets the wall-clock time of the readout of the next buffer, for the
+   * check of the rollovers (see above). Must be called before the buffer is
+   * decoded (or its events pushed), after the records of the previous buffer
+   * were used.
+   *
+   * @param d the decoder
+   * @param clock the time from the start of the acquisition of the board to
+   * the readout of the buffer (time tag units), 0 to skip the check
+   */
+  extern void psdDecoderSetClock(psdDecoder_t *d, uint64_t clock);
+  /* Decodes a readout buffer with the reference (scalar) path. The records
+   * replace those of the previous buffer.
+   *
+   * @param d the decoder of the board the buffer comes from
+   * @param buff32 the readout buffer
+   * @param numWords the size of 'buff32' (32 bit words)
+   * @return 0 on success, -1 in case of data error or if the memory can't be
+   * allocated (a description is printed)
+   */
+  extern int psdDecodeScalar(psdDecoder_t *d, const uint32_t *buff32, uint32_t numWords);
+  /* Decodes a readout buffer with the SIMD path. The records replace those of
+   * the previous buffer.
+   *
+   * @param d the decoder of the board the buffer comes from
+   * @param buff32 the readout buffer
+   * @param numWords the size of 'buff32' (32 bit words)
+   * @return 0 on success, -1 in case of data error or if the memory can't be
+   * allocated (a description is printed)
+   */
+  extern int psdDecodeVector(psdDecoder_t *d, const uint32_t *buff32, uint32_t numWords);
+  /* Appends a record to the channel 'ch' and extends its time tag. It is used
+   * to convert the events unpacked by CAEN_DGTZ_GetDPPEvents().
+   *
+   * @param d the decoder
+   * @param ch the channel (< PSD_MAX_CHANNELS)
+   * @param timeTag the trigger time tag (31 bits)
+   * @param extras the extras word, NULL if the event has none
+   * @param qshort the short gate charge
+   * @param qlong the long gate charge
+   * @param pur the pile-up flag
+   * @return 0 on success, -1 if the memory can't be allocated
+   */
+  extern int psdDecoderPushEvent(psdDecoder_t *d, int ch, uint32_t timeTag, const uint32_t *extras, uint16_t qshort, uint16_t qlong, int pur);
+  /* Counts the events of each channel of a readout buffer reading only the
+   * aggregate headers (used by the raw capture, that doesn't decode). The
+   * count stops at the first malformed header.
+   *
+   * @param buff32 the readout buffer
+   * @param numWords the size of 'buff32' (32 bit words)
+   * @param counts the number of events of each channel is added here
+   * @return 0 on success, -1 if a malformed header was found
+   */
+  extern int psdCountEvents(const uint32_t *buff32, uint32_t numWords, uint64_t counts[PSD_MAX_CHANNELS]);
+#endif
@@ -0,0 +1,61 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * 'psdEvent' defines the compact record used to carry one DPP-PSD event from
+ * the decoder to the analysis and output stages. The record is 16 bytes long,
+ * has no padding and is stored on disk as it is (little endian).
+ *
+ * The time tag counts samples (4 ns). When the event has samples the time of
+ * the pulse can be measured more finely with a digital CFD (see psdCfd.h):
+ * the fine time, a signed correction to the time tag in 1/PSD_EVENT_FINE_UNITS
+ * of a time tag unit (62.5 ps), is then kept in the upper bits of 'flags'
+ * (PSD_EVENT_FLAG_FINE set) and PSD_EVENT_FINE_TIME() gives the time of the
+ * event in these units.
+ * The timestamp is monotonic for each channel (see the rollovers in
+ * psdDecoder.h); PSD_EVENT_TIME_NS() gives it in ns from the start of the
+ * acquisition, as the TEXT_NS text output writes it (see runFile.h).
+ *
+ * 'psdEvent' version: a0.4
+ */
+
+#ifndef _PSD_EVENT
+  #define _PSD_EVENT
+  #include <stdint.h>
+
+  /* number of bits of the DPP-PSD trigger time tag (x720: 31 bits, 4 ns) */
+  #define PSD_TIMETAG_BITS 31
+  #define PSD_TIMETAG_MASK 0x7FFFFFFFu
+  /* duration of a time tag unit (ns) */
+  #define PSD_TIMETAG_NS 4
+
+  /* bits of psdEvent_t.flags */
+  #define PSD_EVENT_FLAG_PUR 0x0001u        /* pile-up flag of the charge word */
+  #define PSD_EVENT_FLAG_LATE 0x0002u       /* written after a newer event by the time merge (see timeMerge.h) */
+  #define PSD_EVENT_FLAG_FINE 0x0004u       /* flags[15:6] hold the fine time */
+  #define PSD_EVENT_FLAG_PRESCALED 0x0008u  /* a single of a TDCR PMT written by the prescale of the coincidence filter (see tdcrFilter.h) */
+
+  /* fine time: flags[15:6], two's complement, in 1/PSD_EVENT_FINE_UNITS of a
+     time tag unit */
+  #define PSD_EVENT_FINE_SHIFT 6
+  #define PSD_EVENT_FINE_UNITS 64
+  #define PSD_EVENT_FINE_MIN (-512)
+  #define PSD_EVENT_FINE_MAX 511
+  /* the fine time of the record 'ev', 0 without PSD_EVENT_FLAG_FINE */
+  #define PSD_EVENT_FINE(ev) (((ev)->flags & PSD_EVENT_FLAG_FINE) ? (int)((ev)->flags >> PSD_EVENT_FINE_SHIFT) - (((ev)->flags & 0x8000u) ? 1024 : 0) : 0)
+  /* sets the fine time of the record 'ev' (PSD_EVENT_FINE_MIN to PSD_EVENT_FINE_MAX) */
+  #define PSD_EVENT_SET_FINE(ev, fine) ((ev)->flags = (uint16_t)(((ev)->flags & 0x003Fu) | PSD_EVENT_FLAG_FINE \
+                                                                 | (((unsigned)(fine) & 0x3FFu) << PSD_EVENT_FINE_SHIFT)))
+  /* time of the record 'ev' in ns (64 bits) */
+  #define PSD_EVENT_TIME_NS(ev) ((uint64_t)(ev)->timestamp * PSD_TIMETAG_NS)
+  /* time of the record 'ev' in 1/PSD_EVENT_FINE_UNITS of a time tag unit */
+  #define PSD_EVENT_FINE_TIME(ev) ((int64_t)((ev)->timestamp * PSD_EVENT_FINE_UNITS) + PSD_EVENT_FINE(ev))
+
+  typedef struct
+  {
+    uint64_t timestamp;     /* extended time tag: (rollovers << 31) | TimeTag */
+    uint16_t qshort;        /* short gate charge (ChargeShort) */
+    uint16_t qlong;         /* long gate charge (ChargeLong) */
+    uint8_t board;          /* index of the board */
+    uint8_t channel;        /* channel of the board */
+    uint16_t flags;         /* PSD_EVENT_FLAG_* */
+  } psdEvent_t;
+#endif
@@ -0,0 +1,76 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'psdHisto' accumulates online the spectra of a channel from its
+ * records (see psdEvent.h):
+ * - the short gate charge (Qs) and the long gate charge (Ql) spectra,
+ *   PSD_HISTO_BINS bins (the 12 bits of the x720 charges);
+ * - the PSD spectrum, the ratio (Ql - Qs) / Ql in [0, 1] over PSD_HISTO_BINS
+ *   bins (1 is in the last bin, the events with Qs >= Ql go into bin 0);
+ * - the 2D Qs vs Ql histogram, PSD_HISTO_2D_BINS x PSD_HISTO_2D_BINS bins
+ *   (the charges divided by 2^PSD_HISTO_2D_SHIFT).
+ *
+ * All the bins of a channel are in one contiguous block. The 1D spectra are
+ * kept in PSD_HISTO_COPIES copies: the records are taken in groups of
+ * PSD_HISTO_COPIES and the n-th record of a group is added to the n-th copy.
+ * Consecutive events with the same charge (a hot bin) then increment
+ * different words, so an increment never waits for the store of the previous
+ * one. The copies are added together only when a snapshot is taken.
+ *
+ * The block is written only by the thread that calls psdHistoFill(); another
+ * thread reads the snapshot, once it is taken (see acqPipeline.h).
+ *
+ * 'psdHisto' module version: a0.1
+ */
+
+#ifndef _PSD_HISTO
+  #define _PSD_HISTO
+  #include <stdint.h>
+  #include "psdEvent.h"
+
+  #define PSD_HISTO_BITS 12
+  #define PSD_HISTO_BINS (1 << PSD_HISTO_BITS)
+  /* copies of the 1D spectra (power of 2) */
+  #define PSD_HISTO_COPIES 4
+  #define PSD_HISTO_2D_SHIFT 4
+  #define PSD_HISTO_2D_BINS (PSD_HISTO_BINS >> PSD_HISTO_2D_SHIFT)
+  /* offsets of the spectra in a copy and in the snapshot */
+  #define PSD_HISTO_QSHORT 0
+  #define PSD_HISTO_QLONG PSD_HISTO_BINS
+  #define PSD_HISTO_PSD (2 * PSD_HISTO_BINS)
+  /* offset of the 2D histogram in the snapshot */
+  #define PSD_HISTO_2D (3 * PSD_HISTO_BINS)
+
+  typedef struct
+  {
+    /* live bins: PSD_HISTO_COPIES copies of the 1D spectra (3 *
+       PSD_HISTO_BINS each) followed by the 2D histogram, [Ql bin][Qs bin] */
+    uint32_t *live;
+    uint64_t entries;
+    /* snapshot: the 1D spectra (the sum of the copies) followed by the 2D
+       histogram */
+    uint32_t *snapshot;
+    uint64_t snapshotEntries;
+  } psdHisto_t;
+
+  /* Allocates the bins of a channel and sets them to 0.
+   *
+   * @return 0 on success, -1 if the memory can't be allocated (a description
+   * is printed to stderr)
+   */
+  extern int initPsdHisto(psdHisto_t *h);
+  /* Frees the memory allocated by initPsdHisto().
+   */
+  extern void freePsdHisto(psdHisto_t *h);
+  /* Adds records to the spectra.
+   *
+   * @param h the histograms of the channel of the records
+   * @param ev the records
+   * @param count the number of records
+   */
+  extern void psdHistoFill(psdHisto_t *h, const psdEvent_t *ev, uint32_t count);
+  /* Copies the live spectra into the snapshot (the copies are summed).
+   *
+   * @param h the histograms
+   */
+  extern void psdHistoSnapshot(psdHisto_t *h);
+#endif
@@ -0,0 +1,154 @@
+/* The module 'readoutOptions' reads the 'Readout options' section of
+ * "tdcr.ini". Unlike the CAEN DTT/DPP-PSD parameters (see myCAEN_DTT_config.h),
+ * that are positional, each readout option is written on its own line with
+ * the syntax
+ *
+ *   <option name> = <value>
+ *
+ * so that options can be written in any order and an option that is not
+ * written keeps its default value. The options tune how the program reads,
+ * decodes and stores the data; they can't be modified interactively.
+ * The number of the first file line with an error is displayed on 'stderr'.
+ * The option 'BoardConfigs' lists the configuration files of the boards read
+ * together with the one configured by "tdcr.ini" (see
+ * acquireBoardParameterValues() in myCAEN_DTT_config.h).
+ * The option 'MergeWindow' enables the time merge of the events (see
+ * timeMerge.h) and the option 'CoincWindow', that needs it, the online
+ * coincidences of the TDCR PMTs (see tdcrCoinc.h). The option 'Histograms'
+ * enables the online spectra (see psdHisto.h). The option 'ReadoutPolicy'
+ * selects how the readout threads wait for the data of the boards (see
+ * acqPipeline.h). The options 'OutputWriter', 'SegmentSize',
+ * 'SegmentPeriod', 'OutputDirect' and 'OutputQueueDepth' select how the output
+ * file is written and split (see runWriter.h). The options 'MetricsFile',
+ * 'MetricsPort' and 'MetricsSocket' publish the state of the acquisition for
+ * a monitoring system (see metricsExport.h). The option 'Waveforms' writes
+ * the samples of the events (Mixed and Oscilloscope 'DPP_AcqMode') to a
+ * waveform file (see runFile.h and acqPipeline.h); with the option
+ * 'SoftwareCharge' the charges are also integrated from the samples and
+ * compared with those of the firmware (see psdCharge.h), and with the
+ * options 'CfdDelay' and 'CfdFraction' the fine time of the events is
+ * measured on the samples (see psdCfd.h). The options 'DeadTimeMode',
+ * 'DeadTime', 'DeadTimeA', 'DeadTimeB' and 'DeadTimeC' impose a dead time on
+ * the PMTs before their coincidences are counted (see tdcrDeadTime.h). The
+ * options 'CoincFilter' and 'SinglesPrescale' write only the records of the
+ * coincidences and a sample of the singles (see tdcrFilter.h). The option
+ * 'CoincScan', that needs the time merge, counts the coincidences for a list
+ * of resolving times at once (see tdcrScan.h). The option 'Extras' selects
+ * the content of the extras word of the events (see psdDecoder.h); its value
+ * TRIGGER_COUNTERS is refused unless the AMC firmware release of the boards
+ * is known to support it (see EXTRAS_OPTION_MIN_AMC_FW in Functions.h).
+ *
+ * 'readoutOptions' module version: a0.20
+ */
+
+#ifndef _READOUT_OPTIONS
+  #define _READOUT_OPTIONS
+  #include "Functions.h"
+  #include "runWriter.h"
+  #include "psdCfd.h"
+  #include "tdcrDeadTime.h"
+  #include "tdcrScan.h"
+
+  /* values of the option 'Decoder' */
+  #define DECODER_LIBRARY 0       /* CAEN_DGTZ_GetDPPEvents() */
+  #define DECODER_SCALAR  1       /* in-tree decoder, reference path */
+  #define DECODER_VECTOR  2       /* in-tree decoder, SIMD path */
+  #define DECODER_COUNT   3       /* number of decoders */
+  /* values of the option 'OutputFormat' */
+  #define OUTPUT_TEXT   0         /* legacy ".dat" text file */
+  #define OUTPUT_BINARY 1         /* binary run file (see runFile.h) */
+  #define OUTPUT_RAW    2         /* raw capture of the readout buffers (see runFile.h) */
+  #define OUTPUT_TEXT_NS 3        /* ".dat" text file with the time in ns (RUN_FILE_TEXT_NS, see runFile.h) */
+  #define OUTPUT_COUNT  4         /* number of output formats */
+  /* values of the option 'ReadoutPolicy' */
+  #define READOUT_POLICY_BUSY     0   /* reads the board back to back */
+  #define READOUT_POLICY_ADAPTIVE 1   /* sleeps between the reads, as long as the readout sizes allow */
+  #define READOUT_POLICY_IRQ      2   /* waits for the interrupt of the board (CAEN_DGTZ_IRQWait()) */
+  #define READOUT_POLICY_COUNT    3   /* number of readout policies */
+  /* the values of the option 'OutputWriter' are RUN_WRITER_STDIO,
+     RUN_WRITER_MMAP and RUN_WRITER_URING (see runWriter.h); the max value of
+     the option 'OutputQueueDepth' is RUN_WRITER_URING_MAX_DEPTH */
+  /* the values of the option 'DeadTimeMode' are TDCR_DEAD_NON_EXTENDABLE and
+     TDCR_DEAD_EXTENDABLE (see tdcrDeadTime.h); the values of the option
+     'Extras' are PSD_EXTRAS_NONE, PSD_EXTRAS_TIME and PSD_EXTRAS_TRIGGERS (see
+     psdDecoder.h) */
+  /* max length of the name of a board configuration file (NUL included) */
+  #define READOUT_FILE_NAME_SIZE 256
+  /* max value of the option 'MergeWindow' (us) */
+  #define READOUT_MAX_MERGE_WINDOW 10000000ul
+  /* max value of the option 'CoincWindow' (ns) */
+  #define READOUT_MAX_COINC_WINDOW 1000000ul
+  /* max value of the option 'HistoSavePeriod' (s) */
+  #define READOUT_MAX_HISTO_SAVE_PERIOD 86400ul
+  /* max value of the option 'PollMaxWait' (us) */
+  #define READOUT_MAX_POLL_WAIT 1000000ul
+  /* max value of the option 'IrqThreshold' (aggregates, 10 bits of the
+     Interrupt Event Number register) */
+  #define READOUT_MAX_IRQ_THRESHOLD 1023ul
+  /* max value of the option 'IrqTimeout' (ms) */
+  #define READOUT_MAX_IRQ_TIMEOUT 10000ul
+  /* max value of the option 'SegmentSize' (MiB) */
+  #define READOUT_MAX_SEGMENT_SIZE 1048576ul
+  /* max value of the option 'SegmentPeriod' (s) */
+  #define READOUT_MAX_SEGMENT_PERIOD 604800ul
+  /* max value of the option 'MetricsPort' */
+  #define READOUT_MAX_METRICS_PORT 65535ul
+  /* max value of the options 'DeadTime', 'DeadTimeA', 'DeadTimeB' and
+     'DeadTimeC' (ns) */
+  #define READOUT_MAX_DEAD_TIME 10000000ul
+  /* max value of the option 'SinglesPrescale' */
+  #define READOUT_MAX_SINGLES_PRESCALE 1000000ul
+
+  typedef struct
+  {
+    int Decoder;            /* DECODER_LIBRARY / DECODER_SCALAR / DECODER_VECTOR */
+    int DecoderCheck;       /* !=0: compare the in-tree decoders with the library */
+    int OutputFormat;       /* OUTPUT_TEXT / OUTPUT_BINARY / OUTPUT_RAW / OUTPUT_TEXT_NS */
+    int NumBoards;          /* boards to read: 1 + the files of 'BoardConfigs' */
+    /* configuration file of each board: [0] is "tdcr.ini", the others are
+       listed by 'BoardConfigs' */
+    char BoardConfigs[MAXNB][READOUT_FILE_NAME_SIZE];
+    unsigned long MergeWindow;  /* reorder window of the time merge (us), 0: no merge */
+    unsigned long CoincWindow;  /* resolving time of the TDCR coincidences (ns), 0: disabled */
+    int Histograms;             /* !=0: fill the spectra of each channel online */
+    unsigned long HistoSavePeriod;  /* period of the histogram snapshots (s), 0: only at the end of the run */
+    int ReadoutPolicy;              /* READOUT_POLICY_BUSY / READOUT_POLICY_ADAPTIVE / READOUT_POLICY_IRQ */
+    unsigned long PollMaxWait;      /* longest pause between two reads (us, READOUT_POLICY_ADAPTIVE) */
+    unsigned long IrqThreshold;     /* aggregates stored in the board that raise the interrupt (READOUT_POLICY_IRQ) */
+    unsigned long IrqTimeout;       /* longest wait for the interrupt (ms, READOUT_POLICY_IRQ) */
+    int OutputWriter;               /* RUN_WRITER_STDIO / RUN_WRITER_MMAP / RUN_WRITER_URING */
+    unsigned long SegmentSize;      /* size limit of an output segment (MiB), 0: no limit */
+    unsigned long SegmentPeriod;    /* time limit of an output segment (s), 0: no limit */
+    int OutputDirect;               /* !=0: open the output files with O_DIRECT (RUN_WRITER_URING) */
+    unsigned long OutputQueueDepth; /* max writes in flight (RUN_WRITER_URING) */
+    char MetricsFile[READOUT_FILE_NAME_SIZE];   /* file the metrics are written to, "": none */
+    unsigned long MetricsPort;                  /* TCP port of the metrics on 127.0.0.1, 0: none */
+    char MetricsSocket[READOUT_FILE_NAME_SIZE]; /* UNIX socket of the metrics, "": none */
+    int Waveforms;                  /* !=0: write the samples of the events to "<name>_wave.bin" */
+    int SoftwareCharge;             /* !=0: integrate the charges from the samples (needs 'Waveforms') */
+    unsigned long CfdDelay;         /* delay of the CFD of the fine time (samples), 0: no fine time (needs 'Waveforms') */
+    unsigned long CfdFraction;      /* fraction of the CFD (%) */
+    int DeadTimeMode;               /* TDCR_DEAD_NON_EXTENDABLE / TDCR_DEAD_EXTENDABLE */
+    unsigned long DeadTime;         /* common dead time of the PMTs (ns), 0: none (needs 'CoincWindow') */
+    unsigned long DeadTimePmt[3];   /* dead time of the PMTs A, B and C (ns), 0: none (needs 'CoincWindow') */
+    int Extras;                     /* PSD_EXTRAS_NONE / PSD_EXTRAS_TIME / PSD_EXTRAS_TRIGGERS */
+    int CoincFilter;                /* !=0: write only the records of the coincidences (needs 'CoincWindow') */
+    unsigned long SinglesPrescale;  /* one single out of 'SinglesPrescale' is still written, 0: none (needs 'CoincFilter') */
+    uint32_t NumScanWindows;        /* resolving times of the coincidence scan, 0: no scan (needs 'MergeWindow') */
+    unsigned long ScanWindows[TDCR_SCAN_MAX_WINDOWS];   /* resolving times of the coincidence scan (ns) */
+  } ReadoutOptions_t;
+
+  extern ReadoutOptions_t readoutOptions;
+
+  /* Sets 'readoutOptions' to the default values then parses the 'Readout
+   * options' section of "tdcr.ini" to update them.
+   *
+   * @return a non-zero integer on success, 0 if "tdcr.ini" can't be read, if
+   * it contains an invalid option (the line number is printed to stderr) or
+   * if two options can't be used together
+   */
+  extern int acquireReadoutOptions(void);
+  /* Prints to stdout the current values of 'readoutOptions'.
+   */
+  extern void printReadoutOptions(void);
+#endif
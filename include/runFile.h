@@ -0,0 +1,190 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'runFile' defines the binary run file written when the readout
+ * option 'OutputFormat' is BINARY, and the two text layouts of the ".dat"
+ * files: the legacy one ('OutputFormat = TEXT') and the one with a single
+ * time column in ns ('OutputFormat = TEXT_NS'). It doesn't depend on the CAEN
+ * libraries, so that the offline tool (see tools/tdcrOffline.c) can link it.
+ *
+ * A binary run file is made of:
+ * - a header of RUN_FILE_HEADER_SIZE bytes: a runFileHeader_t followed by the
+ *   text header that printParamsHeaderToFile() writes at the beginning of a
+ *   ".dat" file (NUL padded);
+ * - with RUN_FILE_CONTENT_EVENTS ('OutputFormat = BINARY'), the records (see
+ *   psdEvent.h), written by the acquisition in blocks whose size is a
+ *   multiple of RUN_FILE_HEADER_SIZE, so that every write of the run starts
+ *   at a block aligned offset;
+ * - with RUN_FILE_CONTENT_RAW ('OutputFormat = RAW'), one frame for each
+ *   buffer returned by CAEN_DGTZ_ReadData(): a runFileFrame_t followed by the
+ *   buffer, written verbatim ('size' bytes). The buffers are decoded offline
+ *   (see the 'decode' command of tdcrOffline);
+ * - with RUN_FILE_CONTENT_TRACES (readout option 'Waveforms'), the samples of
+ *   the events acquired in Mixed or Oscilloscope mode: one record for each
+ *   event with samples, a runFileTrace_t (that carries the event record)
+ *   followed by the samples of its traces (uint16_t, the samples of the
+ *   second trace after those of the first one with the dual trace), padded
+ *   to a multiple of 8 bytes. The records are followed by the index, the
+ *   offset of each record from the beginning of the file (uint64_t), and by
+ *   a runFileTraceIndex_t at the very end of the file: the record n is read
+ *   with two seeks whatever the size of the file. A file without the index
+ *   (run not ended normally) can still be walked record by record.
+ * All the numbers are little endian. When the output is split into segments
+ * (see runWriter.h) each segment is a run file with its own header.
+ *
+ * The text lines of the events are written by formatRunFileText(), that
+ * produces exactly the bytes of fprintf(RUN_FILE_TEXT_LINE) (or of
+ * fprintf(RUN_FILE_TEXT_NS_LINE)) without going through printf: the digits
+ * are written two at a time from a lookup table into fields of fixed width,
+ * and a whole batch of records is formatted into one buffer. The legacy
+ * layout writes the 31-bit time tag and the rollovers (ExtendedTT) apart, as
+ * the analysis scripts read them; the RUN_FILE_TEXT_NS layout writes the
+ * time of each event as a single column, the extended time tag in ns
+ * (PSD_EVENT_TIME_NS(), see psdEvent.h).
+ *
+ * 'runFile' module version: a0.8
+ */
+
+#ifndef _RUN_FILE
+  #define _RUN_FILE
+  #include <stdio.h>
+  #include <stdint.h>
+  #include <stddef.h>
+  #include "psdEvent.h"
+
+  #define RUN_FILE_MAGIC "TDCRRUN"            /* 7 chars + NUL */
+  /* 2: the records may carry a fine time (see psdEvent.h); the files of
+     version 1 are still read */
+  #define RUN_FILE_VERSION 2
+  #define RUN_FILE_HEADER_SIZE 4096
+  /* values of runFileHeader_t.content */
+  #define RUN_FILE_CONTENT_EVENTS 1           /* psdEvent_t records */
+  #define RUN_FILE_CONTENT_RAW 2              /* framed readout buffers */
+  #define RUN_FILE_CONTENT_TRACES 3           /* waveform records and their index */
+  /* first word of each frame of a RUN_FILE_CONTENT_RAW file ("FRME") */
+  #define RUN_FILE_FRAME_SYNC 0x454D5246u
+  /* first word of each record of a RUN_FILE_CONTENT_TRACES file ("TRCE") */
+  #define RUN_FILE_TRACE_SYNC 0x45435254u
+  /* first word of the trailer of a RUN_FILE_CONTENT_TRACES file ("INDX") */
+  #define RUN_FILE_INDEX_SYNC 0x58444E49u
+  /* bytes of a waveform record with 'samples' samples in each of its
+     'traces' traces */
+  #define RUN_FILE_TRACE_SIZE(samples, traces) ((sizeof(runFileTrace_t) + (size_t)(samples) * (traces) * 2 + 7) & ~(size_t)7)
+
+  /* legacy text layout of the ".dat" files: the columns line written after
+     the text header and the format of a line of event */
+  #define RUN_FILE_TEXT_COLUMNS "#    ch       timestamp       Qs       Ql           ExtendedTT\n"
+  #define RUN_FILE_TEXT_LINE "%7d, %15lu, %7d, %7d, %15lu\n"
+  /* text layout with the time in ns: the columns line and the format of a
+     line of event */
+  #define RUN_FILE_TEXT_NS_COLUMNS "#    ch       time (ns)       Qs       Ql\n"
+  #define RUN_FILE_TEXT_NS_LINE "%7d, %15lu, %7d, %7d\n"
+  /* text layouts of formatRunFileText() */
+  #define RUN_FILE_TEXT_LEGACY 0      /* RUN_FILE_TEXT_LINE */
+  #define RUN_FILE_TEXT_NS     1      /* RUN_FILE_TEXT_NS_LINE */
+  /* channel number written in a text line for the channel 'ch' of the board
+     'board' (the boards are numbered from 0) */
+  #define RUN_FILE_TEXT_CHANNEL(board, ch) ((board) * 8 + (ch))
+  /* max length of a text line written by formatRunFileText() */
+  #define RUN_FILE_TEXT_MAX_LINE 96
+
+  typedef struct
+  {
+    char magic[8];              /* RUN_FILE_MAGIC */
+    uint32_t version;           /* RUN_FILE_VERSION */
+    uint32_t headerSize;        /* RUN_FILE_HEADER_SIZE */
+    uint32_t content;           /* RUN_FILE_CONTENT_* */
+    uint32_t recordSize;        /* bytes of each record */
+    uint32_t chargeMask;        /* mask applied to the charges of the text output */
+    uint32_t textHeaderSize;    /* bytes of the text header */
+    int64_t startTime;          /* time the file was created (seconds since the Epoch) */
+  } runFileHeader_t;
+
+  /* Header of a frame of a RUN_FILE_CONTENT_RAW file */
+  typedef struct
+  {
+    uint32_t sync;              /* RUN_FILE_FRAME_SYNC */
+    uint32_t board;             /* index of the board the buffer comes from */
+    uint64_t stamp;             /* wall-clock time of the readout (ns since the Epoch) */
+    uint32_t size;              /* bytes of the readout buffer that follows */
+    uint32_t reserved;
+  } runFileFrame_t;
+
+  /* Header of a waveform record of a RUN_FILE_CONTENT_TRACES file */
+  typedef struct
+  {
+    uint32_t sync;              /* RUN_FILE_TRACE_SYNC */
+    uint32_t size;              /* bytes of the record, this header and the padding included */
+    uint32_t numSamples;        /* samples of each trace */
+    uint32_t numTraces;         /* 1, 2 with the dual trace */
+    psdEvent_t event;           /* the event the samples belong to */
+  } runFileTrace_t;
+
+  /* Trailer of a RUN_FILE_CONTENT_TRACES file */
+  typedef struct
+  {
+    uint32_t sync;              /* RUN_FILE_INDEX_SYNC */
+    uint32_t reserved;
+    uint64_t count;             /* number of records */
+    uint64_t offset;            /* offset of the index (count uint64_t) */
+  } runFileTraceIndex_t;
+
+  /* Builds the header of a binary run file.
+   *
+   * @param block where the header is built (RUN_FILE_HEADER_SIZE bytes)
+   * @param content the content of the file (RUN_FILE_CONTENT_*)
+   * @param recordSize the size of each record (0 for RUN_FILE_CONTENT_RAW)
+   * @param chargeMask the mask applied to the charges of the text output
+   * @param textHeader the text written by printParamsHeaderToFile()
+   * @param textHeaderSize the length of 'textHeader'
+   * @return 0 on success, otherwise a non-zero integer (a description is
+   * printed to stderr)
+   */
+  extern int buildRunFileHeader(char *block, uint32_t content, uint32_t recordSize, uint32_t chargeMask, const char *textHeader, size_t textHeaderSize);
+  /* Writes the header of a binary run file at the beginning of 'fp'.
+   *
+   * @param fp the file, opened in binary mode
+   * @param content the content of the file (RUN_FILE_CONTENT_*)
+   * @param recordSize the size of each record (0 for RUN_FILE_CONTENT_RAW)
+   * @param chargeMask the mask applied to the charges of the text output
+   * @param textHeader the text written by printParamsHeaderToFile()
+   * @param textHeaderSize the length of 'textHeader'
+   * @return 0 on success, otherwise a non-zero integer (a description is
+   * printed to stderr)
+   */
+  extern int writeRunFileHeader(FILE *fp, uint32_t content, uint32_t recordSize, uint32_t chargeMask, const char *textHeader, size_t textHeaderSize);
+  /* Reads and checks the header of a binary run file. On success the file
+   * position is on the first record.
+   *
+   * @param fp the file, opened in binary mode
+   * @param header the header read
+   * @param textHeader where the text header is copied, NUL terminated (at
+   * least RUN_FILE_HEADER_SIZE bytes)
+   * @return 0 on success, otherwise a non-zero integer (a description is
+   * printed to stderr)
+   */
+  extern int readRunFileHeader(FILE *fp, runFileHeader_t *header, char *textHeader);
+  /* Positions a RUN_FILE_CONTENT_TRACES file on the header of the waveform
+   * record 'n' (from 0): through the index at the end of the file or, if the
+   * file has no index, walking the records from the first one.
+   *
+   * @param fp the file, opened in binary mode
+   * @param n the number of the record
+   * @param count where the number of records is written (without the index,
+   * the number of records walked)
+   * @return 0 on success, otherwise a non-zero integer (a description is
+   * printed to stderr)
+   */
+  extern int seekRunFileTrace(FILE *fp, uint64_t n, uint64_t *count);
+  /* Writes the text lines of records (RUN_FILE_TEXT_LINE or
+   * RUN_FILE_TEXT_NS_LINE), byte for byte as sprintf() would.
+   *
+   * @param dst where the lines are written (at least count *
+   * RUN_FILE_TEXT_MAX_LINE bytes), not NUL terminated
+   * @param ev the records
+   * @param count the number of records
+   * @param chargeMask the mask applied to the charges
+   * @param layout RUN_FILE_TEXT_LEGACY or RUN_FILE_TEXT_NS
+   * @return the number of bytes written
+   */
+  extern size_t formatRunFileText(char *dst, const psdEvent_t *ev, size_t count, uint32_t chargeMask, int layout);
+#endif
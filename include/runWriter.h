@@ -0,0 +1,168 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'runWriter' writes the output of a run (text lines, binary
+ * records or raw frames, see runFile.h) to one file or to a sequence of
+ * numbered segment files.
+ *
+ * Three sinks are available (readout option 'OutputWriter'):
+ * - RUN_WRITER_STDIO: the data goes through fwrite() on a FILE opened with
+ *   fopen(), as the program always did;
+ * - RUN_WRITER_MMAP: the file is preallocated with fallocate() in extents of
+ *   RUN_WRITER_EXTENT bytes, so that a long run doesn't end up in a
+ *   fragmented file, and it is written through a mapping of
+ *   RUN_WRITER_WINDOW bytes (mmap()) that slides along the file: a write is a
+ *   memcpy() into the page cache, without system calls but at the window
+ *   boundaries. When the segment is closed the preallocated bytes not
+ *   written are truncated;
+ * - RUN_WRITER_URING: the data is copied into aligned buffers of
+ *   RUN_WRITER_URING_BLOCK bytes; each full buffer is submitted to an io_uring
+ *   (raw system calls, kernel 5.6 or later) and the writer goes on filling the
+ *   next one, with up to 'queueDepth' writes in flight. A buffer is reused when
+ *   its write is completed: the writer waits only if all of them are still in
+ *   flight, which bounds both the memory and the disk bandwidth taken by the
+ *   output. With 'direct' the file is opened with O_DIRECT, so the data never
+ *   goes through the page cache and the writer never meets the writeback of
+ *   the kernel; the last block of a segment is padded to RUN_WRITER_URING_ALIGN
+ *   bytes and the file is then truncated to the bytes written. Where O_DIRECT
+ *   is not supported (tmpfs...) the file is written through the page cache.
+ *   The file is preallocated as with RUN_WRITER_MMAP.
+ *
+ * With a size or a time limit (readout options 'SegmentSize' and
+ * 'SegmentPeriod') the output is split into segments: the file
+ * "<name>.<ext>" becomes "<name>_0000.<ext>", "<name>_0001.<ext>" ... Every
+ * segment starts with the same header (the text header of
+ * printParamsHeaderToFile() or the header of a binary run file), so each of
+ * them can be read on its own. A segment is closed only between two blocks of
+ * whole records (see runWriterCheckRotation()): it can exceed the size limit
+ * by the size of the last block.
+ *
+ * A writer is used by one thread at a time.
+ *
+ * 'runWriter' module version: a0.4
+ */
+
+#ifndef _RUN_WRITER
+  #define _RUN_WRITER
+  #include <stdio.h>
+  #include <stdint.h>
+
+  /* sinks (values of the option 'OutputWriter') */
+  #define RUN_WRITER_STDIO 0
+  #define RUN_WRITER_MMAP  1
+  #define RUN_WRITER_URING 2
+  #define RUN_WRITER_COUNT 3    /* number of sinks */
+  /* size of the mapping that slides along the file (RUN_WRITER_MMAP) */
+  #define RUN_WRITER_WINDOW (32u << 20)
+  /* size of the extents preallocated with fallocate() (multiple of
+     RUN_WRITER_WINDOW) */
+  #define RUN_WRITER_EXTENT (128u << 20)
+  /* size of the buffers of RUN_WRITER_URING: the size of each write */
+  #define RUN_WRITER_URING_BLOCK (4u << 20)
+  /* alignment of the buffers and of the length of the last write
+     (RUN_WRITER_URING with O_DIRECT) */
+  #define RUN_WRITER_URING_ALIGN 4096u
+  /* max number of writes in flight (RUN_WRITER_URING) */
+  #define RUN_WRITER_URING_MAX_DEPTH 64
+  /* max length of a file name (NUL included) */
+  #define RUN_WRITER_NAME_SIZE 300
+
+  typedef struct
+  {
+    /* configuration, set by openRunWriter() */
+    int sink;                   /* RUN_WRITER_STDIO / RUN_WRITER_MMAP / RUN_WRITER_URING */
+    int direct;                 /* RUN_WRITER_URING: the files are opened with O_DIRECT */
+    int queueDepth;             /* RUN_WRITER_URING: max writes in flight */
+    char baseName[RUN_WRITER_NAME_SIZE];
+    char extension[16];         /* ".dat", ".bin", ".raw" */
+    uint64_t segmentSize;       /* bytes, 0: no limit */
+    uint64_t segmentPeriod;     /* ms, 0: no limit */
+    char *header;               /* written at the beginning of each segment */
+    size_t headerSize;
+
+    /* current segment */
+    int segment;                /* number of the segment (from 0) */
+    char fileName[RUN_WRITER_NAME_SIZE];
+    uint64_t size;              /* bytes written to the segment */
+    uint64_t openTime;          /* time the segment was opened (CLOCK_MONOTONIC, ms) */
+    FILE *fp;                   /* RUN_WRITER_STDIO */
+    int fd;                     /* RUN_WRITER_MMAP / RUN_WRITER_URING */
+    char *window;               /* mapping of [windowStart, windowStart + RUN_WRITER_WINDOW) */
+    uint64_t windowStart;
+    uint64_t allocated;         /* bytes preallocated */
+    struct runWriterUring *uring;   /* RUN_WRITER_URING: the ring and the buffers */
+
+    uint64_t totalBytes;        /* bytes written to all the segments */
+    uint64_t maxWriteNs;        /* longest call of runWriterWrite() */
+    uint64_t waits;             /* RUN_WRITER_URING: waits for a write in flight to complete */
+    uint64_t waitNs;            /* RUN_WRITER_URING: time spent in these waits */
+  } runWriter_t;
+
+  /* Opens the first segment (or the only file) of the output and writes the
+   * header to it.
+   *
+   * @param w the writer to open
+   * @param sink RUN_WRITER_STDIO, RUN_WRITER_MMAP or RUN_WRITER_URING
+   * @param direct RUN_WRITER_URING: open the files with O_DIRECT
+   * @param queueDepth RUN_WRITER_URING: max writes in flight (1 to
+   * RUN_WRITER_URING_MAX_DEPTH)
+   * @param baseName the name of the output without the extension
+   * @param extension the extension of the files (".dat", ".bin", ".raw")
+   * @param header the header written at the beginning of each segment
+   * @param headerSize the length of 'header'
+   * @param segmentSize the size limit of a segment (bytes), 0: no limit
+   * @param segmentPeriod the time limit of a segment (s), 0: no limit
+   * @return 0 on success, -1 in case of error (a description is printed to
+   * stderr)
+   */
+  extern int openRunWriter(runWriter_t *w, int sink, int direct, int queueDepth, const char *baseName, const char *extension, const char *header, size_t headerSize,
+                           uint64_t segmentSize, unsigned long segmentPeriod);
+  /* Writes data to the current segment.
+   *
+   * @param w the writer
+   * @param data the data
+   * @param size the number of bytes
+   * @return 0 on success, -1 in case of error (a description is printed to
+   * stderr)
+   */
+  extern int runWriterWrite(runWriter_t *w, const void *data, size_t size);
+  /* Called between two blocks of whole records: closes the current segment
+   * and opens the next one if the size or the time limit is reached.
+   *
+   * @param w the writer
+   * @return 0 on success, -1 in case of error (a description is printed to
+   * stderr)
+   */
+  extern int runWriterCheckRotation(runWriter_t *w);
+  /* Puts the data written so far in the file (RUN_WRITER_STDIO: fflush(),
+   * RUN_WRITER_URING: waits for the writes in flight and writes the buffer
+   * being filled).
+   *
+   * @param w the writer
+   * @return 0 on success, -1 in case of error (a description is printed to
+   * stderr)
+   */
+  extern int runWriterFlush(runWriter_t *w);
+  /* Closes the current segment and frees the writer.
+   *
+   * @param w the writer
+   * @return 0 on success, -1 in case of error (a description is printed to
+   * stderr)
+   */
+  extern int closeRunWriter(runWriter_t *w);
+  /* Writes the name of a segment file into 'name'.
+   *
+   * @param w the writer
+   * @param segment the number of the segment
+   * @param name where the name is written (RUN_WRITER_NAME_SIZE bytes)
+   * @return 0 on success, -1 if the name was truncated (not for the segments
+   * of a writer opened by openRunWriter(), that checks the length of the
+   * names)
+   */
+  extern int runWriterSegmentName(const runWriter_t *w, int segment, char *name);
+  /* Prints the sink and the write statistics of the writer on one line.
+   *
+   * @param w the writer
+   * @param fp the stream
+   */
+  extern void printRunWriterStats(const runWriter_t *w, FILE *fp);
+#endif
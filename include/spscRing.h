@@ -0,0 +1,72 @@
+/* The module 'spscRing' offers a bounded single-producer / single-consumer
+ * lock-free ring of pointers. Exactly one thread may call spscRingPush() and
+ * exactly one (other) thread may call spscRingPop() on the same ring: under
+ * this rule no lock is needed, the two ends only exchange the 'head' and
+ * 'tail' indexes through C11 atomics (release / acquire ordering).
+ * The ring keeps track of its high-water mark so that the occupancy peak of a
+ * pipeline stage can be displayed.
+ *
+ * 'spscRing' module version: a0.1
+ */
+
+#ifndef _SPSC_RING
+  #define _SPSC_RING
+  #include <stdatomic.h>
+
+  typedef struct
+  {
+    void **slots;                       /* 'capacity' pointers */
+    unsigned long mask;                 /* capacity - 1 (capacity is a power of 2) */
+    _Alignas(64) atomic_ulong head;     /* next slot to write, owned by the producer */
+    _Alignas(64) atomic_ulong tail;     /* next slot to read, owned by the consumer */
+    _Alignas(64) atomic_ulong highWater;/* max occupancy seen by the producer */
+  } spscRing_t;
+
+  /* Allocates the slots of 'ring' and sets it empty. 'capacity' must be a
+   * power of 2.
+   *
+   * @param ring the ring to initialize
+   * @param capacity the max number of pointers the ring can hold
+   * @return 0 on success, -1 if 'capacity' is not a power of 2 or if the
+   * memory can't be allocated
+   */
+  extern int spscRingInit(spscRing_t *ring, unsigned long capacity);
+  /* Frees the memory allocated by spscRingInit().
+   *
+   * @param ring the ring to free
+   */
+  extern void spscRingFree(spscRing_t *ring);
+  /* Appends 'item' to the ring. Must be called only by the producer thread.
+   *
+   * @param ring the ring to write to
+   * @param item the pointer to append
+   * @return 1 if 'item' was appended, 0 if the ring is full
+   */
+  extern int spscRingPush(spscRing_t *ring, void *item);
+  /* Removes the oldest pointer of the ring. Must be called only by the
+   * consumer thread.
+   *
+   * @param ring the ring to read from
+   * @return the oldest pointer of the ring or NULL if the ring is empty
+   */
+  extern void *spscRingPop(spscRing_t *ring);
+  /* Returns the number of pointers currently stored in the ring. The value
+   * is a snapshot: it can be called by any thread.
+   *
+   * @param ring the ring to inspect
+   * @return the current occupancy of the ring
+   */
+  extern unsigned long spscRingOccupancy(spscRing_t *ring);
+  /* Returns the max occupancy reached by the ring since spscRingInit().
+   *
+   * @param ring the ring to inspect
+   * @return the high-water mark of the ring
+   */
+  extern unsigned long spscRingHighWater(spscRing_t *ring);
+  /* Returns the capacity of the ring.
+   *
+   * @param ring the ring to inspect
+   * @return the max number of pointers the ring can hold
+   */
+  extern unsigned long spscRingCapacity(spscRing_t *ring);
+#endif
@@ -0,0 +1,75 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'statusDisplay' shows the state of the acquisition once per
+ * second: elapsed time, readout rate, trigger rate and total events of each
+ * channel (and the triggers lost by the board with the TRIGGER_COUNTERS
+ * 'Extras'), TDCR coincidences and pipeline statistics (see acqPipeline.h).
+ *
+ * The display is rendered by a thread of its own, with the lowest scheduling
+ * priority (SCHED_IDLE where available): the values are the atomic counters
+ * of the pipeline, so no other thread ever waits for the display, and the
+ * display never delays the readout, decode or writer threads. Each frame is
+ * formatted in memory and written with a single fwrite(). When stdout is a
+ * terminal the frame is drawn in place with ANSI escape sequences (cursor
+ * home, clear to end of line / screen) instead of spawning "clear"; otherwise
+ * the frames are appended one after the other.
+ * On request (toggleStatusDisplayLatency()) the frame also shows the latency
+ * percentiles of the steps of the pipeline (see printAcqPipelineLatency()).
+ *
+ * 'statusDisplay' module version: a0.3
+ */
+
+#ifndef _STATUS_DISPLAY
+  #define _STATUS_DISPLAY
+  #include <stdint.h>
+  #include <stdatomic.h>
+  #include <pthread.h>
+  #include "acqPipeline.h"
+
+  /* period of the display (milliseconds) */
+  #define STATUS_DISPLAY_PERIOD_MS 1000
+
+  typedef struct
+  {
+    /* configuration, set by startStatusDisplay() */
+    acqPipeline_t *pipeline;
+    const char *fileName;       /* name of the output file */
+    const int *linkNum;         /* link number of each board */
+    uint64_t startTime;         /* start of the acquisition (get_time(), ms) */
+    int tty;                    /* stdout is a terminal: draw in place */
+
+    /* state of the display thread: the counters at the previous frame */
+    uint64_t prevTime;
+    unsigned long prevBytes;
+    unsigned long prevEvents[MAXNB][MaxNChannels];
+    unsigned long prevCoinc[TDCR_NUM_COUNTS];
+
+    atomic_int showLatency;     /* show the latency of the pipeline steps */
+    atomic_int stop;
+    pthread_t thread;
+    int started;
+  } statusDisplay_t;
+
+  /* Starts the display thread. The pipeline must be started.
+   *
+   * @param s the display
+   * @param p the running pipeline
+   * @param fileName the name of the output file
+   * @param linkNum the link number of each board
+   * @param startTime the start of the acquisition (get_time(), ms)
+   * @return 0 on success, -1 if the thread can't be created (a description
+   * is printed)
+   */
+  extern int startStatusDisplay(statusDisplay_t *s, acqPipeline_t *p, const char *fileName, const int *linkNum, uint64_t startTime);
+  /* Stops the display thread and waits until it exits.
+   *
+   * @param s the display
+   */
+  extern void stopStatusDisplay(statusDisplay_t *s);
+  /* Shows the latency of the pipeline steps from the next frame on, or hides
+   * it if it is shown. Can be called by any thread.
+   *
+   * @param s the display
+   */
+  extern void toggleStatusDisplayLatency(statusDisplay_t *s);
+#endif
@@ -0,0 +1,94 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'tdcrCoinc' counts online the coincidences of the three PMTs of
+ * the TDCR counter (A, B and C: the channels TDCR_CH_A, TDCR_CH_B and
+ * TDCR_CH_C of the board TDCR_BOARD) from the time ordered records of the
+ * time merge (see timeMerge.h).
+ *
+ * The resolving time is applied as a non-paralyzable window: the first pulse
+ * of any PMT opens a window of 'resolving time' length, the pulses of the
+ * PMTs within the window (its start and end included) join it and don't
+ * extend it; the first pulse after the end closes the window and opens the
+ * next one. When a window is closed it is counted according to the PMTs that
+ * fired in it:
+ *   AB, BC, AC   the two PMTs fired (whatever the third did)
+ *   D            at least two PMTs fired (logical sum of the doubles)
+ *   T            the three PMTs fired
+ * so that TDCR = T / D. Each record is looked at once and a window is closed
+ * with a few bit tests: the cost is O(1) per event.
+ * The records flagged PSD_EVENT_FLAG_LATE (written out of order by the time
+ * merge) are not counted, only the number of them is kept.
+ * The times are those of PSD_EVENT_FINE_TIME() (see psdEvent.h): the time tag
+ * corrected by the fine time when the record has one ('CfdDelay' readout
+ * option), so that the resolving time is applied with a resolution better
+ * than the 4 ns of the time tag. The merge orders the records by their time
+ * tag: a record older than the pulse that opened the window by its fine time
+ * joins the window.
+ *
+ * 'tdcrCoinc' module version: a0.2
+ */
+
+#ifndef _TDCR_COINC
+  #define _TDCR_COINC
+  #include <stdio.h>
+  #include <stdint.h>
+  #include "psdEvent.h"
+  #include "psdDecoder.h"
+
+  /* channels of the PMTs */
+  #define TDCR_BOARD 0
+  #define TDCR_CH_A 0
+  #define TDCR_CH_B 2
+  #define TDCR_CH_C 3
+  /* indexes of the coincidence counters */
+  #define TDCR_AB 0
+  #define TDCR_BC 1
+  #define TDCR_AC 2
+  #define TDCR_D  3
+  #define TDCR_T  4
+  #define TDCR_NUM_COUNTS 5
+
+  /* names of the coincidence counters ("AB", ... "T") */
+  extern const char *tdcrCoincNames[TDCR_NUM_COUNTS];
+
+  typedef struct
+  {
+    int64_t window;                         /* resolving time (1/PSD_EVENT_FINE_UNITS of a time tag unit) */
+    unsigned long windowNs;                 /* resolving time (ns) */
+    uint8_t pmtBit[PSD_MAX_CHANNELS];       /* bit of the PMT of each channel of TDCR_BOARD (0: not a PMT) */
+    int open;                               /* a window is open */
+    int64_t start;                          /* time of the pulse that opened it (PSD_EVENT_FINE_TIME()) */
+    unsigned fired;                         /* bits of the PMTs fired in it (A: 1, B: 2, C: 4) */
+    uint64_t counts[TDCR_NUM_COUNTS];       /* closed windows, TDCR_AB ... TDCR_T */
+    uint64_t late;                          /* records not counted (PSD_EVENT_FLAG_LATE) */
+  } tdcrCoinc_t;
+
+  /* Initializes the counters.
+   *
+   * @param c the coincidence counters
+   * @param windowNs the resolving time (ns)
+   */
+  extern void initTdcrCoinc(tdcrCoinc_t *c, unsigned long windowNs);
+  /* Counts the coincidences of time ordered records. The records of the
+   * channels that are not a PMT are skipped.
+   *
+   * @param c the coincidence counters
+   * @param ev the records, in time order
+   * @param count the number of records
+   */
+  extern void tdcrCoincPush(tdcrCoinc_t *c, const psdEvent_t *ev, uint32_t count);
+  /* Closes the window still open at the end of the run.
+   *
+   * @param c the coincidence counters
+   */
+  extern void tdcrCoincFlush(tdcrCoinc_t *c);
+  /* Writes the coincidence counts and rates to a run summary.
+   *
+   * @param fp the summary file
+   * @param counts the counters (TDCR_NUM_COUNTS)
+   * @param windowNs the resolving time (ns)
+   * @param seconds the duration of the acquisition (s)
+   * @return 0 on success, otherwise a non-zero integer
+   */
+  extern int printTdcrCoincSummary(FILE *fp, const uint64_t *counts, unsigned long windowNs, double seconds);
+#endif
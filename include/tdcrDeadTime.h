@@ -0,0 +1,120 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'tdcrDeadTime' imposes a dead time on the time ordered records of
+ * the PMTs of the TDCR counter before their coincidences are counted (see
+ * tdcrCoinc.h), as the dead time unit of a coincidence module does: the
+ * counts are then corrected with a live time that is known exactly instead
+ * of with the dead time of the acquisition chain.
+ *
+ * Two stages are applied one after the other, each one only if its length
+ * is not 0:
+ * - the dead time of each PMT: a pulse of the PMT that is not dead starts a
+ *   dead time of the length of its channel, the next pulses of the PMT during
+ *   it are rejected;
+ * - the common dead time: a pulse of any PMT that is not dead starts a dead
+ *   time common to the three PMTs. The pulses within the resolving time of
+ *   the coincidences after it (its start and end included, as the window of
+ *   tdcrCoinc.h) pass: they are the coincident pulses of the same event; the
+ *   next ones, until the end of the dead time, are rejected. The common dead
+ *   time is therefore not shorter than the resolving time.
+ * A dead time is either non-extendable (TDCR_DEAD_NON_EXTENDABLE): it lasts
+ * its length from the pulse that started it, or extendable
+ * (TDCR_DEAD_EXTENDABLE): each pulse that comes during it, rejected or not,
+ * restarts it, so that it ends its length after the last of these pulses.
+ *
+ * The real time of a stage is the time from the first to the last record it
+ * has seen and its live time is the real time minus the time it was dead
+ * (the dead time still running is cut at the last record). The live time of
+ * the common dead time is the one to divide the coincidence counts by.
+ *
+ * The times are those of PSD_EVENT_FINE_TIME() (see psdEvent.h), in integer
+ * arithmetic. Each record is compared with the end of the dead time of its
+ * PMT and of the common stage: the cost is O(1) per event and the state a
+ * few integers per stage. The records flagged PSD_EVENT_FLAG_LATE pass
+ * without being looked at (tdcrCoinc doesn't count them); the records of the
+ * channels that are not a PMT are dropped.
+ *
+ * 'tdcrDeadTime' module version: a0.2
+ */
+
+#ifndef _TDCR_DEAD_TIME
+  #define _TDCR_DEAD_TIME
+  #include <stdio.h>
+  #include <stdint.h>
+  #include "psdEvent.h"
+  #include "psdDecoder.h"
+  #include "tdcrCoinc.h"
+
+  /* kinds of dead time (the option 'DeadTimeMode' of readoutOptions.h) */
+  #define TDCR_DEAD_NON_EXTENDABLE 0
+  #define TDCR_DEAD_EXTENDABLE     1
+  #define TDCR_DEAD_COUNT          2   /* number of kinds */
+  /* indexes of the stages: the PMTs A, B and C then the common dead time */
+  #define TDCR_DEAD_A      0
+  #define TDCR_DEAD_B      1
+  #define TDCR_DEAD_C      2
+  #define TDCR_DEAD_COMMON 3
+  #define TDCR_DEAD_STAGES 4
+
+  /* names of the stages ("A", "B", "C", "common") */
+  extern const char *tdcrDeadStageNames[TDCR_DEAD_STAGES];
+
+  /* A dead time stage; the times are in 1/PSD_EVENT_FINE_UNITS of a time tag
+     unit */
+  typedef struct
+  {
+    int64_t length;             /* 0: no dead time */
+    unsigned long lengthNs;
+    int started;                /* a record has been seen */
+    int64_t start, end;         /* the last dead time */
+    int64_t dead;               /* the dead times before the last one */
+    int64_t first, last;        /* times of the first and of the last record */
+    uint64_t input, rejected;   /* records */
+  } tdcrDeadStage_t;
+
+  typedef struct
+  {
+    int mode;                               /* TDCR_DEAD_NON_EXTENDABLE / TDCR_DEAD_EXTENDABLE */
+    int64_t window;                         /* resolving time of the coincidences */
+    uint8_t stage[PSD_MAX_CHANNELS];        /* 1 + the stage of the PMT of each channel of TDCR_BOARD (0: not a PMT) */
+    tdcrDeadStage_t stages[TDCR_DEAD_STAGES];
+  } tdcrDeadTime_t;
+
+  /* Initializes the dead time stages.
+   *
+   * @param d the dead time stages
+   * @param mode TDCR_DEAD_NON_EXTENDABLE or TDCR_DEAD_EXTENDABLE
+   * @param pmtNs the dead time of the PMTs A, B and C (ns, 0: none)
+   * @param commonNs the common dead time (ns, 0: none)
+   * @param windowNs the resolving time of the coincidences (ns, not longer
+   * than 'commonNs' if it is not 0)
+   * @return 0 on success, -1 if the common dead time is shorter than the
+   * resolving time (a description is printed to stderr)
+   */
+  extern int initTdcrDeadTime(tdcrDeadTime_t *d, int mode, const unsigned long *pmtNs, unsigned long commonNs, unsigned long windowNs);
+  /* Applies the dead times to time ordered records.
+   *
+   * @param d the dead time stages
+   * @param ev the records, in time order
+   * @param count the number of records
+   * @param out the records of the PMTs that pass (room for 'count' records)
+   * @return the number of records in 'out'
+   */
+  extern uint32_t tdcrDeadTimeFilter(tdcrDeadTime_t *d, const psdEvent_t *ev, uint32_t count, psdEvent_t *out);
+  /* @param s a dead time stage
+   * @return the real time of the stage (ns)
+   */
+  extern double tdcrDeadRealNs(const tdcrDeadStage_t *s);
+  /* @param s a dead time stage
+   * @return the live time of the stage (ns)
+   */
+  extern double tdcrDeadLiveNs(const tdcrDeadStage_t *s);
+  /* Writes the records, the real time and the live time of each stage to a
+   * run summary.
+   *
+   * @param fp the summary file
+   * @param d the dead time stages
+   * @return 0 on success, otherwise a non-zero integer
+   */
+  extern int printTdcrDeadTimeSummary(FILE *fp, const tdcrDeadTime_t *d);
+#endif
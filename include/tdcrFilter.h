@@ -0,0 +1,95 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'tdcrFilter' reduces the records written during a TDCR run to
+ * those of the coincidences: it sits between the time merge (see timeMerge.h)
+ * and the output blocks, and lets through only the records of the PMTs (see
+ * tdcrCoinc.h) that belong to at least a double coincidence, plus one single
+ * out of every 'prescale' for diagnostics.
+ *
+ * The windows are those of tdcrCoinc.h: the first pulse of any PMT opens a
+ * non-paralyzable window of 'resolving time' length, the pulses of the PMTs
+ * within it (start and end included) join it, the first pulse after its end
+ * closes it. When a window is closed its records are written if at least two
+ * PMTs fired in it; otherwise each of them is a single, counted and dropped
+ * (or, one out of 'prescale', written and flagged PSD_EVENT_FLAG_PRESCALED).
+ * The records of the open window are held by the filter until it is closed,
+ * by a later record or by tdcrFilterFlush() at the end of the run; the
+ * records of the other channels and boards and the records flagged
+ * PSD_EVENT_FLAG_LATE are not filtered, they are written in their place in
+ * the time order. The filter sees all the records of the PMTs: the dead time
+ * of tdcrDeadTime.h only applies to the coincidences counted online.
+ *
+ * The records written in coincidence, the singles written by the prescale,
+ * the singles dropped and the late records are counted exactly for each
+ * channel of TDCR_BOARD: the records of the PMTs that came out of the merge
+ * are their sum. The cost is O(1) per record, plus a copy.
+ *
+ * 'tdcrFilter' module version: a0.1
+ */
+
+#ifndef _TDCR_FILTER
+  #define _TDCR_FILTER
+  #include <stdio.h>
+  #include <stdint.h>
+  #include "psdEvent.h"
+  #include "psdDecoder.h"
+  #include "tdcrCoinc.h"
+
+  typedef struct
+  {
+    int64_t window;                         /* resolving time (1/PSD_EVENT_FINE_UNITS of a time tag unit) */
+    uint32_t prescale;                      /* one single out of 'prescale' is written, 0: none */
+    uint32_t nextSingle;                    /* singles before the next one written */
+    uint8_t pmtBit[PSD_MAX_CHANNELS];       /* bit of the PMT of each channel of TDCR_BOARD (0: not a PMT) */
+    int open;                               /* a window is open */
+    int64_t start;                          /* time of the pulse that opened it */
+    unsigned fired;                         /* bits of the PMTs fired in it */
+    psdEvent_t *pending;                    /* the records since the start of the open window */
+    uint32_t numPending, pendingCapacity;
+    psdEvent_t *out;                        /* the records written by the last call */
+    uint32_t numOut, outCapacity;
+    uint64_t coincident[PSD_MAX_CHANNELS];  /* records written in a coincidence */
+    uint64_t prescaled[PSD_MAX_CHANNELS];   /* singles written by the prescale */
+    uint64_t suppressed[PSD_MAX_CHANNELS];  /* singles dropped */
+    uint64_t late[PSD_MAX_CHANNELS];        /* records written without being filtered (PSD_EVENT_FLAG_LATE) */
+  } tdcrFilter_t;
+
+  /* Initializes the filter.
+   *
+   * @param f the filter
+   * @param windowNs the resolving time (ns)
+   * @param prescale one single out of 'prescale' is written, 0: none
+   * @return 0 on success, -1 if the memory can't be allocated
+   */
+  extern int initTdcrFilter(tdcrFilter_t *f, unsigned long windowNs, unsigned long prescale);
+  /* Frees the memory allocated by the filter.
+   *
+   * @param f the filter
+   */
+  extern void freeTdcrFilter(tdcrFilter_t *f);
+  /* Filters time ordered records. The records to write, those of the windows
+   * closed by these records and the records of the other channels before the
+   * open window, are put in 'out' ('numOut' of them).
+   *
+   * @param f the filter
+   * @param ev the records, in time order
+   * @param count the number of records
+   * @return 0 on success, -1 if the memory can't be allocated
+   */
+  extern int tdcrFilterPush(tdcrFilter_t *f, const psdEvent_t *ev, uint32_t count);
+  /* Closes the window still open at the end of the run: its records to write
+   * are put in 'out'.
+   *
+   * @param f the filter
+   * @return 0 on success, -1 if the memory can't be allocated
+   */
+  extern int tdcrFilterFlush(tdcrFilter_t *f);
+  /* Writes the records written and dropped by the filter for each PMT to a
+   * run summary.
+   *
+   * @param fp the summary file
+   * @param f the filter
+   * @return 0 on success, otherwise a non-zero integer
+   */
+  extern int printTdcrFilterSummary(FILE *fp, const tdcrFilter_t *f);
+#endif
@@ -0,0 +1,114 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'tdcrScan' counts the coincidences of the three PMTs of the TDCR
+ * counter (AB, BC, AC, D and T, see tdcrCoinc.h) for a list of resolving
+ * times at once, in a single pass over the time ordered records: the counts
+ * of each resolving time are exactly those of a tdcrCoinc_t with that
+ * resolving time. It is used offline on the binary run files (tdcrOffline
+ * scan) and online, on the records of the time merge, with the 'CoincScan'
+ * readout option.
+ *
+ * The windows are non-paralyzable, so that the windows of two resolving times
+ * split the pulses differently: each resolving time has its own window (its
+ * start and the PMTs fired in it). The nesting of the windows is used to
+ * handle them together as long as they were opened by the same pulse (the
+ * scan is then 'synced'): with the resolving times in ascending order, a
+ * pulse that comes no later than the shortest one after the start joins all
+ * the windows, a pulse that comes later than the longest one closes all of
+ * them and opens them again, both with a single test. Only a pulse in between
+ * closes the shortest windows and joins the longest ones: the windows are
+ * then handled one by one until a pulse closes all of them. At the rates of
+ * a TDCR counter most pulses come long after the longest window, so that
+ * the cost is O(1) per record for most of them and O(number of resolving
+ * times) only during the coincidences.
+ * A window is closed by adding 1 to the counter of the PMTs fired in it (one
+ * of 8 patterns, common to all the resolving times while the scan is synced):
+ * the counts AB ... T are computed from these counters by tdcrScanCounts().
+ *
+ * The records flagged PSD_EVENT_FLAG_LATE and the records of the channels
+ * that are not a PMT are skipped, as tdcrCoinc does.
+ *
+ * 'tdcrScan' module version: a0.1
+ */
+
+#ifndef _TDCR_SCAN
+  #define _TDCR_SCAN
+  #include <stdio.h>
+  #include <stdint.h>
+  #include "psdEvent.h"
+  #include "psdDecoder.h"
+  #include "tdcrCoinc.h"
+
+  /* max number of resolving times of a scan */
+  #define TDCR_SCAN_MAX_WINDOWS 32
+  /* max resolving time of a scan (ns), as the 'CoincWindow' readout option */
+  #define TDCR_SCAN_MAX_WINDOW_NS 1000000ul
+  /* patterns of the PMTs fired in a window (A: 1, B: 2, C: 4) */
+  #define TDCR_SCAN_PATTERNS 8
+
+  typedef struct
+  {
+    uint32_t numWindows;
+    unsigned long windowNs[TDCR_SCAN_MAX_WINDOWS];  /* resolving times (ns), in ascending order */
+    int64_t window[TDCR_SCAN_MAX_WINDOWS];          /* resolving times (1/PSD_EVENT_FINE_UNITS of a time tag unit) */
+    uint8_t pmtBit[PSD_MAX_CHANNELS];               /* bit of the PMT of each channel of TDCR_BOARD (0: not a PMT) */
+    int open;                                       /* a pulse has been seen: the windows are open */
+    int synced;                                     /* all the windows were opened by the same pulse */
+    int64_t start;                                  /* synced: time of the pulse that opened them */
+    unsigned fired;                                 /* synced: PMTs fired in them */
+    int64_t end;                                    /* not synced: end of the last window to close */
+    int64_t starts[TDCR_SCAN_MAX_WINDOWS];          /* not synced: start of each window */
+    uint8_t fireds[TDCR_SCAN_MAX_WINDOWS];          /* not synced: PMTs fired in each window */
+    uint64_t syncedClosed[TDCR_SCAN_PATTERNS];      /* windows closed while synced (for each resolving time) */
+    uint64_t closed[TDCR_SCAN_MAX_WINDOWS][TDCR_SCAN_PATTERNS];  /* windows of each resolving time closed while not synced */
+    uint64_t late;                                  /* records not counted (PSD_EVENT_FLAG_LATE) */
+  } tdcrScan_t;
+
+  /* Parses a list of resolving times separated by ',' (e.g. "10,20,40").
+   *
+   * @param list the list
+   * @param windowsNs the resolving times (ns, 1 to TDCR_SCAN_MAX_WINDOW_NS;
+   * room for TDCR_SCAN_MAX_WINDOWS)
+   * @param numWindows the number of resolving times (0 for an empty list)
+   * @return 0 on success, -1 if the list is not valid
+   */
+  extern int parseTdcrScanWindows(const char *list, unsigned long *windowsNs, uint32_t *numWindows);
+  /* Initializes the scan.
+   *
+   * @param s the scan
+   * @param windowsNs the resolving times (ns, in any order)
+   * @param numWindows the number of resolving times (1 to
+   * TDCR_SCAN_MAX_WINDOWS)
+   * @return 0 on success, -1 if a parameter is out of range (a description
+   * is printed to stderr)
+   */
+  extern int initTdcrScan(tdcrScan_t *s, const unsigned long *windowsNs, uint32_t numWindows);
+  /* Counts the coincidences of time ordered records for each resolving time.
+   *
+   * @param s the scan
+   * @param ev the records, in time order
+   * @param count the number of records
+   */
+  extern void tdcrScanPush(tdcrScan_t *s, const psdEvent_t *ev, uint32_t count);
+  /* Closes the windows still open at the end of the run.
+   *
+   * @param s the scan
+   */
+  extern void tdcrScanFlush(tdcrScan_t *s);
+  /* Computes the coincidence counts of a resolving time.
+   *
+   * @param s the scan
+   * @param k the index of the resolving time (in 'windowNs')
+   * @param counts the counters (TDCR_NUM_COUNTS, TDCR_AB ... TDCR_T)
+   */
+  extern void tdcrScanCounts(const tdcrScan_t *s, uint32_t k, uint64_t *counts);
+  /* Writes the coincidence counts and rates of each resolving time to a run
+   * summary.
+   *
+   * @param fp the summary file
+   * @param s the scan
+   * @param seconds the duration of the acquisition (s)
+   * @return 0 on success, otherwise a non-zero integer
+   */
+  extern int printTdcrScanSummary(FILE *fp, const tdcrScan_t *s, double seconds);
+#endif
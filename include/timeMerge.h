@@ -0,0 +1,103 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'timeMerge' puts back in time order the records (see psdEvent.h)
+ * of several streams. The decoders return the events of a readout buffer
+ * grouped by board and by channel: within a channel the extended timestamps
+ * always increase, but two channels (or two boards) can be read out minutes
+ * apart, since each channel aggregate is sent by the board when it is full.
+ *
+ * Each stream (one for each channel of each board) keeps the records pushed
+ * and not yet popped in a ring. The streams with pending records are ordered
+ * by the timestamp of their first record in a binary heap, so that popping a
+ * record is a k-way merge: O(log k) for k streams, and a run of records of the
+ * same stream that precede the first records of all the other streams is
+ * copied without touching the heap.
+ *
+ * A record can be popped only when no record with an older timestamp can be
+ * pushed any more. Since the streams are ordered, this is true for the records
+ * not newer than the last record pushed into every enabled stream. A quiet
+ * channel would then hold back the whole output: the reorder window bounds the
+ * wait, a record not newer than (newest timestamp pushed - window) is popped
+ * anyway. A record pushed after newer records were popped (an aggregate that
+ * came later than the window) is popped as soon as possible, with the flag
+ * PSD_EVENT_FLAG_LATE, and counted as late.
+ *
+ * The timestamps of the streams are compared as they are: the records of
+ * several boards are only in time order if the boards share the same clock
+ * and start their acquisition together. The acquisition program runs the
+ * boards with CAEN_DGTZ_RUN_SYNC_Disabled and starts them one after the
+ * other (CAEN_DGTZ_SWStartAcquisition()), so that the records of two boards
+ * are offset by the start delay and drift apart; a multi-board merge needs a
+ * synchronized clock and run start.
+ *
+ * 'timeMerge' module version: a0.2
+ */
+
+#ifndef _TIME_MERGE
+  #define _TIME_MERGE
+  #include <stdint.h>
+  #include "psdEvent.h"
+
+  /* max number of streams (one bit of the stream mask each) */
+  #define TIME_MERGE_MAX_STREAMS 64
+
+  /* Records of a stream pushed and not yet popped */
+  typedef struct
+  {
+    psdEvent_t *events;     /* ring of 'capacity' records (power of 2), allocated at the first push */
+    uint32_t capacity;
+    uint32_t first;         /* index of the oldest record */
+    uint32_t count;         /* records in the ring */
+    uint64_t last;          /* timestamp of the last record pushed */
+  } timeMergeStream_t;
+
+  typedef struct
+  {
+    timeMergeStream_t streams[TIME_MERGE_MAX_STREAMS];
+    uint64_t streamMask;    /* enabled streams */
+    /* streams with pending records, ordered by the timestamp of their first record */
+    int heap[TIME_MERGE_MAX_STREAMS];
+    int heapSize;
+    uint64_t window;        /* reorder window (time tag units, see PSD_TIMETAG_NS) */
+    uint64_t newest;        /* newest timestamp pushed */
+    uint64_t lastOut;       /* newest timestamp popped */
+    uint64_t pending;       /* records pushed and not yet popped */
+    uint64_t maxPending;    /* high-water mark of 'pending' */
+    uint64_t late;          /* records popped with PSD_EVENT_FLAG_LATE */
+  } timeMerge_t;
+
+  /* Initializes an empty merge.
+   *
+   * @param m the merge to initialize
+   * @param streamMask the enabled streams: bit s set for the stream s. Only
+   * the enabled streams hold back the output (see above)
+   * @param window the reorder window (time tag units)
+   */
+  extern void initTimeMerge(timeMerge_t *m, uint64_t streamMask, uint64_t window);
+  /* Frees the memory allocated by the merge.
+   */
+  extern void freeTimeMerge(timeMerge_t *m);
+  /* Appends records to a stream. The records must be in time order and not
+   * older than those already pushed into the same stream.
+   *
+   * @param m the merge
+   * @param stream the stream (< TIME_MERGE_MAX_STREAMS)
+   * @param ev the records
+   * @param count the number of records
+   * @return 0 on success, -1 if the memory can't be allocated (a description
+   * is printed to stderr)
+   */
+  extern int timeMergePush(timeMerge_t *m, int stream, const psdEvent_t *ev, uint32_t count);
+  /* Pops in time order the records that can't be preceded by a record pushed
+   * later (see above).
+   *
+   * @param m the merge
+   * @param flush non-zero at the end of the run: all the pending records are
+   * popped
+   * @param out where the records are copied
+   * @param max the max number of records to copy into 'out'
+   * @return the number of records copied into 'out': when it is 'max' more
+   * records may be ready
+   */
+  extern uint32_t timeMergePop(timeMerge_t *m, int flush, psdEvent_t *out, uint32_t max);
+#endif
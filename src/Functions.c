@@ -101,22 +101,56 @@ int DataConsistencyCheck(uint32_t *buff32, int NumWords)
 int SaveHistogram(char *basename, int b, int ch, uint32_t *EHisto)
 {
 	/*
-	This function saves the first 10000 bin of each EHisto[ch] array in separate text files
+	This function saves the 1<<MAXNBITS bins of the EHisto array in the text file <basename>_<b>_<ch>.txt
 	each array value is a number representing the histogram height in the corresponding bin
-	NB: each EHisto[ch] must be a pointer already initialized with at least 10000 values
+	NB: EHisto must be a pointer already initialized with at least 1<<MAXNBITS values
 	*/
     FILE *fh;
-    int i;
-    char filename[20];
-    sprintf(filename, "%s_%d_%d.txt", basename, b, ch);
+    int i, err;
+    char filename[MAX_HISTO_FILENAME];
+    if (snprintf(filename, MAX_HISTO_FILENAME, "%s_%d_%d.txt", basename, b, ch) >= MAX_HISTO_FILENAME)
+		return -1;
     fh = fopen(filename, "w");
     if (fh == NULL)
 		return -1;
-    for(i=0; i<(1<<12); i++) {
-		fprintf(fh, "%d\n", EHisto[i]);
+    for(i=0; i<(1<<MAXNBITS); i++) {
+		fprintf(fh, "%u\n", EHisto[i]);
 	}
-    fclose(fh);
-    printf("Histograms saved to '%s_<board>_<channel>.txt'\n", basename);
+    err = ferror(fh);
+    if (fclose(fh) || err)
+		return -1;
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------------------- */
+/*! \fn      SaveHistogram2D(char *basename, int b, int ch, uint32_t *EHisto, int nbins)
+*   \brief   Save a 2D Histogram to output file
+*   \return  0=success; -1=error */
+/* --------------------------------------------------------------------------------------------------------- */
+
+int SaveHistogram2D(char *basename, int b, int ch, uint32_t *EHisto, int nbins)
+{
+	/*
+	This function saves the nbins x nbins bins of the EHisto array (row after row) in the text file
+	<basename>_<b>_<ch>.txt: one line for each row, with the bins of the row separated by blanks
+	*/
+    FILE *fh;
+    int i, j, err;
+    char filename[MAX_HISTO_FILENAME];
+    if (snprintf(filename, MAX_HISTO_FILENAME, "%s_%d_%d.txt", basename, b, ch) >= MAX_HISTO_FILENAME)
+		return -1;
+    fh = fopen(filename, "w");
+    if (fh == NULL)
+		return -1;
+    for(i=0; i<nbins; i++) {
+		for(j=0; j<nbins; j++)
+			fprintf(fh, (j == 0) ? "%u" : " %u", EHisto[i*nbins + j]);
+		fputc('\n', fh);
+	}
+    err = ferror(fh);
+    if (fclose(fh) || err)
+		return -1;
 
     return 0;
 }
@@ -20,15 +20,15 @@
 #include <time.h>
 #include "myCAEN_DTT_config.h"
 #include "paramsHeaderToFile.h"
+#include "acqPipeline.h"
+#include "statusDisplay.h"
+#include "metricsExport.h"
+#include "readoutOptions.h"
+#include "runFile.h"
+#include "runWriter.h"
 
 //#define MANUAL_BUFFER_SETTING   0
-// The following define must be set to the actual number of connected boards
-#define MAXNB   1
-// NB: the following define MUST specify the ACTUAL max allowed number of board's channels
-// it is needed for consistency inside the CAENDigitizer's functions used to allocate the memory
-#define MaxNChannels 4
-
-#define MAXNBITS 12
+/* NB: MAXNB, MaxNChannels and MAXNBITS are defined in Functions.h */
 
 /* include some useful functions from file Functions.h
 you can find this file in the src directory */
@@ -46,7 +46,8 @@ you can find this file in the src directory */
 int ProgramDigitizer(int handle, DigitizerParams_t Params, CAEN_DGTZ_DPP_PSD_Params_t DPPParams)
 {
 	/* This function uses the CAENDigitizer API functions to perform the digitizer's initial configuration */
-	int i, ret = 0;
+	int i, ret = 0, extrasRet = 0;
+	uint32_t reg;
 
 	/* Reset the digitizer */
 	ret |= CAEN_DGTZ_Reset(handle);
@@ -102,17 +103,183 @@ int ProgramDigitizer(int handle, DigitizerParams_t Params, CAEN_DGTZ_DPP_PSD_Par
 			ret |= CAEN_DGTZ_SetChannelDCOffset(handle, i, 0x2F5C);//cambio 0x8000 -> 0x0000: 21/07/2014 ore 9:37, cambio in DE00 08/01/2015 per spostare DC offset
 
 			// Set the Pre-Trigger size (in samples)
-			ret |= CAEN_DGTZ_SetDPPPreTriggerSize(handle, i, 18);
+			ret |= CAEN_DGTZ_SetDPPPreTriggerSize(handle, i, PRE_TRIGGER_SIZE);
 
 			// Set the polarity for the given channel (CAEN_DGTZ_PulsePolarityPositive or CAEN_DGTZ_PulsePolarityNegative)
 			ret |= CAEN_DGTZ_SetChannelPulsePolarity(handle, i, Params.PulsePolarity);
 		}
 	}
 
+	/* Enable the extras word of the events ('Extras' readout option): the extended time stamp or, on a firmware
+	   release checked by main (see EXTRAS_OPTION_MIN_AMC_FW in Functions.h), the lost/total trigger counters of
+	   the channel (see psdDecoder.h). Done after CAEN_DGTZ_SetDPPParameters(), that writes the DPP Algorithm
+	   Control 2 */
+	if (readoutOptions.Extras != PSD_EXTRAS_NONE) {
+		extrasRet |= CAEN_DGTZ_WriteRegister(handle, REG_BOARD_CONFIGURATION_SET, BOARD_CONFIGURATION_EXTRAS);
+		for (i = 0; (i < MaxNChannels) && (readoutOptions.Extras == PSD_EXTRAS_TRIGGERS); i++) {
+			if (Params.ChannelMask & (1 << i)) {
+				extrasRet |= CAEN_DGTZ_ReadRegister(handle, REG_DPP_ALGORITHM_CONTROL2(i), &reg);
+				reg = (reg & ~DPP_EXTRAS_OPTION_MASK) | DPP_EXTRAS_OPTION_TRIGGERS;
+				extrasRet |= CAEN_DGTZ_WriteRegister(handle, REG_DPP_ALGORITHM_CONTROL2(i), reg);
+			}
+		}
+		// the decoder would misread the extras word
+		if (extrasRet) {
+			printf("ERROR: can't configure the extras word of the events.\n");
+			return -1;
+		}
+	}
+
 	return 0;
 
 }
 
+/* --------------------------------------------------------------------------------------------------------- */
+/*! \fn      int WriteRunSummary(const char *fname, const runWriter_t *Output, acqPipeline_t *Pipeline, int *LinkNum, uint64_t AcqTimeMs)
+ *   \brief   Write the summary of a completed run, once the pipeline is finished:
+ *            - the run files, with the statistics of the output writer, and the waveform file;
+ *            - the acquisition time and the events recorded by each channel;
+ *            - with the TRIGGER_COUNTERS 'Extras', the triggers counted and lost by the board;
+ *            - unless the output is RAW, the rollovers of the time tag of each channel and those added by the
+ *              wall-clock check of the decoder;
+ *            - the reads, CPU load and longest gap between the reads with data of each readout thread;
+ *            - the events read by the drain at the end of the run and, with the time merge, the late events;
+ *            - the latency percentiles of the pipeline steps;
+ *            - with 'DeadTime', the records, real time and live time of each dead time stage;
+ *            - with 'CoincWindow', the TDCR coincidences (over the live time of the common dead time if any);
+ *            - with 'CoincScan', the coincidences of each resolving time of the scan, over the same time;
+ *            - with 'CoincFilter', the records written and the singles dropped for each PMT;
+ *            - with 'SoftwareCharge', the software charges compared with those of the firmware.
+ *   \return  0=success; -1=error */
+/* --------------------------------------------------------------------------------------------------------- */
+int WriteRunSummary(const char *fname, const runWriter_t *Output, acqPipeline_t *Pipeline, int *LinkNum, uint64_t AcqTimeMs)
+{
+	FILE *fp;
+	char first[RUN_WRITER_NAME_SIZE];
+	int b, ch, ret;
+	double Seconds = (double)AcqTimeMs / 1000.0, CoincSeconds = Seconds;
+
+	if ((fp = fopen(fname, "w")) == NULL) {
+		perror("Can't create the run summary");
+		return -1;
+	}
+	runWriterSegmentName(Output, 0, first);
+	if (Output->segment > 0)
+		fprintf(fp, "Run files: %s ... %s (%d segments)\n", first, Output->fileName, Output->segment + 1);
+	else
+		fprintf(fp, "Run file: %s\n", first);
+	printRunWriterStats(Output, fp);
+	if (Pipeline->waveforms) {
+		fprintf(fp, "Waveform file: %s (%lu traces)\n", Pipeline->waveOut->fileName, atomic_load(&Pipeline->traces));
+		printRunWriterStats(Pipeline->waveOut, fp);
+		if (Pipeline->cfd)
+			fprintf(fp, "Events with a fine time (CFD): %lu\n", atomic_load(&Pipeline->fineEvents));
+	}
+	fprintf(fp, "Acquisition time (s): %.3f\n", Seconds);
+	fprintf(fp, "# Events recorded\n#  ch   link           counts     rate (s^-1)\n");
+	for (b = 0; b < Pipeline->numBoards; b++) {
+		for (ch = 0; ch < MaxNChannels; ch++) {
+			if (Pipeline->params[b].ChannelMask & (1 << ch))
+				fprintf(fp, "%5d %6d %16lu %15.3f\n", RUN_FILE_TEXT_CHANNEL(b, ch), LinkNum[b], atomic_load(&Pipeline->recordedEvents[b][ch]),
+					(Seconds > 0.0) ? (double)atomic_load(&Pipeline->recordedEvents[b][ch]) / Seconds : 0.0);
+		}
+	}
+	if (Pipeline->extras == PSD_EXTRAS_TRIGGERS) {
+		fprintf(fp, "# Triggers counted by the board (extras word)\n#  ch   link         triggers             lost   live (%%)\n");
+		for (b = 0; b < Pipeline->numBoards; b++) {
+			for (ch = 0; ch < MaxNChannels; ch++) {
+				if (Pipeline->params[b].ChannelMask & (1 << ch))
+					fprintf(fp, "%5d %6d %16lu %16lu %9.3f\n", RUN_FILE_TEXT_CHANNEL(b, ch), LinkNum[b], atomic_load(&Pipeline->boardTriggers[b][ch]),
+						atomic_load(&Pipeline->boardLostTriggers[b][ch]), (atomic_load(&Pipeline->boardTriggers[b][ch]) > 0) ?
+						100.0 * (1.0 - (double)atomic_load(&Pipeline->boardLostTriggers[b][ch]) / (double)atomic_load(&Pipeline->boardTriggers[b][ch])) : 100.0);
+			}
+		}
+	}
+	if (Pipeline->outputFormat != OUTPUT_RAW) {
+		fprintf(fp, "# Time tag rollovers\n#  ch   link        rollovers  added by the wall clock\n");
+		for (b = 0; b < Pipeline->numBoards; b++) {
+			for (ch = 0; ch < MaxNChannels; ch++) {
+				if (Pipeline->params[b].ChannelMask & (1 << ch))
+					fprintf(fp, "%5d %6d %16lu %24lu\n", RUN_FILE_TEXT_CHANNEL(b, ch), LinkNum[b], atomic_load(&Pipeline->rollovers[b][ch]),
+						atomic_load(&Pipeline->missedRollovers[b][ch]));
+			}
+		}
+	}
+	fprintf(fp, "# Readout (%s policy)\n#  link     reads with data     empty reads           waits   CPU (s)  CPU (%%)  max gap (ms)\n",
+		(Pipeline->readoutPolicy == READOUT_POLICY_BUSY) ? "BUSY" : (Pipeline->readoutPolicy == READOUT_POLICY_ADAPTIVE) ? "ADAPTIVE" : "IRQ");
+	for (b = 0; b < Pipeline->numBoards; b++) {
+		fprintf(fp, "%7d %19lu %15lu %15lu %9.3f %8.2f %13.3f\n", LinkNum[b], atomic_load(&Pipeline->readers[b].stats.blocks),
+			atomic_load(&Pipeline->readers[b].stats.idles), atomic_load(&Pipeline->readers[b].waits),
+			(double)atomic_load(&Pipeline->readers[b].cpuNs) / 1e9,
+			(AcqTimeMs > 0) ? (double)atomic_load(&Pipeline->readers[b].cpuNs) / ((double)AcqTimeMs * 1e4) : 0.0,
+			(double)atomic_load(&Pipeline->readers[b].maxGapNs) / 1e6);
+	}
+	fprintf(fp, "# Drain at the end of the run (max %d ms)\n#  link    events read after the stop           bytes  board empty\n", ACQ_DRAIN_TIMEOUT_MS);
+	for (b = 0; b < Pipeline->numBoards; b++) {
+		fprintf(fp, "%7d %29lu %15lu  %s\n", LinkNum[b], atomic_load(&Pipeline->readers[b].drainEvents),
+			atomic_load(&Pipeline->readers[b].drainBytes), atomic_load(&Pipeline->readers[b].drainTimedOut) ? "no" : "yes");
+	}
+	if (Pipeline->merge)
+		fprintf(fp, "Events written out of time order (late): %lu\n", (unsigned long)Pipeline->timeMerge.late);
+	fprintf(fp, "# Latency of the pipeline steps\n");
+	printAcqPipelineLatency(Pipeline, fp);
+	if (Pipeline->deadTime) {
+		printTdcrDeadTimeSummary(fp, &Pipeline->dead);
+		if (Pipeline->dead.stages[TDCR_DEAD_COMMON].length > 0)
+			CoincSeconds = tdcrDeadLiveNs(&Pipeline->dead.stages[TDCR_DEAD_COMMON]) / 1e9;
+	}
+	if (Pipeline->coincidence)
+		printTdcrCoincSummary(fp, Pipeline->coinc.counts, Pipeline->coinc.windowNs, CoincSeconds);
+	if (Pipeline->coincScan)
+		printTdcrScanSummary(fp, &Pipeline->scan, CoincSeconds);
+	if (Pipeline->coincFilter)
+		printTdcrFilterSummary(fp, &Pipeline->filter);
+	if (Pipeline->softwareCharge) {
+		fprintf(fp, "# Software charges (%s), compared with the firmware\n", psdChargeVectorName());
+		printAcqChargeStats(Pipeline, fp);
+	}
+	ret = ferror(fp);
+	if (fclose(fp) || ret) {
+		fprintf(stderr, "An error occurred while writing the run summary!\n");
+		return -1;
+	}
+	printf("Run summary written to %s\n", fname);
+	return 0;
+}
+
+/* --------------------------------------------------------------------------------------------------------- */
+/*! \fn      int SaveSpectra(char *basename, int NumBoards, uint32_t *EHistoShort[][MaxNChannels], ...)
+ *   \brief   Save the histograms of each enabled channel to <basename>_Qs_<b>_<ch>.txt, <basename>_Ql_...,
+ *            <basename>_PSD_... and <basename>_QsQl_... (see SaveHistogram and SaveHistogram2D)
+ *   \return  0=success; -1=error */
+/* --------------------------------------------------------------------------------------------------------- */
+int SaveSpectra(char *basename, int NumBoards, uint32_t *EHistoShort[][MaxNChannels], uint32_t *EHistoLong[][MaxNChannels],
+				uint32_t *EHistoRatio[][MaxNChannels], uint32_t *EHisto2D[][MaxNChannels])
+{
+	char name[MAX_HISTO_FILENAME];
+	int b, ch, ret = 0;
+
+	for (b = 0; b < NumBoards; b++) {
+		for (ch = 0; ch < MaxNChannels; ch++) {
+			if (EHistoShort[b][ch] == NULL)
+				continue;
+			snprintf(name, MAX_HISTO_FILENAME, "%s_Qs", basename);
+			ret |= SaveHistogram(name, b, ch, EHistoShort[b][ch]);
+			snprintf(name, MAX_HISTO_FILENAME, "%s_Ql", basename);
+			ret |= SaveHistogram(name, b, ch, EHistoLong[b][ch]);
+			snprintf(name, MAX_HISTO_FILENAME, "%s_PSD", basename);
+			ret |= SaveHistogram(name, b, ch, EHistoRatio[b][ch]);
+			snprintf(name, MAX_HISTO_FILENAME, "%s_QsQl", basename);
+			ret |= SaveHistogram2D(name, b, ch, EHisto2D[b][ch], PSD_HISTO_2D_BINS);
+		}
+	}
+	if (ret) {
+		fprintf(stderr, "An error occurred while saving the histograms!\n");
+		return -1;
+	}
+	return 0;
+}
+
 /* ########################################################################### */
 /* MAIN                                                                        */
 /* ########################################################################### */
@@ -125,69 +292,70 @@ int main(int argc, char *argv[])
 	if(ret) printf("Some error"); */
 	CAEN_DGTZ_ErrorCode ret;
 
-	/* Buffers to store the data. The memory must be allocated using the appropriate
-	CAENDigitizer API functions (see below), so they must not be initialized here
-	NB: you must use the right type for different DPP analysis (in this case PSD) */
-	char *buffer = NULL;										// readout buffer
-	CAEN_DGTZ_DPP_PSD_Event_t       *Events[MaxNChannels];		// events buffer
-	CAEN_DGTZ_DPP_PSD_Waveforms_t   *Waveform = NULL;			// waveforms buffer
+	/* The readout, decode and writer threads (see acqPipeline.h). The pipeline
+	owns the readout buffers and the events buffer used during the acquisition */
+	static acqPipeline_t Pipeline;
+	int isPipelineInit = 0;
+	/* The rate display thread (see statusDisplay.h) */
+	static statusDisplay_t Display;
+	int isDisplayStarted = 0;
+	/* The metrics export thread (see metricsExport.h) */
+	static metricsExport_t Metrics;
+	int isMetricsStarted = 0;
 
 	/* The following variables will store the digitizer configuration parameters */
 	CAEN_DGTZ_DPP_PSD_Params_t DPPParams[MAXNB];
 	DigitizerParams_t          Params[MAXNB];
 
 	/* Arrays for data analysis */
-	uint64_t PrevTime[MAXNB][MaxNChannels];
-	uint64_t ExtendedTT[MAXNB][MaxNChannels];
+	/* The histograms are the snapshots of the spectra filled by the pipeline
+	('Histograms' readout option, see psdHisto.h): NULL if not filled */
 	uint32_t *EHistoShort[MAXNB][MaxNChannels];   // Energy Histograms for short gate charge integration
 	uint32_t *EHistoLong[MAXNB][MaxNChannels];    // Energy Histograms for long gate charge integration
-	float *EHistoRatio[MAXNB][MaxNChannels];      // Energy Histograms for ratio Long/Short
-	int ECnt[MAXNB][MaxNChannels];                // Number-of-Entries Counter for Energy Histograms short and long gate
-	int TrgCnt[MAXNB][MaxNChannels];
+	uint32_t *EHistoRatio[MAXNB][MaxNChannels];   // PSD Histograms, ratio (Long-Short)/Long
+	uint32_t *EHisto2D[MAXNB][MaxNChannels];      // 2D Histograms, Short vs Long gate charge
 
 	/* The following variable will be used to get an handler for the digitizer. The
 	handler will be used for most of CAENDigitizer functions to identify the board */
 	int handle[MAXNB];
+	int LinkNum[MAXNB];             // link number of each board
+	int NumBoards = 1;              // boards to read (see the 'BoardConfigs' readout option)
+	int NumOpenBoards = 0;          // boards opened so far
 
 	/* Other variables */
-	unsigned int i, b, ch, ev;
+	unsigned int i, ch;
+	int b;                          // board index, as NumBoards and NumOpenBoards
 	int Quit = 0;
 	int AcqRun = 0;
-	uint32_t AllocatedSize, BufferSize;
-	int Nb = 0;
 	int DoSaveWave[MAXNB][MaxNChannels];
-	int MajorNumber;
+	int MajorNumber, MinorNumber;
 	int BitMask = 0;
-	uint64_t CurrentTime, PrevRateTime, ElapsedTime;
-	uint64_t StartAcqTime, EndAcqTime, acquisitionTime = 0;
-	uint32_t NumEvents[MaxNChannels];
+	uint64_t CurrentTime;
+	uint64_t PrevHistoTime;                 // time of the last histogram snapshot request
+	uint64_t StartAcqTime = 0, EndAcqTime = 0, acquisitionTime = 0;
 	CAEN_DGTZ_BoardInfo_t           BoardInfo;
-	FILE *fpout;
-	char fnameOut[255];
+	static runWriter_t Output;          // the output file (see runWriter.h)
+	static runWriter_t WaveOutput;      // the waveform file ('Waveforms' readout option)
+	char fnameOut[RUN_WRITER_NAME_SIZE];  // its name ("<name>_*.<ext>" when it is split into segments)
+	const char *extension;
+	char *textHeader;                   // text header of the output
+	size_t textHeaderSize;
+	char *fileHeader;                   // header of each segment of the output
+	size_t fileHeaderSize;
 	char filename[255];
+	char fnameSummary[270];
+	char fnameWave[265];
+	static char waveHeader[RUN_FILE_HEADER_SIZE];   // header of the waveform file
 	int userRequestedAction = 0;        // code returned by acquireParameterValues()
 	/* var to keep track of what should NOT be closed / freed on program exit */
-	int isFpoutOpen = 0;
-  /* Elapsed time from the beginning of the acquisition (milliseconds) */
-  unsigned long timePassedSinceStart = 0ul;
-  int hoursPassed, minToDisplayPassed, sToDisplayPassed, sPassedSinceStart;
-  /* Var to keep track of the number of events recorded from each channel
-  (each channel has got its own 'counter') */
-  unsigned long int totalRecordedEvents[MaxNChannels];
+	int isOutputOpen = 0;
+	int isWaveOutputOpen = 0;
 
   /* ************************************************************************ *
-   * PLEASE READ CAREFULLY: the current version of this program defines the   *
-   * macro 'MAXNB' and gives to it the value '1'. The macro is then used      *
-   * sometimes along this source code.                                        *
-   * However, actually the code is written and was tested to be used          *
-   * exclusively with just 1 board connected!                                 *
-   * The aforementioned macro and the part of the code that use it were left  *
-   * in the code just to ease future implementations that will really enable  *
-   * the multi-board functionality. So in the current version of the code the *
-   * loops on 'MAXNB' will iterate just once.                                 *
-   *                                                                          *
-   * DO NOT CHANGE THE VALUE OF 'MAXNB' WITHOUT MAKING THE APPROPRIATE        *
-   * SOURCE CODE CHANGES!!!!!!!!                                              *
+   * 'MAXNB' is the max number of boards. The boards actually read are the    *
+   * one configured by "tdcr.ini" (board 0) followed by those whose           *
+   * configuration files are listed by the 'BoardConfigs' readout option:     *
+   * the loops on the boards iterate 'NumBoards' times.                       *
    * ************************************************************************ */
 
   memset(DoSaveWave, 0, MAXNB*MaxNChannels*sizeof(int));
@@ -207,13 +375,10 @@ int main(int argc, char *argv[])
 			EHistoShort[b][ch] = NULL; // Set all histograms pointers to NULL (we will allocate them later)
 			EHistoLong[b][ch] = NULL;
 			EHistoRatio[b][ch] = NULL;
+			EHisto2D[b][ch] = NULL;
 		}
 	}
 
-  /* initialize to 0 the elements of 'totalRecordedEvents' */
-  for (ch = 0; ch < MaxNChannels; ch++){
-    *(totalRecordedEvents + ch) = 0;
-  }
 
 
 	/* Get the acquisition time and DTT / DPP-PSD parameter values from
@@ -228,9 +393,23 @@ int main(int argc, char *argv[])
 		   'acquisitionTime', then continue to START the acquisition    */
 		Params[0] = dttParams;
 		DPPParams[0] = dppParams;
+		LinkNum[0] = linkNum;
 		acquisitionTime = (uint64_t)acqTime;
 	}
 
+	/* Get the readout options (decoder, ...) from 'config file' */
+	if (!acquireReadoutOptions())
+		goto QuitProgram;
+	printReadoutOptions();
+
+	/* Get the parameters of the additional boards from their config files */
+	NumBoards = readoutOptions.NumBoards;
+	for (b = 1; b < NumBoards; b++) {
+		if (!acquireBoardParameterValues(readoutOptions.BoardConfigs[b], &Params[b], &DPPParams[b], &LinkNum[b]))
+			goto QuitProgram;
+		printf("Board %d: '%s', link number %d, channel enable mask %#x\n", b, readoutOptions.BoardConfigs[b], LinkNum[b], Params[b].ChannelMask);
+	}
+
 
 	/* *************************************************************************************** */
 	/* Open the digitizer and read board information                                           */
@@ -238,40 +417,53 @@ int main(int argc, char *argv[])
 	/* The following function is used to open the digitizer with the given connection parameters
 	and get the handler to it */
 
-	/* The following is for one board connected via USB direct link
-	in this case you must set Params[0].LinkType = CAEN_DGTZ_USB and Params[0].VMEBaseAddress = 0 */
-	ret = CAEN_DGTZ_OpenDigitizer(Params[0].LinkType, linkNum, 0, Params[0].VMEBaseAddress, &handle[0]);
+	/* Each board is connected via USB direct link (Params[b].LinkType = CAEN_DGTZ_USB
+	and Params[b].VMEBaseAddress = 0) or via optical link with its own link number */
+	for (b = 0; b < NumBoards; b++) {
+		ret = CAEN_DGTZ_OpenDigitizer(Params[b].LinkType, LinkNum[b], 0, Params[b].VMEBaseAddress, &handle[b]);
 
-	if (ret)
-	{
-		printf("Can't open digitizer\n");
-		goto QuitProgram;
-	}
+		if (ret)
+		{
+			printf("Can't open digitizer (board %d)\n", b);
+			goto QuitProgram;
+		}
+		NumOpenBoards++;
 
-	/* Once we have the handler to the digitizer, we use it to call the other functions */
-	ret = CAEN_DGTZ_GetInfo(handle[0], &BoardInfo);
-	if (ret)
-	{
-		printf("Can't read board info\n");
-		goto QuitProgram;
-	}
-	printf("\nConnected to CAEN Digitizer Model %s, recognized as board %d\n", BoardInfo.ModelName, linkNum);
-	printf("ROC FPGA Release is %s\n", BoardInfo.ROC_FirmwareRel);
-	printf("AMC FPGA Release is %s\n", BoardInfo.AMC_FirmwareRel);
+		/* Once we have the handler to the digitizer, we use it to call the other functions */
+		ret = CAEN_DGTZ_GetInfo(handle[b], &BoardInfo);
+		if (ret)
+		{
+			printf("Can't read board info\n");
+			goto QuitProgram;
+		}
+		printf("\nConnected to CAEN Digitizer Model %s, recognized as board %d\n", BoardInfo.ModelName, LinkNum[b]);
+		printf("ROC FPGA Release is %s\n", BoardInfo.ROC_FirmwareRel);
+		printf("AMC FPGA Release is %s\n", BoardInfo.AMC_FirmwareRel);
 
-	// Check firmware revision (only DPP firmware can be used with this Demo) */
-	sscanf(BoardInfo.AMC_FirmwareRel, "%d", &MajorNumber);
-	if (MajorNumber != 131 && MajorNumber != 132)
-	{
-		printf("This digitizer has not a DPP-PSD firmware\n");
-		goto QuitProgram;
+		// Check firmware revision (only DPP firmware can be used with this Demo) */
+		sscanf(BoardInfo.AMC_FirmwareRel, "%d", &MajorNumber);
+		if (MajorNumber != 131 && MajorNumber != 132)
+		{
+			printf("This digitizer has not a DPP-PSD firmware\n");
+			goto QuitProgram;
+		}
+		// The trigger counters in the extras word need a firmware release with a checked register layout
+		if (readoutOptions.Extras == PSD_EXTRAS_TRIGGERS) {
+			MinorNumber = 0;
+			sscanf(BoardInfo.AMC_FirmwareRel, "%d.%d", &MajorNumber, &MinorNumber);
+			if ((EXTRAS_OPTION_MIN_AMC_FW == 0) || (MajorNumber * 1000 + MinorNumber < EXTRAS_OPTION_MIN_AMC_FW))
+			{
+				printf("The TRIGGER_COUNTERS 'Extras' readout option is not supported with the AMC FPGA Release %s (see EXTRAS_OPTION_MIN_AMC_FW in Functions.h)\n", BoardInfo.AMC_FirmwareRel);
+				goto QuitProgram;
+			}
+		}
 	}
 
 
 	/* *************************************************************************************** */
 	/* Program the digitizer (see function ProgramDigitizer)                                   */
 	/* *************************************************************************************** */
-	for (b = 0; b < MAXNB; b++) {
+	for (b = 0; b < NumBoards; b++) {
 		ret = ProgramDigitizer(handle[b], Params[b], DPPParams[b]);
 		if (ret) {
 			printf("Failed to program the digitizer\n");
@@ -279,24 +471,6 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	/* WARNING: The mallocs MUST be done after the digitizer programming,
-	because the following functions needs to know the digitizer configuration
-	to allocate the right memory amount */
-
-	/* Allocate memory for the readout buffer */
-	ret = CAEN_DGTZ_MallocReadoutBuffer(handle[0], &buffer, &AllocatedSize);
-
-	/* Allocate memory for the events */
-	ret |= CAEN_DGTZ_MallocDPPEvents(handle[0], Events, &AllocatedSize);
-
-	/* Allocate memory for the waveforms */
-	ret |= CAEN_DGTZ_MallocDPPWaveforms(handle[0], &Waveform, &AllocatedSize);
-
-	if (ret)
-	{
-		printf("Can't allocate memory buffers\n");
-		goto QuitProgram;
-	}
 	//printf("%d\n", (int)ret);
 	//getch();
 	/*******************************************************************************************/
@@ -307,23 +481,81 @@ int main(int argc, char *argv[])
 	scanf("%s", filename);
 	time_t now = time(0);
 	struct tm *gmtm = gmtime(&now);
-	sprintf(fnameOut, "%s.dat", filename);
+	if (readoutOptions.OutputFormat == OUTPUT_BINARY)
+		extension = ".bin";
+	else if (readoutOptions.OutputFormat == OUTPUT_RAW)
+		extension = ".raw";
+	else
+		extension = ".dat";
+	if ((readoutOptions.SegmentSize > 0) || (readoutOptions.SegmentPeriod > 0))
+		sprintf(fnameOut, "%s_*%s", filename, extension);
+	else
+		sprintf(fnameOut, "%s%s", filename, extension);
+	sprintf(fnameSummary, "%s_summary.txt", filename);
 	//printf("%s\n", fnameOut);
 
 	printf("AcqTime: %lu ms\n", acquisitionTime);
 
-	if ((fpout = fopen(fnameOut, "w")) == NULL)
+  /* The header written at the beginning of the output (of each segment, see runWriter.h):
+  the text header followed by the columns line or, in the binary run files, the file header
+  that carries the same text header */
+  if(  ((textHeader = printParamsHeaderToString(&textHeaderSize)) == NULL)
+      || ((fileHeader = (char*)malloc(textHeaderSize + sizeof(RUN_FILE_TEXT_COLUMNS) + RUN_FILE_HEADER_SIZE)) == NULL)  ){
+    fprintf(stderr,"An error occurred while writing a file!\n");
+    exit(EXIT_FAILURE);
+  }
+  if (readoutOptions.OutputFormat == OUTPUT_TEXT){
+    memcpy(fileHeader, textHeader, textHeaderSize);
+    memcpy(fileHeader + textHeaderSize, RUN_FILE_TEXT_COLUMNS, sizeof(RUN_FILE_TEXT_COLUMNS) - 1);
+    fileHeaderSize = textHeaderSize + sizeof(RUN_FILE_TEXT_COLUMNS) - 1;
+  }
+  else if (readoutOptions.OutputFormat == OUTPUT_TEXT_NS){
+    memcpy(fileHeader, textHeader, textHeaderSize);
+    memcpy(fileHeader + textHeaderSize, RUN_FILE_TEXT_NS_COLUMNS, sizeof(RUN_FILE_TEXT_NS_COLUMNS) - 1);
+    fileHeaderSize = textHeaderSize + sizeof(RUN_FILE_TEXT_NS_COLUMNS) - 1;
+  }
+  else if( buildRunFileHeader(fileHeader, (readoutOptions.OutputFormat == OUTPUT_RAW) ? RUN_FILE_CONTENT_RAW : RUN_FILE_CONTENT_EVENTS,
+                              (readoutOptions.OutputFormat == OUTPUT_RAW) ? 0 : sizeof(psdEvent_t), (uint32_t)BitMask, textHeader, textHeaderSize) ){
+    fprintf(stderr,"An error occurred while writing a file!\n");
+    exit(EXIT_FAILURE);
+  }
+  else
+    fileHeaderSize = RUN_FILE_HEADER_SIZE;
+
+  /* The waveform file "<name>_wave.bin": a binary run file of waveform records, never split
+  into segments (its index is written at the end of the run) */
+  if (readoutOptions.Waveforms){
+    for (b = 0; b < NumBoards; b++){
+      if(  (Params[b].AcqMode == CAEN_DGTZ_DPP_ACQ_MODE_List) || (Params[b].RecordLength == 0)  )
+        printf("Warning: board %d is in List mode or has RecordLength = 0, its events have no samples\n", b);
+    }
+    sprintf(fnameWave, "%s_wave", filename);
+    if(  buildRunFileHeader(waveHeader, RUN_FILE_CONTENT_TRACES, 0, (uint32_t)BitMask, textHeader, textHeaderSize)
+        || openRunWriter(&WaveOutput, readoutOptions.OutputWriter, readoutOptions.OutputDirect, (int)readoutOptions.OutputQueueDepth, fnameWave, ".bin",
+                         waveHeader, RUN_FILE_HEADER_SIZE, 0, 0)  ){
+      printf("Errore Apertura file!!!!!\n");
+      exit(-1);
+    }
+    isWaveOutputOpen = 1;
+  }
+  free(textHeader);
+
+	if (openRunWriter(&Output, readoutOptions.OutputWriter, readoutOptions.OutputDirect, (int)readoutOptions.OutputQueueDepth, filename, extension, fileHeader, fileHeaderSize,
+					  (uint64_t)readoutOptions.SegmentSize << 20, readoutOptions.SegmentPeriod))
 	{
 		printf("Errore Apertura file!!!!!\n");
 		exit(-1);
 	}
-  else{
-    isFpoutOpen = 1;
-    if( printParamsHeaderToFile(fpout) ){
-      fprintf(stderr,"An error occurred while writing a file!\n");
-      exit(EXIT_FAILURE);
-    }
-  }
+	free(fileHeader);
+	isOutputOpen = 1;
+
+	/* Allocate the readout buffers, the events buffer and the output blocks of the pipeline */
+	isPipelineInit = 1;
+	if (initAcqPipeline(&Pipeline, NumBoards, handle, Params, DPPParams, &readoutOptions, &Output, isWaveOutputOpen ? &WaveOutput : NULL, BitMask))
+	{
+		printf("Can't allocate memory buffers\n");
+		goto QuitProgram;
+	}
 
 	printf("Soglia ChA: %d\n", DPPParams[0].thr[0]);
 	printf("Soglia ChB: %d\n", DPPParams[0].thr[2]);
@@ -331,185 +563,128 @@ int main(int argc, char *argv[])
 	/* *************************************************************************************** */
 	/* Readout Loop                                                                            */
 	/* *************************************************************************************** */
-	// Clear Histograms and counters
-	for (b = 0; b < MAXNB; b++)
+	// Histograms of the enabled channels
+	for (b = 0; b < NumBoards; b++)
 	{
 		for (ch = 0; ch < MaxNChannels; ch++) {
-			// Allocate Memory for Histos and set them to 0
-			EHistoShort[b][ch] = (uint32_t *)malloc((1 << MAXNBITS)*sizeof(uint32_t));
-			memset(EHistoShort[b][ch], 0, (1 << MAXNBITS)*sizeof(uint32_t));
-			EHistoLong[b][ch] = (uint32_t *)malloc((1 << MAXNBITS)*sizeof(uint32_t));
-			memset(EHistoLong[b][ch], 0, (1 << MAXNBITS)*sizeof(uint32_t));
-			EHistoRatio[b][ch] = (float *)malloc((1 << MAXNBITS)*sizeof(float));
-			memset(EHistoRatio[b][ch], 0, (1 << MAXNBITS)*sizeof(float));
-			TrgCnt[b][ch] = 0;
-			ECnt[b][ch] = 0;
-			PrevTime[b][ch] = 0;
-			ExtendedTT[b][ch] = 0;
+			// Histos of the enabled channels: the snapshots of the pipeline (allocated and set to 0 by initAcqPipeline)
+			if (Pipeline.histos[b][ch].snapshot != NULL) {
+				EHistoShort[b][ch] = Pipeline.histos[b][ch].snapshot + PSD_HISTO_QSHORT;
+				EHistoLong[b][ch] = Pipeline.histos[b][ch].snapshot + PSD_HISTO_QLONG;
+				EHistoRatio[b][ch] = Pipeline.histos[b][ch].snapshot + PSD_HISTO_PSD;
+				EHisto2D[b][ch] = Pipeline.histos[b][ch].snapshot + PSD_HISTO_2D;
+			}
 		}
 	}
 
 
-	fprintf(fpout, "#    ch       timestamp       Qs       Ql           ExtendedTT\n");
-
-	for (b = 0; b < MAXNB; b++)
+	for (b = 0; b < NumBoards; b++)
 	{
 		// Start Acquisition
 		// NB: the acquisition for each board starts when the following line is executed
 		// so in general the acquisition does NOT starts syncronously for different boards
 		CAEN_DGTZ_SWStartAcquisition(handle[b]);
-		printf("Acquisition Started for Board %d\n", linkNum);
+		printf("Acquisition Started for Board %d\n", LinkNum[b]);
 	}
 
 	AcqRun = 1;
-	StartAcqTime = PrevRateTime = get_time();
+	StartAcqTime = PrevHistoTime = get_time();
+	/* From now on the boards are read by the readout threads of the pipeline
+	(one for each board) and the rates are displayed by the status display
+	thread (see statusDisplay.h): this loop only saves the histograms and
+	checks the acquisition time */
+	if (startAcqPipeline(&Pipeline))
+		goto QuitProgram;
+	if (startStatusDisplay(&Display, &Pipeline, fnameOut, LinkNum, StartAcqTime) == 0)
+		isDisplayStarted = 1;
+	/* without the metrics the acquisition goes on (the error is printed) */
+	if (startMetricsExport(&Metrics, &Pipeline, &readoutOptions, StartAcqTime) == 0)
+		isMetricsStarted = 1;
 
 	while (!Quit)
 	{
-		/* Calculate throughput and trigger rate (every second) */
 		CurrentTime = get_time();
-		ElapsedTime = CurrentTime - PrevRateTime; /* milliseconds */
-		if (ElapsedTime > 1000)
+
+		/* Save the histograms every 'HistoSavePeriod' seconds: the decode stage takes
+		the snapshot, then it is saved here */
+		if (Pipeline.histograms && (readoutOptions.HistoSavePeriod > 0)
+			&& (CurrentTime - PrevHistoTime >= readoutOptions.HistoSavePeriod * 1000))
 		{
-			system(CLEARSCR);
-      /* Calculate h,m,seconds passed since Start acquisition */
-      timePassedSinceStart += ElapsedTime;
-      sPassedSinceStart = timePassedSinceStart / 1000ul;
-      sToDisplayPassed = sPassedSinceStart % 60ul;
-      minToDisplayPassed = (sPassedSinceStart / 60ul) % 60ul;
-      hoursPassed = ((sPassedSinceStart / 60ul) / 60ul) % 60ul;
-      // Display readout filename, 'h,m,seconds' since Start acquisition, readout rate
-      printf("Data readout file: %s\nElapsed time: %dh %dmin %ds\n\nReadout Rate=%.2f MB\n", fnameOut, hoursPassed, minToDisplayPassed, sToDisplayPassed, (float)Nb / ((float)ElapsedTime*1048.576f));
-			for (b = 0; b < MAXNB; b++)
-			{
-        printf("\nBoard %d:\n", linkNum);
-				for (i = 0; i < MaxNChannels; i++)
-				{
-					if (TrgCnt[b][i]>0)
-            printf("\tCh %d:\tTrgRate=%.2f KHz\tTotal events: %lu\n", b * 8 + i, (float)TrgCnt[b][i] / (float)ElapsedTime, totalRecordedEvents[i]);
-					else
-						printf("\tCh %d:\tNo Data\n", i);
-					TrgCnt[b][i] = 0;
-				}
-			}
-			Nb = 0;
-			PrevRateTime = CurrentTime;
-			printf("\n\n");
+			requestAcqHistoSnapshot(&Pipeline);
+			PrevHistoTime = CurrentTime;
 		}
-
-		/* Read data from the boards */
-		for (b = 0; b < MAXNB; b++)
+		if (acqHistoSnapshotReady(&Pipeline))
 		{
-			/* Read data from the board */
-			ret = CAEN_DGTZ_ReadData(handle[b], CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT, buffer, &BufferSize);
-			if (ret)
-			{
-				printf("Readout Error\n");
-				goto QuitProgram;
-			}
-			if (BufferSize == 0)
-				continue;        // torna all'inizio del while
+			SaveSpectra(filename, NumBoards, EHistoShort, EHistoLong, EHistoRatio, EHisto2D);
+			releaseAcqHistoSnapshot(&Pipeline);
+		}
 
-			Nb += BufferSize;
-			//ret = DataConsistencyCheck((uint32_t *)buffer, BufferSize/4);
-			ret |= CAEN_DGTZ_GetDPPEvents(handle[b], buffer, BufferSize, Events, NumEvents);
-			if (ret)
-			{
-				printf("Data Error: %d\n", ret);
-				goto QuitProgram;
-			}
+		/* 'l': show / hide the latency percentiles in the status display */
+		if (kbhit() && (getch() == 'l'))
+			toggleStatusDisplayLatency(&Display);
 
-			/* Analyze data */
-			for (ch = 0; ch < MaxNChannels; ch++)
-			{
-				if (!(Params[b].ChannelMask & (1 << ch)))
-					continue;
+		/* A stage of the pipeline failed (readout, data or disk error) */
+		if (acqPipelineError(&Pipeline))
+			goto QuitProgram;
 
-				/* Update Histograms */
-				for (ev = 0; ev < NumEvents[ch]; ev++)
-				{
-					TrgCnt[b][ch]++;
-					/* Time Tag */
-					if (Events[ch][ev].TimeTag < PrevTime[b][ch])
-					{
-						ExtendedTT[b][ch]++;
-						printf("%7d\n", ExtendedTT[b][ch]);
-					}
-
-					PrevTime[b][ch] = Events[ch][ev].TimeTag;
-					fprintf(fpout, "%7d, %15lu, %7d, %7d, %15lu\n", ch, Events[ch][ev].TimeTag, (Events[ch][ev].ChargeShort & BitMask), (Events[ch][ev].ChargeLong & BitMask), ExtendedTT[b][ch]);
-				} // loop on events
-
-        /* Update the event counter of each channel */
-        /* NOTE: the next assignment relies on the fact that MAXNB=1
-           See the 'PLEASE READ CAREFULLY' note for more information on this */
-        totalRecordedEvents[ch] += NumEvents[ch];
-			} // loop on channels
-		} // loop on boards
 		EndAcqTime = get_time();
 
 		if ((EndAcqTime - StartAcqTime) >= acquisitionTime)
 		{
-			for (b = 0; b < MAXNB; b++)
+			/* Stop the acquisition: each readout thread stops its board and reads
+			it until it is empty (see drainAcqReadout()), the data is still decoded
+			and written by the pipeline */
+			stopStatusDisplay(&Display);
+			drainAcqReadout(&Pipeline);
+			for (b = 0; b < NumBoards; b++)
 			{
-				// Stop Acquisition
-				CAEN_DGTZ_SWStopAcquisition(handle[b]);
-				printf("Acquisition Stopped for Board %d\n", linkNum);
-        // DELETE THIS LINE!!!!!!!!!!!!!!!
-        // DELETE THIS LINE!!!!!!!!!!!!!!!
-
-        // Retrieve the remaining data from buffer
-        if (CAEN_DGTZ_ReadData(handle[0], CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT, buffer, &BufferSize) == 0){
-
-          if(  CAEN_DGTZ_WriteRegister( handle[0], 0x803a, (uint32_t)1u ) == 0  ){
-
-            if (CAEN_DGTZ_ReadData(handle[0], CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT, buffer, &BufferSize) == 0){
-              if (BufferSize == 0){
-                fprintf(stderr, "\nBuffer size of the last readout = 0!\n");
-              }
-              else{
-                fprintf(stderr, "\nProsegui1.\n");
-              }
-            }
-            else
-              fprintf(stderr, "NOK1");
-
-          }
-          else{
-            fprintf(stderr, "\nWriteRegister error!\n");
-          }
-
-        }
-        else
-          fprintf(stderr, "NOK2");
-
-        // DELETE THIS LINE!!!!!!!!!!!!!!!
-        // DELETE THIS LINE!!!!!!!!!!!!!!!
+				printf("Acquisition Stopped for Board %d: %lu events read after the stop%s\n", LinkNum[b],
+					atomic_load(&Pipeline.readers[b].drainEvents),
+					atomic_load(&Pipeline.readers[b].drainTimedOut) ? " (the board was not empty at the drain timeout)" : "");
+			}
+			/* Wait for the decode and writer stages to empty the rings */
+			if (finishAcqPipeline(&Pipeline) == 0)
+			{
+				WriteRunSummary(fnameSummary, &Output, &Pipeline, LinkNum, EndAcqTime - StartAcqTime);
+				/* Save the final histograms */
+				if (acqHistoSnapshotReady(&Pipeline))
+				{
+					if (SaveSpectra(filename, NumBoards, EHistoShort, EHistoLong, EHistoRatio, EHisto2D) == 0)
+						printf("Histograms saved to '%s_<Qs|Ql|PSD|QsQl>_<board>_<channel>.txt'\n", filename);
+					releaseAcqHistoSnapshot(&Pipeline);
+				}
 			}
 			AcqRun = 0;
 			goto QuitProgram;
 		}
+		Sleep(10);
 	} // End of readout loop
 
 
 
 QuitProgram:
 	printf("Acquisition Time: %lu [ms] \n", EndAcqTime - StartAcqTime);
-	/* stop the acquisition, close the device and free the buffers */
-	for (b = 0; b < MAXNB; b++) {
+	/* stop the pipeline threads (if still running) before closing the devices */
+	if (isDisplayStarted)
+		stopStatusDisplay(&Display);
+	if (isPipelineInit) {
+		stopAcqReadout(&Pipeline);
+		finishAcqPipeline(&Pipeline);
+	}
+	/* the last metrics are the final counters of the pipeline */
+	if (isMetricsStarted)
+		stopMetricsExport(&Metrics);
+	/* stop the acquisition, close the devices and free the buffers */
+	for (b = 0; b < NumOpenBoards; b++)
 		CAEN_DGTZ_SWStopAcquisition(handle[b]);
+	if (isPipelineInit)
+		freeAcqPipeline(&Pipeline);
+	for (b = 0; b < NumOpenBoards; b++)
 		CAEN_DGTZ_CloseDigitizer(handle[b]);
-		for (ch = 0; ch < MaxNChannels; ch++) {
-			free(EHistoShort[b][ch]);
-			free(EHistoLong[b][ch]);
-			free(EHistoRatio[b][ch]);
-		}
-	}
-	CAEN_DGTZ_FreeReadoutBuffer(&buffer);
-	CAEN_DGTZ_FreeDPPEvents(handle[0], Events);
-	CAEN_DGTZ_FreeDPPWaveforms(handle[0], Waveform);
-	if (isFpoutOpen)
-		fclose(fpout);
+	if (isOutputOpen && closeRunWriter(&Output))
+		fprintf(stderr, "An error occurred while closing the output file!\n");
+	if (isWaveOutputOpen && closeRunWriter(&WaveOutput))
+		fprintf(stderr, "An error occurred while closing the waveform file!\n");
 
 	return ret;
 }
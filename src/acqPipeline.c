@@ -0,0 +1,1407 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ * CAEN library version: Rel. 2.6.8  - Nov 2015
+ *
+ * The module 'acqPipeline' decouples the digitizer readout from the decoding
+ * of the events and from the disk writes (see acqPipeline.h).
+ *
+ * 'acqPipeline' module version: a0.23
+ */
+
+#include "acqPipeline.h"
+#include "runFile.h"
+#include <CAENDigitizer.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <time.h>
+
+/* the samples of the traces are masked with PSD_SAMPLE_MASK (see captureTraces()) */
+#if PSD_SAMPLE_BITS != MAXNBITS
+#error "PSD_SAMPLE_BITS (psdDecoder.h) must be the ADC resolution MAXNBITS (Functions.h)"
+#endif
+
+/* pause of a stage that found its input ring empty (microseconds) */
+#define ACQ_IDLE_WAIT_US 200
+/* the board is empty when this number of reads in a row return no data
+   during the drain, ACQ_DRAIN_PAUSE_US apart */
+#define ACQ_DRAIN_EMPTY_READS 2
+#define ACQ_DRAIN_PAUSE_US 1000
+/* period of the update of the CPU time of a readout thread (ns) */
+#define ACQ_CPU_SAMPLE_NS 100000000ull
+/* VME interrupt level and status/ID of the boards (IRQ readout policy) */
+#define ACQ_IRQ_LEVEL 1
+#define ACQ_IRQ_STATUS_ID 0xAAAA
+
+static void *readoutThreadMain(void *arg);
+static void *decodeThreadMain(void *arg);
+static void *writerThreadMain(void *arg);
+static void *waveThreadMain(void *arg);
+static int decodeRawBlock(acqPipeline_t *p, acqBlock_t *raw, acqBlock_t **out);
+static int reserveOutBlock(acqPipeline_t *p, acqBlock_t **blk, uint32_t needed);
+static int appendRecords(acqPipeline_t *p, const psdEvent_t *ev, uint32_t count, acqBlock_t **blk);
+static int outputRecords(acqPipeline_t *p, const psdEvent_t *ev, uint32_t count, acqBlock_t **blk);
+static int outputMerged(acqPipeline_t *p, int flush, acqBlock_t **blk);
+static int captureTraces(acqPipeline_t *p, int board);
+static uint16_t *reserveTrace(acqPipeline_t *p, const psdEvent_t *ev, uint32_t numSamples, uint32_t numTraces);
+static void addChargeTrace(acqPipeline_t *p, int board, int ch, uint16_t *samples, uint32_t numSamples, psdEvent_t *ev);
+static void integrateCharges(acqPipeline_t *p);
+static void takeHistoSnapshot(acqPipeline_t *p);
+static int decodeWith(acqPipeline_t *p, int decoder, acqBlock_t *raw);
+static void checkDecoders(acqPipeline_t *p, int board);
+static acqBlock_t *getFreeBlock(acqPipeline_t *p, spscRing_t *freeRing, acqStageStats_t *stats);
+static acqBlock_t *popRawBlock(acqPipeline_t *p, int *nextBoard);
+static int readersDone(acqPipeline_t *p);
+static int writeRawFrame(acqPipeline_t *p, acqBlock_t *raw);
+static uint64_t monotonicNs(void);
+static void joinReaders(acqPipeline_t *p);
+static uint64_t threadCpuNs(void);
+static void printLatencyRow(FILE *fp, const char *name, latencyHisto_t *h);
+
+
+/* Allocates the readout buffers of each board
+ * (CAEN_DGTZ_MallocReadoutBuffer()), the decoders, the output blocks and the
+ * rings and, with the IRQ 'ReadoutPolicy', enables the interrupt of each
+ * board. Must be called after the digitizers are programmed.
+ *
+ * @param p the pipeline to initialize
+ * @param numBoards the number of boards in 'handle' and 'params'
+ * @param handle the handles of the opened digitizers
+ * @param params the parameters the digitizers were programmed with
+ * @param dppParams the DPP parameters the digitizers were programmed with
+ * (the gates of the software charges, the threshold of the CFD)
+ * @param options the readout options (see readoutOptions.h)
+ * @param out the already opened output file (see runWriter.h)
+ * @param waveOut the already opened waveform file (a run file of
+ * RUN_FILE_CONTENT_TRACES, see runFile.h), NULL if the samples are not
+ * written
+ * @param bitMask the mask applied to the charges written to 'out'
+ * @return 0 on success, -1 in case of error (a description is printed)
+ */
+int initAcqPipeline(acqPipeline_t *p, int numBoards, int *handle, DigitizerParams_t *params, const CAEN_DGTZ_DPP_PSD_Params_t *dppParams,
+                    const ReadoutOptions_t *options, runWriter_t *out, runWriter_t *waveOut, int bitMask){
+  register int i, b;
+  CAEN_DGTZ_ErrorCode ret = CAEN_DGTZ_Success;
+  uint32_t allocatedSize;
+  uint64_t streamMask = 0;
+  acqBoardReader_t *r;
+    memset(p, 0, sizeof(acqPipeline_t));
+    p->numBoards = numBoards;
+    p->handle = handle;
+    p->params = params;
+    p->out = out;
+    p->bitMask = bitMask;
+    p->decoder = options->Decoder;
+    p->decoderCheck = options->DecoderCheck;
+    p->outputFormat = options->OutputFormat;
+    p->readoutPolicy = options->ReadoutPolicy;
+    p->pollMaxWait = options->PollMaxWait;
+    p->irqTimeout = options->IrqTimeout;
+    p->merge = (options->MergeWindow > 0) && (options->OutputFormat != OUTPUT_RAW);
+    p->mergeWindow = options->MergeWindow;
+    p->histograms = options->Histograms && (options->OutputFormat != OUTPUT_RAW);
+    p->coincidence = p->merge && (options->CoincWindow > 0);
+    p->waveforms = (waveOut != NULL) && (options->OutputFormat != OUTPUT_RAW);
+    p->waveOut = waveOut;
+    p->softwareCharge = p->waveforms && options->SoftwareCharge;
+    p->cfd = p->waveforms && (options->CfdDelay > 0);
+    p->extras = (options->OutputFormat != OUTPUT_RAW) ? options->Extras : PSD_EXTRAS_NONE;
+    p->deadTime = p->coincidence && ((options->DeadTime > 0) || (options->DeadTimePmt[0] > 0) || (options->DeadTimePmt[1] > 0) ||
+                                     (options->DeadTimePmt[2] > 0));
+    if (p->coincidence)
+      initTdcrCoinc(&p->coinc, options->CoincWindow);
+    if(  p->deadTime && initTdcrDeadTime(&p->dead, options->DeadTimeMode, options->DeadTimePmt, options->DeadTime, options->CoincWindow)  )
+      return -1;
+    p->coincFilter = p->coincidence && options->CoincFilter;
+    if(  p->coincFilter && initTdcrFilter(&p->filter, options->CoincWindow, options->SinglesPrescale)  )
+      return -1;
+    p->coincScan = p->merge && (options->NumScanWindows > 0);
+    if(  p->coincScan && initTdcrScan(&p->scan, options->ScanWindows, options->NumScanWindows)  )
+      return -1;
+    atomic_init(&p->stopReadout, 0);
+    atomic_init(&p->drain, 0);
+    atomic_init(&p->decodeDone, 0);
+    atomic_init(&p->error, 0);
+    atomic_init(&p->histoSnapshot, ACQ_SNAPSHOT_IDLE);
+
+    if(  spscRingInit(&p->outFree, ACQ_OUT_BLOCKS) || spscRingInit(&p->outFull, ACQ_OUT_BLOCKS)  ){
+      fputs("acqPipeline - error trying allocating memory for the rings\n", stderr);
+      return -1;
+    }
+    for (b = 0; b < numBoards; b++){
+      r = &p->readers[b];
+      r->pipeline = p;
+      r->board = b;
+      atomic_init(&r->done, 0);
+      atomic_init(&r->waits, 0);
+      atomic_init(&r->cpuNs, 0);
+      atomic_init(&r->maxGapNs, 0);
+      atomic_init(&r->drainEvents, 0);
+      atomic_init(&r->drainBytes, 0);
+      atomic_init(&r->drainTimedOut, 0);
+      if(  spscRingInit(&r->rawFree, ACQ_RAW_BLOCKS) || spscRingInit(&r->rawFull, ACQ_RAW_BLOCKS)  ){
+        fputs("acqPipeline - error trying allocating memory for the rings\n", stderr);
+        return -1;
+      }
+      /* The readout buffers MUST be allocated by the CAENDigitizer library: it
+         knows the max size of a readout for the current configuration of the
+         board */
+      for (i = 0; i < ACQ_RAW_BLOCKS; i++){
+        ret |= CAEN_DGTZ_MallocReadoutBuffer(handle[b], &r->rawBlocks[i].data, &allocatedSize);
+        r->rawBlocks[i].capacity = allocatedSize;
+        r->rawBlocks[i].board = b;
+        spscRingPush(&r->rawFree, &r->rawBlocks[i]);
+      }
+    }
+    /* The board raises the interrupt when 'IrqThreshold' aggregates are
+       ready; RORA: the interrupt is released by the readout */
+    if (p->readoutPolicy == READOUT_POLICY_IRQ){
+      for (b = 0; b < numBoards; b++){
+        if(  CAEN_DGTZ_SetInterruptConfig(handle[b], CAEN_DGTZ_ENABLE, ACQ_IRQ_LEVEL, ACQ_IRQ_STATUS_ID,
+                                          (uint16_t)options->IrqThreshold, CAEN_DGTZ_IRQ_MODE_RORA) != CAEN_DGTZ_Success  ){
+          fprintf(stderr, "acqPipeline - can't enable the interrupt of board %d: the IRQ 'ReadoutPolicy' needs the optical link\n", b);
+          return -1;
+        }
+      }
+    }
+    // the raw capture doesn't decode: no decoders nor output blocks
+    if (p->outputFormat == OUTPUT_RAW){
+      p->decoderCheck = 0;
+      if (ret){
+        fprintf(stderr, "acqPipeline - can't allocate the readout buffers (error %d)\n", ret);
+        return -1;
+      }
+      return 0;
+    }
+
+    // the events buffers are needed only to decode with the library
+    if(  (p->decoder == DECODER_LIBRARY) || p->decoderCheck  ){
+      for (b = 0; b < numBoards; b++)
+        ret |= CAEN_DGTZ_MallocDPPEvents(handle[b], (void**)p->events[b], &allocatedSize);
+    }
+    if (ret){
+      fprintf(stderr, "acqPipeline - can't allocate the readout buffers (error %d)\n", ret);
+      return -1;
+    }
+
+    for (b = 0; b < numBoards; b++){
+      for (i = 0; i < DECODER_COUNT; i++){
+        if(  ((i == p->decoder) || p->decoderCheck) && initPsdDecoder(&p->decoders[b][i], b)  )
+          return -1;
+        psdDecoderSetExtras(&p->decoders[b][i], p->extras);
+      }
+    }
+
+    if (p->histograms){
+      for (b = 0; b < numBoards; b++){
+        for (i = 0; i < MaxNChannels; i++){
+          if(  (params[b].ChannelMask & (1 << i)) && initPsdHisto(&p->histos[b][i])  )
+            return -1;
+        }
+      }
+    }
+
+    if (p->merge){
+      // the time tags of the boards are compared as they are (see timeMerge.h)
+      if (numBoards > 1)
+        fprintf(stderr, "acqPipeline - warning: the time merge orders the events of %d boards together, their clocks and run start must be synchronized\n", numBoards);
+      for (b = 0; b < numBoards; b++){
+        for (i = 0; i < MaxNChannels; i++){
+          if (params[b].ChannelMask & (1 << i))
+            streamMask |= 1ull << (b * PSD_MAX_CHANNELS + i);
+        }
+      }
+      initTimeMerge(&p->timeMerge, streamMask, (uint64_t)p->mergeWindow * 1000 / PSD_TIMETAG_NS);
+      if(  (p->mergeOut = (psdEvent_t*)malloc(ACQ_MERGE_CHUNK * sizeof(psdEvent_t))) == NULL  ){
+        fputs("acqPipeline - error trying allocating memory for the time merge\n", stderr);
+        return -1;
+      }
+      if(  p->deadTime && ((p->deadOut = (psdEvent_t*)malloc(ACQ_MERGE_CHUNK * sizeof(psdEvent_t))) == NULL)  ){
+        fputs("acqPipeline - error trying allocating memory for the dead time\n", stderr);
+        return -1;
+      }
+    }
+
+    for (i = 0; i < ACQ_OUT_BLOCKS; i++){
+      if(  (p->outBlocks[i].data = (char*)malloc(ACQ_OUT_BLOCK_SIZE)) == NULL  ){
+        fputs("acqPipeline - error trying allocating memory for the output blocks\n", stderr);
+        return -1;
+      }
+      p->outBlocks[i].capacity = ACQ_OUT_BLOCK_SIZE;
+      spscRingPush(&p->outFree, &p->outBlocks[i]);
+    }
+
+    if (p->waveforms){
+      /* the library unpacks the samples into a waveforms buffer, the in-tree
+         decoders tell where they are in the readout buffer */
+      for (b = 0; b < numBoards; b++){
+        if (p->decoder == DECODER_LIBRARY){
+          if (CAEN_DGTZ_MallocDPPWaveforms(handle[b], (void**)&p->waves[b], &allocatedSize)){
+            fputs("acqPipeline - can't allocate the waveforms buffers\n", stderr);
+            return -1;
+          }
+        }
+        else if (psdDecoderEnableSamples(&p->decoders[b][p->decoder]))
+          return -1;
+      }
+      if(  spscRingInit(&p->waveFree, ACQ_WAVE_BLOCKS) || spscRingInit(&p->waveFull, ACQ_WAVE_BLOCKS)
+          || ((p->traceIndex = (uint64_t*)malloc(ACQ_TRACE_INDEX_INITIAL * sizeof(uint64_t))) == NULL)  ){
+        fputs("acqPipeline - error trying allocating memory for the waveforms\n", stderr);
+        return -1;
+      }
+      p->traceCapacity = ACQ_TRACE_INDEX_INITIAL;
+      // the header of the waveform file is written by openRunWriter()
+      p->traceOffset = RUN_FILE_HEADER_SIZE;
+      for (i = 0; i < ACQ_WAVE_BLOCKS; i++){
+        if(  (p->waveBlocks[i].data = (char*)malloc(ACQ_OUT_BLOCK_SIZE)) == NULL  ){
+          fputs("acqPipeline - error trying allocating memory for the waveforms\n", stderr);
+          return -1;
+        }
+        p->waveBlocks[i].capacity = ACQ_OUT_BLOCK_SIZE;
+        spscRingPush(&p->waveFree, &p->waveBlocks[i]);
+      }
+    }
+
+    // the CFD needs the baselines of the software charges
+    if(  p->softwareCharge || p->cfd  ){
+      for (b = 0; b < numBoards; b++){
+        for (i = 0; i < MaxNChannels; i++){
+          if (!(params[b].ChannelMask & (1 << i)))
+            continue;
+          if(  initPsdChargeGates(&p->chargeGates[b][i], PRE_TRIGGER_SIZE, (uint32_t)dppParams[b].pgate[i], (uint32_t)dppParams[b].sgate[i],
+                                  (uint32_t)dppParams[b].lgate[i], dppParams[b].nsbl[i], params[b].PulsePolarity == CAEN_DGTZ_PulsePolarityNegative)  )
+            return -1;
+          if(  p->cfd && initPsdCfd(&p->cfds[b][i], PRE_TRIGGER_SIZE, p->chargeGates[b][i].gateStart, (uint32_t)options->CfdDelay,
+                                    (uint32_t)options->CfdFraction, (uint32_t)dppParams[b].thr[i], params[b].PulsePolarity == CAEN_DGTZ_PulsePolarityNegative)  )
+            return -1;
+        }
+      }
+    }
+  return 0;
+}
+
+/* Starts the writer, wave, decode and readout threads (one readout thread
+ * for each board, no decode thread with OUTPUT_RAW, no wave thread without
+ * the waveforms). The acquisition must already be started on the boards.
+ *
+ * @param p the pipeline to start
+ * @return 0 on success, -1 if a thread can't be created
+ */
+int startAcqPipeline(acqPipeline_t *p){
+  int b;
+    if( pthread_create(&p->writerThread, NULL, writerThreadMain, p) ){
+      perror("acqPipeline - can't create the writer thread");
+      return -1;
+    }
+    p->threadsStarted = 1;
+    if(  p->waveforms && pthread_create(&p->waveThread, NULL, waveThreadMain, p)  ){
+      perror("acqPipeline - can't create the wave thread");
+      atomic_store(&p->decodeDone, 1);
+      return -1;
+    }
+    p->waveThreadStarted = p->waveforms;
+    if(  (p->outputFormat != OUTPUT_RAW) && pthread_create(&p->decodeThread, NULL, decodeThreadMain, p)  ){
+      perror("acqPipeline - can't create the decode thread");
+      atomic_store(&p->decodeDone, 1);
+      return -1;
+    }
+    p->threadsStarted = 2;
+    p->startTime = monotonicNs();
+    for (b = 0; b < p->numBoards; b++){
+      if( pthread_create(&p->readers[b].thread, NULL, readoutThreadMain, &p->readers[b]) ){
+        perror("acqPipeline - can't create a readout thread");
+        // the decode and writer stages must not wait for the missing readers
+        for (; b < p->numBoards; b++)
+          atomic_store(&p->readers[b].done, 1);
+        p->threadsStarted = 3;
+        return -1;
+      }
+      p->readers[b].threadStarted = 1;
+    }
+    p->threadsStarted = 3;
+  return 0;
+}
+
+/* Asks the readout threads to stop and waits until they exit. The data
+ * already read is still processed by the decode and writer stages, the
+ * data still in the boards is lost (see drainAcqReadout()).
+ *
+ * @param p the running pipeline
+ */
+void stopAcqReadout(acqPipeline_t *p){
+    atomic_store(&p->stopReadout, 1);
+    joinReaders(p);
+}
+
+/* Ends the run: each readout thread stops the acquisition of its board
+ * (CAEN_DGTZ_SWStopAcquisition()) then reads the board until it is empty,
+ * for ACQ_DRAIN_TIMEOUT_MS at most, and exits. Waits until the readout
+ * threads exit; the data is then processed by the decode and writer
+ * stages (see finishAcqPipeline()).
+ *
+ * @param p the running pipeline
+ */
+void drainAcqReadout(acqPipeline_t *p){
+    atomic_store(&p->drain, 1);
+    joinReaders(p);
+}
+
+/* Waits until the readout threads exit.
+ */
+static void joinReaders(acqPipeline_t *p){
+  int b;
+    if (p->threadsStarted == 3){
+      for (b = 0; b < p->numBoards; b++){
+        if (p->readers[b].threadStarted){
+          pthread_join(p->readers[b].thread, NULL);
+          p->readers[b].threadStarted = 0;
+        }
+      }
+      p->threadsStarted = 2;
+    }
+}
+
+/* Waits until the decode and writer stages have processed all the pending
+ * blocks, then joins their threads. drainAcqReadout() or stopAcqReadout()
+ * must be called first.
+ *
+ * @param p the pipeline
+ * @return 0 on success, -1 if a stage reported an error
+ */
+int finishAcqPipeline(acqPipeline_t *p){
+    if (p->threadsStarted == 2){
+      if (p->outputFormat != OUTPUT_RAW)
+        pthread_join(p->decodeThread, NULL);
+      p->threadsStarted = 1;
+    }
+    if (p->threadsStarted == 1){
+      pthread_join(p->writerThread, NULL);
+      if (p->waveThreadStarted){
+        pthread_join(p->waveThread, NULL);
+        p->waveThreadStarted = 0;
+      }
+      p->threadsStarted = 0;
+    }
+  return acqPipelineError(p) ? -1 : 0;
+}
+
+/* Returns a non-zero integer if a stage reported a fatal error.
+ *
+ * @param p the pipeline
+ * @return 0 if no errors were reported, otherwise a non-zero integer
+ */
+int acqPipelineError(acqPipeline_t *p){
+  return atomic_load(&p->error);
+}
+
+/* Returns the number of bytes read from all the boards so far.
+ *
+ * @param p the pipeline
+ * @return the bytes read by the readout stages
+ */
+unsigned long acqPipelineReadoutBytes(acqPipeline_t *p){
+  unsigned long bytes = 0;
+  int b;
+    for (b = 0; b < p->numBoards; b++)
+      bytes += atomic_load_explicit(&p->readers[b].stats.bytes, memory_order_relaxed);
+  return bytes;
+}
+
+/* Asks the decode stage for a snapshot of the spectra (see psdHisto.h),
+ * unless a snapshot is already requested or not yet released.
+ *
+ * @param p the pipeline
+ */
+void requestAcqHistoSnapshot(acqPipeline_t *p){
+  int expected = ACQ_SNAPSHOT_IDLE;
+    atomic_compare_exchange_strong(&p->histoSnapshot, &expected, ACQ_SNAPSHOT_REQUESTED);
+}
+
+/* Returns a non-zero integer if the snapshot of the spectra is ready: the
+ * 'snapshot' of each psdHisto_t in 'histos' can be read until
+ * releaseAcqHistoSnapshot() is called. Once the pipeline is finished (see
+ * finishAcqPipeline()) the snapshot of the final spectra is taken here.
+ *
+ * @param p the pipeline
+ * @return non-zero if the snapshot is ready, otherwise 0
+ */
+int acqHistoSnapshotReady(acqPipeline_t *p){
+    if (!p->histograms)
+      return 0;
+    // no decode thread any more: the spectra can be read from this thread
+    if (p->threadsStarted == 0){
+      takeHistoSnapshot(p);
+      atomic_store(&p->histoSnapshot, ACQ_SNAPSHOT_READY);
+    }
+  return atomic_load(&p->histoSnapshot) == ACQ_SNAPSHOT_READY;
+}
+
+/* Gives the snapshot of the spectra back to the decode stage.
+ *
+ * @param p the pipeline
+ */
+void releaseAcqHistoSnapshot(acqPipeline_t *p){
+    atomic_store(&p->histoSnapshot, ACQ_SNAPSHOT_IDLE);
+}
+
+/* Copies the spectra of each enabled channel into their snapshot.
+ */
+static void takeHistoSnapshot(acqPipeline_t *p){
+  int b, ch;
+    for (b = 0; b < p->numBoards; b++){
+      for (ch = 0; ch < MaxNChannels; ch++){
+        if (p->histos[b][ch].live != NULL)
+          psdHistoSnapshot(&p->histos[b][ch]);
+      }
+    }
+}
+
+/* Prints the occupancy, high-water mark and stall counters of each stage,
+ * the readout stages one by one. The queue of a readout stage
+ * is its raw ring, waiting for the decode stage (for the writer with
+ * OUTPUT_RAW). The CPU load of a readout thread is its CPU time over the
+ * time since the start of the readout.
+ *
+ * @param p the pipeline
+ * @param fp where the statistics are printed
+ */
+void printAcqPipelineStats(acqPipeline_t *p, FILE *fp){
+  acqBoardReader_t *r;
+  int b;
+  uint64_t elapsed = monotonicNs() - p->startTime;
+  fprintf(fp, "Pipeline:\n");
+  for (b = 0; b < p->numBoards; b++){
+    r = &p->readers[b];
+    fprintf(fp, "\tReadout %d: %lu buffers, %.2f MB, queue %lu/%lu (max %lu), stalls %lu, empty reads %lu\n", b,
+                atomic_load(&r->stats.blocks), (float)atomic_load(&r->stats.bytes) / 1048576.0f,
+                spscRingOccupancy(&r->rawFull), spscRingCapacity(&r->rawFull), spscRingHighWater(&r->rawFull),
+                atomic_load(&r->stats.stalls), atomic_load(&r->stats.idles));
+    fprintf(fp, "\t           %s policy: %lu waits, CPU %.1f%%, max gap between reads with data %.2f ms\n",
+                (p->readoutPolicy == READOUT_POLICY_BUSY) ? "BUSY" : (p->readoutPolicy == READOUT_POLICY_ADAPTIVE) ? "ADAPTIVE" : "IRQ",
+                atomic_load(&r->waits), (elapsed > 0) ? (float)atomic_load(&r->cpuNs) * 100.0f / (float)elapsed : 0.0f,
+                (float)atomic_load(&r->maxGapNs) / 1e6f);
+  }
+  if (p->outputFormat == OUTPUT_RAW){
+    fprintf(fp, "\tWriter:  %.2f MB written (raw capture), idle polls %lu\n",
+                (float)atomic_load(&p->writerStats.bytes) / 1048576.0f, atomic_load(&p->writerStats.idles));
+    return;
+  }
+  fprintf(fp, "\tDecode:  %lu buffers, stalls %lu, idle polls %lu\n",
+              atomic_load(&p->decodeStats.blocks), atomic_load(&p->decodeStats.stalls), atomic_load(&p->decodeStats.idles));
+  fprintf(fp, "\tWriter:  queue %lu/%lu (max %lu), %.2f MB written, idle polls %lu\n",
+              spscRingOccupancy(&p->outFull), spscRingCapacity(&p->outFull), spscRingHighWater(&p->outFull),
+              (float)atomic_load(&p->writerStats.bytes) / 1048576.0f, atomic_load(&p->writerStats.idles));
+  if (p->merge)
+    fprintf(fp, "\tMerge:   window %lu us, pending %lu events (max %lu), late %lu\n", p->mergeWindow,
+                atomic_load(&p->mergePending), atomic_load(&p->mergeMaxPending), atomic_load(&p->mergeLate));
+  if (p->decoderCheck)
+    fprintf(fp, "\tDecoder check: %lu buffers with mismatching events\n", atomic_load(&p->decoderMismatches));
+  if (p->waveforms)
+    fprintf(fp, "\tWaves:   queue %lu/%lu (max %lu), %lu traces (%lu fine times), %.2f MB written, stalls %lu, idle polls %lu\n",
+                spscRingOccupancy(&p->waveFull), spscRingCapacity(&p->waveFull), spscRingHighWater(&p->waveFull), atomic_load(&p->traces),
+                atomic_load(&p->fineEvents),
+                (float)atomic_load(&p->waveStats.bytes) / 1048576.0f, atomic_load(&p->waveStats.stalls), atomic_load(&p->waveStats.idles));
+}
+
+/* Prints a table with the count, the mean, the 50th, 99th and 99.9th
+ * percentiles and the max duration (us) of each step of the pipeline that
+ * recorded values. Can be called by any thread while the pipeline runs.
+ *
+ * @param p the pipeline
+ * @param fp where the table is printed
+ */
+void printAcqPipelineLatency(acqPipeline_t *p, FILE *fp){
+  char name[16];
+  int b;
+    fputs("#  step          count     mean (us)      p50 (us)      p99 (us)    p99.9 (us)      max (us)\n", fp);
+    for (b = 0; b < p->numBoards; b++){
+      snprintf(name, sizeof(name), "read %d", b);
+      printLatencyRow(fp, name, &p->readers[b].readLatency);
+    }
+    printLatencyRow(fp, "decode", &p->decodeLatency);
+    printLatencyRow(fp, "charge", &p->chargeLatency);
+    printLatencyRow(fp, "histo", &p->histoLatency);
+    printLatencyRow(fp, "format", &p->formatLatency);
+    printLatencyRow(fp, "write", &p->writeLatency);
+}
+
+/* Prints the comparison of the software charges with those of the firmware,
+ * one line for each enabled channel (see psdCharge.h). The pipeline must be
+ * finished.
+ *
+ * @param p the pipeline
+ * @param fp where the table is printed
+ * @return 0 on success, otherwise a non-zero integer
+ */
+int printAcqChargeStats(acqPipeline_t *p, FILE *fp){
+  int b, ch;
+    fputs(PSD_CHARGE_STATS_HEADER, fp);
+    for (b = 0; b < p->numBoards; b++){
+      for (ch = 0; ch < MaxNChannels; ch++){
+        if (p->params[b].ChannelMask & (1 << ch))
+          printPsdChargeStats(fp, RUN_FILE_TEXT_CHANNEL(b, ch), &p->chargeStats[b][ch]);
+      }
+    }
+  return ferror(fp);
+}
+
+/* Prints the row of a step in the table of printAcqPipelineLatency()
+ * (nothing if the step recorded no values).
+ */
+static void printLatencyRow(FILE *fp, const char *name, latencyHisto_t *h){
+  latencySummary_t s;
+    latencyHistoSummary(h, &s);
+    if (s.count == 0)
+      return;
+    fprintf(fp, "%-9s %11lu %13.1f %13.1f %13.1f %13.1f %13.1f\n", name, s.count, s.mean / 1e3, (double)s.p50 / 1e3,
+                (double)s.p99 / 1e3, (double)s.p999 / 1e3, (double)s.max / 1e3);
+}
+
+/* Frees the memory allocated by initAcqPipeline(). The threads must be
+ * stopped.
+ *
+ * @param p the pipeline
+ */
+void freeAcqPipeline(acqPipeline_t *p){
+  register int i, b;
+  acqBoardReader_t *r;
+    for (b = 0; b < p->numBoards; b++){
+      r = &p->readers[b];
+      for (i = 0; i < ACQ_RAW_BLOCKS; i++){
+        if (r->rawBlocks[i].data != NULL)
+          CAEN_DGTZ_FreeReadoutBuffer(&r->rawBlocks[i].data);
+      }
+      spscRingFree(&r->rawFree);
+      spscRingFree(&r->rawFull);
+      if (p->events[b][0] != NULL)
+        CAEN_DGTZ_FreeDPPEvents(p->handle[b], (void**)p->events[b]);
+      for (i = 0; i < DECODER_COUNT; i++)
+        freePsdDecoder(&p->decoders[b][i]);
+      for (i = 0; i < MaxNChannels; i++)
+        freePsdHisto(&p->histos[b][i]);
+    }
+    for (i = 0; i < ACQ_OUT_BLOCKS; i++){
+      free(p->outBlocks[i].data);
+      p->outBlocks[i].data = NULL;
+    }
+    spscRingFree(&p->outFree);
+    spscRingFree(&p->outFull);
+    for (b = 0; b < p->numBoards; b++){
+      if (p->waves[b] != NULL){
+        CAEN_DGTZ_FreeDPPWaveforms(p->handle[b], p->waves[b]);
+        p->waves[b] = NULL;
+      }
+    }
+    for (i = 0; i < ACQ_WAVE_BLOCKS; i++){
+      free(p->waveBlocks[i].data);
+      p->waveBlocks[i].data = NULL;
+    }
+    spscRingFree(&p->waveFree);
+    spscRingFree(&p->waveFull);
+    free(p->traceIndex);
+    p->traceIndex = NULL;
+    if (p->merge){
+      freeTimeMerge(&p->timeMerge);
+      free(p->mergeOut);
+      p->mergeOut = NULL;
+      free(p->deadOut);
+      p->deadOut = NULL;
+      freeTdcrFilter(&p->filter);
+    }
+}
+
+/* Takes a block from 'freeRing'. If the ring is empty the calling stage
+ * waits (and a stall is counted) until a block is given back or until a
+ * fatal error is reported.
+ *
+ * @return the free block or NULL in case of fatal error
+ */
+static acqBlock_t *getFreeBlock(acqPipeline_t *p, spscRing_t *freeRing, acqStageStats_t *stats){
+  acqBlock_t *blk;
+    if(  (blk = (acqBlock_t*)spscRingPop(freeRing)) == NULL  ){
+      atomic_fetch_add_explicit(&stats->stalls, 1, memory_order_relaxed);
+      while(  (blk = (acqBlock_t*)spscRingPop(freeRing)) == NULL  ){
+        if (atomic_load(&p->error))
+          return NULL;
+        sched_yield();
+      }
+    }
+  return blk;
+}
+
+/* Takes a filled readout buffer from the raw rings of the boards. The rings
+ * are polled in turn from '*nextBoard', so that a busy board can't starve
+ * the others.
+ *
+ * @return the buffer or NULL if all the raw rings are empty
+ */
+static acqBlock_t *popRawBlock(acqPipeline_t *p, int *nextBoard){
+  acqBlock_t *blk;
+  int i, b = *nextBoard;
+    for (i = 0; i < p->numBoards; i++){
+      blk = (acqBlock_t*)spscRingPop(&p->readers[b].rawFull);
+      if (++b == p->numBoards)
+        b = 0;
+      if (blk != NULL){
+        *nextBoard = b;
+        return blk;
+      }
+    }
+  return NULL;
+}
+
+/* Returns a non-zero integer if all the readout threads exited: once it
+ * returned non-zero, the raw rings can only be emptied.
+ */
+static int readersDone(acqPipeline_t *p){
+  int b;
+    for (b = 0; b < p->numBoards; b++){
+      if (!atomic_load(&p->readers[b].done))
+        return 0;
+    }
+  return 1;
+}
+
+/* Readout stage of a board: reads the board into free readout buffers and
+ * passes the filled buffers to the decode stage. Between two reads it waits
+ * as set by the 'ReadoutPolicy' readout option:
+ * - BUSY: no wait;
+ * - ADAPTIVE: after an empty read the pause doubles (from
+ *   ACQ_POLL_MIN_WAIT_US up to 'pollMaxWait'); after a read with data it
+ *   shrinks by a quarter, down to 0 below ACQ_POLL_MIN_WAIT_US, and it drops
+ *   to 0 at once when the read filled half of the buffer (the board memory is
+ *   filling up). At a steady rate the pause settles where most reads return
+ *   data;
+ * - IRQ: CAEN_DGTZ_IRQWait() until the board raises the interrupt or for
+ *   'irqTimeout' at most; after a timeout the board is read anyway, so the
+ *   aggregates below the threshold wait 'irqTimeout' at most.
+ * When the drain is requested the thread stops the acquisition of the board
+ * and reads it without waits until ACQ_DRAIN_EMPTY_READS reads in a row
+ * return no data, or until ACQ_DRAIN_TIMEOUT_MS have passed.
+ */
+static void *readoutThreadMain(void *arg){
+  acqBoardReader_t *r = (acqBoardReader_t*)arg;
+  acqPipeline_t *p = r->pipeline;
+  int handle = p->handle[r->board];
+  acqBlock_t *blk = NULL;
+  CAEN_DGTZ_ErrorCode ret;
+  struct timespec now;
+  unsigned long wait = 0;         /* pause before the next read (us, ADAPTIVE) */
+  uint64_t t, start, lastData, lastCpuSample, drainEnd = 0;
+  uint64_t counts[PSD_MAX_CHANNELS];
+  int draining = 0, emptyReads = 0;
+  register int ch;
+    lastData = lastCpuSample = monotonicNs();
+    while(  !atomic_load(&p->stopReadout) && !atomic_load(&p->error)  ){
+      if(  !draining && atomic_load(&p->drain)  ){
+        // end of the run: the events already stored in the board are read
+        CAEN_DGTZ_SWStopAcquisition(handle);
+        draining = 1;
+        drainEnd = monotonicNs() + ACQ_DRAIN_TIMEOUT_MS * 1000000ull;
+      }
+      if (blk == NULL){
+        if(  (blk = getFreeBlock(p, &r->rawFree, &r->stats)) == NULL  )
+          break;
+      }
+      if (draining){
+        if (emptyReads > 0)
+          usleep(ACQ_DRAIN_PAUSE_US);
+      }
+      else if(  (p->readoutPolicy == READOUT_POLICY_ADAPTIVE) && (wait > 0)  ){
+        atomic_fetch_add_explicit(&r->waits, 1, memory_order_relaxed);
+        usleep(wait);
+      }
+      else if (p->readoutPolicy == READOUT_POLICY_IRQ){
+        atomic_fetch_add_explicit(&r->waits, 1, memory_order_relaxed);
+        ret = CAEN_DGTZ_IRQWait(handle, (uint32_t)p->irqTimeout);
+        if(  (ret != CAEN_DGTZ_Success) && (ret != CAEN_DGTZ_Timeout)  ){
+          printf("Interrupt wait error %d (board %d)\n", ret, r->board);
+          atomic_store(&p->error, 1);
+          break;
+        }
+      }
+      /* Read data from the board */
+      start = monotonicNs();
+      ret = CAEN_DGTZ_ReadData(handle, CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT, blk->data, &blk->size);
+      if (ret){
+        printf("Readout Error (board %d)\n", r->board);
+        atomic_store(&p->error, 1);
+        break;
+      }
+      t = monotonicNs();
+      if (t - lastCpuSample >= ACQ_CPU_SAMPLE_NS){
+        atomic_store_explicit(&r->cpuNs, threadCpuNs(), memory_order_relaxed);
+        lastCpuSample = t;
+      }
+      if (blk->size == 0){
+        // nothing to read: keep the same buffer for the next readout
+        atomic_fetch_add_explicit(&r->stats.idles, 1, memory_order_relaxed);
+        if (draining){
+          if (++emptyReads >= ACQ_DRAIN_EMPTY_READS)
+            break;
+          if (t >= drainEnd){
+            atomic_store(&r->drainTimedOut, 1);
+            break;
+          }
+          continue;
+        }
+        wait = (wait == 0) ? ACQ_POLL_MIN_WAIT_US : wait * 2;
+        if (wait > p->pollMaxWait)
+          wait = p->pollMaxWait;
+        continue;
+      }
+      latencyHistoRecord(&r->readLatency, t - start);
+      if (blk->size >= blk->capacity / 2)
+        wait = 0;
+      else{
+        wait -= wait / 4;
+        // below the first pause the quarters would stop at 3 us, never at 0
+        if (wait < ACQ_POLL_MIN_WAIT_US)
+          wait = 0;
+      }
+      if (t - lastData > atomic_load_explicit(&r->maxGapNs, memory_order_relaxed))
+        atomic_store_explicit(&r->maxGapNs, t - lastData, memory_order_relaxed);
+      lastData = t;
+      if (draining){
+        emptyReads = 0;
+        memset(counts, 0, sizeof(counts));
+        psdCountEvents((const uint32_t*)blk->data, blk->size / 4, counts);
+        for (ch = 0; ch < PSD_MAX_CHANNELS; ch++)
+          atomic_fetch_add_explicit(&r->drainEvents, counts[ch], memory_order_relaxed);
+        atomic_fetch_add_explicit(&r->drainBytes, blk->size, memory_order_relaxed);
+      }
+      clock_gettime(CLOCK_REALTIME, &now);
+      blk->stamp = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+      blk->readTime = t;
+      atomic_fetch_add_explicit(&r->stats.blocks, 1, memory_order_relaxed);
+      atomic_fetch_add_explicit(&r->stats.bytes, blk->size, memory_order_relaxed);
+      // the ring can hold the whole pool: the push never fails
+      spscRingPush(&r->rawFull, blk);
+      blk = NULL;
+      if(  draining && (t >= drainEnd)  ){
+        // the board is still sending data: the stop can't wait any longer
+        atomic_store(&r->drainTimedOut, 1);
+        break;
+      }
+    }
+    if (p->readoutPolicy == READOUT_POLICY_IRQ)
+      CAEN_DGTZ_SetInterruptConfig(handle, CAEN_DGTZ_DISABLE, ACQ_IRQ_LEVEL, ACQ_IRQ_STATUS_ID, 0, CAEN_DGTZ_IRQ_MODE_RORA);
+    atomic_store(&r->cpuNs, threadCpuNs());
+    atomic_store(&r->done, 1);
+  return NULL;
+}
+
+/* @return the CLOCK_MONOTONIC time in nanoseconds */
+static uint64_t monotonicNs(void){
+  struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* @return the CPU time used by the calling thread in nanoseconds */
+static uint64_t threadCpuNs(void){
+  struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Decode stage: unpacks the events of the readout buffers of all the boards,
+ * formats them into output blocks then gives the readout buffers back to the
+ * readout stage of their board.
+ */
+static void *decodeThreadMain(void *arg){
+  acqPipeline_t *p = (acqPipeline_t*)arg;
+  acqBlock_t *raw, *out = NULL;
+  int nextBoard = 0, inputDone;
+    while( !atomic_load(&p->error) ){
+      if(  p->histograms && (atomic_load(&p->histoSnapshot) == ACQ_SNAPSHOT_REQUESTED)  ){
+        takeHistoSnapshot(p);
+        atomic_store(&p->histoSnapshot, ACQ_SNAPSHOT_READY);
+      }
+      // checked before polling: once all the readers exited no buffer can be missed
+      inputDone = readersDone(p);
+      if(  (raw = popRawBlock(p, &nextBoard)) == NULL  ){
+        if (inputDone)
+          break;
+        atomic_fetch_add_explicit(&p->decodeStats.idles, 1, memory_order_relaxed);
+        usleep(ACQ_IDLE_WAIT_US);
+        continue;
+      }
+      if (decodeRawBlock(p, raw, &out)){
+        atomic_store(&p->error, 1);
+        break;
+      }
+      atomic_fetch_add_explicit(&p->decodeStats.blocks, 1, memory_order_relaxed);
+      atomic_fetch_add_explicit(&p->decodeStats.bytes, raw->size, memory_order_relaxed);
+      spscRingPush(&p->readers[raw->board].rawFree, raw);
+    }
+
+    // the end of the run: the records still held by the time merge are written
+    if(  p->merge && !atomic_load(&p->error) && outputMerged(p, 1, &out)  )
+      atomic_store(&p->error, 1);
+    // hand the last (partially filled) output and wave blocks to the writers
+    if (out != NULL)
+      spscRingPush(&p->outFull, out);
+    if (p->waveBlock != NULL)
+      spscRingPush(&p->waveFull, p->waveBlock);
+    atomic_store(&p->decodeDone, 1);
+  return NULL;
+}
+
+/* Unpacks the events of the readout buffer 'raw' and appends them to the
+ * output block '*out' (see outputRecords()). With the time merge the events
+ * are pushed into the merge and those it can already pop are appended.
+ *
+ * @return 0 on success, -1 in case of error
+ */
+static int decodeRawBlock(acqPipeline_t *p, acqBlock_t *raw, acqBlock_t **out){
+  acqBlock_t *blk = *out;
+  int b = raw->board;
+  psdDecoder_t *d = &p->decoders[b][p->decoder];
+  register int i;
+  unsigned int ch;
+  uint64_t start = monotonicNs(), decoded, t, histoNs = 0;
+    if (decodeWith(p, p->decoder, raw))
+      return -1;
+    if (p->decoderCheck){
+      for (i = 0; i < DECODER_COUNT; i++){
+        if(  (i != p->decoder) && decodeWith(p, i, raw)  )
+          return -1;
+      }
+      checkDecoders(p, b);
+    }
+    // the samples point into the readout buffer: they are copied now
+    p->chargeNs = 0;
+    if(  p->waveforms && captureTraces(p, b)  )
+      return -1;
+    decoded = monotonicNs();
+    latencyHistoRecord(&p->decodeLatency, decoded - start - p->chargeNs);
+    if(  p->softwareCharge || p->cfd  )
+      latencyHistoRecord(&p->chargeLatency, p->chargeNs);
+
+    for (ch = 0; ch < MaxNChannels; ch++){
+      if (!(p->params[b].ChannelMask & (1 << ch)))
+        continue;
+
+      if (p->histograms){
+        t = monotonicNs();
+        psdHistoFill(&p->histos[b][ch], d->events[ch], d->numEvents[ch]);
+        histoNs += monotonicNs() - t;
+      }
+      if (p->merge){
+        if (timeMergePush(&p->timeMerge, b * PSD_MAX_CHANNELS + ch, d->events[ch], d->numEvents[ch]))
+          return -1;
+      }
+      else if (outputRecords(p, d->events[ch], d->numEvents[ch], &blk)){
+        *out = NULL;
+        return -1;
+      }
+
+      atomic_fetch_add_explicit(&p->recordedEvents[b][ch], d->numEvents[ch], memory_order_relaxed);
+      atomic_store_explicit(&p->rollovers[b][ch], d->rollovers[ch], memory_order_relaxed);
+      atomic_store_explicit(&p->missedRollovers[b][ch], d->missedRollovers[ch], memory_order_relaxed);
+      if (p->extras == PSD_EXTRAS_TRIGGERS){
+        atomic_store_explicit(&p->boardTriggers[b][ch], d->totalTriggers[ch], memory_order_relaxed);
+        atomic_store_explicit(&p->boardLostTriggers[b][ch], d->lostTriggers[ch], memory_order_relaxed);
+      }
+    } // loop on channels
+
+    if(  p->merge && outputMerged(p, 0, &blk)  ){
+      *out = NULL;
+      return -1;
+    }
+    *out = blk;
+    if (p->histograms)
+      latencyHistoRecord(&p->histoLatency, histoNs);
+    latencyHistoRecord(&p->formatLatency, monotonicNs() - decoded - histoNs);
+  return 0;
+}
+
+/* Appends 'count' records to the output blocks, starting from '*blk': one
+ * text line (RUN_FILE_TEXT_LINE, or RUN_FILE_TEXT_NS_LINE with OUTPUT_TEXT_NS,
+ * see formatRunFileText()) for each record or, with OUTPUT_BINARY, the
+ * records themselves. When a block is full it is passed to the writer stage
+ * and a new free block is taken.
+ *
+ * @return 0 on success, -1 in case of fatal error ('*blk' is then NULL)
+ */
+static int outputRecords(acqPipeline_t *p, const psdEvent_t *ev, uint32_t count, acqBlock_t **blk){
+  uint32_t n;
+  int layout = (p->outputFormat == OUTPUT_TEXT_NS) ? RUN_FILE_TEXT_NS : RUN_FILE_TEXT_LEGACY;
+    if (p->outputFormat == OUTPUT_BINARY)
+      return appendRecords(p, ev, count, blk);
+    // as many lines as the block can surely take are formatted at once
+    while (count > 0){
+      if (reserveOutBlock(p, blk, RUN_FILE_TEXT_MAX_LINE))
+        return -1;
+      n = ((*blk)->capacity - (*blk)->size) / RUN_FILE_TEXT_MAX_LINE;
+      if (n > count)
+        n = count;
+      (*blk)->size += (uint32_t)formatRunFileText((*blk)->data + (*blk)->size, ev, n, (uint32_t)p->bitMask, layout);
+      ev += n;
+      count -= n;
+    }
+  return 0;
+}
+
+/* Copies the samples of the events of the board 'board' just decoded into
+ * waveform records (see runFile.h) in the wave blocks: from the readout
+ * buffer with the in-tree decoders, through CAEN_DGTZ_DecodeDPPWaveforms()
+ * with DECODER_LIBRARY. The events without samples are skipped. With the
+ * software charges or the fine time the first trace of each record is also
+ * integrated (see addChargeTrace()).
+ *
+ * @return 0 on success, -1 in case of error (a description is printed)
+ */
+static int captureTraces(acqPipeline_t *p, int board){
+  psdDecoder_t *d = &p->decoders[board][p->decoder];
+  CAEN_DGTZ_DPP_PSD_Waveforms_t *wf = p->waves[board];
+  CAEN_DGTZ_DPP_PSD_Event_t *ev;
+  CAEN_DGTZ_ErrorCode ret;
+  const psdSamples_t *s;
+  uint16_t *dst;
+  uint32_t i, j, n;
+  unsigned int ch;
+    for (ch = 0; ch < MaxNChannels; ch++){
+      if (!(p->params[board].ChannelMask & (1 << ch)))
+        continue;
+      for (i = 0; i < d->numEvents[ch]; i++){
+        if (p->decoder == DECODER_LIBRARY){
+          ev = &p->events[board][ch][i];
+          if (ev->Waveforms == NULL)
+            continue;
+          if(  (ret = CAEN_DGTZ_DecodeDPPWaveforms(p->handle[board], ev, wf)) != CAEN_DGTZ_Success  ){
+            printf("Data Error: %d\n", ret);
+            return -1;
+          }
+          if (wf->Ns == 0)
+            continue;
+          if(  (dst = reserveTrace(p, &d->events[ch][i], wf->Ns, wf->dualTrace ? 2 : 1)) == NULL  )
+            return -1;
+          memcpy(dst, wf->Trace1, wf->Ns * sizeof(uint16_t));
+          if (wf->dualTrace)
+            memcpy(dst + wf->Ns, wf->Trace2, wf->Ns * sizeof(uint16_t));
+          if(  p->softwareCharge || p->cfd  )
+            addChargeTrace(p, board, ch, dst, wf->Ns, &d->events[ch][i]);
+          continue;
+        }
+        s = &d->samples[ch][i];
+        if(  (s->words == NULL) || (s->numSamples == 0)  )
+          continue;
+        if (s->dualTrace){
+          // two samples a word, one of each trace
+          n = s->numSamples / 2;
+          if(  (dst = reserveTrace(p, &d->events[ch][i], n, 2)) == NULL  )
+            return -1;
+          for (j = 0; j < n; j++){
+            dst[j] = (uint16_t)(s->words[j] & PSD_SAMPLE_MASK);
+            dst[n + j] = (uint16_t)((s->words[j] >> 16) & PSD_SAMPLE_MASK);
+          }
+        }
+        else{
+          n = s->numSamples;
+          if(  (dst = reserveTrace(p, &d->events[ch][i], n, 1)) == NULL  )
+            return -1;
+          for (j = 0; j < n / 2; j++){
+            dst[2 * j] = (uint16_t)(s->words[j] & PSD_SAMPLE_MASK);
+            dst[2 * j + 1] = (uint16_t)((s->words[j] >> 16) & PSD_SAMPLE_MASK);
+          }
+        }
+        if(  p->softwareCharge || p->cfd  )
+          addChargeTrace(p, board, ch, dst, n, &d->events[ch][i]);
+      }
+      if (p->numCharges > 0)
+        integrateCharges(p);
+    }
+  return 0;
+}
+
+/* Adds a trace just copied into a wave block (after the header of its
+ * record, see reserveTrace()) to the batch of the software charges; the
+ * batch is integrated when it is full (it holds the traces of one channel
+ * only).
+ */
+static void addChargeTrace(acqPipeline_t *p, int board, int ch, uint16_t *samples, uint32_t numSamples, psdEvent_t *ev){
+    if(  (p->numCharges > 0) && ((board != p->chargeBoard) || (ch != p->chargeChannel))  )
+      integrateCharges(p);
+    p->chargeBoard = board;
+    p->chargeChannel = ch;
+    p->chargeTraces[p->numCharges].samples = samples;
+    p->chargeTraces[p->numCharges].numSamples = numSamples;
+    p->chargeEvents[p->numCharges] = ev;
+    p->chargeRecords[p->numCharges] = &((runFileTrace_t*)samples - 1)->event;
+    if (++p->numCharges == PSD_CHARGE_BATCH)
+      integrateCharges(p);
+}
+
+/* Integrates the batch of the software charges and compares the charges
+ * with those of the firmware, and/or sets the fine time of the events and
+ * of their waveform records. Must be called before the wave block holding
+ * the traces is passed to the wave thread.
+ */
+static void integrateCharges(acqPipeline_t *p){
+  psdChargeStats_t *stats = &p->chargeStats[p->chargeBoard][p->chargeChannel];
+  uint64_t start = monotonicNs();
+  uint32_t i;
+  unsigned long fine = 0;
+    psdChargeVector(&p->chargeGates[p->chargeBoard][p->chargeChannel], p->chargeTraces, p->numCharges, p->charges);
+    if (p->softwareCharge){
+      for (i = 0; i < p->numCharges; i++)
+        psdChargeStatsAdd(stats, p->chargeEvents[i], &p->charges[i]);
+    }
+    if (p->cfd){
+      psdCfdVector(&p->cfds[p->chargeBoard][p->chargeChannel], p->chargeTraces, p->charges, p->numCharges, p->fineTimes);
+      for (i = 0; i < p->numCharges; i++){
+        if (p->fineTimes[i] == PSD_CFD_NO_TIME)
+          continue;
+        PSD_EVENT_SET_FINE(p->chargeEvents[i], p->fineTimes[i]);
+        PSD_EVENT_SET_FINE(p->chargeRecords[i], p->fineTimes[i]);
+        fine++;
+      }
+      atomic_fetch_add_explicit(&p->fineEvents, fine, memory_order_relaxed);
+    }
+    p->numCharges = 0;
+    p->chargeNs += monotonicNs() - start;
+}
+
+/* Appends the header of a waveform record of the event 'ev' to the wave
+ * blocks (when the block is full it is passed to the wave thread and a new
+ * free block is taken) and adds its offset to the index.
+ *
+ * @return where the 'numSamples' * 'numTraces' samples of the record are
+ * written, NULL in case of fatal error
+ */
+static uint16_t *reserveTrace(acqPipeline_t *p, const psdEvent_t *ev, uint32_t numSamples, uint32_t numTraces){
+  size_t size = RUN_FILE_TRACE_SIZE(numSamples, numTraces);
+  acqBlock_t *blk = p->waveBlock;
+  runFileTrace_t *trace;
+  uint64_t *newIndex;
+    if (size > ACQ_OUT_BLOCK_SIZE){
+      fprintf(stderr, "acqPipeline - a waveform of %u samples doesn't fit in a wave block\n", numSamples);
+      return NULL;
+    }
+    if(  (blk == NULL) || (blk->capacity - blk->size < size)  ){
+      // the traces waiting for their charges are in this block
+      if (p->numCharges > 0)
+        integrateCharges(p);
+      if (blk != NULL)
+        spscRingPush(&p->waveFull, blk);
+      if(  (blk = p->waveBlock = getFreeBlock(p, &p->waveFree, &p->waveStats)) == NULL  )
+        return NULL;
+      blk->size = 0;
+    }
+    if (p->numTraces == p->traceCapacity){
+      if(  (newIndex = (uint64_t*)realloc(p->traceIndex, 2 * p->traceCapacity * sizeof(uint64_t))) == NULL  ){
+        fputs("acqPipeline - error trying allocating memory for the index of the waveforms\n", stderr);
+        return NULL;
+      }
+      p->traceIndex = newIndex;
+      p->traceCapacity *= 2;
+    }
+    p->traceIndex[p->numTraces++] = p->traceOffset;
+    p->traceOffset += size;
+    atomic_store_explicit(&p->traces, p->numTraces, memory_order_relaxed);
+
+    trace = (runFileTrace_t*)(blk->data + blk->size);
+    // the padding, before the header: a record without samples is just the header
+    memset(blk->data + blk->size + size - 8, 0, 8);
+    trace->sync = RUN_FILE_TRACE_SYNC;
+    trace->size = (uint32_t)size;
+    trace->numSamples = numSamples;
+    trace->numTraces = numTraces;
+    trace->event = *ev;
+    blk->size += (uint32_t)size;
+  return (uint16_t*)(trace + 1);
+}
+
+/* Pops the records the time merge can release (all of them if 'flush' is
+ * set), counts their coincidences if enabled, for the resolving time and for
+ * those of the scan (on the records that pass the dead time if any) and
+ * appends them all to the output blocks (see
+ * outputRecords()), or only those the coincidence filter lets through.
+ *
+ * @return 0 on success, -1 in case of fatal error ('*blk' is then NULL)
+ */
+static int outputMerged(acqPipeline_t *p, int flush, acqBlock_t **blk){
+  uint32_t n, m, k;
+  uint64_t counts[TDCR_NUM_COUNTS];
+  register int i;
+    do{
+      n = timeMergePop(&p->timeMerge, flush, p->mergeOut, ACQ_MERGE_CHUNK);
+      if (p->deadTime){
+        m = tdcrDeadTimeFilter(&p->dead, p->mergeOut, n, p->deadOut);
+        tdcrCoincPush(&p->coinc, p->deadOut, m);
+        if (p->coincScan)
+          tdcrScanPush(&p->scan, p->deadOut, m);
+      }
+      else{
+        if (p->coincidence)
+          tdcrCoincPush(&p->coinc, p->mergeOut, n);
+        if (p->coincScan)
+          tdcrScanPush(&p->scan, p->mergeOut, n);
+      }
+      if (p->coincFilter){
+        if(  tdcrFilterPush(&p->filter, p->mergeOut, n) || outputRecords(p, p->filter.out, p->filter.numOut, blk)  )
+          return -1;
+      }
+      else if (outputRecords(p, p->mergeOut, n, blk))
+        return -1;
+    } while (n == ACQ_MERGE_CHUNK);
+    if (p->coincFilter){
+      // the records of the window still open
+      if(  flush && (tdcrFilterFlush(&p->filter) || outputRecords(p, p->filter.out, p->filter.numOut, blk))  )
+        return -1;
+      for (i = 0; i < PSD_MAX_CHANNELS; i++){
+        atomic_store_explicit(&p->filterCoincident[i], p->filter.coincident[i], memory_order_relaxed);
+        atomic_store_explicit(&p->filterPrescaled[i], p->filter.prescaled[i], memory_order_relaxed);
+        atomic_store_explicit(&p->filterSuppressed[i], p->filter.suppressed[i], memory_order_relaxed);
+      }
+    }
+    if (p->coincidence){
+      if (flush)
+        tdcrCoincFlush(&p->coinc);
+      for (i = 0; i < TDCR_NUM_COUNTS; i++)
+        atomic_store_explicit(&p->coincCounts[i], p->coinc.counts[i], memory_order_relaxed);
+    }
+    if (p->coincScan){
+      if (flush)
+        tdcrScanFlush(&p->scan);
+      for (k = 0; k < p->scan.numWindows; k++){
+        tdcrScanCounts(&p->scan, k, counts);
+        for (i = 0; i < TDCR_NUM_COUNTS; i++)
+          atomic_store_explicit(&p->scanCounts[k][i], counts[i], memory_order_relaxed);
+      }
+    }
+    if (p->deadTime){
+      for (i = 0; i < TDCR_DEAD_STAGES; i++){
+        atomic_store_explicit(&p->deadRejected[i], p->dead.stages[i].rejected, memory_order_relaxed);
+        atomic_store_explicit(&p->deadLiveNs[i], (unsigned long)tdcrDeadLiveNs(&p->dead.stages[i]), memory_order_relaxed);
+      }
+    }
+    atomic_store_explicit(&p->mergePending, p->timeMerge.pending, memory_order_relaxed);
+    atomic_store_explicit(&p->mergeMaxPending, p->timeMerge.maxPending, memory_order_relaxed);
+    atomic_store_explicit(&p->mergeLate, p->timeMerge.late, memory_order_relaxed);
+  return 0;
+}
+
+/* Makes sure that the output block '*blk' has room for 'needed' more bytes:
+ * if it hasn't (or if '*blk' is NULL) the block is passed to the writer stage
+ * and a new free block is taken.
+ *
+ * @return 0 on success, -1 in case of fatal error ('*blk' is then NULL)
+ */
+static int reserveOutBlock(acqPipeline_t *p, acqBlock_t **blk, uint32_t needed){
+    if(  (*blk != NULL) && ((*blk)->capacity - (*blk)->size >= needed)  )
+      return 0;
+    if (*blk != NULL)
+      spscRingPush(&p->outFull, *blk);
+    if(  (*blk = getFreeBlock(p, &p->outFree, &p->decodeStats)) == NULL  )
+      return -1;
+    (*blk)->size = 0;
+  return 0;
+}
+
+/* Copies 'count' records into the output blocks, starting from '*blk'. The
+ * blocks are filled up to the last byte: their size is a multiple of the
+ * record size.
+ *
+ * @return 0 on success, -1 in case of fatal error ('*blk' is then NULL)
+ */
+static int appendRecords(acqPipeline_t *p, const psdEvent_t *ev, uint32_t count, acqBlock_t **blk){
+  uint32_t n;
+    while (count > 0){
+      if (reserveOutBlock(p, blk, sizeof(psdEvent_t)))
+        return -1;
+      n = ((*blk)->capacity - (*blk)->size) / sizeof(psdEvent_t);
+      if (n > count)
+        n = count;
+      memcpy((*blk)->data + (*blk)->size, ev, n * sizeof(psdEvent_t));
+      (*blk)->size += n * sizeof(psdEvent_t);
+      ev += n;
+      count -= n;
+    }
+  return 0;
+}
+
+/* Decodes the readout buffer 'raw' into the records of the decoder
+ * 'decoder' (DECODER_*) of its board. With DECODER_LIBRARY the events
+ * unpacked by CAEN_DGTZ_GetDPPEvents() are converted into records.
+ *
+ * @return 0 on success, -1 in case of error (a description is printed)
+ */
+static int decodeWith(acqPipeline_t *p, int decoder, acqBlock_t *raw){
+  CAEN_DGTZ_ErrorCode ret;
+  CAEN_DGTZ_DPP_PSD_Event_t *ev;
+  psdDecoder_t *d = &p->decoders[raw->board][decoder];
+  unsigned int ch, i;
+    // the boards start before the readout threads: PSD_CLOCK_MARGIN covers the difference
+    psdDecoderSetClock(d, (raw->readTime - p->startTime) / PSD_TIMETAG_NS);
+    switch (decoder){
+      case DECODER_SCALAR:
+        return psdDecodeScalar(d, (const uint32_t*)raw->data, raw->size / 4);
+      case DECODER_VECTOR:
+        return psdDecodeVector(d, (const uint32_t*)raw->data, raw->size / 4);
+    }
+
+    ret = CAEN_DGTZ_GetDPPEvents(p->handle[raw->board], raw->data, raw->size, (void**)p->events[raw->board], p->numEvents);
+    if (ret){
+      printf("Data Error: %d\n", ret);
+      return -1;
+    }
+    psdDecoderClear(d);
+    for (ch = 0; ch < MaxNChannels; ch++){
+      for (i = 0; i < p->numEvents[ch]; i++){
+        ev = &p->events[raw->board][ch][i];
+        if (psdDecoderPushEvent(d, ch, ev->TimeTag, ((ev->Format >> 28) & 1) ? &ev->Extras : NULL, (uint16_t)ev->ChargeShort,
+                                (uint16_t)ev->ChargeLong, ev->Pur))
+          return -1;
+      }
+    }
+  return 0;
+}
+
+/* Compares the records of the in-tree decoders of the board 'board' with
+ * those converted from the library output. A buffer with differences is
+ * counted in 'decoderMismatches'; the first difference found during the run
+ * is described on stdout.
+ */
+static void checkDecoders(acqPipeline_t *p, int board){
+  static const char *decoderNames[DECODER_COUNT] = { "library", "scalar", "vector" };
+  psdDecoder_t *lib = &p->decoders[board][DECODER_LIBRARY], *d;
+  register int i;
+  unsigned int ch, n;
+    for (i = DECODER_SCALAR; i <= DECODER_VECTOR; i++){
+      d = &p->decoders[board][i];
+      for (ch = 0; ch < MaxNChannels; ch++){
+        if (d->numEvents[ch] != lib->numEvents[ch]){
+          if (atomic_fetch_add(&p->decoderMismatches, 1) == 0)
+            printf("Decoder check: board %d ch %u: %u events from the %s decoder, %u from the library\n",
+                   board, ch, d->numEvents[ch], decoderNames[i], lib->numEvents[ch]);
+          return;
+        }
+        for (n = 0; n < d->numEvents[ch]; n++){
+          if (memcmp(&d->events[ch][n], &lib->events[ch][n], sizeof(psdEvent_t))){
+            if (atomic_fetch_add(&p->decoderMismatches, 1) == 0)
+              printf("Decoder check: board %d ch %u event %u: %s decoder (ts %lu, qs %u, ql %u, flags %#x) != library (ts %lu, qs %u, ql %u, flags %#x)\n",
+                     board, ch, n, decoderNames[i],
+                     (unsigned long)d->events[ch][n].timestamp, d->events[ch][n].qshort, d->events[ch][n].qlong, d->events[ch][n].flags,
+                     (unsigned long)lib->events[ch][n].timestamp, lib->events[ch][n].qshort, lib->events[ch][n].qlong, lib->events[ch][n].flags);
+            return;
+          }
+        }
+      }
+    }
+}
+
+/* Writes the readout buffer 'raw' verbatim in a frame of the raw capture
+ * file and counts its events from the aggregate headers.
+ *
+ * @return 0 on success, -1 in case of write error (a description is printed)
+ */
+static int writeRawFrame(acqPipeline_t *p, acqBlock_t *raw){
+  runFileFrame_t frame;
+  uint64_t counts[PSD_MAX_CHANNELS] = { 0 };
+  register int ch;
+    frame.sync = RUN_FILE_FRAME_SYNC;
+    frame.board = (uint32_t)raw->board;
+    frame.stamp = raw->stamp;
+    frame.size = raw->size;
+    frame.reserved = 0;
+    // a new segment can start before a frame
+    if(  runWriterCheckRotation(p->out) || runWriterWrite(p->out, &frame, sizeof(runFileFrame_t))
+        || runWriterWrite(p->out, raw->data, raw->size)  )
+      return -1;
+    // a malformed buffer is written anyway: the offline decoder reports it
+    psdCountEvents((const uint32_t*)raw->data, raw->size / 4, counts);
+    for (ch = 0; ch < MaxNChannels; ch++)
+      atomic_fetch_add_explicit(&p->recordedEvents[raw->board][ch], counts[ch], memory_order_relaxed);
+    atomic_fetch_add_explicit(&p->writerStats.bytes, sizeof(runFileFrame_t), memory_order_relaxed);
+  return 0;
+}
+
+/* Writer stage: puts the output blocks on disk then gives them back to the
+ * decode stage. With OUTPUT_RAW the blocks are the readout buffers, taken
+ * from the readout stages and given back to the stage of their board.
+ */
+static void *writerThreadMain(void *arg){
+  acqPipeline_t *p = (acqPipeline_t*)arg;
+  acqBlock_t *blk;
+  int raw = (p->outputFormat == OUTPUT_RAW);
+  int nextBoard = 0, inputDone;
+  uint64_t start;
+    while( !atomic_load(&p->error) ){
+      // checked before polling: once the input stage exited no block can be missed
+      inputDone = raw ? readersDone(p) : atomic_load(&p->decodeDone);
+      if(  (blk = raw ? popRawBlock(p, &nextBoard) : (acqBlock_t*)spscRingPop(&p->outFull)) == NULL  ){
+        if (inputDone)
+          break;
+        atomic_fetch_add_explicit(&p->writerStats.idles, 1, memory_order_relaxed);
+        usleep(ACQ_IDLE_WAIT_US);
+        continue;
+      }
+      start = monotonicNs();
+      if (raw){
+        if (writeRawFrame(p, blk)){
+          atomic_store(&p->error, 1);
+          break;
+        }
+      }
+      // a block holds whole records: a new segment can start before it
+      else if(  runWriterCheckRotation(p->out) || runWriterWrite(p->out, blk->data, blk->size)  ){
+        atomic_store(&p->error, 1);
+        break;
+      }
+      latencyHistoRecord(&p->writeLatency, monotonicNs() - start);
+      atomic_fetch_add_explicit(&p->writerStats.blocks, 1, memory_order_relaxed);
+      atomic_fetch_add_explicit(&p->writerStats.bytes, blk->size, memory_order_relaxed);
+      blk->size = 0;
+      spscRingPush(raw ? &p->readers[blk->board].rawFree : &p->outFree, blk);
+    }
+    if (runWriterFlush(p->out))
+      atomic_store(&p->error, 1);
+  return NULL;
+}
+
+/* Wave stage: puts the wave blocks on disk through the waveform file then
+ * gives them back to the decode stage. Once the decode stage is done the
+ * index of the waveform records and the trailer are written after them (see
+ * runFile.h): a run stopped by an error leaves a file without the index.
+ */
+static void *waveThreadMain(void *arg){
+  acqPipeline_t *p = (acqPipeline_t*)arg;
+  acqBlock_t *blk;
+  runFileTraceIndex_t trailer;
+  int inputDone;
+    while( !atomic_load(&p->error) ){
+      // checked before polling: once the decode stage exited no block can be missed
+      inputDone = atomic_load(&p->decodeDone);
+      if(  (blk = (acqBlock_t*)spscRingPop(&p->waveFull)) == NULL  ){
+        if (inputDone)
+          break;
+        atomic_fetch_add_explicit(&p->waveStats.idles, 1, memory_order_relaxed);
+        usleep(ACQ_IDLE_WAIT_US);
+        continue;
+      }
+      if (runWriterWrite(p->waveOut, blk->data, blk->size)){
+        atomic_store(&p->error, 1);
+        break;
+      }
+      atomic_fetch_add_explicit(&p->waveStats.blocks, 1, memory_order_relaxed);
+      atomic_fetch_add_explicit(&p->waveStats.bytes, blk->size, memory_order_relaxed);
+      blk->size = 0;
+      spscRingPush(&p->waveFree, blk);
+    }
+    // the decode thread is done: the index is not modified any more
+    if (!atomic_load(&p->error)){
+      trailer.sync = RUN_FILE_INDEX_SYNC;
+      trailer.reserved = 0;
+      trailer.count = p->numTraces;
+      trailer.offset = p->traceOffset;
+      if(  ((p->numTraces > 0) && runWriterWrite(p->waveOut, p->traceIndex, p->numTraces * sizeof(uint64_t)))
+          || runWriterWrite(p->waveOut, &trailer, sizeof(runFileTraceIndex_t))  )
+        atomic_store(&p->error, 1);
+    }
+    if (runWriterFlush(p->waveOut))
+      atomic_store(&p->error, 1);
+  return NULL;
+}
@@ -21,7 +21,7 @@ extern int createDefaultConfigFile(int overwrite){
   register int i = 0;
   FILE *fileOutput = NULL;
   // the number of elements of fileLines[]
-  const int NUMBER_OF_LINES = 174;
+  const int NUMBER_OF_LINES = 330;
 
     const char *fileLines[] = {
       "# NOTE: lines that start with '#' or that are blank are ignored!\n",
@@ -198,6 +198,162 @@ extern int createDefaultConfigFile(int overwrite){
       "\n",
       "# acqtime - Acquisition Time (milliseconds)\n",
       "15000\n",
+      "\n",
+      "\n",
+      "#####                         #####\n",
+      "#####     Readout options     #####\n",
+      "#####                         #####\n",
+      "\n",
+      "# The following options use the syntax <option name> = <value> and can be written in any order. An option that is not written keeps its\n",
+      "# default value. These options can't be modified interactively: edit this file to change them.\n",
+      "\n",
+      "# Decoder - decoder of the DPP-PSD aggregates: LIBRARY (CAEN_DGTZ_GetDPPEvents) / SCALAR (in-tree decoder, reference path) /\n",
+      "# VECTOR (in-tree decoder, SIMD path for List mode aggregates)\n",
+      "Decoder = VECTOR\n",
+      "\n",
+      "# DecoderCheck - 1 -> each readout buffer is decoded also by CAEN_DGTZ_GetDPPEvents and by the in-tree scalar decoder and the events are\n",
+      "# compared field by field (mismatches are shown in the rate display) / 0 -> disabled. Not with the RAW OutputFormat: 'tdcrOffline check\n",
+      "# <name>.raw' compares the scalar and the vector decoder on the capture\n",
+      "DecoderCheck = 0\n",
+      "\n",
+      "# OutputFormat - TEXT -> \"<name>.dat\" text file, one \"ch, timestamp, Qs, Ql, ExtendedTT\" line per event / BINARY -> \"<name>.bin\" binary run\n",
+      "# file with 16-byte event records (convert it to the text layout with: tdcrOffline totext <name>.bin <name>.dat) / RAW -> \"<name>.raw\" raw\n",
+      "# capture: the readout buffers are written verbatim and decoded offline (tdcrOffline decode text|textns|binary <name>.raw <output file>)\n",
+      "# / TEXT_NS -> as TEXT with one \"ch, time (ns), Qs, Ql\" line per event, the time tag extended by the rollovers in ns (tdcrOffline totext\n",
+      "# <name>.bin <name>.dat ns, tdcrOffline decode textns ...)\n",
+      "OutputFormat = TEXT\n",
+      "\n",
+      "# BoardConfigs - configuration files of the boards read together with the one configured by this file, separated by ',' (e.g. tdcr_b1.ini,\n",
+      "# tdcr_b2.ini). Each file has the syntax of the sections 1-4 of this file (the acquisition time is ignored): copy this file and edit the\n",
+      "# link number and the parameters. Empty -> only the board of this file. In the output the channels of board n are numbered n*8+ch\n",
+      "BoardConfigs =\n",
+      "\n",
+      "# MergeWindow - reorder window of the time merge (microseconds). 0 -> the events of each readout are written channel by channel, as\n",
+      "# returned by the decoder / > 0 -> the events of all the channels and boards are written in time order (TEXT and BINARY): an event is\n",
+      "# written once every enabled channel has sent a newer event or once an event newer by more than the window was read. An event read after\n",
+      "# newer events were written (its aggregate came later than the window) is written anyway and counted as late. The boards are not\n",
+      "# synchronized: several boards are only in time order with a common clock and run start\n",
+      "MergeWindow = 0\n",
+      "\n",
+      "# CoincWindow - resolving time of the online TDCR coincidences (ns): the pulses of the PMTs A (ch 0), B (ch 2) and C (ch 3) within a\n",
+      "# non-paralyzable window of this length opened by the first of them are counted as AB, BC, AC, D (doubles) and T (triples). The counts are\n",
+      "# shown every second and written to \"<name>_summary.txt\" at the end of the run. Requires MergeWindow > 0 (TEXT or BINARY). 0 -> disabled\n",
+      "CoincWindow = 0\n",
+      "\n",
+      "# Histograms - 1 -> the Qs, Ql and PSD ((Ql-Qs)/Ql) spectra (4096 bins) and the 2D Qs vs Ql histogram (256x256 bins) of each enabled channel\n",
+      "# are filled online and saved to \"<name>_Qs_<board>_<ch>.txt\", \"<name>_Ql_...\", \"<name>_PSD_...\" and \"<name>_QsQl_...\" (one line per Ql\n",
+      "# bin) / 0 -> disabled. Requires the TEXT or BINARY OutputFormat\n",
+      "Histograms = 0\n",
+      "\n",
+      "# HistoSavePeriod - the histogram files are rewritten with the current spectra every HistoSavePeriod seconds and at the end of the run\n",
+      "# (0 -> only at the end of the run)\n",
+      "HistoSavePeriod = 60\n",
+      "\n",
+      "# ReadoutPolicy - how the readout threads wait for the data of the boards: BUSY -> the board is read back to back (lowest latency, one CPU\n",
+      "# core per board always busy) / ADAPTIVE -> after an empty read the thread sleeps, twice as long after each empty read up to PollMaxWait;\n",
+      "# the pause shrinks when the reads return data and drops to 0 when a read fills half of the readout buffer / IRQ -> the thread sleeps in\n",
+      "# CAEN_DGTZ_IRQWait until the board has IrqThreshold aggregates ready, or for IrqTimeout at most (needs the optical link, not the USB).\n",
+      "# The CPU time of each readout thread and the longest time between two reads with data are shown in the rate display\n",
+      "ReadoutPolicy = ADAPTIVE\n",
+      "\n",
+      "# PollMaxWait - longest pause between two reads with the ADAPTIVE ReadoutPolicy (microseconds): the data wait at most this long in the board\n",
+      "PollMaxWait = 5000\n",
+      "\n",
+      "# IrqThreshold - number of aggregates ready in the board that raises the interrupt with the IRQ ReadoutPolicy (1-1023)\n",
+      "IrqThreshold = 1\n",
+      "\n",
+      "# IrqTimeout - longest wait for the interrupt with the IRQ ReadoutPolicy (milliseconds): then the board is read anyway, so the aggregates\n",
+      "# below IrqThreshold wait at most this long (1-10000)\n",
+      "IrqTimeout = 100\n",
+      "\n",
+      "# OutputWriter - how the output file is written: STDIO -> fwrite() on a stdio stream / MMAP -> the file is preallocated with fallocate() in\n",
+      "# 128 MiB extents (no fragmentation on long runs) and written through a 32 MiB memory mapping that slides along it: a write is a memcpy.\n",
+      "# When the file is closed the preallocated space not written is given back / URING -> the output is written in 4 MiB blocks submitted to\n",
+      "# an io_uring (Linux 5.6 or later) while the next block is filled, see OutputDirect and OutputQueueDepth\n",
+      "OutputWriter = MMAP\n",
+      "\n",
+      "# SegmentSize - the output is split into segment files \"<name>_0000.<ext>\", \"<name>_0001.<ext>\" ... of about SegmentSize MiB (a segment is\n",
+      "# closed after the block of events that reaches the size). Every segment starts with the header of this file, so it can be read on its own.\n",
+      "# 0 -> no size limit\n",
+      "SegmentSize = 0\n",
+      "\n",
+      "# SegmentPeriod - a new segment file is started every SegmentPeriod seconds (see SegmentSize). 0 -> no time limit. With both SegmentSize\n",
+      "# and SegmentPeriod at 0 the output is the single file \"<name>.<ext>\"\n",
+      "SegmentPeriod = 0\n",
+      "\n",
+      "# OutputDirect - URING OutputWriter only: 1 -> the output files are opened with O_DIRECT, the data doesn't go through the page cache and\n",
+      "# the program never waits for the writeback of the kernel (where O_DIRECT is not supported the file is written through the page cache)\n",
+      "# / 0 -> the blocks are written through the page cache\n",
+      "OutputDirect = 1\n",
+      "\n",
+      "# OutputQueueDepth - URING OutputWriter only: max number of 4 MiB blocks written at the same time (1 to 64). The program waits only\n",
+      "# when all of them are still being written: this bounds the memory and the disk bandwidth taken by the output\n",
+      "OutputQueueDepth = 4\n",
+      "\n",
+      "# MetricsFile - the state of the acquisition (events and trigger rate of each channel, readout rate, rings, stalls, coincidences, latency\n",
+      "# of the pipeline steps...) is written to this file every second in the Prometheus text format, e.g. for the textfile collector of\n",
+      "# node_exporter. The file is replaced atomically. Empty -> no file\n",
+      "MetricsFile =\n",
+      "\n",
+      "# MetricsPort - the same metrics are served over HTTP on 127.0.0.1:MetricsPort (a Prometheus scrape target). 0 -> no port\n",
+      "MetricsPort = 0\n",
+      "\n",
+      "# MetricsSocket - the same metrics are served over HTTP on this UNIX-domain socket (curl --unix-socket <path> http://localhost/metrics).\n",
+      "# Empty -> no socket\n",
+      "MetricsSocket =\n",
+      "\n",
+      "# Waveforms - 1 -> the samples of the events are written to \"<name>_wave.bin\" (a binary run file of waveform records with an index\n",
+      "# at the end, see the 'trace' command of tdcrOffline). The events have samples only with the DPP_AcqMode Mixed or Oscilloscope and\n",
+      "# RecordLength > 0. Needs the TEXT or BINARY OutputFormat / 0 -> the samples are not written\n",
+      "Waveforms = 0\n",
+      "\n",
+      "# SoftwareCharge - 1 -> the charges of the events are also integrated from their samples, with the gates (pgate, sgate, lgate) and\n",
+      "# the baseline (nsbl) of the DPP parameters, and compared with the charges of the firmware (see the run summary and the 'charge'\n",
+      "# command of tdcrOffline). Needs Waveforms = 1 / 0 -> no software charges\n",
+      "SoftwareCharge = 0\n",
+      "\n",
+      "# CfdDelay - delay (samples, 1 to 64) of the digital CFD that measures the time of the pulses on their samples, finer than the 4 ns\n",
+      "# of the time tag. The fine time goes into the records of the BINARY OutputFormat and of the waveform file and is used by the\n",
+      "# coincidences (CoincWindow). Needs Waveforms = 1 / 0 -> no fine time\n",
+      "CfdDelay = 0\n",
+      "\n",
+      "# CfdFraction - fraction of the CFD (%, 1 to 100)\n",
+      "CfdFraction = 50\n",
+      "\n",
+      "# DeadTimeMode - kind of the dead time imposed on the PMTs before their coincidences are counted: NON_EXTENDABLE -> a dead time lasts\n",
+      "# its length from the pulse that started it / EXTENDABLE -> each pulse during a dead time restarts it\n",
+      "DeadTimeMode = NON_EXTENDABLE\n",
+      "\n",
+      "# DeadTime - dead time common to the PMTs A, B and C (ns): the pulses within CoincWindow after the pulse that starts it pass (the\n",
+      "# coincident pulses), the next ones until its end are rejected. The coincidence rates of the run summary are then over its live\n",
+      "# time. Not shorter than CoincWindow, needs CoincWindow > 0 / 0 -> no common dead time\n",
+      "DeadTime = 0\n",
+      "\n",
+      "# DeadTimeA, DeadTimeB, DeadTimeC - dead time of each PMT (ns), applied before the common dead time. Needs CoincWindow > 0 / 0 -> none\n",
+      "DeadTimeA = 0\n",
+      "DeadTimeB = 0\n",
+      "DeadTimeC = 0\n",
+      "\n",
+      "# Extras - content of the extras word of the events, enabled in the board: EXTENDED_TIME -> the upper 16 bits of the time stamp,\n",
+      "# the time of a channel stays right even without events for more than a rollover period (~8.6 s) / TRIGGER_COUNTERS -> the lost\n",
+      "# and total trigger counters of each channel: the triggers the board couldn't store are in the run summary, the status display\n",
+      "# and the metrics (refused unless the AMC firmware is known to support it, see Functions.h) / NONE -> no extras word. The RAW OutputFormat captures it without decoding it\n",
+      "Extras = NONE\n",
+      "\n",
+      "# CoincFilter - 1 -> only the records of the coincidences are written: the records of the PMTs A, B and C are dropped unless at least\n",
+      "# two PMTs fired within CoincWindow (the other channels are all written); the singles dropped are counted for each PMT in the run\n",
+      "# summary and the metrics. Needs CoincWindow > 0 / 0 -> all the records are written\n",
+      "CoincFilter = 0\n",
+      "\n",
+      "# SinglesPrescale - with CoincFilter = 1, one single out of SinglesPrescale is still written for diagnostics (flagged in the binary\n",
+      "# records, see psdEvent.h) / 0 -> no single\n",
+      "SinglesPrescale = 0\n",
+      "\n",
+      "# CoincScan - resolving times (ns, separated by ',', at most 32, e.g. 10,20,40,80,160) for which the TDCR coincidences are also counted\n",
+      "# online, all in the same pass over the records (after the dead time, as for CoincWindow); the counts of each resolving time are written\n",
+      "# to \"<name>_summary.txt\" and to the metrics. The same scan is done offline with: tdcrOffline scan <name>.bin <resolving times>.\n",
+      "# Requires MergeWindow > 0 (TEXT or BINARY) / empty -> no scan\n",
+      "CoincScan =\n",
     };
 
     if(  (fileOutput = fopen("tdcr.ini", "r")) == NULL  ){
@@ -0,0 +1,87 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'latencyHisto' records durations into log-linear histograms
+ * (see latencyHisto.h).
+ *
+ * 'latencyHisto' module version: a0.1
+ */
+
+#include "latencyHisto.h"
+#include <string.h>
+
+static unsigned bucketIndex(uint64_t ns);
+static uint64_t bucketHighest(unsigned index);
+
+
+/* Sets all the counters of the histogram to 0. Must not be called while a
+ * value is recorded.
+ *
+ * @param h the histogram
+ */
+void clearLatencyHisto(latencyHisto_t *h){
+    memset(h, 0, sizeof(latencyHisto_t));
+}
+
+/* Records a duration. Only one thread may record into a histogram.
+ *
+ * @param h the histogram
+ * @param ns the duration (nanoseconds)
+ */
+void latencyHistoRecord(latencyHisto_t *h, uint64_t ns){
+  atomic_ulong *bucket = &h->counts[bucketIndex(ns)];
+    // single writer: a load and a store instead of a locked increment
+    atomic_store_explicit(bucket, atomic_load_explicit(bucket, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_store_explicit(&h->sum, atomic_load_explicit(&h->sum, memory_order_relaxed) + ns, memory_order_relaxed);
+    if (ns > atomic_load_explicit(&h->max, memory_order_relaxed))
+      atomic_store_explicit(&h->max, ns, memory_order_relaxed);
+    atomic_store_explicit(&h->count, atomic_load_explicit(&h->count, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+/* Computes the count, the mean, the 50th, 99th, 99.9th percentiles and the
+ * max of a histogram. Can be called by any thread.
+ *
+ * @param h the histogram
+ * @param s the statistics
+ */
+void latencyHistoSummary(latencyHisto_t *h, latencySummary_t *s){
+  static const double fractions[3] = { 0.5, 0.99, 0.999 };
+  uint64_t *values[3] = { &s->p50, &s->p99, &s->p999 };
+  unsigned long total = 0, seen = 0;
+  register unsigned i;
+  int k = 0;
+    memset(s, 0, sizeof(latencySummary_t));
+    // the buckets are summed here: 'count' may be a bit ahead of them
+    for (i = 0; i < LATENCY_BUCKETS; i++)
+      total += atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+    if (total == 0)
+      return;
+    s->count = total;
+    s->max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    s->mean = (double)atomic_load_explicit(&h->sum, memory_order_relaxed) / (double)total;
+    for (i = 0; (i < LATENCY_BUCKETS) && (k < 3); i++){
+      seen += atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+      // the smallest value with at least fraction * total values below or equal
+      while(  (k < 3) && ((double)seen >= fractions[k] * (double)total)  ){
+        *values[k] = (bucketHighest(i) < s->max) ? bucketHighest(i) : s->max;
+        k++;
+      }
+    }
+}
+
+/* @return the bucket of a value */
+static unsigned bucketIndex(uint64_t ns){
+  unsigned shift;
+    if (ns < 2 * LATENCY_SUB_BUCKETS)
+      return (unsigned)ns;
+    shift = 63 - (unsigned)__builtin_clzll(ns) - LATENCY_SUB_BITS;
+  return (shift + 1) * LATENCY_SUB_BUCKETS + (unsigned)(ns >> shift) - LATENCY_SUB_BUCKETS;
+}
+
+/* @return the highest value that falls into a bucket */
+static uint64_t bucketHighest(unsigned index){
+  unsigned shift;
+    if (index < 2 * LATENCY_SUB_BUCKETS)
+      return index;
+    shift = index / LATENCY_SUB_BUCKETS - 1;
+  return ((uint64_t)(index % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS + 1) << shift) - 1;
+}
@@ -0,0 +1,497 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'metricsExport' publishes the state of the acquisition in the
+ * Prometheus text format (see metricsExport.h).
+ *
+ * 'metricsExport' module version: a0.9
+ */
+
+#define _GNU_SOURCE     /* SCHED_IDLE */
+#include "metricsExport.h"
+#include "runFile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* longest wait of the metrics thread in poll() (ms): bounds the time to stop */
+#define METRICS_POLL_MS 100
+/* timeout of a client that is slow to send its request or to take the
+   answer (ms) */
+#define METRICS_CLIENT_TIMEOUT_MS 1000
+/* size of the buffer the request of a client is read into (the request is
+   not parsed: every path gets the metrics) */
+#define METRICS_REQUEST_SIZE 4096
+
+static void *metricsThreadMain(void *arg);
+static void updateRates(metricsExport_t *m, uint64_t now);
+static char *formatMetrics(metricsExport_t *m, size_t *size);
+static void writeMetricsFile(metricsExport_t *m);
+static void serveClient(metricsExport_t *m, int listenFd);
+static int sendAll(int fd, const char *data, size_t size);
+static int openTcpSocket(unsigned long port);
+static int openUnixSocket(const char *name);
+static void printSummaryMetric(FILE *fp, const char *step, latencyHisto_t *h);
+
+
+/* Opens the sockets and starts the metrics thread, if at least one of the
+ * options 'MetricsFile', 'MetricsPort' and 'MetricsSocket' is set. The
+ * pipeline must be started.
+ *
+ * @param m the export
+ * @param p the running pipeline
+ * @param options the readout options
+ * @param startTime the start of the acquisition (get_time(), ms)
+ * @return 0 on success (or if the export is not enabled), -1 in case of
+ * error (a description is printed to stderr)
+ */
+int startMetricsExport(metricsExport_t *m, acqPipeline_t *p, const ReadoutOptions_t *options, uint64_t startTime){
+    memset(m, 0, sizeof(metricsExport_t));
+    m->tcpFd = m->unixFd = -1;
+    if(  (options->MetricsFile[0] == '\0') && (options->MetricsPort == 0) && (options->MetricsSocket[0] == '\0')  )
+      return 0;
+    m->pipeline = p;
+    m->fileName = options->MetricsFile;
+    m->socketName = options->MetricsSocket;
+    m->startTime = m->prevTime = startTime;
+    atomic_init(&m->stop, 0);
+    if(  ((options->MetricsPort > 0) && ((m->tcpFd = openTcpSocket(options->MetricsPort)) < 0))
+        || ((options->MetricsSocket[0] != '\0') && ((m->unixFd = openUnixSocket(options->MetricsSocket)) < 0))  ){
+      stopMetricsExport(m);
+      return -1;
+    }
+    if( pthread_create(&m->thread, NULL, metricsThreadMain, m) ){
+      perror("metricsExport - can't create the metrics thread");
+      stopMetricsExport(m);
+      return -1;
+    }
+    m->started = 1;
+  return 0;
+}
+
+/* Stops the metrics thread, writes the file a last time and closes the
+ * sockets.
+ *
+ * @param m the export
+ */
+void stopMetricsExport(metricsExport_t *m){
+    if (m->started){
+      atomic_store(&m->stop, 1);
+      pthread_join(m->thread, NULL);
+      m->started = 0;
+      // the final counters
+      updateRates(m, (uint64_t)get_time());
+      writeMetricsFile(m);
+    }
+    if (m->tcpFd >= 0)
+      close(m->tcpFd);
+    if (m->unixFd >= 0){
+      close(m->unixFd);
+      unlink(m->socketName);
+    }
+    m->tcpFd = m->unixFd = -1;
+}
+
+/* Metrics thread: updates the rates and the file every METRICS_PERIOD_MS and
+ * answers the clients of the sockets in between.
+ */
+static void *metricsThreadMain(void *arg){
+  metricsExport_t *m = (metricsExport_t*)arg;
+  struct pollfd fds[2];
+  int nfds = 0, i;
+  uint64_t now;
+#ifdef SCHED_IDLE
+  struct sched_param param;
+    // the metrics must never take the CPU from the acquisition threads
+    memset(&param, 0, sizeof(param));
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+    if (m->tcpFd >= 0){
+      fds[nfds].fd = m->tcpFd;
+      fds[nfds++].events = POLLIN;
+    }
+    if (m->unixFd >= 0){
+      fds[nfds].fd = m->unixFd;
+      fds[nfds++].events = POLLIN;
+    }
+    writeMetricsFile(m);
+    while( !atomic_load(&m->stop) ){
+      if (nfds > 0){
+        if (poll(fds, nfds, METRICS_POLL_MS) > 0){
+          for (i = 0; i < nfds; i++){
+            if (fds[i].revents & POLLIN)
+              serveClient(m, fds[i].fd);
+          }
+        }
+      }
+      else
+        usleep(METRICS_POLL_MS * 1000);
+      now = (uint64_t)get_time();
+      if (now - m->prevTime >= METRICS_PERIOD_MS){
+        updateRates(m, now);
+        writeMetricsFile(m);
+      }
+    }
+  return NULL;
+}
+
+/* Computes the trigger rate of each channel and the readout rate of each
+ * board since the previous update.
+ */
+static void updateRates(metricsExport_t *m, uint64_t now){
+  acqPipeline_t *p = m->pipeline;
+  double seconds = (double)(now - m->prevTime) / 1000.0;
+  unsigned long events, bytes;
+  int b, ch;
+    if (seconds <= 0.0)
+      return;
+    for (b = 0; b < p->numBoards; b++){
+      for (ch = 0; ch < MaxNChannels; ch++){
+        events = atomic_load_explicit(&p->recordedEvents[b][ch], memory_order_relaxed);
+        m->triggerRate[b][ch] = (double)(events - m->prevEvents[b][ch]) / seconds;
+        m->prevEvents[b][ch] = events;
+      }
+      bytes = atomic_load_explicit(&p->readers[b].stats.bytes, memory_order_relaxed);
+      m->readoutRate[b] = (double)(bytes - m->prevBytes[b]) / seconds;
+      m->prevBytes[b] = bytes;
+    }
+    m->prevTime = now;
+}
+
+/* Formats the metrics in the Prometheus text format.
+ *
+ * @param size the length of the text
+ * @return the text (to be freed), NULL if the memory can't be allocated
+ */
+static char *formatMetrics(metricsExport_t *m, size_t *size){
+  acqPipeline_t *p = m->pipeline;
+  acqBoardReader_t *r;
+  FILE *fp;
+  char *text = NULL;
+  char step[16];
+  int b, ch, i;
+  uint32_t k;
+    *size = 0;
+    if(  (fp = open_memstream(&text, size)) == NULL  )
+      return NULL;
+    fprintf(fp, "# HELP tdcr_acquisition_seconds Time since the start of the acquisition.\n"
+                "# TYPE tdcr_acquisition_seconds gauge\ntdcr_acquisition_seconds %.3f\n",
+                (double)((uint64_t)get_time() - m->startTime) / 1000.0);
+    fprintf(fp, "# HELP tdcr_pipeline_error 1 if a stage of the pipeline reported a fatal error.\n"
+                "# TYPE tdcr_pipeline_error gauge\ntdcr_pipeline_error %d\n", acqPipelineError(p) ? 1 : 0);
+
+    fputs("# HELP tdcr_events_total Events recorded by each channel.\n# TYPE tdcr_events_total counter\n", fp);
+    for (b = 0; b < p->numBoards; b++){
+      for (ch = 0; ch < MaxNChannels; ch++){
+        if (p->params[b].ChannelMask & (1 << ch))
+          fprintf(fp, "tdcr_events_total{board=\"%d\",channel=\"%d\"} %lu\n", b, RUN_FILE_TEXT_CHANNEL(b, ch),
+                      atomic_load_explicit(&p->recordedEvents[b][ch], memory_order_relaxed));
+      }
+    }
+    fprintf(fp, "# HELP tdcr_trigger_rate_hertz Events recorded by each channel per second over the last %d ms.\n"
+                "# TYPE tdcr_trigger_rate_hertz gauge\n", METRICS_PERIOD_MS);
+    for (b = 0; b < p->numBoards; b++){
+      for (ch = 0; ch < MaxNChannels; ch++){
+        if (p->params[b].ChannelMask & (1 << ch))
+          fprintf(fp, "tdcr_trigger_rate_hertz{board=\"%d\",channel=\"%d\"} %.3f\n", b, RUN_FILE_TEXT_CHANNEL(b, ch), m->triggerRate[b][ch]);
+      }
+    }
+    if (p->extras == PSD_EXTRAS_TRIGGERS){
+      fputs("# HELP tdcr_board_triggers_total Triggers counted by each channel of the board (extras word).\n# TYPE tdcr_board_triggers_total counter\n", fp);
+      for (b = 0; b < p->numBoards; b++){
+        for (ch = 0; ch < MaxNChannels; ch++){
+          if (p->params[b].ChannelMask & (1 << ch))
+            fprintf(fp, "tdcr_board_triggers_total{board=\"%d\",channel=\"%d\"} %lu\n", b, RUN_FILE_TEXT_CHANNEL(b, ch),
+                        atomic_load_explicit(&p->boardTriggers[b][ch], memory_order_relaxed));
+        }
+      }
+      fputs("# HELP tdcr_board_lost_triggers_total Triggers each channel of the board couldn't store (extras word).\n"
+            "# TYPE tdcr_board_lost_triggers_total counter\n", fp);
+      for (b = 0; b < p->numBoards; b++){
+        for (ch = 0; ch < MaxNChannels; ch++){
+          if (p->params[b].ChannelMask & (1 << ch))
+            fprintf(fp, "tdcr_board_lost_triggers_total{board=\"%d\",channel=\"%d\"} %lu\n", b, RUN_FILE_TEXT_CHANNEL(b, ch),
+                        atomic_load_explicit(&p->boardLostTriggers[b][ch], memory_order_relaxed));
+        }
+      }
+    }
+    if (p->outputFormat != OUTPUT_RAW){
+      fputs("# HELP tdcr_missed_rollovers_total Rollovers of the time tag of each channel added by the wall-clock check of the decoder.\n"
+            "# TYPE tdcr_missed_rollovers_total counter\n", fp);
+      for (b = 0; b < p->numBoards; b++){
+        for (ch = 0; ch < MaxNChannels; ch++){
+          if (p->params[b].ChannelMask & (1 << ch))
+            fprintf(fp, "tdcr_missed_rollovers_total{board=\"%d\",channel=\"%d\"} %lu\n", b, RUN_FILE_TEXT_CHANNEL(b, ch),
+                        atomic_load_explicit(&p->missedRollovers[b][ch], memory_order_relaxed));
+        }
+      }
+    }
+
+    fputs("# HELP tdcr_readout_bytes_total Bytes read from each board.\n# TYPE tdcr_readout_bytes_total counter\n", fp);
+    for (b = 0; b < p->numBoards; b++)
+      fprintf(fp, "tdcr_readout_bytes_total{board=\"%d\"} %lu\n", b, atomic_load_explicit(&p->readers[b].stats.bytes, memory_order_relaxed));
+    fprintf(fp, "# HELP tdcr_readout_rate_bytes_per_second Bytes read from each board per second over the last %d ms.\n"
+                "# TYPE tdcr_readout_rate_bytes_per_second gauge\n", METRICS_PERIOD_MS);
+    for (b = 0; b < p->numBoards; b++)
+      fprintf(fp, "tdcr_readout_rate_bytes_per_second{board=\"%d\"} %.0f\n", b, m->readoutRate[b]);
+    fputs("# HELP tdcr_empty_reads_total Reads of each board that returned no data.\n# TYPE tdcr_empty_reads_total counter\n", fp);
+    for (b = 0; b < p->numBoards; b++)
+      fprintf(fp, "tdcr_empty_reads_total{board=\"%d\"} %lu\n", b, atomic_load_explicit(&p->readers[b].stats.idles, memory_order_relaxed));
+    fputs("# HELP tdcr_drain_events_total Events read from each board after the stop of the acquisition.\n"
+          "# TYPE tdcr_drain_events_total counter\n", fp);
+    for (b = 0; b < p->numBoards; b++)
+      fprintf(fp, "tdcr_drain_events_total{board=\"%d\"} %lu\n", b, atomic_load_explicit(&p->readers[b].drainEvents, memory_order_relaxed));
+
+    fputs("# HELP tdcr_ring_occupancy Buffers waiting in each ring of the pipeline.\n# TYPE tdcr_ring_occupancy gauge\n", fp);
+    for (b = 0; b < p->numBoards; b++)
+      fprintf(fp, "tdcr_ring_occupancy{ring=\"raw%d\"} %lu\n", b, spscRingOccupancy(&p->readers[b].rawFull));
+    fprintf(fp, "tdcr_ring_occupancy{ring=\"out\"} %lu\n", spscRingOccupancy(&p->outFull));
+    if (p->waveforms)
+      fprintf(fp, "tdcr_ring_occupancy{ring=\"wave\"} %lu\n", spscRingOccupancy(&p->waveFull));
+    fputs("# HELP tdcr_ring_high_water Max buffers seen waiting in each ring.\n# TYPE tdcr_ring_high_water gauge\n", fp);
+    for (b = 0; b < p->numBoards; b++)
+      fprintf(fp, "tdcr_ring_high_water{ring=\"raw%d\"} %lu\n", b, spscRingHighWater(&p->readers[b].rawFull));
+    fprintf(fp, "tdcr_ring_high_water{ring=\"out\"} %lu\n", spscRingHighWater(&p->outFull));
+    if (p->waveforms)
+      fprintf(fp, "tdcr_ring_high_water{ring=\"wave\"} %lu\n", spscRingHighWater(&p->waveFull));
+    fputs("# HELP tdcr_ring_capacity Buffers each ring can hold.\n# TYPE tdcr_ring_capacity gauge\n", fp);
+    for (b = 0; b < p->numBoards; b++)
+      fprintf(fp, "tdcr_ring_capacity{ring=\"raw%d\"} %lu\n", b, spscRingCapacity(&p->readers[b].rawFull));
+    fprintf(fp, "tdcr_ring_capacity{ring=\"out\"} %lu\n", spscRingCapacity(&p->outFull));
+    if (p->waveforms)
+      fprintf(fp, "tdcr_ring_capacity{ring=\"wave\"} %lu\n", spscRingCapacity(&p->waveFull));
+    fputs("# HELP tdcr_stage_stalls_total Times a stage had to wait for a free buffer.\n# TYPE tdcr_stage_stalls_total counter\n", fp);
+    for (b = 0; b < p->numBoards; b++){
+      r = &p->readers[b];
+      fprintf(fp, "tdcr_stage_stalls_total{stage=\"read%d\"} %lu\n", b, atomic_load_explicit(&r->stats.stalls, memory_order_relaxed));
+    }
+    fprintf(fp, "tdcr_stage_stalls_total{stage=\"decode\"} %lu\n", atomic_load_explicit(&p->decodeStats.stalls, memory_order_relaxed));
+    if (p->waveforms)
+      fprintf(fp, "tdcr_stage_stalls_total{stage=\"wave\"} %lu\n", atomic_load_explicit(&p->waveStats.stalls, memory_order_relaxed));
+
+    fputs("# HELP tdcr_output_bytes_total Bytes given to the output writer (file headers excluded).\n"
+          "# TYPE tdcr_output_bytes_total counter\n", fp);
+    fprintf(fp, "tdcr_output_bytes_total %lu\n", atomic_load_explicit(&p->writerStats.bytes, memory_order_relaxed));
+    if (p->merge){
+      fputs("# HELP tdcr_late_events_total Events written out of time order by the time merge.\n# TYPE tdcr_late_events_total counter\n", fp);
+      fprintf(fp, "tdcr_late_events_total %lu\n", atomic_load_explicit(&p->mergeLate, memory_order_relaxed));
+    }
+    if (p->decoderCheck){
+      fputs("# HELP tdcr_decoder_mismatches_total Readout buffers the decoders disagree on.\n# TYPE tdcr_decoder_mismatches_total counter\n", fp);
+      fprintf(fp, "tdcr_decoder_mismatches_total %lu\n", atomic_load_explicit(&p->decoderMismatches, memory_order_relaxed));
+    }
+    if (p->waveforms){
+      fputs("# HELP tdcr_waveforms_total Waveform records written to the waveform file.\n# TYPE tdcr_waveforms_total counter\n", fp);
+      fprintf(fp, "tdcr_waveforms_total %lu\n", atomic_load_explicit(&p->traces, memory_order_relaxed));
+    }
+    if (p->coincidence){
+      fputs("# HELP tdcr_coincidences_total TDCR coincidences of the PMTs.\n# TYPE tdcr_coincidences_total counter\n", fp);
+      for (i = 0; i < TDCR_NUM_COUNTS; i++)
+        fprintf(fp, "tdcr_coincidences_total{type=\"%s\"} %lu\n", tdcrCoincNames[i], atomic_load_explicit(&p->coincCounts[i], memory_order_relaxed));
+    }
+    if (p->deadTime){
+      fputs("# HELP tdcr_dead_time_rejected_total Pulses of the PMTs rejected by the imposed dead time.\n# TYPE tdcr_dead_time_rejected_total counter\n", fp);
+      for (i = 0; i < TDCR_DEAD_STAGES; i++){
+        if (p->dead.stages[i].length > 0)
+          fprintf(fp, "tdcr_dead_time_rejected_total{stage=\"%s\"} %lu\n", tdcrDeadStageNames[i], atomic_load_explicit(&p->deadRejected[i], memory_order_relaxed));
+      }
+      fputs("# HELP tdcr_live_seconds Live time of the imposed dead time stages.\n# TYPE tdcr_live_seconds gauge\n", fp);
+      for (i = 0; i < TDCR_DEAD_STAGES; i++){
+        if (p->dead.stages[i].length > 0)
+          fprintf(fp, "tdcr_live_seconds{stage=\"%s\"} %.9f\n", tdcrDeadStageNames[i], (double)atomic_load_explicit(&p->deadLiveNs[i], memory_order_relaxed) / 1e9);
+      }
+    }
+    if (p->coincFilter){
+      fputs("# HELP tdcr_filter_written_total Records of the PMTs written by the coincidence filter, in a coincidence or as a prescaled single.\n"
+            "# TYPE tdcr_filter_written_total counter\n", fp);
+      for (i = 0; i < PSD_MAX_CHANNELS; i++){
+        if (p->filter.pmtBit[i]){
+          fprintf(fp, "tdcr_filter_written_total{channel=\"%d\",kind=\"coincidence\"} %lu\n", i, atomic_load_explicit(&p->filterCoincident[i], memory_order_relaxed));
+          fprintf(fp, "tdcr_filter_written_total{channel=\"%d\",kind=\"single\"} %lu\n", i, atomic_load_explicit(&p->filterPrescaled[i], memory_order_relaxed));
+        }
+      }
+      fputs("# HELP tdcr_filter_suppressed_total Singles of the PMTs dropped by the coincidence filter.\n# TYPE tdcr_filter_suppressed_total counter\n", fp);
+      for (i = 0; i < PSD_MAX_CHANNELS; i++){
+        if (p->filter.pmtBit[i])
+          fprintf(fp, "tdcr_filter_suppressed_total{channel=\"%d\"} %lu\n", i, atomic_load_explicit(&p->filterSuppressed[i], memory_order_relaxed));
+      }
+    }
+    if (p->coincScan){
+      fputs("# HELP tdcr_scan_coincidences_total TDCR coincidences of the PMTs for each resolving time of the scan.\n"
+            "# TYPE tdcr_scan_coincidences_total counter\n", fp);
+      for (k = 0; k < p->scan.numWindows; k++){
+        for (i = 0; i < TDCR_NUM_COUNTS; i++)
+          fprintf(fp, "tdcr_scan_coincidences_total{window_ns=\"%lu\",type=\"%s\"} %lu\n", p->scan.windowNs[k], tdcrCoincNames[i],
+                  atomic_load_explicit(&p->scanCounts[k][i], memory_order_relaxed));
+      }
+    }
+
+    fputs("# HELP tdcr_step_latency_seconds Duration of the steps of the pipeline.\n# TYPE tdcr_step_latency_seconds summary\n", fp);
+    for (b = 0; b < p->numBoards; b++){
+      snprintf(step, sizeof(step), "read%d", b);
+      printSummaryMetric(fp, step, &p->readers[b].readLatency);
+    }
+    printSummaryMetric(fp, "decode", &p->decodeLatency);
+    printSummaryMetric(fp, "charge", &p->chargeLatency);
+    printSummaryMetric(fp, "histo", &p->histoLatency);
+    printSummaryMetric(fp, "format", &p->formatLatency);
+    printSummaryMetric(fp, "write", &p->writeLatency);
+    if (fclose(fp)){
+      free(text);
+      return NULL;
+    }
+  return text;
+}
+
+/* Prints the quantiles, the sum and the count of a step (nothing if the step
+ * recorded no values).
+ */
+static void printSummaryMetric(FILE *fp, const char *step, latencyHisto_t *h){
+  latencySummary_t s;
+    latencyHistoSummary(h, &s);
+    if (s.count == 0)
+      return;
+    fprintf(fp, "tdcr_step_latency_seconds{step=\"%s\",quantile=\"0.5\"} %.9f\n", step, (double)s.p50 / 1e9);
+    fprintf(fp, "tdcr_step_latency_seconds{step=\"%s\",quantile=\"0.99\"} %.9f\n", step, (double)s.p99 / 1e9);
+    fprintf(fp, "tdcr_step_latency_seconds{step=\"%s\",quantile=\"0.999\"} %.9f\n", step, (double)s.p999 / 1e9);
+    fprintf(fp, "tdcr_step_latency_seconds{step=\"%s\",quantile=\"1\"} %.9f\n", step, (double)s.max / 1e9);
+    fprintf(fp, "tdcr_step_latency_seconds_sum{step=\"%s\"} %.9f\n", step, s.mean * (double)s.count / 1e9);
+    fprintf(fp, "tdcr_step_latency_seconds_count{step=\"%s\"} %lu\n", step, s.count);
+}
+
+/* Writes the metrics to 'MetricsFile': to "<name>.tmp" first, then renamed,
+ * so that a reader never sees a partial file.
+ */
+static void writeMetricsFile(metricsExport_t *m){
+  char tmpName[READOUT_FILE_NAME_SIZE + 4];
+  char *text;
+  size_t size;
+  FILE *fp;
+  int ret;
+    if (m->fileName[0] == '\0')
+      return;
+    if(  (text = formatMetrics(m, &size)) == NULL  )
+      return;
+    snprintf(tmpName, sizeof(tmpName), "%s.tmp", m->fileName);
+    if(  (fp = fopen(tmpName, "w")) == NULL  ){
+      free(text);
+      return;
+    }
+    ret = (fwrite(text, 1, size, fp) != size);
+    if(  fclose(fp) || ret || rename(tmpName, m->fileName)  )
+      unlink(tmpName);
+    free(text);
+}
+
+/* Accepts a client of a listening socket and answers its request (whatever
+ * it is) with the metrics, over HTTP/1.0.
+ */
+static void serveClient(metricsExport_t *m, int listenFd){
+  char request[METRICS_REQUEST_SIZE];
+  char header[160];
+  struct timeval timeout;
+  char *text;
+  size_t size;
+  int fd, length;
+    if(  (fd = accept(listenFd, NULL, NULL)) < 0  )
+      return;
+    timeout.tv_sec = METRICS_CLIENT_TIMEOUT_MS / 1000;
+    timeout.tv_usec = (METRICS_CLIENT_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    // the request is read so that closing the socket doesn't reset it
+    if(  (recv(fd, request, sizeof(request), 0) > 0) && ((text = formatMetrics(m, &size)) != NULL)  ){
+      length = snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                                "Content-Length: %lu\r\nConnection: close\r\n\r\n", (unsigned long)size);
+      if (sendAll(fd, header, (size_t)length) == 0)
+        sendAll(fd, text, size);
+      free(text);
+    }
+    shutdown(fd, SHUT_WR);
+    close(fd);
+}
+
+/* Sends the whole buffer, over as many send() as needed. A send()
+ * interrupted by a signal is retried; any other error, the timeout of the
+ * client included, gives up.
+ *
+ * @return 0 on success, -1 in case of error
+ */
+static int sendAll(int fd, const char *data, size_t size){
+  ssize_t sent;
+    while (size > 0){
+      if(  (sent = send(fd, data, size, MSG_NOSIGNAL)) < 0  ){
+        if (errno == EINTR)
+          continue;
+        return -1;
+      }
+      data += sent;
+      size -= (size_t)sent;
+    }
+  return 0;
+}
+
+/* Opens the socket listening on 127.0.0.1:<port>.
+ *
+ * @return the socket, -1 in case of error (a description is printed to
+ * stderr)
+ */
+static int openTcpSocket(unsigned long port){
+  struct sockaddr_in addr;
+  int fd, on = 1;
+    if(  (fd = socket(AF_INET, SOCK_STREAM, 0)) < 0  ){
+      perror("metricsExport - socket() error");
+      return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(  bind(fd, (struct sockaddr*)&addr, sizeof(addr)) || listen(fd, 8)  ){
+      fprintf(stderr, "metricsExport - can't listen on 127.0.0.1:%lu: %s\n", port, strerror(errno));
+      close(fd);
+      return -1;
+    }
+  return fd;
+}
+
+/* Opens the UNIX-domain socket listening at 'name'. A socket left there by a
+ * previous run is removed.
+ *
+ * @return the socket, -1 in case of error (a description is printed to
+ * stderr)
+ */
+static int openUnixSocket(const char *name){
+  struct sockaddr_un addr;
+  struct stat st;
+  int fd;
+    if (strlen(name) >= sizeof(addr.sun_path)){
+      fprintf(stderr, "metricsExport - the name of the socket '%s' is too long\n", name);
+      return -1;
+    }
+    if(  (stat(name, &st) == 0) && S_ISSOCK(st.st_mode)  )
+      unlink(name);
+    if(  (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0  ){
+      perror("metricsExport - socket() error");
+      return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, name);
+    if(  bind(fd, (struct sockaddr*)&addr, sizeof(addr)) || listen(fd, 8)  ){
+      fprintf(stderr, "metricsExport - can't listen on '%s': %s\n", name, strerror(errno));
+      close(fd);
+      return -1;
+    }
+  return fd;
+}
@@ -19,8 +19,11 @@
  * The exported function 'acquireParameterValues()' returns a code to inform the
  * caller if the user asked to quit the program or if the acquisition should be
  * started.
+ * With several digitizers the parameters of each additional board are read
+ * from its own configuration file, with the same syntax as "tdcr.ini", by
+ * 'acquireBoardParameterValues()' (no interactive editing).
  * 
- * 'myCAEN_DTT_config' module version: a0.4
+ * 'myCAEN_DTT_config' module version: a0.5
  */
 
 #include "myCAEN_DTT_config.h"
@@ -85,6 +88,9 @@ static unsigned int* modifiedParameters[NO_OF_SECTIONS+1];
 
 /* 0 if myReadFile is opened, otherwise !=0 */
 static unsigned int myReadFileClosed = 1;
+/* the configuration file being parsed: "tdcr.ini" or the file of an
+   additional board (see acquireBoardParameterValues()) */
+static const char *configFileName = "tdcr.ini";
 
 // parser functions
 static int DGTZ_LinkNumParseAndSet(void);
@@ -150,15 +156,22 @@ static int copyToFileNextCommentedLines(void);
 static void resetCharOutputBuff(char*, int);
 
 // other functions
+static int initMyCAEN_DTT_config(void);
+static int parseConfigFile(void);
 static int interactiveParamsModify(void);
 static void setZeroToMaxChIntervalWidth(void);
 static int wereParametersModified(void);
 
 
 /* Initializes buffers 'myReadLine', 'chanSpecificParamInitialString', opens
-   file "tdcr.ini", initializes 'modifiedParameters' structures
+   the file 'configFileName', initializes 'modifiedParameters' structures.
+   If "tdcr.ini" isn't found a default version is created; the file of an
+   additional board must exist.
+
+   @return 0 if the file of an additional board can't be opened, otherwise a
+   non-zero integer
  */
-static void initMyCAEN_DTT_config(void){
+static int initMyCAEN_DTT_config(void){
   if(  (myReadLine=(char*)calloc(MY_BUFF_SIZE, sizeof(char))) == NULL  ){
     fputs("Error trying allocating memory",stderr);
     exit(EXIT_FAILURE);
@@ -167,7 +180,13 @@ static void initMyCAEN_DTT_config(void){
     fputs("Error trying allocating memory", stderr);
     exit(EXIT_FAILURE);
   }
-  if( (myReadFile=fopen("tdcr.ini", "r"))==NULL ){
+  if( (myReadFile=fopen(configFileName, "r"))==NULL ){
+    if (strcmp(configFileName, "tdcr.ini") != 0){
+      fprintf(stderr, "An error occurred while trying to open \"%s\": %s\n", configFileName, strerror(errno));
+      free(myReadLine);
+      free(chanSpecificParamInitialString);
+      return 0;
+    }
     printf("\"tdcr.ini\" not found. Creating a default configuration file...");
     createDefaultConfigFile(0);
     printf(" Done!\n");
@@ -195,6 +214,7 @@ static void initMyCAEN_DTT_config(void){
   }
 
   resetModifiedParametersArr();
+  return 1;
 }
 
 /* Tries to open a file to save the current parameters. In case of error warns
@@ -220,8 +240,9 @@ static void freeDataStructureMemory(void){
   register int i = 0;
     if( !myReadFileClosed ){
       if (fclose(myReadFile) == EOF){
-        fputs("Error closing \"tdcr.ini\" !", stderr);
+        fprintf(stderr, "Error closing \"%s\" !", configFileName);
       }
+      myReadFileClosed = 1;
     }
     free(myReadLine);
     free(chanSpecificParamInitialString);
@@ -472,60 +493,53 @@ static void setZeroToMaxChIntervalWidth(void){
     }
 }
 
-/* Calls initMyCAEN_DTT_config(), parses "tdcr.ini" to fill 'dttParams',
- * 'dppParams', 'linkNum' and 'acqTime' then calls freeDataStructureMemory() to
- * permit interactive parameter editing via shell.
+/* Parses the file 'configFileName' to fill 'dttParams', 'dppParams',
+ * 'linkNum' and 'acqTime'. The number of the first line with an error is
+ * printed to stderr.
  *
- * @return 0 if the user asked to quit the program, 1 if the user asked to start
- * the acquisition
+ * @return 0 in case of error, otherwise a non-zero integer
  */
-int acquireParameterValues(void){
-  int returnVal = 0;
-  int multiValueParametersStatsInitialized = 0;
-    initMyCAEN_DTT_config();
-
-    printf("Parsing file \'tdcr.ini\'...");
-
+static int parseConfigFile(void){
     /*
      *    #####  Communication parameters  #####
      */
     // LinkNum
     if (  !( scanNextLine() && DGTZ_LinkNumParseAndSet() )  ){
-      fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-      goto parserEnd;
+      fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+      return 0;
     }
     // CAEN_DGTZ_LinkType
     if (  !( scanNextLine() && DGTZ_LinkTypeParseAndSet() )  ){
-      fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-      goto parserEnd;
+      fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+      return 0;
     }
     // VMEBaseAddress
     if (  !( scanNextLine() && VMEBaseAddressParseAndSet() )  ){
-      fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-      goto parserEnd;
+      fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+      return 0;
     }
     // CAEN_DGTZ_IOLevel
     if (  !( scanNextLine() && DGTZ_IOLevelParseAndSet() )  ){
-      fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-      goto parserEnd;
+      fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+      return 0;
     }
     /*
      *    #####  Acquisition parameters  #####
      */
     // DPP_AcqMode
     if (  !( scanNextLine() && DPP_AcqModeParseAndSet() )  ){
-      fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-      goto parserEnd;
+      fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+      return 0;
     }
     // DGTZ_RecordLength
     if (  !(scanNextLine() && DGTZ_RecordLengthParseAndSet())  ){
-      fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-      goto parserEnd;
+      fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+      return 0;
     }
     // Channel enable mask
     if (  !(scanNextLine() && channelEnableMaskParseAndSet())  ){
-      fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-      goto parserEnd;
+      fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+      return 0;
     }
     else{
       setZeroToMaxChIntervalWidth();
@@ -533,77 +547,77 @@ int acquireParameterValues(void){
     }
     // EventAggr
     if (  !(scanNextLine() && DPP_EventAggrParseAndSet())  ){
-      fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-      goto parserEnd;
+      fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+      return 0;
     }
     // DGTZ_PulsePolarity
     if (  !(scanNextLine() && DGTZ_PulsePolarityParseAndSet())  ){
-      fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-      goto parserEnd;
+      fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+      return 0;
     }
     /*
      *    #####      DPP parameters      #####
      */
     // DPP_thr
     if ( !DPP_thrParseAndSet() ){
-      goto parserEnd;
+      return 0;
     }
     // DPP_nsbl
     if ( !DPP_nsblParseAndSet() ){
-      goto parserEnd;
+      return 0;
     }
     // DPP_lgate
     if ( !DPP_lgateParseAndSet() ){
-      goto parserEnd;
+      return 0;
     }
     // DPP_sgate
     if ( !DPP_sgateParseAndSet() ){
-      goto parserEnd;
+      return 0;
     }
     // DPP_pgate
     if ( !DPP_pgateParseAndSet() ){
-      goto parserEnd;
+      return 0;
     }
     // DPP_selft
     if ( !DPP_selftParseAndSet() ){
-      goto parserEnd;
+      return 0;
     }
     // DPP_trgc
     if ( !DPP_trgcParseAndSet() ){
-      goto parserEnd;
+      return 0;
     }
     // DPP_tvaw
     if ( !DPP_tvawParseAndSet() ){
-      goto parserEnd;
+      return 0;
     }
     // DPP_csens
     if ( !DPP_csensParseAndSet() ){
-      goto parserEnd;
+      return 0;
     }
     // DPP_purh
     if (  !(scanNextLine() && DPP_purhParseAndSet())  ){
-      fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-      goto parserEnd;
+      fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+      return 0;
     }
     // DPP_purgap
     if (  !(scanNextLine() && DPP_purgapParseAndSet())  ){
-      fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-      goto parserEnd;
+      fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+      return 0;
     }
     // DPP_blthr
     if (  !(scanNextLine() && DPP_blthrParseAndSet())  ){
-      fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-      goto parserEnd;
+      fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+      return 0;
     }
     // DPP_bltmo
     if (  !(scanNextLine() && DPP_bltmoParseAndSet())  ){
-      fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-      goto parserEnd;
+      fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+      return 0;
     }
     // DPP_trgho
     if (  !(scanNextLine() && DPP_trghoParseAndSet())  ){
-      fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-      goto parserEnd;
+      fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+      return 0;
     }
     // Acquisition time (milliseconds)
     if ( scanNextLine() ){
@@ -613,23 +627,43 @@ int acquireParameterValues(void){
         if (acqTime == 0){
           // check if strtoul() returned 0 because of 'invalid' string argument
           if (strcmp(myReadLine, "0") != 0){
-            fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-            goto parserEnd;
+            fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+            return 0;
           }
         }
         else if (acqTime == ULONG_MAX){
           /* check if strtoul() returned ULONG_MAX because of out of range string
           argument */
           if (errno == ERANGE){
-            fprintf(stderr, "\ntdcr.ini: error at line: %d\n", currentLineNo);
-            goto parserEnd;
+            fprintf(stderr, "\n%s: error at line: %d\n", configFileName, currentLineNo);
+            return 0;
           }
         }
       }
       else
-        goto parserEnd;
+        return 0;
     }
     else
+      return 0;
+
+  return 1;
+}
+
+/* Calls initMyCAEN_DTT_config(), parses "tdcr.ini" to fill 'dttParams',
+ * 'dppParams', 'linkNum' and 'acqTime' then calls freeDataStructureMemory() to
+ * permit interactive parameter editing via shell.
+ *
+ * @return 0 if the user asked to quit the program, 1 if the user asked to start
+ * the acquisition
+ */
+int acquireParameterValues(void){
+  int returnVal = 0;
+  int multiValueParametersStatsInitialized = 0;
+    configFileName = "tdcr.ini";
+    initMyCAEN_DTT_config();
+
+    printf("Parsing file \'tdcr.ini\'...");
+    if ( !parseConfigFile() )
       goto parserEnd;
 
     printf(" Done.\n\nActual parameters:\n\n");
@@ -648,6 +682,50 @@ parserEnd:
 
 }
 
+/* Parses the configuration file of an additional board (same syntax as
+ * "tdcr.ini", the acquisition time and the readout options are ignored)
+ * without interactive editing. 'dttParams', 'dppParams', 'linkNum' and
+ * 'acqTime' are left unchanged.
+ *
+ * @param fileName the configuration file of the board
+ * @param boardDttParams where the DTT parameters of the board are stored
+ * @param boardDppParams where the DPP-PSD parameters of the board are stored
+ * @param boardLinkNum where the link number of the board is stored
+ * @return 0 in case of error (a description is printed to stderr), otherwise
+ * a non-zero integer
+ */
+int acquireBoardParameterValues(const char *fileName, DigitizerParams_t *boardDttParams, CAEN_DGTZ_DPP_PSD_Params_t *boardDppParams, int *boardLinkNum){
+  int success;
+  DigitizerParams_t savedDttParams = dttParams;
+  CAEN_DGTZ_DPP_PSD_Params_t savedDppParams = dppParams;
+  unsigned long int savedAcqTime = acqTime;
+  int savedLinkNum = linkNum;
+  int savedZeroToMaxChIntervalWidth = zeroToMaxChIntervalWidth;
+  int savedFileZeroToMaxChIntervalWidth = fileZeroToMaxChIntervalWidth;
+    configFileName = fileName;
+    currentLineNo = 0;
+    if ( !initMyCAEN_DTT_config() ){
+      configFileName = "tdcr.ini";
+      return 0;
+    }
+    memset(&dttParams, 0, sizeof(DigitizerParams_t));
+    memset(&dppParams, 0, sizeof(CAEN_DGTZ_DPP_PSD_Params_t));
+    if(  (success = parseConfigFile())  ){
+      *boardDttParams = dttParams;
+      *boardDppParams = dppParams;
+      *boardLinkNum = linkNum;
+    }
+    freeDataStructureMemory();
+    dttParams = savedDttParams;
+    dppParams = savedDppParams;
+    acqTime = savedAcqTime;
+    linkNum = savedLinkNum;
+    zeroToMaxChIntervalWidth = savedZeroToMaxChIntervalWidth;
+    fileZeroToMaxChIntervalWidth = savedFileZeroToMaxChIntervalWidth;
+    configFileName = "tdcr.ini";
+  return success;
+}
+
 /* Function that asks the user via stdin/stdout which parameters he would like
  * to modify and then stores the values in the right variables. The function
  * performs some error checks.
@@ -2328,7 +2406,14 @@ static void saveCurrentParametersToFile(void){
       }
     }
     
-    copyToFileNextCommentedLines();
+    /* copy the rest of the file (the 'Readout options' section, that is
+       parsed by the 'readoutOptions' module) as it is */
+    while( copyToFileNextCommentedLines() ){
+      if(  (fputs(myReadLine, myOutputFile) == EOF) || (fputs("\n", myOutputFile) == EOF)  ){
+        perror("Error while saving data on disk");
+        goto destroy_output_file;
+      }
+    }
 
 
     // replace old tdcr.ini with the updated file
@@ -3049,13 +3134,13 @@ static int DPP_csensParseAndSet(void){
               if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0')
                 ;       // OK
               else{
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3064,14 +3149,14 @@ static int DPP_csensParseAndSet(void){
             if (readChNo == i)
               ;       // OK
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -3087,7 +3172,7 @@ static int DPP_csensParseAndSet(void){
             if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0'){
               // check if channel is really not enabled
               if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
@@ -3095,14 +3180,14 @@ static int DPP_csensParseAndSet(void){
                 ;   // OK
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
           else if (readEnable == 1){
             if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3110,13 +3195,13 @@ static int DPP_csensParseAndSet(void){
               ;     // OK
           }
           else{
-            fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+            fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
             error = 1;
             break;
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -3133,7 +3218,7 @@ static int DPP_csensParseAndSet(void){
               dppParams.csens[i] = readValue;
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3143,13 +3228,13 @@ static int DPP_csensParseAndSet(void){
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
       }
       else{
-        fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+        fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
         error = 1;
         break;
       }
@@ -3197,13 +3282,13 @@ static int DPP_tvawParseAndSet(void){
               if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0')
                 ;       // OK
               else{
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3212,14 +3297,14 @@ static int DPP_tvawParseAndSet(void){
             if (readChNo == i)
               ;       // OK
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -3235,7 +3320,7 @@ static int DPP_tvawParseAndSet(void){
             if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0'){
               // check if channel is really not enabled
               if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
@@ -3243,14 +3328,14 @@ static int DPP_tvawParseAndSet(void){
                 ;   // OK
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
           else if (readEnable == 1){
             if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3258,13 +3343,13 @@ static int DPP_tvawParseAndSet(void){
               ;     // OK
           }
           else{
-            fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+            fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
             error = 1;
             break;
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -3281,7 +3366,7 @@ static int DPP_tvawParseAndSet(void){
               dppParams.tvaw[i] = readValue;
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3291,13 +3376,13 @@ static int DPP_tvawParseAndSet(void){
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
       }
       else{
-        fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+        fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
         error = 1;
         break;
       }
@@ -3345,13 +3430,13 @@ static int DPP_trgcParseAndSet(void){
             if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0')
               ;       // OK
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
           else{
-            fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+            fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
             error = 1;
             break;
           }
@@ -3360,14 +3445,14 @@ static int DPP_trgcParseAndSet(void){
           if (readChNo == i)
             ;       // OK
           else{
-            fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+            fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
             error = 1;
             break;
           }
         }
       }
       else{
-        fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+        fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
         error = 1;
         break;
       }
@@ -3383,7 +3468,7 @@ static int DPP_trgcParseAndSet(void){
           if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0'){
             // check if channel is really not enabled
             if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3391,14 +3476,14 @@ static int DPP_trgcParseAndSet(void){
               ;   // OK
           }
           else{
-            fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+            fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
             error = 1;
             break;
           }
         }
         else if (readEnable == 1){
           if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-            fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+            fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
             error = 1;
             break;
           }
@@ -3406,13 +3491,13 @@ static int DPP_trgcParseAndSet(void){
             ;     // OK
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
       }
       else{
-        fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+        fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
         error = 1;
         break;
       }
@@ -3429,19 +3514,19 @@ static int DPP_trgcParseAndSet(void){
           dppParams.trgc[i] = CAEN_DGTZ_DPP_TriggerConfig_Peak;
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
       }
       else{
-        fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+        fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
         error = 1;
         break;
       }
     }
     else{
-      fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+      fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
       error = 1;
       break;
     }
@@ -3489,13 +3574,13 @@ static int DPP_selftParseAndSet(void){
               if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0')
                 ;       // OK
               else{
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3504,14 +3589,14 @@ static int DPP_selftParseAndSet(void){
             if (readChNo == i)
               ;       // OK
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -3527,7 +3612,7 @@ static int DPP_selftParseAndSet(void){
             if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0'){
               // check if channel is really not enabled
               if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
@@ -3535,14 +3620,14 @@ static int DPP_selftParseAndSet(void){
                 ;   // OK
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
           else if (readEnable == 1){
             if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3550,13 +3635,13 @@ static int DPP_selftParseAndSet(void){
               ;     // OK
           }
           else{
-            fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+            fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
             error = 1;
             break;
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -3573,7 +3658,7 @@ static int DPP_selftParseAndSet(void){
               dppParams.selft[i] = readValue;
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3583,13 +3668,13 @@ static int DPP_selftParseAndSet(void){
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
       }
       else{
-        fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+        fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
         error = 1;
         break;
       }
@@ -3637,13 +3722,13 @@ static int DPP_pgateParseAndSet(void){
               if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0')
                 ;       // OK
               else{
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3652,14 +3737,14 @@ static int DPP_pgateParseAndSet(void){
             if (readChNo == i)
               ;       // OK
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -3675,7 +3760,7 @@ static int DPP_pgateParseAndSet(void){
             if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0'){
               // check if channel is really not enabled
               if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
@@ -3683,14 +3768,14 @@ static int DPP_pgateParseAndSet(void){
                 ;   // OK
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
           else if (readEnable == 1){
             if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3698,13 +3783,13 @@ static int DPP_pgateParseAndSet(void){
               ;     // OK
           }
           else{
-            fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+            fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
             error = 1;
             break;
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -3721,7 +3806,7 @@ static int DPP_pgateParseAndSet(void){
               dppParams.pgate[i] = readValue;
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3731,13 +3816,13 @@ static int DPP_pgateParseAndSet(void){
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
       }
       else{
-        fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+        fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
         error = 1;
         break;
       }
@@ -3785,13 +3870,13 @@ static int DPP_sgateParseAndSet(void){
               if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0')
                 ;       // OK
               else{
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3800,14 +3885,14 @@ static int DPP_sgateParseAndSet(void){
             if (readChNo == i)
               ;       // OK
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -3823,7 +3908,7 @@ static int DPP_sgateParseAndSet(void){
             if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0'){
               // check if channel is really not enabled
               if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
@@ -3831,14 +3916,14 @@ static int DPP_sgateParseAndSet(void){
                 ;   // OK
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
           else if (readEnable == 1){
             if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3846,13 +3931,13 @@ static int DPP_sgateParseAndSet(void){
               ;     // OK
           }
           else{
-            fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+            fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
             error = 1;
             break;
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -3869,7 +3954,7 @@ static int DPP_sgateParseAndSet(void){
               dppParams.sgate[i] = readValue;
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3879,13 +3964,13 @@ static int DPP_sgateParseAndSet(void){
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
       }
       else{
-        fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+        fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
         error = 1;
         break;
       }
@@ -3933,13 +4018,13 @@ static int DPP_lgateParseAndSet(void){
               if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0')
                 ;       // OK
               else{
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3948,14 +4033,14 @@ static int DPP_lgateParseAndSet(void){
             if (readChNo == i)
               ;       // OK
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -3971,7 +4056,7 @@ static int DPP_lgateParseAndSet(void){
             if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0'){
               // check if channel is really not enabled
               if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
@@ -3979,14 +4064,14 @@ static int DPP_lgateParseAndSet(void){
                 ;   // OK
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
           else if (readEnable == 1){
             if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -3994,13 +4079,13 @@ static int DPP_lgateParseAndSet(void){
               ;     // OK
           }
           else{
-            fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+            fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
             error = 1;
             break;
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -4017,7 +4102,7 @@ static int DPP_lgateParseAndSet(void){
               dppParams.lgate[i] = readValue;
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -4027,13 +4112,13 @@ static int DPP_lgateParseAndSet(void){
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
       }
       else{
-        fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+        fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
         error = 1;
         break;
       }
@@ -4081,13 +4166,13 @@ static int DPP_nsblParseAndSet(void){
               if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0')
                 ;       // OK
               else{
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -4096,14 +4181,14 @@ static int DPP_nsblParseAndSet(void){
             if (readChNo == i)
               ;       // OK
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -4119,7 +4204,7 @@ static int DPP_nsblParseAndSet(void){
             if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0'){
               // check if channel is really not enabled
               if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
@@ -4127,14 +4212,14 @@ static int DPP_nsblParseAndSet(void){
                 ;   // OK
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
           else if (readEnable == 1){
             if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -4142,13 +4227,13 @@ static int DPP_nsblParseAndSet(void){
               ;     // OK
           }
           else{
-            fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+            fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
             error = 1;
             break;
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -4165,7 +4250,7 @@ static int DPP_nsblParseAndSet(void){
               dppParams.nsbl[i] = readValue;
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -4175,13 +4260,13 @@ static int DPP_nsblParseAndSet(void){
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
       }
       else{
-        fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+        fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
         error = 1;
         break;
       }
@@ -4229,13 +4314,13 @@ static int DPP_thrParseAndSet(void){
               if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0')
                 ;       // OK
               else{
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error= 1;
                 break;
               }
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -4244,14 +4329,14 @@ static int DPP_thrParseAndSet(void){
             if (readChNo == i)
               ;       // OK
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -4267,7 +4352,7 @@ static int DPP_thrParseAndSet(void){
               if (*readStrPtr == '0' && *(readStrPtr + 1) == '\0'){
                 // check if channel is really not enabled
                 if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-                  fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                  fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                   error = 1;
                   break;
                 }
@@ -4275,14 +4360,14 @@ static int DPP_thrParseAndSet(void){
                   ;   // OK
               }
               else{
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
             }
             else if(readEnable==1){
               if (readEnable ^ ((dttParams.ChannelMask & scannerBit) >> i)){
-                fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+                fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
                 error = 1;
                 break;
               }
@@ -4290,13 +4375,13 @@ static int DPP_thrParseAndSet(void){
                 ;     // OK
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
@@ -4313,7 +4398,7 @@ static int DPP_thrParseAndSet(void){
               dppParams.thr[i] = readValue;
             }
             else{
-              fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+              fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
               error = 1;
               break;
             }
@@ -4323,13 +4408,13 @@ static int DPP_thrParseAndSet(void){
           }
         }
         else{
-          fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+          fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
           error = 1;
           break;
         }
       }
       else{
-        fprintf(stderr, "tdcr.ini: error in line %d", currentLineNo);
+        fprintf(stderr, "%s: error in line %d", configFileName, currentLineNo);
         error = 1;
         break;
       }
@@ -6,10 +6,11 @@
  * CAEN DTT/DPP-PSD parameter values, the digitizer's 'Link number' and the
  * acquisition time.
  *
- * 'paramsHeaderToFile' module version: a0.2
+ * 'paramsHeaderToFile' module version: a0.3
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "paramsHeaderToFile.h"
 #include "myCAEN_DTT_config.h"
 #include "Functions.h"
@@ -252,6 +253,33 @@ endPrintToFpout:
     return success;
   }
 
+  /* Writes the header of printParamsHeaderToFile() into a new string (it is
+   * stored in the header of the binary run files).
+   *
+   * @param size where the length of the string is stored
+   * @return the string, to be released with free(), or NULL in case of error
+   * (a description of the error is printed to stderr)
+   */
+  char *printParamsHeaderToString(size_t *size){
+    char *str = NULL;
+    FILE *memStream;
+      if(  (memStream = open_memstream(&str, size)) == NULL  ){
+        perror("ParamsHeaderToFile - open_memstream() error");
+        return NULL;
+      }
+      if( printParamsHeaderToFile(memStream) ){
+        fclose(memStream);
+        free(str);
+        return NULL;
+      }
+      if( fclose(memStream) ){
+        perror("ParamsHeaderToFile - fclose() error");
+        free(str);
+        return NULL;
+      }
+    return str;
+  }
+
   /* Returns the width of the interval between the higher DTT channel enabled
      and channel number 0
   
@@ -0,0 +1,156 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'psdCfd' measures the fine time of the pulses with a digital
+ * constant fraction discriminator (see psdCfd.h).
+ *
+ * 'psdCfd' module version: a0.2
+ */
+
+#include "psdCfd.h"
+#include <stdio.h>
+#include <math.h>
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+/* The CFD signal x PSD_CFD_ONE at the sample i is
+     c[i] = coefSample * s[i] + coefDelayed * s[i - delay] + offset
+   with the baseline of the trace in 'offset' */
+typedef struct
+{
+  int32_t coefSample, coefDelayed, offset;
+} cfdCoefficients_t;
+
+static inline void cfdCoefficients(const psdCfd_t *c, float baseline, cfdCoefficients_t *k);
+static inline int32_t cfdAt(const cfdCoefficients_t *k, const uint16_t *s, uint32_t i, uint32_t delay);
+static inline int16_t cfdFine(const psdCfd_t *c, const cfdCoefficients_t *k, const uint16_t *s, uint32_t i);
+static int16_t cfdScalar(const psdCfd_t *c, const cfdCoefficients_t *k, const uint16_t *s, uint32_t i, uint32_t n, int armed);
+
+
+/* Sets the parameters of the CFD of a channel.
+ *
+ * @return 0 on success, -1 if a parameter is out of range (a description is
+ * printed to stderr)
+ */
+int initPsdCfd(psdCfd_t *c, uint32_t trigger, uint32_t start, uint32_t delay, uint32_t fractionPercent, uint32_t threshold, int negative){
+    if(  (delay < 1) || (delay > PSD_CFD_MAX_DELAY) || (fractionPercent < 1) || (fractionPercent > 100)  ){
+      fprintf(stderr, "psdCfd - invalid delay (%u samples) or fraction (%u%%)\n", delay, fractionPercent);
+      return -1;
+    }
+    c->trigger = trigger;
+    c->delay = delay;
+    // c needs the sample 'delay' samples before
+    c->start = (start > delay) ? start : delay;
+    c->fraction = (int32_t)((fractionPercent * PSD_CFD_ONE + 50) / 100);
+    c->arm = c->fraction * (int32_t)threshold;
+    c->negative = negative;
+  return 0;
+}
+
+/* Computes the fine time of 'count' traces, reference path.
+ */
+void psdCfdScalar(const psdCfd_t *c, const psdChargeTrace_t *traces, const psdCharge_t *charges, uint32_t count, int16_t *fine){
+  cfdCoefficients_t k;
+  uint32_t t;
+    for (t = 0; t < count; t++){
+      cfdCoefficients(c, charges[t].baseline, &k);
+      fine[t] = cfdScalar(c, &k, traces[t].samples, c->start, traces[t].numSamples, 0);
+    }
+}
+
+/* Computes the fine time of 'count' traces, SIMD path: the arming and the
+ * crossing are looked for in the masks of the comparisons of 8 values of c;
+ * the tail of the trace is done by the scalar code.
+ */
+void psdCfdVector(const psdCfd_t *c, const psdChargeTrace_t *traces, const psdCharge_t *charges, uint32_t count, int16_t *fine){
+#ifdef __SSE2__
+  cfdCoefficients_t k;
+  const uint16_t *s;
+  uint32_t t, i, n;
+  unsigned armMask, crossMask;
+  int armed;
+  __m128i coef, offset, arm, one, a, b, lo, hi;
+    one = _mm_set1_epi32(1);
+    arm = _mm_set1_epi32(c->arm);
+    for (t = 0; t < count; t++){
+      cfdCoefficients(c, charges[t].baseline, &k);
+      // pairs (s[i], s[i - delay]) multiplied by (coefSample, coefDelayed)
+      coef = _mm_set1_epi32((int32_t)(((uint32_t)k.coefDelayed << 16) | ((uint32_t)k.coefSample & 0xFFFF)));
+      offset = _mm_set1_epi32(k.offset);
+      s = traces[t].samples;
+      n = traces[t].numSamples;
+      armed = 0;
+      fine[t] = PSD_CFD_NO_TIME;
+      for (i = c->start; i + 8 <= n; i += 8){
+        a = _mm_loadu_si128((const __m128i*)(s + i));
+        b = _mm_loadu_si128((const __m128i*)(s + i - c->delay));
+        lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), coef), offset);
+        hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), coef), offset);
+        armMask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(lo, arm)))
+                  | ((unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(hi, arm))) << 4);
+        // c <= 0
+        crossMask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(lo, one)))
+                    | ((unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(hi, one))) << 4);
+        if (!armed){
+          if (armMask == 0)
+            continue;
+          armed = 1;
+          // the crossing comes after the first armed sample
+          crossMask &= ~((2u << __builtin_ctz(armMask)) - 1);
+        }
+        if (crossMask != 0){
+          fine[t] = cfdFine(c, &k, s, i + (uint32_t)__builtin_ctz(crossMask));
+          break;
+        }
+      }
+      if(  (i + 8 > n) && (i < n)  )
+        fine[t] = cfdScalar(c, &k, s, i, n, armed);
+    }
+#else
+    psdCfdScalar(c, traces, charges, count, fine);
+#endif
+}
+
+/* Sets the coefficients of c for a trace of baseline 'baseline'.
+ */
+static inline void cfdCoefficients(const psdCfd_t *c, float baseline, cfdCoefficients_t *k){
+  int32_t sign = c->negative ? -1 : 1;
+    k->coefSample = sign * c->fraction;
+    k->coefDelayed = -sign * PSD_CFD_ONE;
+    k->offset = (int32_t)lrint((double)sign * (double)(PSD_CFD_ONE - c->fraction) * (double)baseline);
+}
+
+/* @return c at the sample 'i'
+ */
+static inline int32_t cfdAt(const cfdCoefficients_t *k, const uint16_t *s, uint32_t i, uint32_t delay){
+  return k->coefSample * (int32_t)s[i] + k->coefDelayed * (int32_t)s[i - delay] + k->offset;
+}
+
+/* @return the fine time of the crossing between the samples i - 1 and i, or
+ * PSD_CFD_NO_TIME if it is out of range
+ */
+static inline int16_t cfdFine(const psdCfd_t *c, const cfdCoefficients_t *k, const uint16_t *s, uint32_t i){
+  int32_t before = cfdAt(k, s, i - 1, c->delay), after = cfdAt(k, s, i, c->delay);
+  double t = (double)(i - 1) + (double)before / ((double)before - (double)after);
+  long fine = lrint((t - (double)c->trigger - (double)c->delay) * PSD_EVENT_FINE_UNITS);
+    if(  (fine < PSD_EVENT_FINE_MIN) || (fine > PSD_EVENT_FINE_MAX)  )
+      return PSD_CFD_NO_TIME;
+  return (int16_t)fine;
+}
+
+/* Looks for the arming (unless 'armed') then the crossing of c from the
+ * sample 'i' to the end of the trace.
+ *
+ * @return the fine time or PSD_CFD_NO_TIME
+ */
+static int16_t cfdScalar(const psdCfd_t *c, const cfdCoefficients_t *k, const uint16_t *s, uint32_t i, uint32_t n, int armed){
+  int32_t value;
+    for (; i < n; i++){
+      value = cfdAt(k, s, i, c->delay);
+      if (!armed)
+        armed = (value > c->arm);
+      else if (value <= 0)
+        return cfdFine(c, k, s, i);
+    }
+  return PSD_CFD_NO_TIME;
+}
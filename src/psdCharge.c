@@ -0,0 +1,211 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'psdCharge' integrates the charges of the events from their
+ * samples (see psdCharge.h).
+ *
+ * 'psdCharge' module version: a0.2
+ */
+
+#include "psdCharge.h"
+#include <math.h>
+#if defined(__AVX2__)
+  #include <immintrin.h>
+#elif defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+
+/* samples of the baseline for each code of CAEN_DGTZ_DPP_PSD_Params_t.nsbl
+   (x720), 0: all the samples before the gates */
+static const uint32_t baselineSamples[] = { 0, 8, 32, 128 };
+
+static inline uint32_t clipWindow(uint32_t start, uint32_t length, uint32_t numSamples);
+static inline uint32_t sumScalar(const uint16_t *s, uint32_t n);
+#ifdef __SSE2__
+static inline uint32_t sumVector(const uint16_t *s, uint32_t n);
+#endif
+static inline void integrate(const psdChargeGates_t *g, const psdChargeTrace_t *t, psdCharge_t *out, int vector);
+
+
+/* Sets the windows of the gates from the DPP parameters of a channel.
+ *
+ * @return 0 on success, -1 if a parameter is out of range (a description is
+ * printed to stderr)
+ */
+int initPsdChargeGates(psdChargeGates_t *g, uint32_t preTrigger, uint32_t pgate, uint32_t sgate, uint32_t lgate, int nsbl, int negative){
+    if(  (nsbl < 0) || (nsbl >= (int)(sizeof(baselineSamples) / sizeof(baselineSamples[0])))  ){
+      fprintf(stderr, "psdCharge - invalid baseline code (nsbl) %d\n", nsbl);
+      return -1;
+    }
+    if(  (sgate > PSD_CHARGE_MAX_WINDOW) || (lgate > PSD_CHARGE_MAX_WINDOW) || (preTrigger > PSD_CHARGE_MAX_WINDOW)  ){
+      fprintf(stderr, "psdCharge - the gates can't be longer than %d samples\n", PSD_CHARGE_MAX_WINDOW);
+      return -1;
+    }
+    g->gateStart = (pgate < preTrigger) ? preTrigger - pgate : 0;
+    g->shortLength = sgate;
+    g->longLength = lgate;
+    g->baselineLength = g->gateStart;
+    if(  (baselineSamples[nsbl] > 0) && (baselineSamples[nsbl] < g->gateStart)  )
+      g->baselineLength = baselineSamples[nsbl];
+    g->baselineStart = g->gateStart - g->baselineLength;
+    g->negative = negative;
+  return 0;
+}
+
+/* Computes the charges of 'count' traces, reference path.
+ */
+void psdChargeScalar(const psdChargeGates_t *g, const psdChargeTrace_t *traces, uint32_t count, psdCharge_t *out){
+  uint32_t i;
+    for (i = 0; i < count; i++)
+      integrate(g, &traces[i], &out[i], 0);
+}
+
+/* Computes the charges of 'count' traces, SIMD path. The windows of the next
+ * trace are prefetched while the current one is integrated.
+ */
+void psdChargeVector(const psdChargeGates_t *g, const psdChargeTrace_t *traces, uint32_t count, psdCharge_t *out){
+#ifdef __SSE2__
+  uint32_t i;
+    for (i = 0; i < count; i++){
+      if (i + 1 < count)
+        _mm_prefetch((const char*)(traces[i + 1].samples + g->baselineStart), _MM_HINT_T0);
+      integrate(g, &traces[i], &out[i], 1);
+    }
+#else
+    psdChargeScalar(g, traces, count, out);
+#endif
+}
+
+/* @return the name of the SIMD instructions used by psdChargeVector()
+ */
+const char *psdChargeVectorName(void){
+#if defined(__AVX2__)
+  return "AVX2";
+#elif defined(__SSE2__)
+  return "SSE2";
+#else
+  return "none";
+#endif
+}
+
+/* Compares the charges of a trace with those of its event.
+ */
+void psdChargeStatsAdd(psdChargeStats_t *s, const psdEvent_t *ev, const psdCharge_t *q){
+  double r, psd;
+    if (ev->qlong == 0){
+      s->noCharge++;
+      return;
+    }
+    s->count++;
+    r = (double)q->qlong / (double)ev->qlong;
+    s->sumLong += r;
+    s->sumLong2 += r * r;
+    if (ev->qshort > 0){
+      r = (double)q->qshort / (double)ev->qshort;
+      s->sumShort += r;
+      s->sumShort2 += r * r;
+      s->countShort++;
+    }
+    psd = (double)q->psd - ((double)ev->qlong - (double)ev->qshort) / (double)ev->qlong;
+    s->sumPsd += psd;
+    s->sumPsd2 += psd * psd;
+}
+
+/* Prints the statistics on one line (see PSD_CHARGE_STATS_HEADER).
+ *
+ * @return 0 on success, otherwise a non-zero integer
+ */
+int printPsdChargeStats(FILE *fp, int channel, const psdChargeStats_t *s){
+  double n = (double)s->count, ns = (double)s->countShort;
+  double ml = 0.0, rl = 0.0, ms = 0.0, rs = 0.0, mp = 0.0, rp = 0.0;
+    if (s->count > 0){
+      ml = s->sumLong / n;
+      rl = sqrt(fmax(s->sumLong2 / n - ml * ml, 0.0));
+      mp = s->sumPsd / n;
+      rp = sqrt(fmax(s->sumPsd2 / n - mp * mp, 0.0));
+    }
+    if (s->countShort > 0){
+      ms = s->sumShort / ns;
+      rs = sqrt(fmax(s->sumShort2 / ns - ms * ms, 0.0));
+    }
+    fprintf(fp, "%5d %15lu %13lu %15.4f %10.4f %15.4f %10.4f %16.5f %10.5f\n", channel, (unsigned long)(s->count + s->noCharge),
+                (unsigned long)s->noCharge, ml, rl, ms, rs, mp, rp);
+  return ferror(fp);
+}
+
+/* @return the length of the window [start, start + length) cut at the end
+ * of a trace of 'numSamples' samples
+ */
+static inline uint32_t clipWindow(uint32_t start, uint32_t length, uint32_t numSamples){
+    if (start >= numSamples)
+      return 0;
+  return (length < numSamples - start) ? length : numSamples - start;
+}
+
+/* @return the sum of 'n' samples
+ */
+static inline uint32_t sumScalar(const uint16_t *s, uint32_t n){
+  uint32_t i, sum = 0;
+    for (i = 0; i < n; i++)
+      sum += s[i];
+  return sum;
+}
+
+#ifdef __SSE2__
+/* @return the sum of 'n' samples (< 0x8000): pmaddwd with 1 adds up the
+ * pairs of samples into 32 bit lanes, the lanes are added at the end
+ */
+static inline uint32_t sumVector(const uint16_t *s, uint32_t n){
+  uint32_t i = 0;
+  __m128i acc = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi16(1);
+#ifdef __AVX2__
+  __m256i acc256 = _mm256_setzero_si256();
+    for (; i + 16 <= n; i += 16)
+      acc256 = _mm256_add_epi32(acc256, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i*)(s + i)), _mm256_set1_epi16(1)));
+    acc = _mm_add_epi32(_mm256_castsi256_si128(acc256), _mm256_extracti128_si256(acc256, 1));
+#endif
+    for (; i + 8 <= n; i += 8)
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(s + i)), ones));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+  return (uint32_t)_mm_cvtsi128_si32(acc) + sumScalar(s + i, n - i);
+}
+#endif
+
+/* Computes the charges of the trace 't'. The short and the long gate open
+ * together: the samples of the shorter one are added once.
+ */
+static inline void integrate(const psdChargeGates_t *g, const psdChargeTrace_t *t, psdCharge_t *out, int vector){
+  uint32_t nb = clipWindow(g->baselineStart, g->baselineLength, t->numSamples);
+  uint32_t ns = clipWindow(g->gateStart, g->shortLength, t->numSamples);
+  uint32_t nl = clipWindow(g->gateStart, g->longLength, t->numSamples);
+  uint32_t first = (ns < nl) ? ns : nl, last = (ns < nl) ? nl : ns;
+  uint32_t sumB, sumFirst, sumLast;
+  const uint16_t *gate = t->samples + g->gateStart;
+  double baseline, qshort, qlong;
+#ifdef __SSE2__
+    if (vector){
+      sumB = sumVector(t->samples + g->baselineStart, nb);
+      sumFirst = sumVector(gate, first);
+      sumLast = sumFirst + sumVector(gate + first, last - first);
+    }
+    else
+#endif
+    {
+      (void)vector;
+      sumB = sumScalar(t->samples + g->baselineStart, nb);
+      sumFirst = sumScalar(gate, first);
+      sumLast = sumFirst + sumScalar(gate + first, last - first);
+    }
+    baseline = (nb > 0) ? (double)sumB / (double)nb : 0.0;
+    qshort = (double)((ns < nl) ? sumFirst : sumLast) - baseline * (double)ns;
+    qlong = (double)((ns < nl) ? sumLast : sumFirst) - baseline * (double)nl;
+    if (g->negative){
+      qshort = -qshort;
+      qlong = -qlong;
+    }
+    out->baseline = (float)baseline;
+    out->qshort = (float)qshort;
+    out->qlong = (float)qlong;
+    out->psd = (qlong > 0.0) ? (float)((qlong - qshort) / qlong) : 0.0f;
+}
@@ -0,0 +1,541 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'psdDecoder' unpacks the readout buffers of a x720 board with
+ * DPP-PSD firmware into psdEvent_t records (see psdDecoder.h).
+ *
+ * 'psdDecoder' module version: a0.6
+ */
+
+#include "psdDecoder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+/* initial number of records allocated for each channel */
+#define PSD_INITIAL_CAPACITY 4096
+
+/* board aggregate header */
+#define PSD_BOARD_HEADER_WORDS 4
+#define PSD_BOARD_TAG(w) (((w) >> 28) & 0xF)
+#define PSD_BOARD_SIZE(w) ((w) & 0x0FFFFFFF)
+#define PSD_BOARD_CHMASK(w) ((w) & 0xFF)
+/* channel aggregate header */
+#define PSD_CHANNEL_HEADER_WORDS 2
+#define PSD_CHANNEL_TAG(w) (((w) >> 31) & 0x1)
+#define PSD_CHANNEL_SIZE(w) ((w) & 0x003FFFFF)
+#define PSD_FORMAT_DT(w) (((w) >> 31) & 0x1)
+#define PSD_FORMAT_EQ(w) (((w) >> 30) & 0x1)
+#define PSD_FORMAT_EE(w) (((w) >> 28) & 0x1)
+#define PSD_FORMAT_ES(w) (((w) >> 27) & 0x1)
+#define PSD_FORMAT_NS8(w) ((w) & 0xFFFF)
+/* charge word */
+#define PSD_QSHORT(w) ((uint16_t)((w) & 0x7FFF))
+#define PSD_QLONG(w) ((uint16_t)((w) >> 16))
+#define PSD_PUR(w) (((w) >> 15) & 0x1)
+/* extras word */
+#define PSD_EXTRAS_LOW(w) ((w) & 0xFFFF)
+#define PSD_EXTRAS_HIGH(w) ((w) >> 16)
+
+/* max number of consecutive zero words (see DataConsistencyCheck()) */
+#define PSD_MAX_ZERO_WORDS 2
+
+static int psdDecode(psdDecoder_t *d, const uint32_t *buff32, uint32_t numWords, int vector);
+static int reserveEvents(psdDecoder_t *d, int ch, uint32_t count);
+static void locateSamples(psdDecoder_t *d, int ch, const uint32_t *w, uint32_t numEvents, uint32_t eventSize, uint32_t format);
+static int countZeroWord(psdDecoder_t *d, uint32_t word);
+static inline void applyExtras(psdDecoder_t *d, int ch, uint32_t extras);
+static inline void checkClock(psdDecoder_t *d, int ch, uint32_t timeTag);
+static int decodeChannelScalar(psdDecoder_t *d, int ch, const uint32_t *w, uint32_t numEvents, uint32_t eventSize, uint32_t format);
+#ifdef __SSE2__
+static int decodeChannelVector(psdDecoder_t *d, int ch, const uint32_t *w, uint32_t numEvents, uint32_t eventSize, uint32_t format);
+#endif
+
+
+/* Initializes the decoder of the board 'board' (an index < 256).
+ *
+ * @return 0 on success, -1 if the memory can't be allocated
+ */
+int initPsdDecoder(psdDecoder_t *d, int board){
+  register int ch;
+    memset(d, 0, sizeof(psdDecoder_t));
+    d->board = (uint8_t)board;
+    for (ch = 0; ch < PSD_MAX_CHANNELS; ch++){
+      if(  (d->events[ch] = (psdEvent_t*)malloc(PSD_INITIAL_CAPACITY * sizeof(psdEvent_t))) == NULL  ){
+        fputs("psdDecoder - error trying allocating memory for the events\n", stderr);
+        freePsdDecoder(d);
+        return -1;
+      }
+      d->capacity[ch] = PSD_INITIAL_CAPACITY;
+    }
+  return 0;
+}
+
+/* Frees the memory allocated by the decoder.
+ */
+void freePsdDecoder(psdDecoder_t *d){
+  register int ch;
+    for (ch = 0; ch < PSD_MAX_CHANNELS; ch++){
+      free(d->events[ch]);
+      free(d->samples[ch]);
+      d->events[ch] = NULL;
+      d->samples[ch] = NULL;
+      d->numEvents[ch] = d->capacity[ch] = 0;
+    }
+}
+
+/* Empties the per-channel record arrays. The rollover counters are kept.
+ */
+void psdDecoderClear(psdDecoder_t *d){
+  register int ch;
+    for (ch = 0; ch < PSD_MAX_CHANNELS; ch++)
+      d->numEvents[ch] = 0;
+    d->zeroCount = 0;
+}
+
+/* Makes the decoder keep where the samples of each record are
+ * ('samples').
+ *
+ * @return 0 on success, -1 if the memory can't be allocated
+ */
+int psdDecoderEnableSamples(psdDecoder_t *d){
+  register int ch;
+    for (ch = 0; ch < PSD_MAX_CHANNELS; ch++){
+      if(  (d->samples[ch] == NULL) && ((d->samples[ch] = (psdSamples_t*)malloc(d->capacity[ch] * sizeof(psdSamples_t))) == NULL)  ){
+        fputs("psdDecoder - error trying allocating memory for the samples\n", stderr);
+        return -1;
+      }
+    }
+  return 0;
+}
+
+/* Sets how the extras word of the events is read.
+ */
+void psdDecoderSetExtras(psdDecoder_t *d, int extras){
+    d->extras = extras;
+}
+
+/* Sets the wall-clock time of the readout of the next buffer. The latest
+ * time of the board is first taken from the records of the previous one.
+ */
+void psdDecoderSetClock(psdDecoder_t *d, uint64_t clock){
+  register int ch;
+  uint64_t last;
+    for (ch = 0; ch < PSD_MAX_CHANNELS; ch++){
+      if (d->numEvents[ch] == 0)
+        continue;
+      last = d->events[ch][d->numEvents[ch] - 1].timestamp;
+      if (last > d->refTime){
+        d->refTime = last;
+        d->refClock = d->clock;
+      }
+    }
+    d->clock = clock;
+}
+
+/* Decodes a readout buffer with the reference (scalar) path. The records
+ * replace those of the previous buffer.
+ *
+ * @param d the decoder of the board the buffer comes from
+ * @param buff32 the readout buffer
+ * @param numWords the size of 'buff32' (32 bit words)
+ * @return 0 on success, -1 in case of data error or if the memory can't be
+ * allocated (a description is printed)
+ */
+int psdDecodeScalar(psdDecoder_t *d, const uint32_t *buff32, uint32_t numWords){
+  return psdDecode(d, buff32, numWords, 0);
+}
+
+/* Decodes a readout buffer with the SIMD path. The records replace those of
+ * the previous buffer.
+ *
+ * @param d the decoder of the board the buffer comes from
+ * @param buff32 the readout buffer
+ * @param numWords the size of 'buff32' (32 bit words)
+ * @return 0 on success, -1 in case of data error or if the memory can't be
+ * allocated (a description is printed)
+ */
+int psdDecodeVector(psdDecoder_t *d, const uint32_t *buff32, uint32_t numWords){
+  return psdDecode(d, buff32, numWords, 1);
+}
+
+/* Appends a record to the channel 'ch' and extends its time tag. It is used
+ * to convert the events unpacked by CAEN_DGTZ_GetDPPEvents().
+ *
+ * @param d the decoder
+ * @param ch the channel (< PSD_MAX_CHANNELS)
+ * @param timeTag the trigger time tag (31 bits)
+ * @param extras the extras word, NULL if the event has none
+ * @param qshort the short gate charge
+ * @param qlong the long gate charge
+ * @param pur the pile-up flag
+ * @return 0 on success, -1 if the memory can't be allocated
+ */
+int psdDecoderPushEvent(psdDecoder_t *d, int ch, uint32_t timeTag, const uint32_t *extras, uint16_t qshort, uint16_t qlong, int pur){
+  psdEvent_t *ev;
+    if (reserveEvents(d, ch, 1))
+      return -1;
+    timeTag &= PSD_TIMETAG_MASK;
+    if(  (d->numEvents[ch] == 0) && ((extras == NULL) || (d->extras != PSD_EXTRAS_TIME))  )
+      checkClock(d, ch, timeTag);
+    if (timeTag < d->prevTimeTag[ch])
+      d->rollovers[ch]++;
+    d->prevTimeTag[ch] = timeTag;
+    if (extras != NULL)
+      applyExtras(d, ch, *extras);
+    if (d->samples[ch] != NULL)
+      d->samples[ch][d->numEvents[ch]].words = NULL;
+    ev = &d->events[ch][d->numEvents[ch]++];
+    ev->timestamp = (d->rollovers[ch] << PSD_TIMETAG_BITS) | timeTag;
+    ev->qshort = qshort;
+    ev->qlong = qlong;
+    ev->board = d->board;
+    ev->channel = (uint8_t)ch;
+    ev->flags = pur ? PSD_EVENT_FLAG_PUR : 0;
+  return 0;
+}
+
+/* Counts the events of each channel of a readout buffer reading only the
+ * aggregate headers (used by the raw capture, that doesn't decode). The
+ * count stops at the first malformed header.
+ *
+ * @param buff32 the readout buffer
+ * @param numWords the size of 'buff32' (32 bit words)
+ * @param counts the number of events of each channel is added here
+ * @return 0 on success, -1 if a malformed header was found
+ */
+int psdCountEvents(const uint32_t *buff32, uint32_t numWords, uint64_t counts[PSD_MAX_CHANNELS]){
+  uint32_t pnt = 0, boardEnd, chSize, format, chMask, eventSize;
+  register int ch;
+    while (pnt < numWords){
+      boardEnd = pnt + PSD_BOARD_SIZE(buff32[pnt]);
+      if(  (PSD_BOARD_TAG(buff32[pnt]) != 0xA) || (boardEnd > numWords) || (boardEnd - pnt < PSD_BOARD_HEADER_WORDS)  )
+        return -1;
+      chMask = PSD_BOARD_CHMASK(buff32[pnt + 1]);
+      pnt += PSD_BOARD_HEADER_WORDS;
+      for (ch = 0; ch < PSD_MAX_CHANNELS; ch++){
+        if (!(chMask & (1 << ch)))
+          continue;
+        if (boardEnd - pnt < PSD_CHANNEL_HEADER_WORDS)
+          return -1;
+        chSize = PSD_CHANNEL_SIZE(buff32[pnt]);
+        format = buff32[pnt + 1];
+        if(  (chSize < PSD_CHANNEL_HEADER_WORDS) || (chSize > boardEnd - pnt)  )
+          return -1;
+        eventSize = 1 + (PSD_FORMAT_ES(format) ? PSD_FORMAT_NS8(format) * 4 : 0) + PSD_FORMAT_EE(format) + PSD_FORMAT_EQ(format);
+        counts[ch] += (chSize - PSD_CHANNEL_HEADER_WORDS) / eventSize;
+        pnt += chSize;
+      }
+      pnt = boardEnd;
+    }
+  return 0;
+}
+
+/* Makes room in the record array of the channel 'ch' for 'count' more
+ * records.
+ *
+ * @return 0 on success, -1 if the memory can't be allocated
+ */
+static int reserveEvents(psdDecoder_t *d, int ch, uint32_t count){
+  uint32_t newCapacity;
+  psdEvent_t *newEvents;
+  psdSamples_t *newSamples;
+    if (d->numEvents[ch] + count <= d->capacity[ch])
+      return 0;
+    newCapacity = d->capacity[ch] ? d->capacity[ch] : PSD_INITIAL_CAPACITY;
+    while (newCapacity < d->numEvents[ch] + count)
+      newCapacity *= 2;
+    if(  (newEvents = (psdEvent_t*)realloc(d->events[ch], newCapacity * sizeof(psdEvent_t))) == NULL  ){
+      fputs("psdDecoder - error trying allocating memory for the events\n", stderr);
+      return -1;
+    }
+    d->events[ch] = newEvents;
+    if (d->samples[ch] != NULL){
+      if(  (newSamples = (psdSamples_t*)realloc(d->samples[ch], newCapacity * sizeof(psdSamples_t))) == NULL  ){
+        fputs("psdDecoder - error trying allocating memory for the samples\n", stderr);
+        return -1;
+      }
+      d->samples[ch] = newSamples;
+    }
+    d->capacity[ch] = newCapacity;
+  return 0;
+}
+
+/* Keeps where the samples of the 'numEvents' events of the channel 'ch'
+ * starting at 'w' are, for the records just decoded from them.
+ */
+static void locateSamples(psdDecoder_t *d, int ch, const uint32_t *w, uint32_t numEvents, uint32_t eventSize, uint32_t format){
+  psdSamples_t *s = d->samples[ch] + d->numEvents[ch] - numEvents;
+  uint32_t i;
+    for (i = 0; i < numEvents; i++, w += eventSize, s++){
+      s->words = PSD_FORMAT_ES(format) ? w + 1 : NULL;
+      s->numSamples = PSD_FORMAT_NS8(format) * 8;
+      s->dualTrace = PSD_FORMAT_DT(format);
+    }
+}
+
+/* Updates the count of consecutive zero words with 'word'.
+ *
+ * @return 0 on success, -1 on a burst of zeroes (a description is printed)
+ */
+static int countZeroWord(psdDecoder_t *d, uint32_t word){
+    if (word != 0)
+      d->zeroCount = 0;
+    else if (++d->zeroCount > PSD_MAX_ZERO_WORDS){
+      printf("Data Error: Burst of zeroes\n");
+      return -1;
+    }
+  return 0;
+}
+
+/* Reads the extras word of an event of the channel 'ch' (see
+ * psdDecoderSetExtras()), after the rollovers of its time tag were counted.
+ */
+static inline void applyExtras(psdDecoder_t *d, int ch, uint32_t extras){
+  uint64_t rollovers;
+    if (d->extras == PSD_EXTRAS_TIME){
+      // the 16 bits of the extended time stamp replace those of the rollovers, a wrap of them is carried
+      rollovers = (d->rollovers[ch] & ~(uint64_t)0xFFFF) | PSD_EXTRAS_LOW(extras);
+      if (rollovers < d->rollovers[ch])
+        rollovers += 0x10000;
+      d->rollovers[ch] = rollovers;
+    }
+    else if (d->extras == PSD_EXTRAS_TRIGGERS){
+      d->totalTriggers[ch] += (uint16_t)(PSD_EXTRAS_LOW(extras) - PSD_EXTRAS_LOW(d->prevExtras[ch]));
+      d->lostTriggers[ch] += (uint16_t)(PSD_EXTRAS_HIGH(extras) - PSD_EXTRAS_HIGH(d->prevExtras[ch]));
+      d->prevExtras[ch] = extras;
+    }
+}
+
+/* Checks the rollovers of the channel 'ch' against the wall clock before
+ * its first event of the buffer, of time tag 'timeTag', is decoded (see
+ * psdDecoder.h). The rollovers missed are added so that the event gets the
+ * latest time below the bound; the previous time tag is cleared so that the
+ * counting doesn't add one more.
+ */
+static inline void checkClock(psdDecoder_t *d, int ch, uint32_t timeTag){
+  uint64_t bound, rollovers, counted;
+    if(  (d->clock == 0) || (d->clock < d->refClock)  )
+      return;
+    bound = d->refTime + (d->clock - d->refClock) + PSD_CLOCK_MARGIN;
+    // a rollover can be missed only after more than a rollover period
+    if (bound <= ((d->rollovers[ch] << PSD_TIMETAG_BITS) | d->prevTimeTag[ch]) + PSD_TIMETAG_MASK)
+      return;
+    rollovers = (bound - timeTag) >> PSD_TIMETAG_BITS;
+    counted = d->rollovers[ch] + (timeTag < d->prevTimeTag[ch]);
+    if (rollovers > counted){
+      d->missedRollovers[ch] += rollovers - counted;
+      d->rollovers[ch] = rollovers;
+      d->prevTimeTag[ch] = 0;
+    }
+}
+
+/* Walks the board and channel aggregates of a readout buffer, checks the
+ * headers and decodes each channel aggregate with the scalar or the vector
+ * path.
+ *
+ * @return 0 on success, -1 in case of error (a description is printed)
+ */
+static int psdDecode(psdDecoder_t *d, const uint32_t *buff32, uint32_t numWords, int vector){
+  uint32_t pnt = 0, boardSize, boardEnd, chSize, format, chMask, eventSize, payload;
+  register int ch;
+    psdDecoderClear(d);
+    while (pnt < numWords){
+      /* board aggregate header */
+      boardSize = PSD_BOARD_SIZE(buff32[pnt]);
+      if(  (PSD_BOARD_TAG(buff32[pnt]) != 0xA) || (boardSize < PSD_BOARD_HEADER_WORDS)  ){
+        printf("Data Error: Bad board aggregate header\n");
+        return -1;
+      }
+      if (boardSize > numWords - pnt){
+        printf("Data Error: Event truncation\n");
+        return -1;
+      }
+      // W0 is never zero (tag)
+      d->zeroCount = 0;
+      if(  countZeroWord(d, buff32[pnt + 1]) || countZeroWord(d, buff32[pnt + 2]) || countZeroWord(d, buff32[pnt + 3])  )
+        return -1;
+      chMask = PSD_BOARD_CHMASK(buff32[pnt + 1]);
+      boardEnd = pnt + boardSize;
+      pnt += PSD_BOARD_HEADER_WORDS;
+
+      /* channel aggregates */
+      for (ch = 0; ch < PSD_MAX_CHANNELS; ch++){
+        if (!(chMask & (1 << ch)))
+          continue;
+        if (boardEnd - pnt < PSD_CHANNEL_HEADER_WORDS){
+          printf("Data Error: Event truncation\n");
+          return -1;
+        }
+        chSize = PSD_CHANNEL_SIZE(buff32[pnt]);
+        format = buff32[pnt + 1];
+        if(  !PSD_CHANNEL_TAG(buff32[pnt]) || (chSize < PSD_CHANNEL_HEADER_WORDS) || (chSize > boardEnd - pnt)  ){
+          printf("Data Error: Bad channel aggregate header\n");
+          return -1;
+        }
+        d->zeroCount = 0;
+        if (countZeroWord(d, format))
+          return -1;
+        eventSize = 1 + (PSD_FORMAT_ES(format) ? PSD_FORMAT_NS8(format) * 4 : 0) + PSD_FORMAT_EE(format) + PSD_FORMAT_EQ(format);
+        payload = chSize - PSD_CHANNEL_HEADER_WORDS;
+        if (payload % eventSize){
+          printf("Data Error: Bad channel aggregate size\n");
+          return -1;
+        }
+        if (reserveEvents(d, ch, payload / eventSize))
+          return -1;
+        if(  (payload > 0) && (d->numEvents[ch] == 0) && !(PSD_FORMAT_EE(format) && (d->extras == PSD_EXTRAS_TIME))  )
+          checkClock(d, ch, buff32[pnt + PSD_CHANNEL_HEADER_WORDS] & PSD_TIMETAG_MASK);
+#ifdef __SSE2__
+        if(  vector && !PSD_FORMAT_ES(format) && PSD_FORMAT_EQ(format)  ){
+          if (decodeChannelVector(d, ch, buff32 + pnt + PSD_CHANNEL_HEADER_WORDS, payload / eventSize, eventSize, format))
+            return -1;
+        }
+        else
+#endif
+        if (decodeChannelScalar(d, ch, buff32 + pnt + PSD_CHANNEL_HEADER_WORDS, payload / eventSize, eventSize, format))
+          return -1;
+        if (d->samples[ch] != NULL)
+          locateSamples(d, ch, buff32 + pnt + PSD_CHANNEL_HEADER_WORDS, payload / eventSize, eventSize, format);
+        pnt += chSize;
+      }
+      if (pnt != boardEnd){
+        printf("Data Error: Event truncation\n");
+        return -1;
+      }
+    }
+  return 0;
+}
+
+/* Decodes 'numEvents' events of the channel 'ch' starting at 'w'. The room
+ * for the records must already be reserved.
+ *
+ * @return 0 on success, -1 on a burst of zeroes (a description is printed)
+ */
+static int decodeChannelScalar(psdDecoder_t *d, int ch, const uint32_t *w, uint32_t numEvents, uint32_t eventSize, uint32_t format){
+  uint32_t i, timeTag, charge = 0;
+  uint32_t chargeOffset = eventSize - 1, extrasOffset = eventSize - 1 - PSD_FORMAT_EQ(format);
+  psdEvent_t *ev = d->events[ch] + d->numEvents[ch];
+    for (i = 0; i < numEvents; i++, w += eventSize, ev++){
+      if (countZeroWord(d, w[0]))
+        return -1;
+      if(  PSD_FORMAT_EE(format) && countZeroWord(d, w[extrasOffset])  )
+        return -1;
+      if (PSD_FORMAT_EQ(format)){
+        charge = w[chargeOffset];
+        if (countZeroWord(d, charge))
+          return -1;
+      }
+      timeTag = w[0] & PSD_TIMETAG_MASK;
+      if (timeTag < d->prevTimeTag[ch])
+        d->rollovers[ch]++;
+      d->prevTimeTag[ch] = timeTag;
+      if (PSD_FORMAT_EE(format))
+        applyExtras(d, ch, w[extrasOffset]);
+      ev->timestamp = (d->rollovers[ch] << PSD_TIMETAG_BITS) | timeTag;
+      ev->qshort = PSD_QSHORT(charge);
+      ev->qlong = PSD_QLONG(charge);
+      ev->board = d->board;
+      ev->channel = (uint8_t)ch;
+      ev->flags = PSD_PUR(charge) ? PSD_EVENT_FLAG_PUR : 0;
+    }
+    d->numEvents[ch] += numEvents;
+  return 0;
+}
+
+#ifdef __SSE2__
+/* Decodes 'numEvents' List mode events (no samples, charge enabled) of the
+ * channel 'ch' starting at 'w', 4 events at a time. A group of 4 events with
+ * a rollover or a zero word is passed to decodeChannelScalar(), as well as the
+ * last numEvents % 4 events; so is, with PSD_EXTRAS_TIME, a group whose
+ * extended time stamps differ from the rollovers counted so far. With
+ * PSD_EXTRAS_TRIGGERS the differences of the trigger counters are computed
+ * on the 16 bit lanes, that wrap as the counters do. The room for the records
+ * must already be reserved.
+ *
+ * @return 0 on success, -1 on a burst of zeroes (a description is printed)
+ */
+static int decodeChannelVector(psdDecoder_t *d, int ch, const uint32_t *w, uint32_t numEvents, uint32_t eventSize, uint32_t format){
+  uint32_t i, s = eventSize;
+  const __m128i ttMask = _mm_set1_epi32((int)PSD_TIMETAG_MASK);
+  const __m128i chargeMask = _mm_set1_epi32((int)0xFFFF7FFF);
+  const __m128i purBit = _mm_set1_epi32(0x8000);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i tagWord = _mm_set1_epi32(d->board | (ch << 8));
+  const __m128i lowMask = _mm_set1_epi32(0xFFFF);
+  const int extendedTime = PSD_FORMAT_EE(format) && (d->extras == PSD_EXTRAS_TIME);
+  const int triggers = PSD_FORMAT_EE(format) && (d->extras == PSD_EXTRAS_TRIGGERS);
+  __m128i tt, q, ex, prev, w0, w1, w2, w3, t0, t1, t2, t3, lo, hi, delta, total = zero, lost = zero;
+  __m128i *dst;
+  uint64_t sums[2];
+    for (i = 0; i + 4 <= numEvents; i += 4, w += 4 * s){
+      if (s == 2){
+        // [tt0 q0 tt1 q1] [tt2 q2 tt3 q3] -> [tt0 tt1 tt2 tt3] [q0 q1 q2 q3]
+        lo = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)w), _MM_SHUFFLE(3, 1, 2, 0));
+        hi = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(w + 4)), _MM_SHUFFLE(3, 1, 2, 0));
+        tt = _mm_unpacklo_epi64(lo, hi);
+        q = _mm_unpackhi_epi64(lo, hi);
+        ex = tt;
+      }
+      else{
+        tt = _mm_set_epi32((int)w[3 * s], (int)w[2 * s], (int)w[s], (int)w[0]);
+        q = _mm_set_epi32((int)w[4 * s - 1], (int)w[3 * s - 1], (int)w[2 * s - 1], (int)w[s - 1]);
+        ex = PSD_FORMAT_EE(format) ? _mm_set_epi32((int)w[4 * s - 2], (int)w[3 * s - 2], (int)w[2 * s - 2], (int)w[s - 2]) : tt;
+      }
+
+      /* a zero word (burst of zeroes check) or a rollover inside the group:
+         leave it to the scalar path */
+      if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi32(tt, zero), _mm_cmpeq_epi32(q, zero)), _mm_cmpeq_epi32(ex, zero)))){
+        if (decodeChannelScalar(d, ch, w, 4, eventSize, format))
+          return -1;
+        continue;
+      }
+      tt = _mm_and_si128(tt, ttMask);
+      // previous time tag of each event: [prev tt0 tt1 tt2] (31 bit values, the signed compare is safe)
+      prev = _mm_or_si128(_mm_slli_si128(tt, 4), _mm_cvtsi32_si128((int)d->prevTimeTag[ch]));
+      if(  _mm_movemask_epi8(_mm_cmplt_epi32(tt, prev)) ||
+           (extendedTime && (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(ex, lowMask), _mm_set1_epi32((int)(d->rollovers[ch] & 0xFFFF)))) != 0xFFFF))  ){
+        if (decodeChannelScalar(d, ch, w, 4, eventSize, format))
+          return -1;
+        continue;
+      }
+      if (triggers){
+        // counters of each event minus those of the previous one: [prev ex0 ex1 ex2]
+        delta = _mm_sub_epi16(ex, _mm_or_si128(_mm_slli_si128(ex, 4), _mm_cvtsi32_si128((int)d->prevExtras[ch])));
+        d->prevExtras[ch] = (uint32_t)_mm_cvtsi128_si32(_mm_shuffle_epi32(ex, _MM_SHUFFLE(3, 3, 3, 3)));
+        lo = _mm_and_si128(delta, lowMask);
+        hi = _mm_srli_epi32(delta, 16);
+        total = _mm_add_epi64(total, _mm_add_epi64(_mm_unpacklo_epi32(lo, zero), _mm_unpackhi_epi32(lo, zero)));
+        lost = _mm_add_epi64(lost, _mm_add_epi64(_mm_unpacklo_epi32(hi, zero), _mm_unpackhi_epi32(hi, zero)));
+      }
+      d->zeroCount = 0;
+      d->prevTimeTag[ch] = (uint32_t)_mm_cvtsi128_si32(_mm_shuffle_epi32(tt, _MM_SHUFFLE(3, 3, 3, 3)));
+
+      /* the 4 words of each record, one register per word */
+      w0 = _mm_or_si128(tt, _mm_set1_epi32((int)((d->rollovers[ch] & 1) << 31)));
+      w1 = _mm_set1_epi32((int)(d->rollovers[ch] >> 1));
+      w2 = _mm_and_si128(q, chargeMask);
+      w3 = _mm_or_si128(tagWord, _mm_slli_epi32(_mm_and_si128(q, purBit), 1));
+      /* transpose into 4 records */
+      t0 = _mm_unpacklo_epi32(w0, w1);
+      t1 = _mm_unpacklo_epi32(w2, w3);
+      t2 = _mm_unpackhi_epi32(w0, w1);
+      t3 = _mm_unpackhi_epi32(w2, w3);
+      dst = (__m128i*)(d->events[ch] + d->numEvents[ch]);
+      _mm_storeu_si128(dst, _mm_unpacklo_epi64(t0, t1));
+      _mm_storeu_si128(dst + 1, _mm_unpackhi_epi64(t0, t1));
+      _mm_storeu_si128(dst + 2, _mm_unpacklo_epi64(t2, t3));
+      _mm_storeu_si128(dst + 3, _mm_unpackhi_epi64(t2, t3));
+      d->numEvents[ch] += 4;
+    }
+    if (triggers){
+      _mm_storeu_si128((__m128i*)sums, total);
+      d->totalTriggers[ch] += sums[0] + sums[1];
+      _mm_storeu_si128((__m128i*)sums, lost);
+      d->lostTriggers[ch] += sums[0] + sums[1];
+    }
+  return decodeChannelScalar(d, ch, w, numEvents - i, eventSize, format);
+}
+#endif
@@ -0,0 +1,95 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'psdHisto' accumulates online the spectra of a channel (see
+ * psdHisto.h).
+ *
+ * 'psdHisto' module version: a0.1
+ */
+
+#include "psdHisto.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* words of a copy of the 1D spectra, of the 2D histogram, of the live block */
+#define COPY_SIZE (3 * PSD_HISTO_BINS)
+#define HISTO_2D_SIZE (PSD_HISTO_2D_BINS * PSD_HISTO_2D_BINS)
+#define LIVE_SIZE (PSD_HISTO_COPIES * COPY_SIZE + HISTO_2D_SIZE)
+
+static void fillOne(uint32_t *copy, uint32_t *histo2D, const psdEvent_t *ev);
+
+
+/* Allocates the bins of a channel and sets them to 0.
+ *
+ * @return 0 on success, -1 if the memory can't be allocated (a description
+ * is printed to stderr)
+ */
+int initPsdHisto(psdHisto_t *h){
+    memset(h, 0, sizeof(psdHisto_t));
+    if(  ((h->live = (uint32_t*)calloc(LIVE_SIZE, sizeof(uint32_t))) == NULL)
+        || ((h->snapshot = (uint32_t*)calloc(COPY_SIZE + HISTO_2D_SIZE, sizeof(uint32_t))) == NULL)  ){
+      fputs("psdHisto - error trying allocating memory for the histograms\n", stderr);
+      freePsdHisto(h);
+      return -1;
+    }
+  return 0;
+}
+
+/* Frees the memory allocated by initPsdHisto().
+ */
+void freePsdHisto(psdHisto_t *h){
+    free(h->live);
+    free(h->snapshot);
+    h->live = h->snapshot = NULL;
+}
+
+/* Adds a record to a copy of the 1D spectra and to the 2D histogram.
+ */
+static void fillOne(uint32_t *copy, uint32_t *histo2D, const psdEvent_t *ev){
+  uint32_t qs = ev->qshort & (PSD_HISTO_BINS - 1);
+  uint32_t ql = ev->qlong & (PSD_HISTO_BINS - 1);
+  uint32_t psd = (qs < ql) ? ((ql - qs) << PSD_HISTO_BITS) / ql : 0;
+    // Qs = 0: the ratio is 1, counted in the last bin
+    if (psd == PSD_HISTO_BINS)
+      psd--;
+    copy[PSD_HISTO_QSHORT + qs]++;
+    copy[PSD_HISTO_QLONG + ql]++;
+    copy[PSD_HISTO_PSD + psd]++;
+    histo2D[(ql >> PSD_HISTO_2D_SHIFT) * PSD_HISTO_2D_BINS + (qs >> PSD_HISTO_2D_SHIFT)]++;
+}
+
+/* Adds records to the spectra.
+ *
+ * @param h the histograms of the channel of the records
+ * @param ev the records
+ * @param count the number of records
+ */
+void psdHistoFill(psdHisto_t *h, const psdEvent_t *ev, uint32_t count){
+  uint32_t *histo2D = h->live + PSD_HISTO_COPIES * COPY_SIZE;
+  uint32_t n = 0;
+  register int k;
+    // the n-th record of each group goes to the n-th copy
+    for (; n + PSD_HISTO_COPIES <= count; n += PSD_HISTO_COPIES){
+      for (k = 0; k < PSD_HISTO_COPIES; k++)
+        fillOne(h->live + k * COPY_SIZE, histo2D, &ev[n + k]);
+    }
+    for (k = 0; n < count; n++, k++)
+      fillOne(h->live + k * COPY_SIZE, histo2D, &ev[n]);
+    h->entries += count;
+}
+
+/* Copies the live spectra into the snapshot (the copies are summed).
+ *
+ * @param h the histograms
+ */
+void psdHistoSnapshot(psdHisto_t *h){
+  register uint32_t i;
+  register int k;
+    memcpy(h->snapshot, h->live, COPY_SIZE * sizeof(uint32_t));
+    for (k = 1; k < PSD_HISTO_COPIES; k++){
+      for (i = 0; i < COPY_SIZE; i++)
+        h->snapshot[i] += h->live[k * COPY_SIZE + i];
+    }
+    memcpy(h->snapshot + COPY_SIZE, h->live + PSD_HISTO_COPIES * COPY_SIZE, HISTO_2D_SIZE * sizeof(uint32_t));
+    h->snapshotEntries = h->entries;
+}
@@ -0,0 +1,361 @@
+/* The module 'readoutOptions' reads the 'Readout options' section of
+ * "tdcr.ini" (see readoutOptions.h).
+ *
+ * 'readoutOptions' module version: a0.20
+ */
+
+#include "readoutOptions.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+
+#define OPT_LINE_SIZE 303
+
+/* kinds of option values */
+#define OPT_ENUM 0      /* one of 'enumNames', stored as int (index) */
+#define OPT_BOOL 1      /* 0 or 1, stored as int */
+#define OPT_UINT 2      /* unsigned integer in ['min','max'], stored as unsigned long */
+#define OPT_BOARDS 3    /* comma separated list of the configuration files of the
+                           additional boards, stored in 'BoardConfigs' and 'NumBoards' */
+#define OPT_PATH 4      /* file name shorter than READOUT_FILE_NAME_SIZE, stored as
+                           char[READOUT_FILE_NAME_SIZE], empty: not used */
+#define OPT_WINDOWS 5   /* comma separated list of resolving times (see
+                           parseTdcrScanWindows()), stored in 'ScanWindows' and
+                           'NumScanWindows', empty: none */
+
+typedef struct
+{
+  const char *name;
+  int type;
+  void *value;
+  const char **enumNames;
+  int enumCount;
+  unsigned long min, max;
+} readoutOptionDesc_t;
+
+ReadoutOptions_t readoutOptions;
+
+static const char *decoderNames[DECODER_COUNT] = { "LIBRARY", "SCALAR", "VECTOR" };
+static const char *outputFormatNames[OUTPUT_COUNT] = { "TEXT", "BINARY", "RAW", "TEXT_NS" };
+static const char *readoutPolicyNames[READOUT_POLICY_COUNT] = { "BUSY", "ADAPTIVE", "IRQ" };
+static const char *outputWriterNames[RUN_WRITER_COUNT] = { "STDIO", "MMAP", "URING" };
+static const char *deadTimeModeNames[TDCR_DEAD_COUNT] = { "NON_EXTENDABLE", "EXTENDABLE" };
+static const char *extrasNames[PSD_EXTRAS_COUNT] = { "NONE", "EXTENDED_TIME", "TRIGGER_COUNTERS" };
+
+/* description of every option: the order is the one used by
+   printReadoutOptions() */
+static readoutOptionDesc_t optionDescs[] = {
+  { "Decoder", OPT_ENUM, &readoutOptions.Decoder, decoderNames, DECODER_COUNT, 0, 0 },
+  { "DecoderCheck", OPT_BOOL, &readoutOptions.DecoderCheck, NULL, 0, 0, 1 },
+  { "OutputFormat", OPT_ENUM, &readoutOptions.OutputFormat, outputFormatNames, OUTPUT_COUNT, 0, 0 },
+  { "BoardConfigs", OPT_BOARDS, &readoutOptions.NumBoards, NULL, 0, 0, MAXNB - 1 },
+  { "MergeWindow", OPT_UINT, &readoutOptions.MergeWindow, NULL, 0, 0, READOUT_MAX_MERGE_WINDOW },
+  { "CoincWindow", OPT_UINT, &readoutOptions.CoincWindow, NULL, 0, 0, READOUT_MAX_COINC_WINDOW },
+  { "Histograms", OPT_BOOL, &readoutOptions.Histograms, NULL, 0, 0, 1 },
+  { "HistoSavePeriod", OPT_UINT, &readoutOptions.HistoSavePeriod, NULL, 0, 0, READOUT_MAX_HISTO_SAVE_PERIOD },
+  { "ReadoutPolicy", OPT_ENUM, &readoutOptions.ReadoutPolicy, readoutPolicyNames, READOUT_POLICY_COUNT, 0, 0 },
+  { "PollMaxWait", OPT_UINT, &readoutOptions.PollMaxWait, NULL, 0, 0, READOUT_MAX_POLL_WAIT },
+  { "IrqThreshold", OPT_UINT, &readoutOptions.IrqThreshold, NULL, 0, 1, READOUT_MAX_IRQ_THRESHOLD },
+  { "IrqTimeout", OPT_UINT, &readoutOptions.IrqTimeout, NULL, 0, 1, READOUT_MAX_IRQ_TIMEOUT },
+  { "OutputWriter", OPT_ENUM, &readoutOptions.OutputWriter, outputWriterNames, RUN_WRITER_COUNT, 0, 0 },
+  { "SegmentSize", OPT_UINT, &readoutOptions.SegmentSize, NULL, 0, 0, READOUT_MAX_SEGMENT_SIZE },
+  { "SegmentPeriod", OPT_UINT, &readoutOptions.SegmentPeriod, NULL, 0, 0, READOUT_MAX_SEGMENT_PERIOD },
+  { "OutputDirect", OPT_BOOL, &readoutOptions.OutputDirect, NULL, 0, 0, 1 },
+  { "OutputQueueDepth", OPT_UINT, &readoutOptions.OutputQueueDepth, NULL, 0, 1, RUN_WRITER_URING_MAX_DEPTH },
+  { "MetricsFile", OPT_PATH, readoutOptions.MetricsFile, NULL, 0, 0, 0 },
+  { "MetricsPort", OPT_UINT, &readoutOptions.MetricsPort, NULL, 0, 0, READOUT_MAX_METRICS_PORT },
+  { "MetricsSocket", OPT_PATH, readoutOptions.MetricsSocket, NULL, 0, 0, 0 },
+  { "Waveforms", OPT_BOOL, &readoutOptions.Waveforms, NULL, 0, 0, 1 },
+  { "SoftwareCharge", OPT_BOOL, &readoutOptions.SoftwareCharge, NULL, 0, 0, 1 },
+  { "CfdDelay", OPT_UINT, &readoutOptions.CfdDelay, NULL, 0, 0, PSD_CFD_MAX_DELAY },
+  { "CfdFraction", OPT_UINT, &readoutOptions.CfdFraction, NULL, 0, 1, 100 },
+  { "DeadTimeMode", OPT_ENUM, &readoutOptions.DeadTimeMode, deadTimeModeNames, TDCR_DEAD_COUNT, 0, 0 },
+  { "DeadTime", OPT_UINT, &readoutOptions.DeadTime, NULL, 0, 0, READOUT_MAX_DEAD_TIME },
+  { "DeadTimeA", OPT_UINT, &readoutOptions.DeadTimePmt[0], NULL, 0, 0, READOUT_MAX_DEAD_TIME },
+  { "DeadTimeB", OPT_UINT, &readoutOptions.DeadTimePmt[1], NULL, 0, 0, READOUT_MAX_DEAD_TIME },
+  { "DeadTimeC", OPT_UINT, &readoutOptions.DeadTimePmt[2], NULL, 0, 0, READOUT_MAX_DEAD_TIME },
+  { "Extras", OPT_ENUM, &readoutOptions.Extras, extrasNames, PSD_EXTRAS_COUNT, 0, 0 },
+  { "CoincFilter", OPT_BOOL, &readoutOptions.CoincFilter, NULL, 0, 0, 1 },
+  { "SinglesPrescale", OPT_UINT, &readoutOptions.SinglesPrescale, NULL, 0, 0, READOUT_MAX_SINGLES_PRESCALE },
+  { "CoincScan", OPT_WINDOWS, &readoutOptions.NumScanWindows, NULL, 0, 0, 0 },
+};
+
+static void setDefaultReadoutOptions(void);
+static int optionParseAndSet(readoutOptionDesc_t *desc, const char *value);
+static int boardsParseAndSet(readoutOptionDesc_t *desc, const char *value);
+static char *trimString(char *str);
+
+
+/* Sets 'readoutOptions' to the default values.
+ */
+static void setDefaultReadoutOptions(void){
+  readoutOptions.Decoder = DECODER_VECTOR;
+  readoutOptions.DecoderCheck = 0;
+  readoutOptions.OutputFormat = OUTPUT_TEXT;
+  readoutOptions.NumBoards = 1;
+  strcpy(readoutOptions.BoardConfigs[0], "tdcr.ini");
+  readoutOptions.MergeWindow = 0;
+  readoutOptions.CoincWindow = 0;
+  readoutOptions.Histograms = 0;
+  readoutOptions.HistoSavePeriod = 60;
+  readoutOptions.ReadoutPolicy = READOUT_POLICY_ADAPTIVE;
+  readoutOptions.PollMaxWait = 5000;
+  readoutOptions.IrqThreshold = 1;
+  readoutOptions.IrqTimeout = 100;
+  readoutOptions.OutputWriter = RUN_WRITER_MMAP;
+  readoutOptions.SegmentSize = 0;
+  readoutOptions.SegmentPeriod = 0;
+  readoutOptions.OutputDirect = 1;
+  readoutOptions.OutputQueueDepth = 4;
+  readoutOptions.MetricsFile[0] = '\0';
+  readoutOptions.MetricsPort = 0;
+  readoutOptions.MetricsSocket[0] = '\0';
+  readoutOptions.Waveforms = 0;
+  readoutOptions.SoftwareCharge = 0;
+  readoutOptions.CfdDelay = 0;
+  readoutOptions.CfdFraction = 50;
+  readoutOptions.DeadTimeMode = TDCR_DEAD_NON_EXTENDABLE;
+  readoutOptions.DeadTime = 0;
+  readoutOptions.DeadTimePmt[0] = readoutOptions.DeadTimePmt[1] = readoutOptions.DeadTimePmt[2] = 0;
+  readoutOptions.Extras = PSD_EXTRAS_NONE;
+  readoutOptions.CoincFilter = 0;
+  readoutOptions.SinglesPrescale = 0;
+  readoutOptions.NumScanWindows = 0;
+}
+
+/* Removes the leading and trailing blanks (and CR / LF) of 'str'.
+ *
+ * @return a pointer to the first not blank char of 'str'
+ */
+static char *trimString(char *str){
+  char *end;
+    while(  (*str != '\0') && isspace((unsigned char)*str)  )
+      str++;
+    end = str + strlen(str);
+    while(  (end > str) && isspace((unsigned char)*(end - 1))  )
+      end--;
+    *end = '\0';
+  return str;
+}
+
+/* Parses 'value' according to the kind of the option described by 'desc'
+ * and, if it is valid, stores it.
+ *
+ * @return a non-zero integer if 'value' is valid, otherwise 0
+ */
+static int optionParseAndSet(readoutOptionDesc_t *desc, const char *value){
+  int success = 0;
+  register int i;
+  unsigned long ulValue;
+  char *endPtr;
+    switch (desc->type){
+      case OPT_ENUM:
+        for (i = 0; i < desc->enumCount; i++){
+          if (strcmp(value, desc->enumNames[i]) == 0){
+            *(int*)desc->value = i;
+            success = 1;
+            break;
+          }
+        }
+        break;
+      case OPT_BOOL:
+        if(  (strcmp(value, "0") == 0) || (strcmp(value, "1") == 0)  ){
+          *(int*)desc->value = (*value == '1');
+          success = 1;
+        }
+        break;
+      case OPT_UINT:
+        if(  (*value != '\0') && (*value != '-')  ){
+          errno = 0;
+          ulValue = strtoul(value, &endPtr, 0);
+          if(  (*endPtr == '\0') && (errno != ERANGE) && (ulValue >= desc->min) && (ulValue <= desc->max)  ){
+            *(unsigned long*)desc->value = ulValue;
+            success = 1;
+          }
+        }
+        break;
+      case OPT_BOARDS:
+        success = boardsParseAndSet(desc, value);
+        break;
+      case OPT_PATH:
+        if (strlen(value) < READOUT_FILE_NAME_SIZE){
+          strcpy((char*)desc->value, value);
+          success = 1;
+        }
+        break;
+      case OPT_WINDOWS:
+        success = (parseTdcrScanWindows(value, readoutOptions.ScanWindows, (uint32_t*)desc->value) == 0);
+        break;
+    }
+  return success;
+}
+
+/* Parses the list of configuration files of the additional boards (an empty
+ * list means only the board of "tdcr.ini") into 'readoutOptions.BoardConfigs'
+ * from index 1 and sets 'readoutOptions.NumBoards'.
+ *
+ * @return a non-zero integer if 'value' is valid, otherwise 0
+ */
+static int boardsParseAndSet(readoutOptionDesc_t *desc, const char *value){
+  char list[OPT_LINE_SIZE];
+  char *name, *next;
+  int numBoards = 1;
+    strncpy(list, value, OPT_LINE_SIZE - 1);
+    list[OPT_LINE_SIZE - 1] = '\0';
+    if (*trimString(list) != '\0'){
+      for (name = list; name != NULL; name = next){
+        if(  (next = strchr(name, ',')) != NULL  )
+          *next++ = '\0';
+        name = trimString(name);
+        if(  (*name == '\0') || (strlen(name) >= READOUT_FILE_NAME_SIZE) || ((unsigned long)numBoards > desc->max)  )
+          return 0;
+        strcpy(readoutOptions.BoardConfigs[numBoards++], name);
+      }
+    }
+    *(int*)desc->value = numBoards;
+  return 1;
+}
+
+/* Sets 'readoutOptions' to the default values then parses the 'Readout
+ * options' section of "tdcr.ini" to update them.
+ *
+ * @return a non-zero integer on success, 0 if "tdcr.ini" can't be read, if
+ * it contains an invalid option (the line number is printed to stderr) or
+ * if two options can't be used together
+ */
+int acquireReadoutOptions(void){
+  int success = 1;
+  unsigned lineNo = 0;
+  register unsigned i;
+  FILE *fp;
+  char line[OPT_LINE_SIZE];
+  char *name, *value, *equal;
+    setDefaultReadoutOptions();
+    if(  (fp = fopen("tdcr.ini", "r")) == NULL  ){
+      perror("An error occurred while trying to open \"tdcr.ini\"");
+      return 0;
+    }
+    while(  fgets(line, OPT_LINE_SIZE, fp) != NULL  ){
+      lineNo++;
+      name = trimString(line);
+      /* skip comments, blank lines and the positional DTT/DPP-PSD values
+         (they never contain a '=') */
+      if(  (*name == '#') || ((equal = strchr(name, '=')) == NULL)  )
+        continue;
+      *equal = '\0';
+      name = trimString(name);
+      value = trimString(equal + 1);
+      for (i = 0; i < sizeof(optionDescs) / sizeof(optionDescs[0]); i++){
+        if (strcmp(name, optionDescs[i].name) == 0)
+          break;
+      }
+      if(  (i == sizeof(optionDescs) / sizeof(optionDescs[0])) || !optionParseAndSet(&optionDescs[i], value)  ){
+        fprintf(stderr, "\ntdcr.ini: error at line: %u\n", lineNo);
+        success = 0;
+        break;
+      }
+    }
+    if (ferror(fp)){
+      perror("Error while reading \"tdcr.ini\"");
+      success = 0;
+    }
+    fclose(fp);
+    // the coincidences are counted on the time ordered events
+    if(  success && (readoutOptions.CoincWindow > 0) && ((readoutOptions.MergeWindow == 0) || (readoutOptions.OutputFormat == OUTPUT_RAW))  ){
+      fputs("\ntdcr.ini: 'CoincWindow' requires 'MergeWindow' > 0 and the TEXT or BINARY 'OutputFormat'\n", stderr);
+      success = 0;
+    }
+    // the raw capture doesn't decode the events
+    if(  success && readoutOptions.Histograms && (readoutOptions.OutputFormat == OUTPUT_RAW)  ){
+      fputs("\ntdcr.ini: 'Histograms' requires the TEXT or BINARY 'OutputFormat'\n", stderr);
+      success = 0;
+    }
+    // the raw capture already holds the samples
+    if(  success && readoutOptions.Waveforms && (readoutOptions.OutputFormat == OUTPUT_RAW)  ){
+      fputs("\ntdcr.ini: 'Waveforms' requires the TEXT or BINARY 'OutputFormat'\n", stderr);
+      success = 0;
+    }
+    // the charges are integrated on the samples being captured
+    if(  success && readoutOptions.SoftwareCharge && !readoutOptions.Waveforms  ){
+      fputs("\ntdcr.ini: 'SoftwareCharge' requires 'Waveforms'\n", stderr);
+      success = 0;
+    }
+    if(  success && (readoutOptions.CfdDelay > 0) && !readoutOptions.Waveforms  ){
+      fputs("\ntdcr.ini: 'CfdDelay' requires 'Waveforms'\n", stderr);
+      success = 0;
+    }
+    // the dead time is imposed on the stream of the coincidences
+    if(  success && ((readoutOptions.DeadTime > 0) || (readoutOptions.DeadTimePmt[0] > 0) || (readoutOptions.DeadTimePmt[1] > 0) ||
+                     (readoutOptions.DeadTimePmt[2] > 0)) && (readoutOptions.CoincWindow == 0)  ){
+      fputs("\ntdcr.ini: 'DeadTime', 'DeadTimeA', 'DeadTimeB' and 'DeadTimeC' require 'CoincWindow' > 0\n", stderr);
+      success = 0;
+    }
+    // the coincident pulses of an event pass the common dead time
+    if(  success && (readoutOptions.DeadTime > 0) && (readoutOptions.DeadTime < readoutOptions.CoincWindow)  ){
+      fputs("\ntdcr.ini: 'DeadTime' can't be shorter than 'CoincWindow'\n", stderr);
+      success = 0;
+    }
+    // the filter keeps the records of the coincidence windows
+    if(  success && readoutOptions.CoincFilter && (readoutOptions.CoincWindow == 0)  ){
+      fputs("\ntdcr.ini: 'CoincFilter' requires 'CoincWindow' > 0\n", stderr);
+      success = 0;
+    }
+    if(  success && (readoutOptions.SinglesPrescale > 0) && !readoutOptions.CoincFilter  ){
+      fputs("\ntdcr.ini: 'SinglesPrescale' requires 'CoincFilter'\n", stderr);
+      success = 0;
+    }
+    if(  success && (readoutOptions.NumScanWindows > 0) && ((readoutOptions.MergeWindow == 0) || (readoutOptions.OutputFormat == OUTPUT_RAW))  ){
+      fputs("\ntdcr.ini: 'CoincScan' requires 'MergeWindow' > 0 and the TEXT or BINARY 'OutputFormat'\n", stderr);
+      success = 0;
+    }
+  return success;
+}
+
+/* Prints to stdout the current values of 'readoutOptions'.
+ */
+void printReadoutOptions(void){
+  register unsigned i;
+  int b;
+  uint32_t k;
+  size_t length;
+  char list[OPT_LINE_SIZE];
+  readoutOptionDesc_t *desc;
+    printf("5. Readout options\n--------------------------------------------------\n");
+    for (i = 0; i < sizeof(optionDescs) / sizeof(optionDescs[0]); i++){
+      desc = &optionDescs[i];
+      switch (desc->type){
+        case OPT_ENUM:
+          printf("%s: %*s\n", desc->name, (int)(48 - strlen(desc->name)), desc->enumNames[*(int*)desc->value]);
+          break;
+        case OPT_BOOL:
+          printf("%s: %*d\n", desc->name, (int)(48 - strlen(desc->name)), *(int*)desc->value);
+          break;
+        case OPT_UINT:
+          printf("%s: %*lu\n", desc->name, (int)(48 - strlen(desc->name)), *(unsigned long*)desc->value);
+          break;
+        case OPT_BOARDS:
+          if (readoutOptions.NumBoards == 1)
+            printf("%s: %*s\n", desc->name, (int)(48 - strlen(desc->name)), "-");
+          for (b = 1; b < readoutOptions.NumBoards; b++){
+            if (b == 1)
+              printf("%s: %*s\n", desc->name, (int)(48 - strlen(desc->name)), readoutOptions.BoardConfigs[b]);
+            else
+              printf("%50s\n", readoutOptions.BoardConfigs[b]);
+          }
+          break;
+        case OPT_PATH:
+          printf("%s: %*s\n", desc->name, (int)(48 - strlen(desc->name)), (*(char*)desc->value != '\0') ? (char*)desc->value : "-");
+          break;
+        case OPT_WINDOWS:
+          strcpy(list, "-");
+          for (k = 0, length = 0; k < readoutOptions.NumScanWindows; k++)
+            length += snprintf(list + length, sizeof(list) - length, k ? ",%lu" : "%lu", readoutOptions.ScanWindows[k]);
+          printf("%s: %*s\n", desc->name, (int)(48 - strlen(desc->name)), list);
+          break;
+      }
+    }
+    printf("__________________________________________________\n\n");
+}
@@ -0,0 +1,228 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'runFile' defines the binary run file and the text layouts of
+ * the ".dat" files (see runFile.h).
+ *
+ * 'runFile' module version: a0.8
+ */
+
+#include "runFile.h"
+#include <string.h>
+#include <time.h>
+
+/* "00" "01" ... "99": the two digits of each number below 100 */
+static const char digitPairs[201] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+static char *putField(char *dst, uint64_t value, int width);
+
+/* Builds the header of a binary run file.
+ *
+ * @param block where the header is built (RUN_FILE_HEADER_SIZE bytes)
+ * @param content the content of the file (RUN_FILE_CONTENT_*)
+ * @param recordSize the size of each record (0 for RUN_FILE_CONTENT_RAW)
+ * @param chargeMask the mask applied to the charges of the text output
+ * @param textHeader the text written by printParamsHeaderToFile()
+ * @param textHeaderSize the length of 'textHeader'
+ * @return 0 on success, otherwise a non-zero integer (a description is
+ * printed to stderr)
+ */
+int buildRunFileHeader(char *block, uint32_t content, uint32_t recordSize, uint32_t chargeMask, const char *textHeader, size_t textHeaderSize){
+  runFileHeader_t header;
+    if (textHeaderSize >= RUN_FILE_HEADER_SIZE - sizeof(runFileHeader_t)){
+      fputs("runFile - the text header doesn't fit in the file header\n", stderr);
+      return 1;
+    }
+    memset(&header, 0, sizeof(runFileHeader_t));
+    memcpy(header.magic, RUN_FILE_MAGIC, sizeof(header.magic));
+    header.version = RUN_FILE_VERSION;
+    header.headerSize = RUN_FILE_HEADER_SIZE;
+    header.content = content;
+    header.recordSize = recordSize;
+    header.chargeMask = chargeMask;
+    header.textHeaderSize = (uint32_t)textHeaderSize;
+    header.startTime = (int64_t)time(NULL);
+
+    memset(block, 0, RUN_FILE_HEADER_SIZE);
+    memcpy(block, &header, sizeof(runFileHeader_t));
+    memcpy(block + sizeof(runFileHeader_t), textHeader, textHeaderSize);
+  return 0;
+}
+
+/* Writes the header of a binary run file at the beginning of 'fp'.
+ *
+ * @param fp the file, opened in binary mode
+ * @param content the content of the file (RUN_FILE_CONTENT_*)
+ * @param recordSize the size of each record (0 for RUN_FILE_CONTENT_RAW)
+ * @param chargeMask the mask applied to the charges of the text output
+ * @param textHeader the text written by printParamsHeaderToFile()
+ * @param textHeaderSize the length of 'textHeader'
+ * @return 0 on success, otherwise a non-zero integer (a description is
+ * printed to stderr)
+ */
+int writeRunFileHeader(FILE *fp, uint32_t content, uint32_t recordSize, uint32_t chargeMask, const char *textHeader, size_t textHeaderSize){
+  char block[RUN_FILE_HEADER_SIZE];
+    if (buildRunFileHeader(block, content, recordSize, chargeMask, textHeader, textHeaderSize))
+      return 1;
+    // flush now: the records are then written at block aligned offsets
+    if(  (fwrite(block, 1, RUN_FILE_HEADER_SIZE, fp) != RUN_FILE_HEADER_SIZE) || fflush(fp)  ){
+      perror("runFile - an error occurred while writing the file header");
+      return 1;
+    }
+  return 0;
+}
+
+/* Reads and checks the header of a binary run file. On success the file
+ * position is on the first record.
+ *
+ * @param fp the file, opened in binary mode
+ * @param header the header read
+ * @param textHeader where the text header is copied, NUL terminated (at
+ * least RUN_FILE_HEADER_SIZE bytes)
+ * @return 0 on success, otherwise a non-zero integer (a description is
+ * printed to stderr)
+ */
+int readRunFileHeader(FILE *fp, runFileHeader_t *header, char *textHeader){
+  char block[RUN_FILE_HEADER_SIZE];
+    if (fread(block, 1, RUN_FILE_HEADER_SIZE, fp) != RUN_FILE_HEADER_SIZE){
+      fputs("runFile - the file is too short for a run file header\n", stderr);
+      return 1;
+    }
+    memcpy(header, block, sizeof(runFileHeader_t));
+    if (memcmp(header->magic, RUN_FILE_MAGIC, sizeof(header->magic))){
+      fputs("runFile - not a binary run file\n", stderr);
+      return 1;
+    }
+    if(  (header->version < 1) || (header->version > RUN_FILE_VERSION) || (header->headerSize != RUN_FILE_HEADER_SIZE)
+        || (header->textHeaderSize >= RUN_FILE_HEADER_SIZE - sizeof(runFileHeader_t))  ){
+      fprintf(stderr, "runFile - unsupported run file (version %u)\n", header->version);
+      return 1;
+    }
+    memcpy(textHeader, block + sizeof(runFileHeader_t), header->textHeaderSize);
+    textHeader[header->textHeaderSize] = '\0';
+  return 0;
+}
+
+/* Positions a RUN_FILE_CONTENT_TRACES file on the header of the waveform
+ * record 'n' (from 0): through the index at the end of the file or, if the
+ * file has no index, walking the records from the first one.
+ *
+ * @param fp the file, opened in binary mode
+ * @param n the number of the record
+ * @param count where the number of records is written (without the index,
+ * the number of records walked)
+ * @return 0 on success, otherwise a non-zero integer (a description is
+ * printed to stderr)
+ */
+int seekRunFileTrace(FILE *fp, uint64_t n, uint64_t *count){
+  runFileTraceIndex_t trailer;
+  runFileTrace_t trace;
+  uint64_t offset;
+    *count = 0;
+    if(  (fseek(fp, -(long)sizeof(runFileTraceIndex_t), SEEK_END) == 0) && (fread(&trailer, sizeof(trailer), 1, fp) == 1)
+        && (trailer.sync == RUN_FILE_INDEX_SYNC)  ){
+      *count = trailer.count;
+      if (n >= trailer.count){
+        fprintf(stderr, "runFile - the file has %lu waveform records\n", (unsigned long)trailer.count);
+        return 1;
+      }
+      if(  fseek(fp, (long)(trailer.offset + n * sizeof(uint64_t)), SEEK_SET) || (fread(&offset, sizeof(offset), 1, fp) != 1)
+          || fseek(fp, (long)offset, SEEK_SET)  ){
+        fputs("runFile - the index of the waveform records is damaged\n", stderr);
+        return 1;
+      }
+      return 0;
+    }
+    // no index: the run didn't end normally
+    fputs("runFile - warning, the file has no index, the records are walked\n", stderr);
+    if (fseek(fp, RUN_FILE_HEADER_SIZE, SEEK_SET))
+      return 1;
+    for (;;){
+      offset = (uint64_t)ftell(fp);
+      if(  (fread(&trace, sizeof(trace), 1, fp) != 1) || (trace.sync != RUN_FILE_TRACE_SYNC)
+          || (trace.size != RUN_FILE_TRACE_SIZE(trace.numSamples, trace.numTraces))  ){
+        fprintf(stderr, "runFile - the file has %lu waveform records\n", (unsigned long)*count);
+        return 1;
+      }
+      if (*count == n)
+        return fseek(fp, (long)offset, SEEK_SET) ? 1 : 0;
+      (*count)++;
+      if (fseek(fp, (long)(offset + trace.size), SEEK_SET))
+        return 1;
+    }
+}
+
+/* Writes the text lines of records (RUN_FILE_TEXT_LINE or
+ * RUN_FILE_TEXT_NS_LINE), byte for byte as sprintf() would.
+ *
+ * @param dst where the lines are written (at least count *
+ * RUN_FILE_TEXT_MAX_LINE bytes), not NUL terminated
+ * @param ev the records
+ * @param count the number of records
+ * @param chargeMask the mask applied to the charges
+ * @param layout RUN_FILE_TEXT_LEGACY or RUN_FILE_TEXT_NS
+ * @return the number of bytes written
+ */
+size_t formatRunFileText(char *dst, const psdEvent_t *ev, size_t count, uint32_t chargeMask, int layout){
+  char *p = dst;
+  size_t n;
+  int ns = (layout == RUN_FILE_TEXT_NS);
+    // "%7d, %15lu, %7d, %7d, %15lu\n" or "%7d, %15lu, %7d, %7d\n": all the values are positive
+    for (n = 0; n < count; n++, ev++){
+      p = putField(p, (uint64_t)RUN_FILE_TEXT_CHANNEL(ev->board, ev->channel), 7);
+      memcpy(p, ", ", 2);
+      p = putField(p + 2, ns ? PSD_EVENT_TIME_NS(ev) : ev->timestamp & PSD_TIMETAG_MASK, 15);
+      memcpy(p, ", ", 2);
+      p = putField(p + 2, ev->qshort & chargeMask, 7);
+      memcpy(p, ", ", 2);
+      p = putField(p + 2, ev->qlong & chargeMask, 7);
+      if (!ns){
+        memcpy(p, ", ", 2);
+        p = putField(p + 2, ev->timestamp >> PSD_TIMETAG_BITS, 15);
+      }
+      *p++ = '\n';
+    }
+  return (size_t)(p - dst);
+}
+
+/* Writes 'value' right aligned in a field of 'width' chars, padded with
+ * blanks, or in as many chars as its digits if they are more (as
+ * printf("%<width>lu")).
+ *
+ * @return the end of the field
+ */
+static char *putField(char *dst, uint64_t value, int width){
+  uint64_t limit = 10;
+  int digits = 1;
+  char *end;
+  uint32_t v32;
+    while(  (digits < 20) && (value >= limit)  ){
+      digits++;
+      limit *= 10;
+    }
+    if (digits < width){
+      memset(dst, ' ', (size_t)(width - digits));
+      dst += width - digits;
+    }
+    end = dst + digits;
+    dst = end;
+    // the channels, the charges and the time tags fit in 32 bits: the divisions are cheaper
+    while (value > UINT32_MAX){
+      dst -= 2;
+      memcpy(dst, digitPairs + 2 * (value % 100), 2);
+      value /= 100;
+    }
+    v32 = (uint32_t)value;
+    while (v32 >= 100){
+      dst -= 2;
+      memcpy(dst, digitPairs + 2 * (v32 % 100), 2);
+      v32 /= 100;
+    }
+    if (v32 >= 10)
+      memcpy(dst - 2, digitPairs + 2 * v32, 2);
+    else
+      *(dst - 1) = (char)('0' + v32);
+  return end;
+}
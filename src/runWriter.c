@@ -0,0 +1,628 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'runWriter' writes the output of a run to one file or to a
+ * sequence of segment files (see runWriter.h).
+ *
+ * 'runWriter' module version: a0.4
+ */
+
+#define _GNU_SOURCE     /* fallocate(), O_DIRECT */
+#include "runWriter.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+
+/* RUN_WRITER_URING needs the io_uring definitions of the kernel headers */
+#if defined(__linux__) && defined(__has_include)
+  #if __has_include(<linux/io_uring.h>)
+    #define RUN_WRITER_HAVE_URING
+  #endif
+#endif
+
+#ifdef RUN_WRITER_HAVE_URING
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/* the ring and the buffers of RUN_WRITER_URING */
+struct runWriterUring
+{
+  int ring;                     /* io_uring file descriptor */
+  void *sqMap, *cqMap;          /* mappings of the rings (the same with IORING_FEAT_SINGLE_MMAP) */
+  size_t sqMapSize, cqMapSize;
+  struct io_uring_sqe *sqes;
+  size_t sqesSize;
+  atomic_uint *sqTail;
+  unsigned *sqMask, *sqArray;
+  atomic_uint *cqHead, *cqTail;
+  unsigned *cqMask;
+  struct io_uring_cqe *cqes;
+
+  int buffers;                  /* queueDepth + 1: one is being filled */
+  char *buffer[RUN_WRITER_URING_MAX_DEPTH + 1];
+  unsigned length[RUN_WRITER_URING_MAX_DEPTH + 1];  /* length of the write in flight, 0: free */
+  int current;                  /* buffer being filled */
+  uint64_t bufferStart;         /* offset in the segment of the buffer being filled */
+  int inFlight;
+};
+
+static int uringSetup(runWriter_t *w);
+static void uringFree(runWriter_t *w);
+static int uringSubmit(runWriter_t *w, int buffer, unsigned length);
+static int uringReap(runWriter_t *w, int wait);
+static int uringWrite(runWriter_t *w, const char *src, size_t size);
+static int uringSync(runWriter_t *w);
+#endif
+
+static int writeData(runWriter_t *w, const void *data, size_t size);
+static int openSegment(runWriter_t *w);
+static int closeSegment(runWriter_t *w);
+static int mapWindow(runWriter_t *w, uint64_t start);
+static int preallocate(runWriter_t *w, uint64_t size);
+static uint64_t monotonicNs(void);
+
+
+/* Opens the first segment (or the only file) of the output and writes the
+ * header to it.
+ *
+ * @param w the writer to open
+ * @param sink RUN_WRITER_STDIO, RUN_WRITER_MMAP or RUN_WRITER_URING
+ * @param direct RUN_WRITER_URING: open the files with O_DIRECT
+ * @param queueDepth RUN_WRITER_URING: max writes in flight (1 to
+ * RUN_WRITER_URING_MAX_DEPTH)
+ * @param baseName the name of the output without the extension
+ * @param extension the extension of the files (".dat", ".bin", ".raw")
+ * @param header the header written at the beginning of each segment
+ * @param headerSize the length of 'header'
+ * @param segmentSize the size limit of a segment (bytes), 0: no limit
+ * @param segmentPeriod the time limit of a segment (s), 0: no limit
+ * @return 0 on success, -1 in case of error (a description is printed to
+ * stderr)
+ */
+int openRunWriter(runWriter_t *w, int sink, int direct, int queueDepth, const char *baseName, const char *extension, const char *header, size_t headerSize,
+                  uint64_t segmentSize, unsigned long segmentPeriod){
+    memset(w, 0, sizeof(runWriter_t));
+    w->sink = sink;
+    w->fd = -1;
+    // room for "_<segment>"
+    if(  (strlen(baseName) + strlen(extension) + 12 >= RUN_WRITER_NAME_SIZE) || (strlen(extension) >= sizeof(w->extension))  ){
+      fputs("runWriter - the name of the output file is too long\n", stderr);
+      return -1;
+    }
+    strcpy(w->baseName, baseName);
+    strcpy(w->extension, extension);
+    w->segmentSize = segmentSize;
+    w->segmentPeriod = (uint64_t)segmentPeriod * 1000;
+    if (sink == RUN_WRITER_URING){
+#ifdef RUN_WRITER_HAVE_URING
+      if(  (queueDepth < 1) || (queueDepth > RUN_WRITER_URING_MAX_DEPTH)  ){
+        fprintf(stderr, "runWriter - the writes in flight must be 1 to %d\n", RUN_WRITER_URING_MAX_DEPTH);
+        return -1;
+      }
+      w->direct = direct;
+      w->queueDepth = queueDepth;
+      if (uringSetup(w))
+        return -1;
+#else
+      fputs("runWriter - io_uring is not available in this build\n", stderr);
+      return -1;
+#endif
+    }
+    if (headerSize > 0){
+      if(  (w->header = (char*)malloc(headerSize)) == NULL  ){
+        fputs("runWriter - error trying allocating memory for the header\n", stderr);
+        closeRunWriter(w);
+        return -1;
+      }
+      memcpy(w->header, header, headerSize);
+    }
+    w->headerSize = headerSize;
+  return openSegment(w);
+}
+
+/* Writes the name of a segment file into 'name'.
+ *
+ * @param w the writer
+ * @param segment the number of the segment
+ * @param name where the name is written (RUN_WRITER_NAME_SIZE bytes)
+ * @return 0 on success, -1 if the name was truncated
+ */
+int runWriterSegmentName(const runWriter_t *w, int segment, char *name){
+  int len;
+    if(  (w->segmentSize > 0) || (w->segmentPeriod > 0)  )
+      len = snprintf(name, RUN_WRITER_NAME_SIZE, "%s_%04d%s", w->baseName, segment, w->extension);
+    else
+      len = snprintf(name, RUN_WRITER_NAME_SIZE, "%s%s", w->baseName, w->extension);
+  return ((len < 0) || (len >= RUN_WRITER_NAME_SIZE)) ? -1 : 0;
+}
+
+/* Writes data to the current segment.
+ *
+ * @param w the writer
+ * @param data the data
+ * @param size the number of bytes
+ * @return 0 on success, -1 in case of error (a description is printed to
+ * stderr)
+ */
+int runWriterWrite(runWriter_t *w, const void *data, size_t size){
+  uint64_t start = monotonicNs();
+  int ret = writeData(w, data, size);
+  uint64_t elapsed = monotonicNs() - start;
+    if (elapsed > w->maxWriteNs)
+      w->maxWriteNs = elapsed;
+  return ret;
+}
+
+/* Writes data to the current segment (see runWriterWrite()).
+ */
+static int writeData(runWriter_t *w, const void *data, size_t size){
+  const char *src = (const char*)data;
+  size_t n;
+    if (w->sink == RUN_WRITER_STDIO){
+      if(  (size > 0) && (fwrite(data, 1, size, w->fp) != size)  ){
+        perror("runWriter - an error occurred while writing the output file");
+        return -1;
+      }
+      w->size += size;
+      w->totalBytes += size;
+      return 0;
+    }
+#ifdef RUN_WRITER_HAVE_URING
+    if (w->sink == RUN_WRITER_URING)
+      return uringWrite(w, src, size);
+#endif
+    while (size > 0){
+      // the window is full: map the next one
+      if(  (w->size == w->windowStart + RUN_WRITER_WINDOW) && mapWindow(w, w->size)  )
+        return -1;
+      n = (size_t)(w->windowStart + RUN_WRITER_WINDOW - w->size);
+      if (n > size)
+        n = size;
+      memcpy(w->window + (w->size - w->windowStart), src, n);
+      src += n;
+      size -= n;
+      w->size += n;
+      w->totalBytes += n;
+    }
+  return 0;
+}
+
+/* Called between two blocks of whole records: closes the current segment
+ * and opens the next one if the size or the time limit is reached.
+ *
+ * @param w the writer
+ * @return 0 on success, -1 in case of error (a description is printed to
+ * stderr)
+ */
+int runWriterCheckRotation(runWriter_t *w){
+    if(  ((w->segmentSize > 0) && (w->size >= w->segmentSize))
+        || ((w->segmentPeriod > 0) && (monotonicNs() / 1000000 - w->openTime >= w->segmentPeriod))  ){
+      if (closeSegment(w))
+        return -1;
+      w->segment++;
+      return openSegment(w);
+    }
+  return 0;
+}
+
+/* Puts the data written so far in the file (RUN_WRITER_STDIO: fflush(),
+ * RUN_WRITER_URING: waits for the writes in flight and writes the buffer
+ * being filled).
+ *
+ * @param w the writer
+ * @return 0 on success, -1 in case of error (a description is printed to
+ * stderr)
+ */
+int runWriterFlush(runWriter_t *w){
+#ifdef RUN_WRITER_HAVE_URING
+    if(  (w->sink == RUN_WRITER_URING) && (w->fd >= 0)  )
+      return uringSync(w);
+#endif
+    // RUN_WRITER_MMAP: the data is already in the page cache
+    if(  (w->fp != NULL) && fflush(w->fp)  ){
+      perror("runWriter - fflush() error");
+      return -1;
+    }
+  return 0;
+}
+
+/* Closes the current segment and frees the writer.
+ *
+ * @param w the writer
+ * @return 0 on success, -1 in case of error (a description is printed to
+ * stderr)
+ */
+int closeRunWriter(runWriter_t *w){
+  int ret = 0;
+    if(  (w->fp != NULL) || (w->fd >= 0)  )
+      ret = closeSegment(w);
+#ifdef RUN_WRITER_HAVE_URING
+    uringFree(w);
+#endif
+    free(w->header);
+    w->header = NULL;
+  return ret;
+}
+
+/* Prints the sink and the write statistics of the writer on one line.
+ *
+ * @param w the writer
+ * @param fp the stream
+ */
+void printRunWriterStats(const runWriter_t *w, FILE *fp){
+    if (w->sink == RUN_WRITER_URING)
+      fprintf(fp, "Output writer: URING%s, %d writes of %u MiB in flight, %lu waits for a write (%.3f s), longest write call %.3f ms\n",
+              w->direct ? " (O_DIRECT)" : "", w->queueDepth, RUN_WRITER_URING_BLOCK >> 20, (unsigned long)w->waits,
+              (double)w->waitNs / 1e9, (double)w->maxWriteNs / 1e6);
+    else
+      fprintf(fp, "Output writer: %s, longest write call %.3f ms\n", (w->sink == RUN_WRITER_STDIO) ? "STDIO" : "MMAP",
+              (double)w->maxWriteNs / 1e6);
+}
+
+/* Creates the file of the current segment and writes the header.
+ *
+ * @return 0 on success, -1 in case of error (a description is printed to
+ * stderr)
+ */
+static int openSegment(runWriter_t *w){
+    if (runWriterSegmentName(w, w->segment, w->fileName)){
+      fputs("runWriter - the name of the segment file is too long\n", stderr);
+      return -1;
+    }
+    w->size = 0;
+    w->openTime = monotonicNs() / 1000000;
+    if (w->sink == RUN_WRITER_STDIO){
+      if(  (w->fp = fopen(w->fileName, "wb")) == NULL  ){
+        fprintf(stderr, "runWriter - can't create '%s': %s\n", w->fileName, strerror(errno));
+        return -1;
+      }
+    }
+    else{
+      w->fd = -1;
+      if(  (w->sink == RUN_WRITER_URING) && w->direct
+          && ((w->fd = open(w->fileName, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666)) < 0) && (errno == EINVAL)  ){
+        // the file system doesn't support O_DIRECT
+        fprintf(stderr, "runWriter - O_DIRECT is not supported for '%s', the file is written through the page cache\n", w->fileName);
+        w->direct = 0;
+      }
+      if(  (w->fd < 0) && ((w->fd = open(w->fileName, O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0)  ){
+        fprintf(stderr, "runWriter - can't create '%s': %s\n", w->fileName, strerror(errno));
+        return -1;
+      }
+      w->allocated = 0;
+      w->window = NULL;
+      if(  (w->sink == RUN_WRITER_MMAP) && mapWindow(w, 0)  )
+        return -1;
+#ifdef RUN_WRITER_HAVE_URING
+      if (w->sink == RUN_WRITER_URING)
+        w->uring->bufferStart = 0;
+#endif
+    }
+  return writeData(w, w->header, w->headerSize);
+}
+
+/* Closes the file of the current segment. RUN_WRITER_MMAP and
+ * RUN_WRITER_URING: the file is truncated to the bytes written.
+ *
+ * @return 0 on success, -1 in case of error (a description is printed to
+ * stderr)
+ */
+static int closeSegment(runWriter_t *w){
+  int ret = 0;
+    if (w->sink == RUN_WRITER_STDIO){
+      if (fclose(w->fp)){
+        perror("runWriter - an error occurred while closing the output file");
+        ret = -1;
+      }
+      w->fp = NULL;
+      return ret;
+    }
+#ifdef RUN_WRITER_HAVE_URING
+    if(  (w->sink == RUN_WRITER_URING) && uringSync(w)  )
+      ret = -1;
+#endif
+    if(  (w->window != NULL) && munmap(w->window, RUN_WRITER_WINDOW)  ){
+      perror("runWriter - munmap() error");
+      ret = -1;
+    }
+    w->window = NULL;
+    // the preallocated bytes not written (and the padding of the last
+    // O_DIRECT write) are given back
+    if (ftruncate(w->fd, (off_t)w->size)){
+      perror("runWriter - ftruncate() error");
+      ret = -1;
+    }
+    if (close(w->fd)){
+      perror("runWriter - an error occurred while closing the output file");
+      ret = -1;
+    }
+    w->fd = -1;
+  return ret;
+}
+
+/* Maps the window of the file that starts at 'start' (a multiple of
+ * RUN_WRITER_WINDOW) in place of the current one, preallocating the next
+ * extent if needed.
+ *
+ * @return 0 on success, -1 in case of error (a description is printed to
+ * stderr)
+ */
+static int mapWindow(runWriter_t *w, uint64_t start){
+  void *map;
+    if(  (start + RUN_WRITER_WINDOW > w->allocated) && preallocate(w, start + RUN_WRITER_EXTENT)  )
+      return -1;
+    if(  (w->window != NULL) && munmap(w->window, RUN_WRITER_WINDOW)  ){
+      perror("runWriter - munmap() error");
+      return -1;
+    }
+    w->window = NULL;
+    if(  (map = mmap(NULL, RUN_WRITER_WINDOW, PROT_READ | PROT_WRITE, MAP_SHARED, w->fd, (off_t)start)) == MAP_FAILED  ){
+      perror("runWriter - mmap() error");
+      return -1;
+    }
+    w->window = (char*)map;
+    w->windowStart = start;
+  return 0;
+}
+
+/* Extends the file of the current segment to 'size' bytes with allocated
+ * blocks. On the file systems without fallocate() the file is extended
+ * without allocating the blocks.
+ *
+ * @return 0 on success, -1 in case of error (a description is printed to
+ * stderr)
+ */
+static int preallocate(runWriter_t *w, uint64_t size){
+    if (fallocate(w->fd, 0, (off_t)w->allocated, (off_t)(size - w->allocated))){
+      if(  (errno != EOPNOTSUPP) && (errno != ENOSYS)  ){
+        perror("runWriter - can't preallocate the output file");
+        return -1;
+      }
+      if (ftruncate(w->fd, (off_t)size)){
+        perror("runWriter - ftruncate() error");
+        return -1;
+      }
+    }
+    w->allocated = size;
+  return 0;
+}
+
+/* @return the CLOCK_MONOTONIC time in nanoseconds */
+static uint64_t monotonicNs(void){
+  struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#ifdef RUN_WRITER_HAVE_URING
+/* Creates the io_uring of the writer, maps its rings and allocates the
+ * aligned buffers.
+ *
+ * @return 0 on success, -1 in case of error (a description is printed to
+ * stderr)
+ */
+static int uringSetup(runWriter_t *w){
+  struct runWriterUring *u;
+  struct io_uring_params params;
+  char *sq, *cq;
+  register int i;
+    if(  (u = (struct runWriterUring*)calloc(1, sizeof(struct runWriterUring))) == NULL  ){
+      fputs("runWriter - error trying allocating memory for the io_uring\n", stderr);
+      return -1;
+    }
+    w->uring = u;
+    u->ring = -1;
+    u->sqMap = u->cqMap = u->sqes = MAP_FAILED;
+    memset(&params, 0, sizeof(params));
+    if(  (u->ring = (int)syscall(__NR_io_uring_setup, (unsigned)w->queueDepth, &params)) < 0  ){
+      perror("runWriter - io_uring_setup() error");
+      uringFree(w);
+      return -1;
+    }
+    u->sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    u->cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP){
+      if (u->cqMapSize > u->sqMapSize)
+        u->sqMapSize = u->cqMapSize;
+      u->cqMapSize = u->sqMapSize;
+    }
+    u->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqMap = mmap(NULL, u->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring, IORING_OFF_SQ_RING);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+      u->cqMap = u->sqMap;
+    else if (u->sqMap != MAP_FAILED)
+      u->cqMap = mmap(NULL, u->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring, IORING_OFF_CQ_RING);
+    if (u->cqMap != MAP_FAILED)
+      u->sqes = (struct io_uring_sqe*)mmap(NULL, u->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring, IORING_OFF_SQES);
+    if(  (u->sqMap == MAP_FAILED) || (u->cqMap == MAP_FAILED) || (u->sqes == MAP_FAILED)  ){
+      perror("runWriter - can't map the io_uring");
+      uringFree(w);
+      return -1;
+    }
+    sq = (char*)u->sqMap;
+    cq = (char*)u->cqMap;
+    u->sqTail = (atomic_uint*)(sq + params.sq_off.tail);
+    u->sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+    u->sqArray = (unsigned*)(sq + params.sq_off.array);
+    u->cqHead = (atomic_uint*)(cq + params.cq_off.head);
+    u->cqTail = (atomic_uint*)(cq + params.cq_off.tail);
+    u->cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    u->buffers = w->queueDepth + 1;
+    for (i = 0; i < u->buffers; i++){
+      if (posix_memalign((void**)&u->buffer[i], RUN_WRITER_URING_ALIGN, RUN_WRITER_URING_BLOCK)){
+        u->buffer[i] = NULL;
+        fputs("runWriter - error trying allocating memory for the io_uring buffers\n", stderr);
+        uringFree(w);
+        return -1;
+      }
+    }
+  return 0;
+}
+
+/* Closes the io_uring of the writer and frees the buffers (no write must be
+ * in flight).
+ */
+static void uringFree(runWriter_t *w){
+  struct runWriterUring *u = w->uring;
+  register int i;
+    if (u == NULL)
+      return;
+    for (i = 0; i <= RUN_WRITER_URING_MAX_DEPTH; i++)
+      free(u->buffer[i]);
+    if (u->sqes != MAP_FAILED)
+      munmap(u->sqes, u->sqesSize);
+    if(  (u->cqMap != MAP_FAILED) && (u->cqMap != u->sqMap)  )
+      munmap(u->cqMap, u->cqMapSize);
+    if (u->sqMap != MAP_FAILED)
+      munmap(u->sqMap, u->sqMapSize);
+    if (u->ring >= 0)
+      close(u->ring);
+    free(u);
+    w->uring = NULL;
+}
+
+/* Submits the write of 'length' bytes of a buffer at the offset of the
+ * buffer being filled ('bufferStart').
+ *
+ * @return 0 on success, -1 in case of error (a description is printed to
+ * stderr)
+ */
+static int uringSubmit(runWriter_t *w, int buffer, unsigned length){
+  struct runWriterUring *u = w->uring;
+  unsigned tail = atomic_load_explicit(u->sqTail, memory_order_relaxed);
+  unsigned index = tail & *u->sqMask;
+  struct io_uring_sqe *sqe = &u->sqes[index];
+  int ret;
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = w->fd;
+    sqe->off = u->bufferStart;
+    sqe->addr = (uint64_t)(uintptr_t)u->buffer[buffer];
+    sqe->len = length;
+    sqe->user_data = (uint64_t)buffer;
+    u->sqArray[index] = index;
+    // the kernel reads the entry after it sees the new tail
+    atomic_store_explicit(u->sqTail, tail + 1, memory_order_release);
+    do {
+      ret = (int)syscall(__NR_io_uring_enter, u->ring, 1u, 0u, 0u, NULL, 0);
+    } while(  (ret < 0) && (errno == EINTR)  );
+    if (ret != 1){
+      perror("runWriter - io_uring_enter() error");
+      return -1;
+    }
+    u->length[buffer] = length;
+    u->inFlight++;
+  return 0;
+}
+
+/* Frees the buffers whose writes are completed.
+ *
+ * @param wait !=0: wait for a completion if none is ready
+ * @return 0 on success, -1 if a write failed or in case of error (a
+ * description is printed to stderr)
+ */
+static int uringReap(runWriter_t *w, int wait){
+  struct runWriterUring *u = w->uring;
+  unsigned head = atomic_load_explicit(u->cqHead, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(u->cqTail, memory_order_acquire);
+  struct io_uring_cqe *cqe;
+  uint64_t start;
+  int ret = 0;
+    if(  (head == tail) && wait  ){
+      w->waits++;
+      start = monotonicNs();
+      do {
+        ret = (int)syscall(__NR_io_uring_enter, u->ring, 0u, 1u, IORING_ENTER_GETEVENTS, NULL, 0);
+      } while(  (ret < 0) && (errno == EINTR)  );
+      w->waitNs += monotonicNs() - start;
+      if (ret < 0){
+        perror("runWriter - io_uring_enter() error");
+        return -1;
+      }
+      tail = atomic_load_explicit(u->cqTail, memory_order_acquire);
+    }
+    for (; head != tail; head++){
+      cqe = &u->cqes[head & *u->cqMask];
+      if (cqe->res < 0){
+        fprintf(stderr, "runWriter - an error occurred while writing '%s': %s\n", w->fileName, strerror(-cqe->res));
+        ret = -1;
+      }
+      else if ((unsigned)cqe->res != u->length[cqe->user_data]){
+        fprintf(stderr, "runWriter - short write on '%s' (disk full?)\n", w->fileName);
+        ret = -1;
+      }
+      u->length[cqe->user_data] = 0;
+      u->inFlight--;
+    }
+    atomic_store_explicit(u->cqHead, head, memory_order_release);
+  return (ret < 0) ? -1 : 0;
+}
+
+/* Copies data into the buffers, submitting each of them when it is full
+ * (see writeData()).
+ */
+static int uringWrite(runWriter_t *w, const char *src, size_t size){
+  struct runWriterUring *u = w->uring;
+  size_t n;
+    while (size > 0){
+      n = RUN_WRITER_URING_BLOCK - (size_t)(w->size - u->bufferStart);
+      if (n > size)
+        n = size;
+      memcpy(u->buffer[u->current] + (w->size - u->bufferStart), src, n);
+      src += n;
+      size -= n;
+      w->size += n;
+      w->totalBytes += n;
+      if (w->size - u->bufferStart < RUN_WRITER_URING_BLOCK)
+        break;
+      if(  (u->bufferStart + RUN_WRITER_URING_BLOCK > w->allocated) && preallocate(w, u->bufferStart + RUN_WRITER_EXTENT)  )
+        return -1;
+      if (uringSubmit(w, u->current, RUN_WRITER_URING_BLOCK))
+        return -1;
+      u->current = (u->current + 1) % u->buffers;
+      u->bufferStart = w->size;
+      // the next buffer can be filled when its last write is completed
+      if (uringReap(w, 0))
+        return -1;
+      while (u->length[u->current] > 0){
+        if (uringReap(w, 1))
+          return -1;
+      }
+    }
+  return 0;
+}
+
+/* Waits for the writes in flight, then writes the buffer being filled
+ * (padded to RUN_WRITER_URING_ALIGN bytes with O_DIRECT) and waits for it.
+ * The buffer is kept: the next data is appended to it and it is written
+ * again in the same place.
+ *
+ * @return 0 on success, -1 in case of error (a description is printed to
+ * stderr)
+ */
+static int uringSync(runWriter_t *w){
+  struct runWriterUring *u = w->uring;
+  unsigned fill = (unsigned)(w->size - u->bufferStart);
+  unsigned length = w->direct ? (fill + RUN_WRITER_URING_ALIGN - 1) & ~(RUN_WRITER_URING_ALIGN - 1) : fill;
+    while (u->inFlight > 0){
+      if (uringReap(w, 1))
+        return -1;
+    }
+    if (fill == 0)
+      return 0;
+    memset(u->buffer[u->current] + fill, 0, length - fill);
+    if (uringSubmit(w, u->current, length))
+      return -1;
+    while (u->inFlight > 0){
+      if (uringReap(w, 1))
+        return -1;
+    }
+  return 0;
+}
+#endif
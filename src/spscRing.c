@@ -0,0 +1,108 @@
+/* The module 'spscRing' offers a bounded single-producer / single-consumer
+ * lock-free ring of pointers (see spscRing.h).
+ *
+ * 'spscRing' module version: a0.1
+ */
+
+#include "spscRing.h"
+#include <stdlib.h>
+
+/* Allocates the slots of 'ring' and sets it empty. 'capacity' must be a
+ * power of 2.
+ *
+ * @param ring the ring to initialize
+ * @param capacity the max number of pointers the ring can hold
+ * @return 0 on success, -1 if 'capacity' is not a power of 2 or if the
+ * memory can't be allocated
+ */
+int spscRingInit(spscRing_t *ring, unsigned long capacity){
+    if(  (capacity == 0) || (capacity & (capacity - 1))  )
+      return -1;
+    if(  (ring->slots = (void**)calloc(capacity, sizeof(void*))) == NULL  )
+      return -1;
+    ring->mask = capacity - 1;
+    atomic_init(&ring->head, 0ul);
+    atomic_init(&ring->tail, 0ul);
+    atomic_init(&ring->highWater, 0ul);
+  return 0;
+}
+
+/* Frees the memory allocated by spscRingInit().
+ *
+ * @param ring the ring to free
+ */
+void spscRingFree(spscRing_t *ring){
+  free(ring->slots);
+  ring->slots = NULL;
+}
+
+/* Appends 'item' to the ring. Must be called only by the producer thread.
+ *
+ * @param ring the ring to write to
+ * @param item the pointer to append
+ * @return 1 if 'item' was appended, 0 if the ring is full
+ */
+int spscRingPush(spscRing_t *ring, void *item){
+  unsigned long head, tail, occupancy;
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail > ring->mask)
+      return 0;                                   // full
+    ring->slots[head & ring->mask] = item;
+    // publish the slot: the consumer reads 'head' with acquire semantic
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    occupancy = head + 1 - tail;
+    if (occupancy > atomic_load_explicit(&ring->highWater, memory_order_relaxed))
+      atomic_store_explicit(&ring->highWater, occupancy, memory_order_relaxed);
+  return 1;
+}
+
+/* Removes the oldest pointer of the ring. Must be called only by the
+ * consumer thread.
+ *
+ * @param ring the ring to read from
+ * @return the oldest pointer of the ring or NULL if the ring is empty
+ */
+void *spscRingPop(spscRing_t *ring){
+  unsigned long head, tail;
+  void *item;
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail)
+      return NULL;                                // empty
+    item = ring->slots[tail & ring->mask];
+    // release the slot: the producer reads 'tail' with acquire semantic
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+  return item;
+}
+
+/* Returns the number of pointers currently stored in the ring. The value
+ * is a snapshot: it can be called by any thread.
+ *
+ * @param ring the ring to inspect
+ * @return the current occupancy of the ring
+ */
+unsigned long spscRingOccupancy(spscRing_t *ring){
+  unsigned long tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  unsigned long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  return head - tail;
+}
+
+/* Returns the max occupancy reached by the ring since spscRingInit().
+ *
+ * @param ring the ring to inspect
+ * @return the high-water mark of the ring
+ */
+unsigned long spscRingHighWater(spscRing_t *ring){
+  return atomic_load_explicit(&ring->highWater, memory_order_relaxed);
+}
+
+/* Returns the capacity of the ring.
+ *
+ * @param ring the ring to inspect
+ * @return the max number of pointers the ring can hold
+ */
+unsigned long spscRingCapacity(spscRing_t *ring){
+  return ring->mask + 1;
+}
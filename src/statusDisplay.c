@@ -0,0 +1,197 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'statusDisplay' shows the state of the acquisition once per
+ * second from a low priority thread (see statusDisplay.h).
+ *
+ * 'statusDisplay' module version: a0.3
+ */
+
+#define _GNU_SOURCE     /* SCHED_IDLE */
+#include "statusDisplay.h"
+#include "runFile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+
+/* pause between two checks of the stop request (microseconds) */
+#define STATUS_DISPLAY_POLL_US 50000
+/* ANSI escape sequences */
+#define ESC_HOME "\033[H"
+#define ESC_CLEAR_SCREEN "\033[2J"
+#define ESC_CLEAR_EOL "\033[K"
+#define ESC_CLEAR_EOS "\033[J"
+
+static void *displayThreadMain(void *arg);
+static void formatFrame(statusDisplay_t *s, FILE *fp, uint64_t now);
+static void writeFrame(statusDisplay_t *s, const char *frame, size_t size);
+
+
+/* Starts the display thread. The pipeline must be started.
+ *
+ * @param s the display
+ * @param p the running pipeline
+ * @param fileName the name of the output file
+ * @param linkNum the link number of each board
+ * @param startTime the start of the acquisition (get_time(), ms)
+ * @return 0 on success, -1 if the thread can't be created (a description
+ * is printed)
+ */
+int startStatusDisplay(statusDisplay_t *s, acqPipeline_t *p, const char *fileName, const int *linkNum, uint64_t startTime){
+    memset(s, 0, sizeof(statusDisplay_t));
+    s->pipeline = p;
+    s->fileName = fileName;
+    s->linkNum = linkNum;
+    s->startTime = s->prevTime = startTime;
+    s->tty = isatty(STDOUT_FILENO);
+    atomic_init(&s->showLatency, 0);
+    atomic_init(&s->stop, 0);
+    if( pthread_create(&s->thread, NULL, displayThreadMain, s) ){
+      perror("statusDisplay - can't create the display thread");
+      return -1;
+    }
+    s->started = 1;
+  return 0;
+}
+
+/* Stops the display thread and waits until it exits.
+ *
+ * @param s the display
+ */
+void stopStatusDisplay(statusDisplay_t *s){
+    if (s->started){
+      atomic_store(&s->stop, 1);
+      pthread_join(s->thread, NULL);
+      s->started = 0;
+    }
+}
+
+/* Shows the latency of the pipeline steps from the next frame on, or hides
+ * it if it is shown. Can be called by any thread.
+ *
+ * @param s the display
+ */
+void toggleStatusDisplayLatency(statusDisplay_t *s){
+    atomic_fetch_xor(&s->showLatency, 1);
+}
+
+/* Display thread: renders a frame every STATUS_DISPLAY_PERIOD_MS.
+ */
+static void *displayThreadMain(void *arg){
+  statusDisplay_t *s = (statusDisplay_t*)arg;
+  FILE *fp;
+  char *frame;
+  size_t size;
+  uint64_t now;
+#ifdef SCHED_IDLE
+  struct sched_param param;
+    // the display must never take the CPU from the acquisition threads
+    memset(&param, 0, sizeof(param));
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+    if (s->tty){
+      fputs(ESC_HOME ESC_CLEAR_SCREEN, stdout);
+      fflush(stdout);
+    }
+    while( !atomic_load(&s->stop) ){
+      now = (uint64_t)get_time();
+      if (now - s->prevTime < STATUS_DISPLAY_PERIOD_MS){
+        usleep(STATUS_DISPLAY_POLL_US);
+        continue;
+      }
+      frame = NULL;
+      size = 0;
+      if(  (fp = open_memstream(&frame, &size)) == NULL  ){
+        perror("statusDisplay - can't format the display");
+        break;
+      }
+      formatFrame(s, fp, now);
+      fclose(fp);
+      writeFrame(s, frame, size);
+      free(frame);
+      s->prevTime = now;
+    }
+  return NULL;
+}
+
+/* Formats a frame: the rates are computed from the counters at the
+ * previous frame.
+ */
+static void formatFrame(statusDisplay_t *s, FILE *fp, uint64_t now){
+  acqPipeline_t *p = s->pipeline;
+  uint64_t elapsed = now - s->prevTime;     /* milliseconds */
+  unsigned long seconds = (unsigned long)((now - s->startTime) / 1000);
+  unsigned long bytes, events, coinc[TDCR_NUM_COUNTS];
+  int b, ch, i;
+    bytes = acqPipelineReadoutBytes(p);
+    fprintf(fp, "Data readout file: %s\nElapsed time: %luh %lumin %lus\n\nReadout Rate=%.2f MB/s\n", s->fileName,
+                seconds / 3600, (seconds / 60) % 60, seconds % 60, (float)(bytes - s->prevBytes) / ((float)elapsed * 1048.576f));
+    s->prevBytes = bytes;
+    for (b = 0; b < p->numBoards; b++){
+      fprintf(fp, "\nBoard %d:\n", s->linkNum[b]);
+      for (ch = 0; ch < MaxNChannels; ch++){
+        events = atomic_load_explicit(&p->recordedEvents[b][ch], memory_order_relaxed);
+        if (events > s->prevEvents[b][ch])
+          fprintf(fp, "\tCh %d:\tTrgRate=%.2f KHz\tTotal events: %lu", RUN_FILE_TEXT_CHANNEL(b, ch),
+                      (float)(events - s->prevEvents[b][ch]) / (float)elapsed, events);
+        else
+          fprintf(fp, "\tCh %d:\tNo Data", RUN_FILE_TEXT_CHANNEL(b, ch));
+        if (p->extras == PSD_EXTRAS_TRIGGERS)
+          fprintf(fp, "\tLost in the board: %lu", atomic_load_explicit(&p->boardLostTriggers[b][ch], memory_order_relaxed));
+        fputc('\n', fp);
+        s->prevEvents[b][ch] = events;
+      }
+    }
+    if (p->coincidence){
+      fprintf(fp, "\nCoincidences (resolving time %lu ns):\n", p->coinc.windowNs);
+      for (i = 0; i < TDCR_NUM_COUNTS; i++){
+        coinc[i] = atomic_load_explicit(&p->coincCounts[i], memory_order_relaxed);
+        fprintf(fp, "\t%s:\tRate=%.2f cps\tTotal: %lu\n", tdcrCoincNames[i], (float)(coinc[i] - s->prevCoinc[i]) * 1000.0f / (float)elapsed, coinc[i]);
+        s->prevCoinc[i] = coinc[i];
+      }
+      fprintf(fp, "\tTDCR (T/D): %.4f\n", (coinc[TDCR_D] > 0) ? (float)coinc[TDCR_T] / (float)coinc[TDCR_D] : 0.0f);
+    }
+    fputc('\n', fp);
+    printAcqPipelineStats(p, fp);
+    if (atomic_load(&s->showLatency)){
+      fputs("\nLatency of the pipeline steps ('l' to hide):\n", fp);
+      printAcqPipelineLatency(p, fp);
+    }
+    else
+      fputs("\nPress 'l' to show the latency of the pipeline steps\n", fp);
+}
+
+/* Writes a frame to stdout: on a terminal it overwrites the previous frame
+ * (each line is cleared up to its end and the screen below the frame is
+ * cleared), otherwise it is appended.
+ */
+static void writeFrame(statusDisplay_t *s, const char *frame, size_t size){
+  const char *line, *end, *last = frame + size;
+  char *out, *o;
+    if (!s->tty){
+      fwrite(frame, 1, size, stdout);
+      fputs("\n\n", stdout);
+      fflush(stdout);
+      return;
+    }
+    // worst case: every char is a '\n' preceded by ESC_CLEAR_EOL
+    if(  (out = (char*)malloc(size * (sizeof(ESC_CLEAR_EOL) + 1) + sizeof(ESC_HOME ESC_CLEAR_EOS))) == NULL  )
+      return;
+    o = out;
+    memcpy(o, ESC_HOME, sizeof(ESC_HOME) - 1);
+    o += sizeof(ESC_HOME) - 1;
+    for (line = frame; line < last; line = end + 1){
+      if(  (end = (const char*)memchr(line, '\n', last - line)) == NULL  )
+        end = last;
+      memcpy(o, line, end - line);
+      o += end - line;
+      memcpy(o, ESC_CLEAR_EOL "\n", sizeof(ESC_CLEAR_EOL));
+      o += sizeof(ESC_CLEAR_EOL);
+    }
+    memcpy(o, ESC_CLEAR_EOS, sizeof(ESC_CLEAR_EOS) - 1);
+    o += sizeof(ESC_CLEAR_EOS) - 1;
+    fwrite(out, 1, o - out, stdout);
+    fflush(stdout);
+    free(out);
+}
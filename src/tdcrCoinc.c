@@ -0,0 +1,106 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'tdcrCoinc' counts online the coincidences of the three PMTs of
+ * the TDCR counter (see tdcrCoinc.h).
+ *
+ * 'tdcrCoinc' module version: a0.2
+ */
+
+#include "tdcrCoinc.h"
+#include <string.h>
+
+/* bits of tdcrCoinc_t.fired */
+#define PMT_A 1u
+#define PMT_B 2u
+#define PMT_C 4u
+
+const char *tdcrCoincNames[TDCR_NUM_COUNTS] = { "AB", "BC", "AC", "D", "T" };
+
+static void closeWindow(tdcrCoinc_t *c);
+
+
+/* Initializes the counters.
+ *
+ * @param c the coincidence counters
+ * @param windowNs the resolving time (ns)
+ */
+void initTdcrCoinc(tdcrCoinc_t *c, unsigned long windowNs){
+    memset(c, 0, sizeof(tdcrCoinc_t));
+    c->windowNs = windowNs;
+    c->window = (int64_t)windowNs * PSD_EVENT_FINE_UNITS / PSD_TIMETAG_NS;
+    c->pmtBit[TDCR_CH_A] = PMT_A;
+    c->pmtBit[TDCR_CH_B] = PMT_B;
+    c->pmtBit[TDCR_CH_C] = PMT_C;
+}
+
+/* Counts the open window according to the PMTs fired in it.
+ */
+static void closeWindow(tdcrCoinc_t *c){
+  unsigned f = c->fired;
+    c->counts[TDCR_AB] += ((f & (PMT_A | PMT_B)) == (PMT_A | PMT_B));
+    c->counts[TDCR_BC] += ((f & (PMT_B | PMT_C)) == (PMT_B | PMT_C));
+    c->counts[TDCR_AC] += ((f & (PMT_A | PMT_C)) == (PMT_A | PMT_C));
+    // at least two bits set
+    c->counts[TDCR_D] += ((f & (f - 1)) != 0);
+    c->counts[TDCR_T] += (f == (PMT_A | PMT_B | PMT_C));
+    c->open = 0;
+}
+
+/* Counts the coincidences of time ordered records. The records of the
+ * channels that are not a PMT are skipped.
+ *
+ * @param c the coincidence counters
+ * @param ev the records, in time order
+ * @param count the number of records
+ */
+void tdcrCoincPush(tdcrCoinc_t *c, const psdEvent_t *ev, uint32_t count){
+  unsigned bit;
+  uint32_t n;
+  int64_t t;
+    for (n = 0; n < count; n++, ev++){
+      if(  (ev->board != TDCR_BOARD) || (ev->channel >= PSD_MAX_CHANNELS) || ((bit = c->pmtBit[ev->channel]) == 0)  )
+        continue;
+      if (ev->flags & PSD_EVENT_FLAG_LATE){
+        c->late++;
+        continue;
+      }
+      t = PSD_EVENT_FINE_TIME(ev);
+      if(  c->open && (t - c->start <= c->window)  ){
+        c->fired |= bit;
+        continue;
+      }
+      if (c->open)
+        closeWindow(c);
+      c->open = 1;
+      c->start = t;
+      c->fired = bit;
+    }
+}
+
+/* Closes the window still open at the end of the run.
+ *
+ * @param c the coincidence counters
+ */
+void tdcrCoincFlush(tdcrCoinc_t *c){
+    if (c->open)
+      closeWindow(c);
+}
+
+/* Writes the coincidence counts and rates to a run summary.
+ *
+ * @param fp the summary file
+ * @param counts the counters (TDCR_NUM_COUNTS)
+ * @param windowNs the resolving time (ns)
+ * @param seconds the duration of the acquisition (s)
+ * @return 0 on success, otherwise a non-zero integer
+ */
+int printTdcrCoincSummary(FILE *fp, const uint64_t *counts, unsigned long windowNs, double seconds){
+  register int i;
+    fprintf(fp, "# Coincidences (A: ch %d, B: ch %d, C: ch %d of board %d)\n", TDCR_CH_A, TDCR_CH_B, TDCR_CH_C, TDCR_BOARD);
+    fprintf(fp, "Resolving time (ns): %lu\n", windowNs);
+    fprintf(fp, "#  counts            rate (s^-1)\n");
+    for (i = 0; i < TDCR_NUM_COUNTS; i++)
+      fprintf(fp, "%-3s %15lu %15.3f\n", tdcrCoincNames[i], (unsigned long)counts[i], (seconds > 0.0) ? (double)counts[i] / seconds : 0.0);
+    fprintf(fp, "TDCR (T/D): %.6f\n", (counts[TDCR_D] > 0) ? (double)counts[TDCR_T] / (double)counts[TDCR_D] : 0.0);
+  return ferror(fp);
+}
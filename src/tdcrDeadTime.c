@@ -0,0 +1,146 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'tdcrDeadTime' imposes a dead time on the records of the PMTs of
+ * the TDCR counter before their coincidences are counted (see
+ * tdcrDeadTime.h).
+ *
+ * 'tdcrDeadTime' module version: a0.2
+ */
+
+#include "tdcrDeadTime.h"
+#include <string.h>
+
+const char *tdcrDeadStageNames[TDCR_DEAD_STAGES] = { "A", "B", "C", "common" };
+
+static inline int64_t nsToTime(unsigned long ns);
+static inline int deadTimeReject(tdcrDeadStage_t *s, int64_t t, int64_t window, int extendable);
+
+
+/* Initializes the dead time stages.
+ *
+ * @return 0 on success, -1 if the common dead time is shorter than the
+ * resolving time (a description is printed to stderr)
+ */
+int initTdcrDeadTime(tdcrDeadTime_t *d, int mode, const unsigned long *pmtNs, unsigned long commonNs, unsigned long windowNs){
+  register int i;
+    if(  (commonNs > 0) && (commonNs < windowNs)  ){
+      fprintf(stderr, "tdcrDeadTime - the common dead time (%lu ns) is shorter than the resolving time (%lu ns)\n", commonNs, windowNs);
+      return -1;
+    }
+    memset(d, 0, sizeof(tdcrDeadTime_t));
+    d->mode = mode;
+    d->window = nsToTime(windowNs);
+    d->stage[TDCR_CH_A] = 1 + TDCR_DEAD_A;
+    d->stage[TDCR_CH_B] = 1 + TDCR_DEAD_B;
+    d->stage[TDCR_CH_C] = 1 + TDCR_DEAD_C;
+    for (i = TDCR_DEAD_A; i <= TDCR_DEAD_C; i++){
+      d->stages[i].lengthNs = pmtNs[i];
+      d->stages[i].length = nsToTime(pmtNs[i]);
+    }
+    d->stages[TDCR_DEAD_COMMON].lengthNs = commonNs;
+    d->stages[TDCR_DEAD_COMMON].length = nsToTime(commonNs);
+  return 0;
+}
+
+/* @return 'ns' in 1/PSD_EVENT_FINE_UNITS of a time tag unit
+ */
+static inline int64_t nsToTime(unsigned long ns){
+  return (int64_t)ns * PSD_EVENT_FINE_UNITS / PSD_TIMETAG_NS;
+}
+
+/* Passes a record at the time 't' through the stage 's': the record is
+ * rejected if the stage is dead, unless it comes no later than 'window'
+ * after the start of the dead time (-1 for the PMT stages: only a record
+ * before the start, out of the order of the fine times). A record that is
+ * not rejected outside of the dead time starts the next one.
+ *
+ * @return a non-zero integer if the record is rejected
+ */
+static inline int deadTimeReject(tdcrDeadStage_t *s, int64_t t, int64_t window, int extendable){
+    s->input++;
+    if (!s->started){
+      s->started = 1;
+      s->first = s->last = s->start = s->end = t;
+    }
+    if (t > s->last)
+      s->last = t;
+    if (t < s->end){
+      if(  extendable && (t + s->length > s->end)  )
+        s->end = t + s->length;
+      if (t - s->start <= window)
+        return 0;
+      s->rejected++;
+      return 1;
+    }
+    s->dead += s->end - s->start;
+    s->start = t;
+    s->end = t + s->length;
+  return 0;
+}
+
+/* Applies the dead times to time ordered records.
+ *
+ * @param d the dead time stages
+ * @param ev the records, in time order
+ * @param count the number of records
+ * @param out the records of the PMTs that pass (room for 'count' records)
+ * @return the number of records in 'out'
+ */
+uint32_t tdcrDeadTimeFilter(tdcrDeadTime_t *d, const psdEvent_t *ev, uint32_t count, psdEvent_t *out){
+  tdcrDeadStage_t *pmt, *common = &d->stages[TDCR_DEAD_COMMON];
+  int extendable = (d->mode == TDCR_DEAD_EXTENDABLE);
+  unsigned stage;
+  uint32_t n, passed = 0;
+  int64_t t;
+    for (n = 0; n < count; n++, ev++){
+      if(  (ev->board != TDCR_BOARD) || (ev->channel >= PSD_MAX_CHANNELS) || ((stage = d->stage[ev->channel]) == 0)  )
+        continue;
+      if (!(ev->flags & PSD_EVENT_FLAG_LATE)){
+        t = PSD_EVENT_FINE_TIME(ev);
+        pmt = &d->stages[stage - 1];
+        if(  (pmt->length > 0) && deadTimeReject(pmt, t, -1, extendable)  )
+          continue;
+        if(  (common->length > 0) && deadTimeReject(common, t, d->window, extendable)  )
+          continue;
+      }
+      out[passed++] = *ev;
+    }
+  return passed;
+}
+
+/* @return the real time of the stage (ns)
+ */
+double tdcrDeadRealNs(const tdcrDeadStage_t *s){
+  return (double)(s->last - s->first) * PSD_TIMETAG_NS / PSD_EVENT_FINE_UNITS;
+}
+
+/* @return the live time of the stage (ns)
+ */
+double tdcrDeadLiveNs(const tdcrDeadStage_t *s){
+  int64_t dead = s->dead + (((s->end < s->last) ? s->end : s->last) - s->start);
+  return (double)(s->last - s->first - dead) * PSD_TIMETAG_NS / PSD_EVENT_FINE_UNITS;
+}
+
+/* Writes the records, the real time and the live time of each stage to a
+ * run summary.
+ *
+ * @param fp the summary file
+ * @param d the dead time stages
+ * @return 0 on success, otherwise a non-zero integer
+ */
+int printTdcrDeadTimeSummary(FILE *fp, const tdcrDeadTime_t *d){
+  const tdcrDeadStage_t *s;
+  double real;
+  register int i;
+    fprintf(fp, "# Dead time (%s), before the coincidences\n", (d->mode == TDCR_DEAD_EXTENDABLE) ? "extendable" : "non-extendable");
+    fprintf(fp, "#  stage   length (ns)          records         rejected   real time (s)   live time (s)  live (%%)\n");
+    for (i = 0; i < TDCR_DEAD_STAGES; i++){
+      s = &d->stages[i];
+      if (s->length == 0)
+        continue;
+      real = tdcrDeadRealNs(s);
+      fprintf(fp, "%-8s %13lu %16lu %16lu %15.6f %15.6f %9.3f\n", tdcrDeadStageNames[i], s->lengthNs, (unsigned long)s->input,
+                  (unsigned long)s->rejected, real / 1e9, tdcrDeadLiveNs(s) / 1e9, (real > 0.0) ? 100.0 * tdcrDeadLiveNs(s) / real : 0.0);
+    }
+  return ferror(fp);
+}
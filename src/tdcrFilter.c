@@ -0,0 +1,177 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'tdcrFilter' writes only the records of the TDCR coincidences
+ * and a prescaled sample of the singles (see tdcrFilter.h).
+ *
+ * 'tdcrFilter' module version: a0.1
+ */
+
+#include "tdcrFilter.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* initial number of records allocated for the open window and the output */
+#define TDCR_FILTER_INITIAL_CAPACITY 1024
+
+static int reserveRecords(psdEvent_t **records, uint32_t *capacity, uint32_t count);
+static void closeWindow(tdcrFilter_t *f);
+
+
+/* Initializes the filter.
+ *
+ * @return 0 on success, -1 if the memory can't be allocated
+ */
+int initTdcrFilter(tdcrFilter_t *f, unsigned long windowNs, unsigned long prescale){
+    memset(f, 0, sizeof(tdcrFilter_t));
+    f->window = (int64_t)windowNs * PSD_EVENT_FINE_UNITS / PSD_TIMETAG_NS;
+    f->prescale = (uint32_t)prescale;
+    f->pmtBit[TDCR_CH_A] = 1;
+    f->pmtBit[TDCR_CH_B] = 2;
+    f->pmtBit[TDCR_CH_C] = 4;
+    if(  reserveRecords(&f->pending, &f->pendingCapacity, TDCR_FILTER_INITIAL_CAPACITY)
+         || reserveRecords(&f->out, &f->outCapacity, TDCR_FILTER_INITIAL_CAPACITY)  ){
+      freeTdcrFilter(f);
+      return -1;
+    }
+  return 0;
+}
+
+/* Frees the memory allocated by the filter.
+ */
+void freeTdcrFilter(tdcrFilter_t *f){
+    free(f->pending);
+    free(f->out);
+    f->pending = f->out = NULL;
+    f->pendingCapacity = f->outCapacity = f->numPending = f->numOut = 0;
+}
+
+/* Makes room in 'records' for 'count' records (the records already there are
+ * kept).
+ *
+ * @return 0 on success, -1 if the memory can't be allocated
+ */
+static int reserveRecords(psdEvent_t **records, uint32_t *capacity, uint32_t count){
+  uint32_t newCapacity;
+  psdEvent_t *newRecords;
+    if (count <= *capacity)
+      return 0;
+    newCapacity = *capacity ? *capacity : TDCR_FILTER_INITIAL_CAPACITY;
+    while (newCapacity < count)
+      newCapacity *= 2;
+    if(  (newRecords = (psdEvent_t*)realloc(*records, newCapacity * sizeof(psdEvent_t))) == NULL  ){
+      fputs("tdcrFilter - error trying allocating memory for the records\n", stderr);
+      return -1;
+    }
+    *records = newRecords;
+    *capacity = newCapacity;
+  return 0;
+}
+
+/* Moves the records of the open window to 'out': all of them if at least two
+ * PMTs fired in it, otherwise only the records that are not filtered and one
+ * single out of 'prescale'. The room must already be reserved.
+ */
+static void closeWindow(tdcrFilter_t *f){
+  psdEvent_t *ev = f->pending, *end = f->pending + f->numPending;
+  int coincident = ((f->fired & (f->fired - 1)) != 0);
+    for (; ev < end; ev++){
+      if(  (ev->board != TDCR_BOARD) || (ev->channel >= PSD_MAX_CHANNELS) || (f->pmtBit[ev->channel] == 0)  ){
+        f->out[f->numOut++] = *ev;
+        continue;
+      }
+      if (ev->flags & PSD_EVENT_FLAG_LATE){
+        f->late[ev->channel]++;
+        f->out[f->numOut++] = *ev;
+      }
+      else if (coincident){
+        f->coincident[ev->channel]++;
+        f->out[f->numOut++] = *ev;
+      }
+      else if(  (f->prescale > 0) && (f->nextSingle-- == 0)  ){
+        f->nextSingle = f->prescale - 1;
+        f->prescaled[ev->channel]++;
+        f->out[f->numOut] = *ev;
+        f->out[f->numOut++].flags |= PSD_EVENT_FLAG_PRESCALED;
+      }
+      else
+        f->suppressed[ev->channel]++;
+    }
+    f->numPending = 0;
+    f->open = 0;
+}
+
+/* Filters time ordered records.
+ *
+ * @return 0 on success, -1 if the memory can't be allocated
+ */
+int tdcrFilterPush(tdcrFilter_t *f, const psdEvent_t *ev, uint32_t count){
+  unsigned bit;
+  uint32_t n;
+  int64_t t;
+    f->numOut = 0;
+    // at worst every record, and those held, is written
+    if(  reserveRecords(&f->out, &f->outCapacity, f->numPending + count) || reserveRecords(&f->pending, &f->pendingCapacity, f->numPending + count)  )
+      return -1;
+    for (n = 0; n < count; n++, ev++){
+      bit = (  (ev->board == TDCR_BOARD) && (ev->channel < PSD_MAX_CHANNELS)  ) ? f->pmtBit[ev->channel] : 0;
+      if(  (bit == 0) || (ev->flags & PSD_EVENT_FLAG_LATE)  ){
+        // not filtered: it waits for the open window to keep the time order
+        if (f->open)
+          f->pending[f->numPending++] = *ev;
+        else{
+          if (bit)
+            f->late[ev->channel]++;
+          f->out[f->numOut++] = *ev;
+        }
+        continue;
+      }
+      t = PSD_EVENT_FINE_TIME(ev);
+      if(  !f->open || (t - f->start > f->window)  ){
+        if (f->open)
+          closeWindow(f);
+        f->open = 1;
+        f->start = t;
+        f->fired = 0;
+      }
+      f->fired |= bit;
+      f->pending[f->numPending++] = *ev;
+    }
+  return 0;
+}
+
+/* Closes the window still open at the end of the run.
+ *
+ * @return 0 on success, -1 if the memory can't be allocated
+ */
+int tdcrFilterFlush(tdcrFilter_t *f){
+    f->numOut = 0;
+    if (reserveRecords(&f->out, &f->outCapacity, f->numPending))
+      return -1;
+    // the records are held only while a window is open
+    if (f->open)
+      closeWindow(f);
+  return 0;
+}
+
+/* Writes the records written and dropped by the filter for each PMT to a
+ * run summary.
+ *
+ * @return 0 on success, otherwise a non-zero integer
+ */
+int printTdcrFilterSummary(FILE *fp, const tdcrFilter_t *f){
+  static const int channels[3] = { TDCR_CH_A, TDCR_CH_B, TDCR_CH_C };
+  static const char *names[3] = { "A", "B", "C" };
+  register int i;
+  int ch;
+    if (f->prescale > 0)
+      fprintf(fp, "# Coincidence filter: the records of the coincidences and 1 single out of %lu are written\n", (unsigned long)f->prescale);
+    else
+      fprintf(fp, "# Coincidence filter: only the records of the coincidences are written\n");
+    fprintf(fp, "#  PMT   ch   in coincidence   singles written   singles dropped   late (not filtered)\n");
+    for (i = 0; i < 3; i++){
+      ch = channels[i];
+      fprintf(fp, "%5s %4d %16lu %17lu %17lu %21lu\n", names[i], ch, (unsigned long)f->coincident[ch],
+                  (unsigned long)f->prescaled[ch], (unsigned long)f->suppressed[ch], (unsigned long)f->late[ch]);
+    }
+  return ferror(fp);
+}
@@ -0,0 +1,219 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'tdcrScan' counts the TDCR coincidences for a list of resolving
+ * times in a single pass (see tdcrScan.h).
+ *
+ * 'tdcrScan' module version: a0.1
+ */
+
+#include "tdcrScan.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+static inline void closeAll(tdcrScan_t *s, int64_t t, unsigned bit);
+static void pushSplit(tdcrScan_t *s, int64_t t, unsigned bit);
+
+
+/* Parses a list of resolving times separated by ','.
+ *
+ * @return 0 on success, -1 if the list is not valid
+ */
+int parseTdcrScanWindows(const char *list, unsigned long *windowsNs, uint32_t *numWindows){
+  uint32_t n = 0;
+  unsigned long ns;
+  char *endPtr;
+    while (isspace((unsigned char)*list))
+      list++;
+    while (*list != '\0'){
+      if(  (n == TDCR_SCAN_MAX_WINDOWS) || !isdigit((unsigned char)*list)  )
+        return -1;
+      errno = 0;
+      ns = strtoul(list, &endPtr, 10);
+      if(  (errno == ERANGE) || (ns < 1) || (ns > TDCR_SCAN_MAX_WINDOW_NS)  )
+        return -1;
+      windowsNs[n++] = ns;
+      for (list = endPtr; isspace((unsigned char)*list); list++);
+      if (*list == ','){
+        for (list++; isspace((unsigned char)*list); list++);
+        if (*list == '\0')
+          return -1;
+      }
+      else if (*list != '\0')
+        return -1;
+    }
+    *numWindows = n;
+  return 0;
+}
+
+/* Initializes the scan.
+ *
+ * @return 0 on success, -1 if a parameter is out of range (a description is
+ * printed to stderr)
+ */
+int initTdcrScan(tdcrScan_t *s, const unsigned long *windowsNs, uint32_t numWindows){
+  uint32_t k, j;
+  unsigned long ns;
+    if(  (numWindows < 1) || (numWindows > TDCR_SCAN_MAX_WINDOWS)  ){
+      fprintf(stderr, "tdcrScan - invalid number of resolving times (%u, 1 to %d)\n", numWindows, TDCR_SCAN_MAX_WINDOWS);
+      return -1;
+    }
+    memset(s, 0, sizeof(tdcrScan_t));
+    // insertion sort: the windows are nested from the shortest one
+    for (k = 0; k < numWindows; k++){
+      ns = windowsNs[k];
+      if(  (ns < 1) || (ns > TDCR_SCAN_MAX_WINDOW_NS)  ){
+        fprintf(stderr, "tdcrScan - invalid resolving time (%lu ns, 1 to %lu)\n", ns, TDCR_SCAN_MAX_WINDOW_NS);
+        return -1;
+      }
+      for (j = k; (j > 0) && (s->windowNs[j - 1] > ns); j--)
+        s->windowNs[j] = s->windowNs[j - 1];
+      s->windowNs[j] = ns;
+    }
+    s->numWindows = numWindows;
+    for (k = 0; k < numWindows; k++)
+      s->window[k] = (int64_t)s->windowNs[k] * PSD_EVENT_FINE_UNITS / PSD_TIMETAG_NS;
+    s->pmtBit[TDCR_CH_A] = 1;
+    s->pmtBit[TDCR_CH_B] = 2;
+    s->pmtBit[TDCR_CH_C] = 4;
+  return 0;
+}
+
+/* Closes all the windows (synced or not) and opens them again, synced, with
+ * the pulse of the PMT 'bit' at the time 't'.
+ */
+static inline void closeAll(tdcrScan_t *s, int64_t t, unsigned bit){
+  uint32_t k;
+    if (s->synced)
+      s->syncedClosed[s->fired]++;
+    else{
+      for (k = 0; k < s->numWindows; k++)
+        s->closed[k][s->fireds[k]]++;
+    }
+    s->synced = 1;
+    s->start = t;
+    s->fired = bit;
+}
+
+/* Passes the pulse of the PMT 'bit' at the time 't' to each window: it joins
+ * the windows it comes within, it closes the other ones and opens them again.
+ * The scan is not synced.
+ */
+static void pushSplit(tdcrScan_t *s, int64_t t, unsigned bit){
+  uint32_t k;
+  int64_t end = INT64_MIN;
+    for (k = 0; k < s->numWindows; k++){
+      if (t - s->starts[k] <= s->window[k])
+        s->fireds[k] |= bit;
+      else{
+        s->closed[k][s->fireds[k]]++;
+        s->starts[k] = t;
+        s->fireds[k] = (uint8_t)bit;
+      }
+      if (s->starts[k] + s->window[k] > end)
+        end = s->starts[k] + s->window[k];
+    }
+    s->end = end;
+}
+
+/* Counts the coincidences of time ordered records for each resolving time.
+ *
+ * @param s the scan
+ * @param ev the records, in time order
+ * @param count the number of records
+ */
+void tdcrScanPush(tdcrScan_t *s, const psdEvent_t *ev, uint32_t count){
+  unsigned bit;
+  uint32_t n, k;
+  int64_t t, d;
+    for (n = 0; n < count; n++, ev++){
+      if(  (ev->board != TDCR_BOARD) || (ev->channel >= PSD_MAX_CHANNELS) || ((bit = s->pmtBit[ev->channel]) == 0)  )
+        continue;
+      if (ev->flags & PSD_EVENT_FLAG_LATE){
+        s->late++;
+        continue;
+      }
+      t = PSD_EVENT_FINE_TIME(ev);
+      if (!s->open){
+        s->open = s->synced = 1;
+        s->start = t;
+        s->fired = bit;
+        continue;
+      }
+      if (s->synced){
+        d = t - s->start;
+        if (d <= s->window[0])
+          s->fired |= bit;
+        else if (d > s->window[s->numWindows - 1])
+          closeAll(s, t, bit);
+        else{
+          // closes the shortest windows only: each window goes its own way
+          for (k = 0; k < s->numWindows; k++){
+            s->starts[k] = s->start;
+            s->fireds[k] = (uint8_t)s->fired;
+          }
+          s->synced = 0;
+          pushSplit(s, t, bit);
+        }
+      }
+      else if (t > s->end)
+        closeAll(s, t, bit);
+      else
+        pushSplit(s, t, bit);
+    }
+}
+
+/* Closes the windows still open at the end of the run.
+ *
+ * @param s the scan
+ */
+void tdcrScanFlush(tdcrScan_t *s){
+    if (s->open)
+      closeAll(s, 0, 0);
+    s->open = 0;
+}
+
+/* Computes the coincidence counts of a resolving time.
+ *
+ * @param s the scan
+ * @param k the index of the resolving time (in 'windowNs')
+ * @param counts the counters (TDCR_NUM_COUNTS, TDCR_AB ... TDCR_T)
+ */
+void tdcrScanCounts(const tdcrScan_t *s, uint32_t k, uint64_t *counts){
+  unsigned f;
+  uint64_t c;
+    memset(counts, 0, TDCR_NUM_COUNTS * sizeof(uint64_t));
+    for (f = 0; f < TDCR_SCAN_PATTERNS; f++){
+      c = s->syncedClosed[f] + s->closed[k][f];
+      counts[TDCR_AB] += ((f & 3) == 3) ? c : 0;
+      counts[TDCR_BC] += ((f & 6) == 6) ? c : 0;
+      counts[TDCR_AC] += ((f & 5) == 5) ? c : 0;
+      // at least two bits set
+      counts[TDCR_D] += ((f & (f - 1)) != 0) ? c : 0;
+      counts[TDCR_T] += (f == 7) ? c : 0;
+    }
+}
+
+/* Writes the coincidence counts and rates of each resolving time to a run
+ * summary.
+ *
+ * @param fp the summary file
+ * @param s the scan
+ * @param seconds the duration of the acquisition (s)
+ * @return 0 on success, otherwise a non-zero integer
+ */
+int printTdcrScanSummary(FILE *fp, const tdcrScan_t *s, double seconds){
+  uint64_t counts[TDCR_NUM_COUNTS];
+  uint32_t k;
+    fprintf(fp, "# Coincidence scan (A: ch %d, B: ch %d, C: ch %d of board %d)\n", TDCR_CH_A, TDCR_CH_B, TDCR_CH_C, TDCR_BOARD);
+    fprintf(fp, "#  window (ns)           AB           BC           AC            D            T     D (s^-1)     T (s^-1)   TDCR (T/D)\n");
+    for (k = 0; k < s->numWindows; k++){
+      tdcrScanCounts(s, k, counts);
+      fprintf(fp, "%13lu %12lu %12lu %12lu %12lu %12lu %12.3f %12.3f %12.6f\n", s->windowNs[k], (unsigned long)counts[TDCR_AB],
+                  (unsigned long)counts[TDCR_BC], (unsigned long)counts[TDCR_AC], (unsigned long)counts[TDCR_D], (unsigned long)counts[TDCR_T],
+                  (seconds > 0.0) ? (double)counts[TDCR_D] / seconds : 0.0, (seconds > 0.0) ? (double)counts[TDCR_T] / seconds : 0.0,
+                  (counts[TDCR_D] > 0) ? (double)counts[TDCR_T] / (double)counts[TDCR_D] : 0.0);
+    }
+  return ferror(fp);
+}
@@ -0,0 +1,212 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * The module 'timeMerge' puts back in time order the records of several
+ * streams (see timeMerge.h).
+ *
+ * 'timeMerge' module version: a0.2
+ */
+
+#include "timeMerge.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* records allocated for a stream at its first push */
+#define TIME_MERGE_INITIAL_CAPACITY 4096
+
+/* timestamp of the first pending record of the stream 's' */
+#define HEAD_TIMESTAMP(m, s) ((m)->streams[s].events[(m)->streams[s].first].timestamp)
+
+static int growStream(timeMergeStream_t *s, uint32_t needed);
+static void heapSiftUp(timeMerge_t *m, int i);
+static void heapSiftDown(timeMerge_t *m, int i);
+
+
+/* Initializes an empty merge.
+ *
+ * @param m the merge to initialize
+ * @param streamMask the enabled streams: bit s set for the stream s
+ * @param window the reorder window (time tag units)
+ */
+void initTimeMerge(timeMerge_t *m, uint64_t streamMask, uint64_t window){
+    memset(m, 0, sizeof(timeMerge_t));
+    m->streamMask = streamMask;
+    m->window = window;
+}
+
+/* Frees the memory allocated by the merge.
+ */
+void freeTimeMerge(timeMerge_t *m){
+  register int s;
+    for (s = 0; s < TIME_MERGE_MAX_STREAMS; s++){
+      free(m->streams[s].events);
+      m->streams[s].events = NULL;
+      m->streams[s].capacity = m->streams[s].count = 0;
+    }
+    m->heapSize = 0;
+}
+
+/* Makes room in the ring of 's' for 'needed' more records. The ring is
+ * reallocated with its records moved to the beginning.
+ *
+ * @return 0 on success, -1 if the memory can't be allocated
+ */
+static int growStream(timeMergeStream_t *s, uint32_t needed){
+  psdEvent_t *events;
+  uint32_t capacity = (s->capacity > 0) ? s->capacity : TIME_MERGE_INITIAL_CAPACITY;
+  uint32_t n;
+    if (s->capacity - s->count >= needed)
+      return 0;
+    while (capacity - s->count < needed)
+      capacity <<= 1;
+    if(  (events = (psdEvent_t*)malloc(capacity * sizeof(psdEvent_t))) == NULL  ){
+      fputs("timeMerge - error trying allocating memory for the pending events\n", stderr);
+      return -1;
+    }
+    if (s->count > 0){
+      n = s->capacity - s->first;
+      if (n > s->count)
+        n = s->count;
+      memcpy(events, s->events + s->first, n * sizeof(psdEvent_t));
+      memcpy(events + n, s->events, (s->count - n) * sizeof(psdEvent_t));
+    }
+    free(s->events);
+    s->events = events;
+    s->capacity = capacity;
+    s->first = 0;
+  return 0;
+}
+
+/* Moves up the heap entry 'i' until its parent is not newer.
+ */
+static void heapSiftUp(timeMerge_t *m, int i){
+  int s = m->heap[i], parent;
+  uint64_t ts = HEAD_TIMESTAMP(m, s);
+    while (i > 0){
+      parent = (i - 1) / 2;
+      if (HEAD_TIMESTAMP(m, m->heap[parent]) <= ts)
+        break;
+      m->heap[i] = m->heap[parent];
+      i = parent;
+    }
+    m->heap[i] = s;
+}
+
+/* Moves down the heap entry 'i' until none of its children is older.
+ */
+static void heapSiftDown(timeMerge_t *m, int i){
+  int s = m->heap[i], child;
+  uint64_t ts = HEAD_TIMESTAMP(m, s);
+    while(  (child = 2 * i + 1) < m->heapSize  ){
+      if(  (child + 1 < m->heapSize) && (HEAD_TIMESTAMP(m, m->heap[child + 1]) < HEAD_TIMESTAMP(m, m->heap[child]))  )
+        child++;
+      if (ts <= HEAD_TIMESTAMP(m, m->heap[child]))
+        break;
+      m->heap[i] = m->heap[child];
+      i = child;
+    }
+    m->heap[i] = s;
+}
+
+/* Appends records to a stream. The records must be in time order and not
+ * older than those already pushed into the same stream.
+ *
+ * @param m the merge
+ * @param stream the stream (< TIME_MERGE_MAX_STREAMS)
+ * @param ev the records
+ * @param count the number of records
+ * @return 0 on success, -1 if the memory can't be allocated (a description
+ * is printed to stderr)
+ */
+int timeMergePush(timeMerge_t *m, int stream, const psdEvent_t *ev, uint32_t count){
+  timeMergeStream_t *s = &m->streams[stream];
+  uint32_t last, n;
+    if (count == 0)
+      return 0;
+    if (growStream(s, count))
+      return -1;
+    // copy in (at most) two pieces: up to the end of the ring then from its beginning
+    last = (s->first + s->count) & (s->capacity - 1);
+    n = s->capacity - last;
+    if (n > count)
+      n = count;
+    memcpy(s->events + last, ev, n * sizeof(psdEvent_t));
+    memcpy(s->events, ev + n, (count - n) * sizeof(psdEvent_t));
+    s->count += count;
+    s->last = ev[count - 1].timestamp;
+    if (s->last > m->newest)
+      m->newest = s->last;
+    m->pending += count;
+    if (m->pending > m->maxPending)
+      m->maxPending = m->pending;
+    // the stream was empty: it enters the heap
+    if (s->count == count){
+      m->heap[m->heapSize++] = stream;
+      heapSiftUp(m, m->heapSize - 1);
+    }
+  return 0;
+}
+
+/* Pops in time order the records that can't be preceded by a record pushed
+ * later.
+ *
+ * @param m the merge
+ * @param flush non-zero at the end of the run: all the pending records are
+ * popped
+ * @param out where the records are copied
+ * @param max the max number of records to copy into 'out'
+ * @return the number of records copied into 'out': when it is 'max' more
+ * records may be ready
+ */
+uint32_t timeMergePop(timeMerge_t *m, int flush, psdEvent_t *out, uint32_t max){
+  uint64_t horizon, limit, ts;
+  uint64_t mask;
+  timeMergeStream_t *s;
+  uint32_t n = 0;
+  register int i;
+    /* the newest timestamp that can be popped: the oldest of the last
+       timestamps of the enabled streams, or the window */
+    horizon = UINT64_MAX;
+    if (!flush){
+      for (i = 0, mask = m->streamMask; mask != 0; i++, mask >>= 1){
+        if(  (mask & 1) && (m->streams[i].last < horizon)  )
+          horizon = m->streams[i].last;
+      }
+      if(  (m->newest > m->window) && (m->newest - m->window > horizon)  )
+        horizon = m->newest - m->window;
+    }
+
+    while(  (n < max) && (m->heapSize > 0)  ){
+      s = &m->streams[m->heap[0]];
+      if (s->events[s->first].timestamp > horizon)
+        break;
+      // the records of this stream can be copied up to the first record of the next stream
+      limit = horizon;
+      for (i = 1; (i <= 2) && (i < m->heapSize); i++){
+        if (HEAD_TIMESTAMP(m, m->heap[i]) < limit)
+          limit = HEAD_TIMESTAMP(m, m->heap[i]);
+      }
+      do{
+        out[n] = s->events[s->first];
+        ts = out[n].timestamp;
+        if (ts < m->lastOut){
+          out[n].flags |= PSD_EVENT_FLAG_LATE;
+          m->late++;
+        }
+        else
+          m->lastOut = ts;
+        n++;
+        s->first = (s->first + 1) & (s->capacity - 1);
+        s->count--;
+      } while(  (n < max) && (s->count > 0) && (s->events[s->first].timestamp <= limit)  );
+      if (s->count == 0){
+        // the stream leaves the heap
+        m->heap[0] = m->heap[--m->heapSize];
+        if (m->heapSize == 0)
+          break;
+      }
+      heapSiftDown(m, 0);
+    }
+    m->pending -= n;
+  return n;
+}
@@ -0,0 +1,1121 @@
+/* DTT version: 5720 desktop (with DPP_PSD firmware)
+ *
+ * 'tdcrOffline' is the offline companion of the acquisition program: it works
+ * on the files written during a run and doesn't need the CAEN libraries nor
+ * the digitizer.
+ *
+ * Usage: tdcrOffline <command> <arguments>
+ *
+ *   totext <run.bin> <run.dat> [ns]
+ *       converts a binary run file (see runFile.h) into the legacy text
+ *       layout: the text header, the columns line and one
+ *       "ch, timestamp, Qs, Ql, ExtendedTT" line per event, exactly as the
+ *       acquisition writes them with 'OutputFormat = TEXT'. With 'ns' the
+ *       lines are "ch, time (ns), Qs, Ql", as with 'OutputFormat = TEXT_NS'.
+ *
+ *   decode <text|textns|binary> <run.raw> <output file>
+ *       decodes the readout buffers of a raw capture ('OutputFormat = RAW')
+ *       with the in-tree decoder (see psdDecoder.h) and writes the events in
+ *       the legacy text layout, in the text layout with the time in ns or in
+ *       a binary run file. A frame that can't be decoded is reported and
+ *       skipped. The rollovers are checked against the wall-clock time of the
+ *       frames from the first frame of the board (see psdDecoder.h).
+ *
+ *   check <run.raw> [none|time|triggers]
+ *       replays the readout buffers of a raw capture through the scalar and
+ *       the vector path of the in-tree decoder (see psdDecoder.h), each with
+ *       its own decoder state, and compares them buffer by buffer: the
+ *       records, where their samples are, the rollover counters and the
+ *       trigger counters read from the extras word, as read with the given
+ *       content of the extras word (none by default, as the decode command).
+ *       The frames with differences are counted and the first difference is
+ *       described. CAEN_DGTZ_GetDPPEvents() can't take part: it needs the
+ *       open digitizer the buffers come from. The library is compared with
+ *       the in-tree decoder during the acquisition instead ('DecoderCheck'
+ *       readout option).
+ *
+ *   bench <run.bin>
+ *       measures the events/s of the text formatting on the records of a
+ *       binary run file (at most BENCH_MAX_RECORDS): fprintf() of each line
+ *       (as the acquisition did before formatRunFileText()), sprintf() into
+ *       a buffer, and formatRunFileText(), in the legacy layout. The output
+ *       of formatRunFileText() is first checked to be identical to the one of
+ *       sprintf(), in both text layouts.
+ *
+ *   trace <run_wave.bin> <n>
+ *       prints the waveform record n (from 0) of a waveform file (readout
+ *       option 'Waveforms'): its event (with its fine time, if any) and one
+ *       line per sample. The record is found through the index at the end of
+ *       the file (see runFile.h).
+ *
+ *   charge <run_wave.bin> <preTrigger> <pgate> <sgate> <lgate> <nsbl> <negative|positive>
+ *       integrates the charges of the first waveform records (at most
+ *       CHARGE_MAX_TRACES) of a waveform file again with the given gates and
+ *       baseline (in samples, nsbl as the code of the DPP parameters, see
+ *       psdCharge.h) and prints, for each channel, the mean software charges
+ *       and PSD and their comparison with the charges of the firmware. Then
+ *       measures the traces/s of the scalar and of the SIMD path, after
+ *       checking that their charges are identical.
+ *
+ *   scan <run.bin> <windows>
+ *       counts the TDCR coincidences (AB, BC, AC, D and T, see tdcrCoinc.h)
+ *       of a binary run file for each resolving time of 'windows' (ns,
+ *       separated by ',', e.g. 10,20,40,80) in a single pass (see tdcrScan.h)
+ *       and prints them with their rates, over the time from the first to
+ *       the last record.
+ *
+ *   scanbench <run.bin> <windows>
+ *       checks on the records of a binary run file (at most
+ *       BENCH_MAX_RECORDS) that the counts of the single pass are identical
+ *       to those of one pass of tdcrCoinc per resolving time, then measures
+ *       the events/s of both.
+ *
+ * Build (from the repository root; add -mavx2 or -march=native for the AVX2
+ * path of psdCharge.c):
+ *
+ *   gcc -O2 -Iinclude -o tdcrOffline tools/tdcrOffline.c src/runFile.c src/psdDecoder.c src/psdCharge.c src/tdcrCoinc.c \
+ *       src/tdcrScan.c -lm
+ *
+ * 'tdcrOffline' version: a0.11
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "runFile.h"
+#include "psdEvent.h"
+#include "psdDecoder.h"
+#include "psdCharge.h"
+#include "tdcrCoinc.h"
+#include "tdcrScan.h"
+
+/* number of records read from the run file at a time */
+#define RECORDS_PER_READ 65536
+/* max number of boards of a raw capture (psdEvent_t.board is 8 bits) */
+#define MAX_BOARDS 256
+/* max size of a frame of a raw capture (bytes) */
+#define MAX_FRAME_SIZE (256u << 20)
+/* number of records formatted into the text buffer at a time */
+#define TEXT_BATCH 4096
+/* max number of records loaded by the 'bench' command */
+#define BENCH_MAX_RECORDS (1u << 22)
+/* min duration of the measure of each formatter or charge path (s) */
+#define BENCH_MIN_TIME 1.0
+/* max number of waveform records loaded by the 'charge' command */
+#define CHARGE_MAX_TRACES (1u << 18)
+
+/* the text lines of a batch of records */
+static char textBuffer[TEXT_BATCH * RUN_FILE_TEXT_MAX_LINE];
+/* 'charge' command: the comparison with the firmware and the sums of the
+   software charges (Qs, Ql, PSD, PSD^2) of each channel (b*8+ch) */
+static psdChargeStats_t chargeStats[MAX_BOARDS * PSD_MAX_CHANNELS];
+static double chargeSums[MAX_BOARDS * PSD_MAX_CHANNELS][4];
+
+typedef struct
+{
+  const char *name;
+  int numArgs;
+  const char *usage;
+  int (*run)(char **args);
+} offlineCommand_t;
+
+static int runToText(char **args);
+static int runToTextNs(char **args);
+static int convertToText(char **args, int layout);
+static int runDecode(char **args);
+static int runCheck(char **args);
+static int runCheckExtras(char **args);
+static int checkCapture(const char *name, int extras);
+static int compareDecoders(const psdDecoder_t *s, const psdDecoder_t *v, unsigned long frameNum, int describe);
+static int readRawFrame(FILE *fin, const char *name, runFileFrame_t *frame, uint32_t **buffer, uint32_t *bufferSize);
+static int runBench(char **args);
+static int runTrace(char **args);
+static int runCharge(char **args);
+static int runScan(char **args);
+static int runScanBench(char **args);
+static int loadScan(char **args, tdcrScan_t *scan, FILE **fin);
+static int loadTraces(FILE *fin, const char *name, psdChargeTrace_t *traces, psdEvent_t *events, uint16_t **samples, uint64_t *numTraces);
+static double benchCharge(int vector, const psdChargeGates_t *g, const psdChargeTrace_t *traces, uint64_t numTraces, psdCharge_t *charges);
+static double benchScan(int single, const tdcrScan_t *scan, const psdEvent_t *records, size_t numRecords);
+static double benchFormatter(int method, FILE *fnull, const psdEvent_t *records, size_t numRecords, uint32_t chargeMask);
+static double monotonicSeconds(void);
+static int writeTextLines(FILE *fout, const psdEvent_t *ev, size_t count, uint32_t chargeMask, int layout);
+static void printUsage(void);
+
+static const offlineCommand_t commands[] = {
+  { "totext", 2, "totext <run.bin> <run.dat>", runToText },
+  { "totext", 3, "totext <run.bin> <run.dat> ns", runToTextNs },
+  { "decode", 3, "decode <text|textns|binary> <run.raw> <output file>", runDecode },
+  { "check", 1, "check <run.raw>", runCheck },
+  { "check", 2, "check <run.raw> <none|time|triggers>", runCheckExtras },
+  { "bench", 1, "bench <run.bin>", runBench },
+  { "trace", 2, "trace <run_wave.bin> <n>", runTrace },
+  { "charge", 7, "charge <run_wave.bin> <preTrigger> <pgate> <sgate> <lgate> <nsbl> <negative|positive>", runCharge },
+  { "scan", 2, "scan <run.bin> <windows>", runScan },
+  { "scanbench", 2, "scanbench <run.bin> <windows>", runScanBench },
+};
+
+
+int main(int argc, char **argv){
+  register unsigned i;
+    if (argc >= 2){
+      for (i = 0; i < sizeof(commands) / sizeof(commands[0]); i++){
+        if(  (strcmp(argv[1], commands[i].name) == 0) && (argc - 2 == commands[i].numArgs)  )
+          return commands[i].run(argv + 2) ? EXIT_FAILURE : EXIT_SUCCESS;
+      }
+    }
+    printUsage();
+  return EXIT_FAILURE;
+}
+
+/* Prints to stderr the usage of each command.
+ */
+static void printUsage(void){
+  register unsigned i;
+    fputs("Usage: tdcrOffline <command> <arguments>\n", stderr);
+    for (i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+      fprintf(stderr, "  tdcrOffline %s\n", commands[i].usage);
+}
+
+/* Writes 'count' records to 'fout' in the text layout 'layout' (the channels
+ * of board b are numbered b*8+ch), TEXT_BATCH records at a time.
+ *
+ * @return 0 on success, -1 in case of write error
+ */
+static int writeTextLines(FILE *fout, const psdEvent_t *ev, size_t count, uint32_t chargeMask, int layout){
+  size_t n, size;
+    while (count > 0){
+      n = (count < TEXT_BATCH) ? count : TEXT_BATCH;
+      size = formatRunFileText(textBuffer, ev, n, chargeMask, layout);
+      if (fwrite(textBuffer, 1, size, fout) != size)
+        return -1;
+      ev += n;
+      count -= n;
+    }
+  return 0;
+}
+
+/* Converts the binary run file 'args[0]' into the legacy text file
+ * 'args[1]'.
+ *
+ * @return 0 on success, otherwise a non-zero integer (a description is
+ * printed to stderr)
+ */
+static int runToText(char **args){
+  return convertToText(args, RUN_FILE_TEXT_LEGACY);
+}
+
+/* Converts the binary run file 'args[0]' into the text file 'args[1]' with
+ * the time in ns ('args[2]' is "ns").
+ *
+ * @return 0 on success, otherwise a non-zero integer (a description is
+ * printed to stderr)
+ */
+static int runToTextNs(char **args){
+    if (strcmp(args[2], "ns") != 0){
+      printUsage();
+      return 1;
+    }
+  return convertToText(args, RUN_FILE_TEXT_NS);
+}
+
+/* Converts the binary run file 'args[0]' into the text file 'args[1]' in
+ * the layout 'layout' (RUN_FILE_TEXT_LEGACY or RUN_FILE_TEXT_NS).
+ *
+ * @return 0 on success, otherwise a non-zero integer (a description is
+ * printed to stderr)
+ */
+static int convertToText(char **args, int layout){
+  int failure = 1;
+  FILE *fin, *fout = NULL;
+  runFileHeader_t header;
+  char textHeader[RUN_FILE_HEADER_SIZE];
+  psdEvent_t *records = NULL;
+  size_t numRecords;
+  unsigned long totalRecords = 0;
+    if(  (fin = fopen(args[0], "rb")) == NULL  ){
+      perror(args[0]);
+      return 1;
+    }
+    if (readRunFileHeader(fin, &header, textHeader))
+      goto endToText;
+    if(  (header.content != RUN_FILE_CONTENT_EVENTS) || (header.recordSize != sizeof(psdEvent_t))  ){
+      fprintf(stderr, "%s: the file doesn't contain event records\n", args[0]);
+      goto endToText;
+    }
+    if(  (records = (psdEvent_t*)malloc(RECORDS_PER_READ * sizeof(psdEvent_t))) == NULL  ){
+      fputs("tdcrOffline - error trying allocating memory\n", stderr);
+      goto endToText;
+    }
+    if(  (fout = fopen(args[1], "w")) == NULL  ){
+      perror(args[1]);
+      goto endToText;
+    }
+    if(  (fputs(textHeader, fout) == EOF)
+        || (fputs((layout == RUN_FILE_TEXT_NS) ? RUN_FILE_TEXT_NS_COLUMNS : RUN_FILE_TEXT_COLUMNS, fout) == EOF)  ){
+      perror(args[1]);
+      goto endToText;
+    }
+
+    while(  (numRecords = fread(records, sizeof(psdEvent_t), RECORDS_PER_READ, fin)) > 0  ){
+      if (writeTextLines(fout, records, numRecords, header.chargeMask, layout)){
+        perror(args[1]);
+        goto endToText;
+      }
+      totalRecords += numRecords;
+    }
+    if (ferror(fin)){
+      perror(args[0]);
+      goto endToText;
+    }
+    if (ftell(fin) != (long)(RUN_FILE_HEADER_SIZE + totalRecords * sizeof(psdEvent_t)))
+      fprintf(stderr, "%s: warning, the last record is truncated\n", args[0]);
+    printf("%lu events converted\n", totalRecords);
+    failure = 0;
+
+endToText:
+    free(records);
+    if(  (fout != NULL) && fclose(fout)  ){
+      perror(args[1]);
+      failure = 1;
+    }
+    fclose(fin);
+  return failure;
+}
+
+/* Decodes the raw capture 'args[1]' into the file 'args[2]', written in the
+ * legacy text layout ('args[0]' is "text"), in the text layout with the time
+ * in ns ("textns") or as a binary run file ("binary").
+ *
+ * @return 0 on success, otherwise a non-zero integer (a description is
+ * printed to stderr)
+ */
+static int runDecode(char **args){
+  int failure = 1, text, layout, ch;
+  FILE *fin, *fout = NULL;
+  runFileHeader_t header;
+  runFileFrame_t frame;
+  char textHeader[RUN_FILE_HEADER_SIZE];
+  psdDecoder_t *decoders[MAX_BOARDS] = { NULL };
+  psdDecoder_t *d;
+  uint64_t firstStamp[MAX_BOARDS];
+  uint32_t *buffer = NULL, bufferSize = 0;
+  unsigned long numFrames = 0, badFrames = 0, totalRecords = 0;
+  register int b, ret;
+    if(  (strcmp(args[0], "text") != 0) && (strcmp(args[0], "textns") != 0) && (strcmp(args[0], "binary") != 0)  ){
+      printUsage();
+      return 1;
+    }
+    text = (strcmp(args[0], "binary") != 0);
+    layout = (strcmp(args[0], "textns") == 0) ? RUN_FILE_TEXT_NS : RUN_FILE_TEXT_LEGACY;
+    if(  (fin = fopen(args[1], "rb")) == NULL  ){
+      perror(args[1]);
+      return 1;
+    }
+    if (readRunFileHeader(fin, &header, textHeader))
+      goto endDecode;
+    if (header.content != RUN_FILE_CONTENT_RAW){
+      fprintf(stderr, "%s: the file is not a raw capture\n", args[1]);
+      goto endDecode;
+    }
+    if(  (fout = fopen(args[2], text ? "w" : "wb")) == NULL  ){
+      perror(args[2]);
+      goto endDecode;
+    }
+    if (text){
+      if(  (fputs(textHeader, fout) == EOF)
+          || (fputs((layout == RUN_FILE_TEXT_NS) ? RUN_FILE_TEXT_NS_COLUMNS : RUN_FILE_TEXT_COLUMNS, fout) == EOF)  ){
+        perror(args[2]);
+        goto endDecode;
+      }
+    }
+    else if (writeRunFileHeader(fout, RUN_FILE_CONTENT_EVENTS, sizeof(psdEvent_t), header.chargeMask, textHeader, header.textHeaderSize))
+      goto endDecode;
+
+    while(  (ret = readRawFrame(fin, args[1], &frame, &buffer, &bufferSize)) > 0  ){
+      numFrames++;
+      if(  (d = decoders[frame.board]) == NULL  ){
+        if(  ((d = (psdDecoder_t*)malloc(sizeof(psdDecoder_t))) == NULL) || initPsdDecoder(d, (int)frame.board)  ){
+          free(d);
+          fputs("tdcrOffline - error trying allocating memory\n", stderr);
+          goto endDecode;
+        }
+        decoders[frame.board] = d;
+        firstStamp[frame.board] = frame.stamp;
+      }
+      // the time of the first frame stands for the start: the bound is lower than online
+      psdDecoderSetClock(d, (frame.stamp > firstStamp[frame.board]) ? (frame.stamp - firstStamp[frame.board]) / PSD_TIMETAG_NS : 0);
+      if (psdDecodeVector(d, buffer, frame.size / 4)){
+        fprintf(stderr, "%s: frame %lu (board %u) skipped\n", args[1], numFrames, frame.board);
+        badFrames++;
+        continue;
+      }
+      for (ch = 0; ch < PSD_MAX_CHANNELS; ch++){
+        if(  text ? writeTextLines(fout, d->events[ch], d->numEvents[ch], header.chargeMask, layout)
+                  : (fwrite(d->events[ch], sizeof(psdEvent_t), d->numEvents[ch], fout) != d->numEvents[ch])  ){
+          perror(args[2]);
+          goto endDecode;
+        }
+        totalRecords += d->numEvents[ch];
+      }
+    }
+    if (ret < 0)
+      goto endDecode;
+    printf("%lu frames (%lu skipped), %lu events decoded\n", numFrames, badFrames, totalRecords);
+    failure = 0;
+
+endDecode:
+    for (b = 0; b < MAX_BOARDS; b++){
+      if (decoders[b] != NULL){
+        freePsdDecoder(decoders[b]);
+        free(decoders[b]);
+      }
+    }
+    free(buffer);
+    if(  (fout != NULL) && fclose(fout)  ){
+      perror(args[2]);
+      failure = 1;
+    }
+    fclose(fin);
+  return failure;
+}
+
+/* Compares the scalar and the vector decoder on the raw capture 'args[0]'.
+ *
+ * @return 0 if they decode it identically, otherwise a non-zero integer
+ */
+static int runCheck(char **args){
+  return checkCapture(args[0], PSD_EXTRAS_NONE);
+}
+
+/* Compares the scalar and the vector decoder on the raw capture 'args[0]',
+ * with the content of the extras word 'args[1]'.
+ *
+ * @return 0 if they decode it identically, otherwise a non-zero integer
+ */
+static int runCheckExtras(char **args){
+    if (strcmp(args[1], "none") == 0)
+      return checkCapture(args[0], PSD_EXTRAS_NONE);
+    if (strcmp(args[1], "time") == 0)
+      return checkCapture(args[0], PSD_EXTRAS_TIME);
+    if (strcmp(args[1], "triggers") == 0)
+      return checkCapture(args[0], PSD_EXTRAS_TRIGGERS);
+    printUsage();
+  return 1;
+}
+
+/* Replays the readout buffers of the raw capture 'name' through the scalar
+ * and the vector decoder and compares them buffer by buffer.
+ *
+ * @param name the raw capture
+ * @param extras how the extras word is read (PSD_EXTRAS_*)
+ * @return 0 if the two decoders are identical on every buffer, otherwise a
+ * non-zero integer (the first difference is described on stdout, the errors
+ * are printed to stderr)
+ */
+static int checkCapture(const char *name, int extras){
+  int failure = 1, scalarRet, vectorRet;
+  FILE *fin;
+  runFileHeader_t header;
+  runFileFrame_t frame;
+  char textHeader[RUN_FILE_HEADER_SIZE];
+  psdDecoder_t *decoders[MAX_BOARDS] = { NULL };   /* scalar and vector decoder of each board */
+  psdDecoder_t *d;
+  uint64_t firstStamp[MAX_BOARDS], clock;
+  uint32_t *buffer = NULL, bufferSize = 0;
+  unsigned long numFrames = 0, badFrames = 0, diffFrames = 0, totalRecords = 0;
+  register int b, ch, ret;
+    if(  (fin = fopen(name, "rb")) == NULL  ){
+      perror(name);
+      return 1;
+    }
+    if (readRunFileHeader(fin, &header, textHeader))
+      goto endCheck;
+    if (header.content != RUN_FILE_CONTENT_RAW){
+      fprintf(stderr, "%s: the file is not a raw capture\n", name);
+      goto endCheck;
+    }
+
+    while(  (ret = readRawFrame(fin, name, &frame, &buffer, &bufferSize)) > 0  ){
+      numFrames++;
+      if(  (d = decoders[frame.board]) == NULL  ){
+        if(  (d = (psdDecoder_t*)calloc(2, sizeof(psdDecoder_t))) == NULL  ){
+          fputs("tdcrOffline - error trying allocating memory\n", stderr);
+          goto endCheck;
+        }
+        decoders[frame.board] = d;
+        if(  initPsdDecoder(&d[0], (int)frame.board) || initPsdDecoder(&d[1], (int)frame.board)
+            || psdDecoderEnableSamples(&d[0]) || psdDecoderEnableSamples(&d[1])  ){
+          fputs("tdcrOffline - error trying allocating memory\n", stderr);
+          goto endCheck;
+        }
+        psdDecoderSetExtras(&d[0], extras);
+        psdDecoderSetExtras(&d[1], extras);
+        firstStamp[frame.board] = frame.stamp;
+      }
+      clock = (frame.stamp > firstStamp[frame.board]) ? (frame.stamp - firstStamp[frame.board]) / PSD_TIMETAG_NS : 0;
+      psdDecoderSetClock(&d[0], clock);
+      psdDecoderSetClock(&d[1], clock);
+      scalarRet = psdDecodeScalar(&d[0], buffer, frame.size / 4);
+      vectorRet = psdDecodeVector(&d[1], buffer, frame.size / 4);
+      if (scalarRet != vectorRet){
+        if (diffFrames++ == 0)
+          printf("frame %lu (board %u): the %s decoder rejects it, the %s decoder doesn't\n", numFrames, frame.board,
+                 scalarRet ? "scalar" : "vector", scalarRet ? "vector" : "scalar");
+        continue;
+      }
+      if (scalarRet){
+        fprintf(stderr, "%s: frame %lu (board %u) rejected by both decoders\n", name, numFrames, frame.board);
+        badFrames++;
+        continue;
+      }
+      if (compareDecoders(&d[0], &d[1], numFrames, diffFrames == 0))
+        diffFrames++;
+      for (ch = 0; ch < PSD_MAX_CHANNELS; ch++)
+        totalRecords += d[0].numEvents[ch];
+    }
+    if (ret < 0)
+      goto endCheck;
+    printf("%lu frames (%lu rejected by both decoders), %lu events: %lu frames decoded differently by the scalar and the vector decoder\n",
+           numFrames, badFrames, totalRecords, diffFrames);
+    failure = (diffFrames > 0);
+
+endCheck:
+    for (b = 0; b < MAX_BOARDS; b++){
+      if (decoders[b] != NULL){
+        freePsdDecoder(&decoders[b][0]);
+        freePsdDecoder(&decoders[b][1]);
+        free(decoders[b]);
+      }
+    }
+    free(buffer);
+    fclose(fin);
+  return failure;
+}
+
+/* Compares the scalar decoder 's' and the vector decoder 'v' after they
+ * decoded the same buffer: the records, where their samples are and the
+ * counters of each channel.
+ *
+ * @param frameNum the number of the frame of the buffer (from 1)
+ * @param describe the first difference is described on stdout if non-zero
+ * @return 0 if they are identical, otherwise 1
+ */
+static int compareDecoders(const psdDecoder_t *s, const psdDecoder_t *v, unsigned long frameNum, int describe){
+  const psdEvent_t *es, *ev;
+  unsigned int ch, n;
+    for (ch = 0; ch < PSD_MAX_CHANNELS; ch++){
+      if (s->numEvents[ch] != v->numEvents[ch]){
+        if (describe)
+          printf("frame %lu (board %u) ch %u: %u events from the scalar decoder, %u from the vector decoder\n",
+                 frameNum, s->board, ch, s->numEvents[ch], v->numEvents[ch]);
+        return 1;
+      }
+      for (n = 0; n < s->numEvents[ch]; n++){
+        es = &s->events[ch][n];
+        ev = &v->events[ch][n];
+        if (memcmp(es, ev, sizeof(psdEvent_t))){
+          if (describe)
+            printf("frame %lu (board %u) ch %u event %u: scalar decoder (ts %lu, qs %u, ql %u, flags %#x) != vector decoder (ts %lu, qs %u, ql %u, flags %#x)\n",
+                   frameNum, s->board, ch, n, (unsigned long)es->timestamp, es->qshort, es->qlong, es->flags,
+                   (unsigned long)ev->timestamp, ev->qshort, ev->qlong, ev->flags);
+          return 1;
+        }
+        if(  (s->samples[ch][n].words != v->samples[ch][n].words) || (s->samples[ch][n].numSamples != v->samples[ch][n].numSamples)
+            || (s->samples[ch][n].dualTrace != v->samples[ch][n].dualTrace)  ){
+          if (describe)
+            printf("frame %lu (board %u) ch %u event %u: the samples differ (scalar decoder: %u, vector decoder: %u)\n",
+                   frameNum, s->board, ch, n, s->samples[ch][n].numSamples, v->samples[ch][n].numSamples);
+          return 1;
+        }
+      }
+      if(  (s->rollovers[ch] != v->rollovers[ch]) || (s->missedRollovers[ch] != v->missedRollovers[ch])
+          || (s->lostTriggers[ch] != v->lostTriggers[ch]) || (s->totalTriggers[ch] != v->totalTriggers[ch])  ){
+        if (describe)
+          printf("frame %lu (board %u) ch %u: the counters differ (scalar decoder: %lu/%lu rollovers, %lu/%lu lost triggers; "
+                 "vector decoder: %lu/%lu rollovers, %lu/%lu lost triggers)\n", frameNum, s->board, ch,
+                 (unsigned long)s->rollovers[ch], (unsigned long)s->missedRollovers[ch], (unsigned long)s->lostTriggers[ch], (unsigned long)s->totalTriggers[ch],
+                 (unsigned long)v->rollovers[ch], (unsigned long)v->missedRollovers[ch], (unsigned long)v->lostTriggers[ch], (unsigned long)v->totalTriggers[ch]);
+        return 1;
+      }
+    }
+  return 0;
+}
+
+/* Reads the next frame of a raw capture into '*buffer', that is enlarged if
+ * needed.
+ *
+ * @param fin the raw capture, after its header
+ * @param name its name
+ * @param frame the header of the frame
+ * @param buffer the buffer of the readout buffer (realloc()ed)
+ * @param bufferSize its size (bytes)
+ * @return 1 if a frame was read, 0 at the end of the file (or of its last
+ * complete frame), -1 in case of error (a description is printed to stderr)
+ */
+static int readRawFrame(FILE *fin, const char *name, runFileFrame_t *frame, uint32_t **buffer, uint32_t *bufferSize){
+  uint32_t *newBuffer;
+    if (fread(frame, sizeof(runFileFrame_t), 1, fin) != 1){
+      if (ferror(fin)){
+        perror(name);
+        return -1;
+      }
+      return 0;
+    }
+    if(  (frame->sync != RUN_FILE_FRAME_SYNC) || (frame->board >= MAX_BOARDS) || (frame->size % 4) || (frame->size > MAX_FRAME_SIZE)  ){
+      fprintf(stderr, "%s: bad frame header at offset %ld\n", name, ftell(fin) - (long)sizeof(runFileFrame_t));
+      return -1;
+    }
+    if (frame->size > *bufferSize){
+      if(  (newBuffer = (uint32_t*)realloc(*buffer, frame->size)) == NULL  ){
+        fputs("tdcrOffline - error trying allocating memory\n", stderr);
+        return -1;
+      }
+      *buffer = newBuffer;
+      *bufferSize = frame->size;
+    }
+    if (fread(*buffer, 1, frame->size, fin) != frame->size){
+      if (ferror(fin)){
+        perror(name);
+        return -1;
+      }
+      fprintf(stderr, "%s: warning, the last frame is truncated\n", name);
+      return 0;
+    }
+  return 1;
+}
+
+/* Measures the text formatters on the records of the binary run file
+ * 'args[0]' and prints their events/s.
+ *
+ * @return 0 on success, otherwise a non-zero integer (a description is
+ * printed to stderr)
+ */
+static int runBench(char **args){
+  static const char *methodNames[] = { "fprintf", "sprintf", "formatRunFileText" };
+  int failure = 1, method, length;
+  FILE *fin, *fnull = NULL;
+  runFileHeader_t header;
+  char textHeader[RUN_FILE_HEADER_SIZE];
+  char reference[RUN_FILE_TEXT_MAX_LINE];
+  psdEvent_t *records = NULL;
+  size_t numRecords, n, size;
+  double rate[3];
+    if(  (fin = fopen(args[0], "rb")) == NULL  ){
+      perror(args[0]);
+      return 1;
+    }
+    if (readRunFileHeader(fin, &header, textHeader))
+      goto endBench;
+    if(  (header.content != RUN_FILE_CONTENT_EVENTS) || (header.recordSize != sizeof(psdEvent_t))  ){
+      fprintf(stderr, "%s: the file doesn't contain event records\n", args[0]);
+      goto endBench;
+    }
+    if(  (records = (psdEvent_t*)malloc(BENCH_MAX_RECORDS * sizeof(psdEvent_t))) == NULL  ){
+      fputs("tdcrOffline - error trying allocating memory\n", stderr);
+      goto endBench;
+    }
+    if(  (numRecords = fread(records, sizeof(psdEvent_t), BENCH_MAX_RECORDS, fin)) == 0  ){
+      fprintf(stderr, "%s: no records\n", args[0]);
+      goto endBench;
+    }
+    if(  (fnull = fopen("/dev/null", "w")) == NULL  ){
+      perror("/dev/null");
+      goto endBench;
+    }
+
+    // the lines must be the same, byte for byte, in both layouts
+    for (n = 0; n < numRecords; n++){
+      length = sprintf(reference, RUN_FILE_TEXT_LINE, RUN_FILE_TEXT_CHANNEL(records[n].board, records[n].channel),
+                       (unsigned long)(records[n].timestamp & PSD_TIMETAG_MASK), (int)(records[n].qshort & header.chargeMask),
+                       (int)(records[n].qlong & header.chargeMask), (unsigned long)(records[n].timestamp >> PSD_TIMETAG_BITS));
+      size = formatRunFileText(textBuffer, &records[n], 1, header.chargeMask, RUN_FILE_TEXT_LEGACY);
+      if(  (size != (size_t)length) || memcmp(reference, textBuffer, size)  ){
+        fprintf(stderr, "record %lu: formatRunFileText() differs from sprintf()\n", (unsigned long)n);
+        goto endBench;
+      }
+      length = sprintf(reference, RUN_FILE_TEXT_NS_LINE, RUN_FILE_TEXT_CHANNEL(records[n].board, records[n].channel),
+                       (unsigned long)PSD_EVENT_TIME_NS(&records[n]), (int)(records[n].qshort & header.chargeMask),
+                       (int)(records[n].qlong & header.chargeMask));
+      size = formatRunFileText(textBuffer, &records[n], 1, header.chargeMask, RUN_FILE_TEXT_NS);
+      if(  (size != (size_t)length) || memcmp(reference, textBuffer, size)  ){
+        fprintf(stderr, "record %lu: formatRunFileText() differs from sprintf() (time in ns)\n", (unsigned long)n);
+        goto endBench;
+      }
+    }
+    printf("%lu records, the text lines of formatRunFileText() are identical to sprintf()\n", (unsigned long)numRecords);
+    for (method = 0; method < 3; method++){
+      rate[method] = benchFormatter(method, fnull, records, numRecords, header.chargeMask);
+      printf("%-18s %14.0f events/s %8.2fx\n", methodNames[method], rate[method], rate[method] / rate[0]);
+    }
+    failure = 0;
+
+endBench:
+    free(records);
+    if (fnull != NULL)
+      fclose(fnull);
+    fclose(fin);
+  return failure;
+}
+
+/* Prints the waveform record 'args[1]' of the waveform file 'args[0]'.
+ *
+ * @return 0 on success, otherwise a non-zero integer (a description is
+ * printed to stderr)
+ */
+static int runTrace(char **args){
+  int failure = 1;
+  FILE *fin;
+  runFileHeader_t header;
+  runFileTrace_t trace;
+  char textHeader[RUN_FILE_HEADER_SIZE];
+  char *endPtr;
+  uint16_t *samples = NULL;
+  uint64_t n, count;
+  uint32_t i;
+    n = strtoull(args[1], &endPtr, 10);
+    if(  (*args[1] == '\0') || (*endPtr != '\0')  ){
+      fprintf(stderr, "%s: not a record number\n", args[1]);
+      return 1;
+    }
+    if(  (fin = fopen(args[0], "rb")) == NULL  ){
+      perror(args[0]);
+      return 1;
+    }
+    if (readRunFileHeader(fin, &header, textHeader))
+      goto endTrace;
+    if (header.content != RUN_FILE_CONTENT_TRACES){
+      fprintf(stderr, "%s: the file doesn't contain waveform records\n", args[0]);
+      goto endTrace;
+    }
+    if (seekRunFileTrace(fin, n, &count))
+      goto endTrace;
+    if(  (fread(&trace, sizeof(trace), 1, fin) != 1) || (trace.sync != RUN_FILE_TRACE_SYNC)
+        || (trace.size != RUN_FILE_TRACE_SIZE(trace.numSamples, trace.numTraces)) || (trace.numTraces < 1) || (trace.numTraces > 2)  ){
+      fprintf(stderr, "%s: record %lu is damaged\n", args[0], (unsigned long)n);
+      goto endTrace;
+    }
+    if(  (samples = (uint16_t*)malloc((size_t)trace.numSamples * trace.numTraces * sizeof(uint16_t) + 1)) == NULL  ){
+      fputs("tdcrOffline - error trying allocating memory\n", stderr);
+      goto endTrace;
+    }
+    if (fread(samples, sizeof(uint16_t), (size_t)trace.numSamples * trace.numTraces, fin) != (size_t)trace.numSamples * trace.numTraces){
+      fprintf(stderr, "%s: record %lu is truncated\n", args[0], (unsigned long)n);
+      goto endTrace;
+    }
+    printf("# record %lu: ch %d, time %lu ns, Qs %u, Ql %u%s, %u samples x %u trace%s\n", (unsigned long)n,
+           RUN_FILE_TEXT_CHANNEL(trace.event.board, trace.event.channel), (unsigned long)PSD_EVENT_TIME_NS(&trace.event),
+           trace.event.qshort, trace.event.qlong,
+           (trace.event.flags & PSD_EVENT_FLAG_PUR) ? ", pile-up" : "", trace.numSamples, trace.numTraces, (trace.numTraces > 1) ? "s" : "");
+    if (trace.event.flags & PSD_EVENT_FLAG_FINE)
+      printf("# fine time %+d/%d of a time tag unit (%+.3f ns)\n", PSD_EVENT_FINE(&trace.event), PSD_EVENT_FINE_UNITS,
+             (double)PSD_EVENT_FINE(&trace.event) * PSD_TIMETAG_NS / PSD_EVENT_FINE_UNITS);
+    for (i = 0; i < trace.numSamples; i++){
+      if (trace.numTraces > 1)
+        printf("%7u %6u %6u\n", i, samples[i], samples[trace.numSamples + i]);
+      else
+        printf("%7u %6u\n", i, samples[i]);
+    }
+    failure = 0;
+
+endTrace:
+    free(samples);
+    fclose(fin);
+  return failure;
+}
+
+/* Integrates the charges of the waveform records of the waveform file
+ * 'args[0]' with the gates 'args[1]' to 'args[6]', prints their statistics
+ * for each channel and the traces/s of the two paths of psdCharge.h.
+ *
+ * @return 0 on success, otherwise a non-zero integer (a description is
+ * printed to stderr)
+ */
+static int runCharge(char **args){
+  static const char *gateNames[] = { "preTrigger", "pgate", "sgate", "lgate", "nsbl" };
+  int failure = 1, negative, i;
+  FILE *fin;
+  runFileHeader_t header;
+  char textHeader[RUN_FILE_HEADER_SIZE];
+  char *endPtr;
+  unsigned long value[5];
+  psdChargeGates_t gates;
+  psdChargeTrace_t *traces = NULL;
+  psdEvent_t *events = NULL;
+  psdCharge_t *charges = NULL, *check = NULL;
+  uint16_t *samples = NULL;
+  uint64_t numTraces, n;
+  double rate[2], qn;
+  unsigned ch;
+    for (i = 0; i < 5; i++){
+      value[i] = strtoul(args[i + 1], &endPtr, 10);
+      if(  (*args[i + 1] == '\0') || (*endPtr != '\0')  ){
+        fprintf(stderr, "%s: not a valid %s\n", args[i + 1], gateNames[i]);
+        return 1;
+      }
+    }
+    if(  (strcmp(args[6], "negative") != 0) && (strcmp(args[6], "positive") != 0)  ){
+      fprintf(stderr, "%s: the polarity is negative or positive\n", args[6]);
+      return 1;
+    }
+    negative = (strcmp(args[6], "negative") == 0);
+    if (initPsdChargeGates(&gates, (uint32_t)value[0], (uint32_t)value[1], (uint32_t)value[2], (uint32_t)value[3], (int)value[4], negative))
+      return 1;
+    if(  (fin = fopen(args[0], "rb")) == NULL  ){
+      perror(args[0]);
+      return 1;
+    }
+    if (readRunFileHeader(fin, &header, textHeader))
+      goto endCharge;
+    if (header.content != RUN_FILE_CONTENT_TRACES){
+      fprintf(stderr, "%s: the file doesn't contain waveform records\n", args[0]);
+      goto endCharge;
+    }
+    if(  ((traces = (psdChargeTrace_t*)malloc(CHARGE_MAX_TRACES * sizeof(psdChargeTrace_t))) == NULL)
+        || ((events = (psdEvent_t*)malloc(CHARGE_MAX_TRACES * sizeof(psdEvent_t))) == NULL)
+        || ((charges = (psdCharge_t*)malloc(CHARGE_MAX_TRACES * sizeof(psdCharge_t))) == NULL)
+        || ((check = (psdCharge_t*)malloc(CHARGE_MAX_TRACES * sizeof(psdCharge_t))) == NULL)  ){
+      fputs("tdcrOffline - error trying allocating memory\n", stderr);
+      goto endCharge;
+    }
+    if (loadTraces(fin, args[0], traces, events, &samples, &numTraces))
+      goto endCharge;
+
+    // both paths add up the same integer samples: the charges must be identical
+    psdChargeScalar(&gates, traces, (uint32_t)numTraces, check);
+    psdChargeVector(&gates, traces, (uint32_t)numTraces, charges);
+    if (memcmp(check, charges, numTraces * sizeof(psdCharge_t))){
+      fputs("psdChargeVector() differs from psdChargeScalar()\n", stderr);
+      goto endCharge;
+    }
+    for (n = 0; n < numTraces; n++){
+      ch = RUN_FILE_TEXT_CHANNEL(events[n].board, events[n].channel);
+      psdChargeStatsAdd(&chargeStats[ch], &events[n], &charges[n]);
+      chargeSums[ch][0] += charges[n].qshort;
+      chargeSums[ch][1] += charges[n].qlong;
+      chargeSums[ch][2] += charges[n].psd;
+      chargeSums[ch][3] += (double)charges[n].psd * charges[n].psd;
+    }
+    printf("# %lu traces, baseline [%u, %u), short gate [%u, %u), long gate [%u, %u) (samples), %s pulses\n", (unsigned long)numTraces,
+           gates.baselineStart, gates.baselineStart + gates.baselineLength, gates.gateStart, gates.gateStart + gates.shortLength,
+           gates.gateStart, gates.gateStart + gates.longLength, negative ? "negative" : "positive");
+    printf("#  ch          traces         mean Qs         mean Ql   mean PSD    rms PSD\n");
+    for (ch = 0; ch < MAX_BOARDS * PSD_MAX_CHANNELS; ch++){
+      if(  (qn = (double)(chargeStats[ch].count + chargeStats[ch].noCharge)) == 0.0  )
+        continue;
+      printf("%5u %15.0f %15.2f %15.2f %10.5f %10.5f\n", ch, qn, chargeSums[ch][0] / qn, chargeSums[ch][1] / qn, chargeSums[ch][2] / qn,
+             sqrt(fmax(chargeSums[ch][3] / qn - (chargeSums[ch][2] / qn) * (chargeSums[ch][2] / qn), 0.0)));
+    }
+    fputs(PSD_CHARGE_STATS_HEADER, stdout);
+    for (ch = 0; ch < MAX_BOARDS * PSD_MAX_CHANNELS; ch++){
+      if (chargeStats[ch].count + chargeStats[ch].noCharge > 0)
+        printPsdChargeStats(stdout, (int)ch, &chargeStats[ch]);
+    }
+
+    rate[0] = benchCharge(0, &gates, traces, numTraces, charges);
+    printf("%-18s %14.0f traces/s %8.2fx\n", "scalar", rate[0], 1.0);
+    rate[1] = benchCharge(1, &gates, traces, numTraces, charges);
+    printf("%-18s %14.0f traces/s %8.2fx\n", psdChargeVectorName(), rate[1], rate[1] / rate[0]);
+    failure = 0;
+
+endCharge:
+    free(traces);
+    free(events);
+    free(charges);
+    free(check);
+    free(samples);
+    fclose(fin);
+  return failure;
+}
+
+/* Initializes the scan of the resolving times 'args[1]' and opens the binary
+ * run file 'args[0]', positioned on its first record.
+ *
+ * @return 0 on success, -1 in case of error (a description is printed to
+ * stderr)
+ */
+static int loadScan(char **args, tdcrScan_t *scan, FILE **fin){
+  runFileHeader_t header;
+  char textHeader[RUN_FILE_HEADER_SIZE];
+  unsigned long windowsNs[TDCR_SCAN_MAX_WINDOWS];
+  uint32_t numWindows;
+    if(  parseTdcrScanWindows(args[1], windowsNs, &numWindows) || (numWindows == 0)  ){
+      fprintf(stderr, "%s: not a list of 1 to %d resolving times (ns, 1 to %lu) separated by ','\n", args[1], TDCR_SCAN_MAX_WINDOWS,
+              TDCR_SCAN_MAX_WINDOW_NS);
+      return -1;
+    }
+    if (initTdcrScan(scan, windowsNs, numWindows))
+      return -1;
+    if(  (*fin = fopen(args[0], "rb")) == NULL  ){
+      perror(args[0]);
+      return -1;
+    }
+    if (readRunFileHeader(*fin, &header, textHeader)){
+      fclose(*fin);
+      return -1;
+    }
+    if(  (header.content != RUN_FILE_CONTENT_EVENTS) || (header.recordSize != sizeof(psdEvent_t))  ){
+      fprintf(stderr, "%s: the file doesn't contain event records\n", args[0]);
+      fclose(*fin);
+      return -1;
+    }
+  return 0;
+}
+
+/* Counts the coincidences of the binary run file 'args[0]' for each
+ * resolving time of 'args[1]' in a single pass and prints them.
+ *
+ * @return 0 on success, otherwise a non-zero integer (a description is
+ * printed to stderr)
+ */
+static int runScan(char **args){
+  int failure = 1;
+  FILE *fin;
+  tdcrScan_t scan;
+  psdEvent_t *records = NULL;
+  size_t numRecords;
+  unsigned long totalRecords = 0;
+  uint64_t first = 0, last = 0;
+  double start, elapsed;
+    if (loadScan(args, &scan, &fin))
+      return 1;
+    if(  (records = (psdEvent_t*)malloc(RECORDS_PER_READ * sizeof(psdEvent_t))) == NULL  ){
+      fputs("tdcrOffline - error trying allocating memory\n", stderr);
+      goto endScan;
+    }
+
+    start = monotonicSeconds();
+    while(  (numRecords = fread(records, sizeof(psdEvent_t), RECORDS_PER_READ, fin)) > 0  ){
+      if (totalRecords == 0)
+        first = PSD_EVENT_TIME_NS(&records[0]);
+      last = PSD_EVENT_TIME_NS(&records[numRecords - 1]);
+      tdcrScanPush(&scan, records, (uint32_t)numRecords);
+      totalRecords += numRecords;
+    }
+    if (ferror(fin)){
+      perror(args[0]);
+      goto endScan;
+    }
+    tdcrScanFlush(&scan);
+    elapsed = monotonicSeconds() - start;
+    printf("# %lu records (%.3f s of acquisition), %u resolving times scanned in %.3f s\n", totalRecords, (double)(last - first) / 1e9,
+           scan.numWindows, elapsed);
+    if (scan.late > 0)
+      printf("# %lu records of the PMTs written out of time order (late) not counted\n", (unsigned long)scan.late);
+    printTdcrScanSummary(stdout, &scan, (double)(last - first) / 1e9);
+    failure = 0;
+
+endScan:
+    free(records);
+    fclose(fin);
+  return failure;
+}
+
+/* Checks the single pass scan of the resolving times 'args[1]' against one
+ * pass of tdcrCoinc per resolving time on the records of the binary run file
+ * 'args[0]' and prints the events/s of both.
+ *
+ * @return 0 on success, otherwise a non-zero integer (a description is
+ * printed to stderr)
+ */
+static int runScanBench(char **args){
+  int failure = 1;
+  FILE *fin;
+  tdcrScan_t scan;
+  tdcrCoinc_t coinc;
+  psdEvent_t *records = NULL;
+  size_t numRecords;
+  uint64_t counts[TDCR_NUM_COUNTS];
+  uint32_t k;
+  double rate[2];
+    if (loadScan(args, &scan, &fin))
+      return 1;
+    if(  (records = (psdEvent_t*)malloc(BENCH_MAX_RECORDS * sizeof(psdEvent_t))) == NULL  ){
+      fputs("tdcrOffline - error trying allocating memory\n", stderr);
+      goto endScanBench;
+    }
+    if(  (numRecords = fread(records, sizeof(psdEvent_t), BENCH_MAX_RECORDS, fin)) == 0  ){
+      fprintf(stderr, "%s: no records\n", args[0]);
+      goto endScanBench;
+    }
+
+    // the counts must be the same for each resolving time
+    tdcrScanPush(&scan, records, (uint32_t)numRecords);
+    tdcrScanFlush(&scan);
+    for (k = 0; k < scan.numWindows; k++){
+      initTdcrCoinc(&coinc, scan.windowNs[k]);
+      tdcrCoincPush(&coinc, records, (uint32_t)numRecords);
+      tdcrCoincFlush(&coinc);
+      tdcrScanCounts(&scan, k, counts);
+      if (memcmp(counts, coinc.counts, sizeof(counts))){
+        fprintf(stderr, "resolving time %lu ns: the counts of tdcrScan differ from tdcrCoinc\n", scan.windowNs[k]);
+        goto endScanBench;
+      }
+    }
+    printf("%lu records, the counts of the %u resolving times are identical to one tdcrCoinc pass each\n", (unsigned long)numRecords,
+           scan.numWindows);
+    rate[0] = benchScan(0, &scan, records, numRecords);
+    printf("%-18s %14.0f events/s %8.2fx\n", "tdcrCoinc passes", rate[0], 1.0);
+    rate[1] = benchScan(1, &scan, records, numRecords);
+    printf("%-18s %14.0f events/s %8.2fx\n", "tdcrScan", rate[1], rate[1] / rate[0]);
+    failure = 0;
+
+endScanBench:
+    free(records);
+    fclose(fin);
+  return failure;
+}
+
+/* Reads the waveform records of a waveform file, from the first one, into
+ * 'traces' (the first trace of each record) and 'events' (at most
+ * CHARGE_MAX_TRACES). The samples are allocated in '*samples'.
+ *
+ * @return 0 on success, -1 in case of error (a description is printed to
+ * stderr)
+ */
+static int loadTraces(FILE *fin, const char *name, psdChargeTrace_t *traces, psdEvent_t *events, uint16_t **samples, uint64_t *numTraces){
+  runFileTrace_t trace;
+  uint64_t count, n;
+  size_t used = 0, capacity = 0, words;
+  uint16_t *buffer = NULL, *newBuffer;
+    *samples = NULL;
+    if (seekRunFileTrace(fin, 0, &count))
+      return -1;
+    if (count > CHARGE_MAX_TRACES)
+      count = CHARGE_MAX_TRACES;
+    if (count == 0){
+      fprintf(stderr, "%s: no waveform records\n", name);
+      return -1;
+    }
+    for (n = 0; n < count; n++){
+      if(  (fread(&trace, sizeof(trace), 1, fin) != 1) || (trace.sync != RUN_FILE_TRACE_SYNC)
+          || (trace.size != RUN_FILE_TRACE_SIZE(trace.numSamples, trace.numTraces)) || (trace.numTraces < 1) || (trace.numTraces > 2)  ){
+        fprintf(stderr, "%s: record %lu is damaged\n", name, (unsigned long)n);
+        free(buffer);
+        return -1;
+      }
+      // the whole record but the header: the traces and the padding
+      words = (trace.size - sizeof(trace)) / sizeof(uint16_t);
+      if (used + words > capacity){
+        capacity = (capacity == 0) ? (1u << 20) : 2 * capacity;
+        if (capacity < used + words)
+          capacity = used + words;
+        if(  (newBuffer = (uint16_t*)realloc(buffer, capacity * sizeof(uint16_t))) == NULL  ){
+          fputs("tdcrOffline - error trying allocating memory\n", stderr);
+          free(buffer);
+          return -1;
+        }
+        buffer = newBuffer;
+      }
+      if (fread(buffer + used, sizeof(uint16_t), words, fin) != words){
+        fprintf(stderr, "%s: record %lu is truncated\n", name, (unsigned long)n);
+        free(buffer);
+        return -1;
+      }
+      // the buffer may still move: the offset for now
+      traces[n].samples = (const uint16_t*)(uintptr_t)used;
+      traces[n].numSamples = trace.numSamples;
+      events[n] = trace.event;
+      used += words;
+    }
+    for (n = 0; n < count; n++)
+      traces[n].samples = buffer + (uintptr_t)traces[n].samples;
+    *samples = buffer;
+    *numTraces = count;
+  return 0;
+}
+
+/* Integrates the traces again and again, PSD_CHARGE_BATCH at a time, for at
+ * least BENCH_MIN_TIME seconds, with the scalar (vector = 0) or the SIMD path.
+ *
+ * @return the traces/s
+ */
+static double benchCharge(int vector, const psdChargeGates_t *g, const psdChargeTrace_t *traces, uint64_t numTraces, psdCharge_t *charges){
+  double start = monotonicSeconds(), elapsed;
+  unsigned long done = 0;
+  uint64_t i, n;
+    do{
+      for (i = 0; i < numTraces; i += n){
+        n = (numTraces - i < PSD_CHARGE_BATCH) ? numTraces - i : PSD_CHARGE_BATCH;
+        if (vector)
+          psdChargeVector(g, traces + i, (uint32_t)n, charges + i);
+        else
+          psdChargeScalar(g, traces + i, (uint32_t)n, charges + i);
+      }
+      done += numTraces;
+    } while(  (elapsed = monotonicSeconds() - start) < BENCH_MIN_TIME  );
+  return (double)done / elapsed;
+}
+
+/* Counts the coincidences of the records again and again, for at least
+ * BENCH_MIN_TIME seconds, for each resolving time of 'scan': with one pass of
+ * tdcrCoinc per resolving time (single = 0) or with a single pass of
+ * tdcrScan.
+ *
+ * @return the events/s
+ */
+static double benchScan(int single, const tdcrScan_t *scan, const psdEvent_t *records, size_t numRecords){
+  tdcrScan_t s;
+  tdcrCoinc_t c;
+  double start = monotonicSeconds(), elapsed;
+  unsigned long events = 0;
+  uint32_t k;
+    do{
+      if (single){
+        initTdcrScan(&s, scan->windowNs, scan->numWindows);
+        tdcrScanPush(&s, records, (uint32_t)numRecords);
+        tdcrScanFlush(&s);
+      }
+      else{
+        for (k = 0; k < scan->numWindows; k++){
+          initTdcrCoinc(&c, scan->windowNs[k]);
+          tdcrCoincPush(&c, records, (uint32_t)numRecords);
+          tdcrCoincFlush(&c);
+        }
+      }
+      events += numRecords;
+    } while(  (elapsed = monotonicSeconds() - start) < BENCH_MIN_TIME  );
+  return (double)events / elapsed;
+}
+
+/* Formats the records again and again, for at least BENCH_MIN_TIME seconds,
+ * with fprintf() to 'fnull' (method 0), sprintf() (1) or formatRunFileText()
+ * (2).
+ *
+ * @return the events/s
+ */
+static double benchFormatter(int method, FILE *fnull, const psdEvent_t *records, size_t numRecords, uint32_t chargeMask){
+  const psdEvent_t *ev;
+  double start = monotonicSeconds(), elapsed;
+  unsigned long events = 0;
+  size_t i, n;
+  char *p;
+    do{
+      for (i = 0; i < numRecords; i += n){
+        n = (numRecords - i < TEXT_BATCH) ? numRecords - i : TEXT_BATCH;
+        if (method == 2)
+          formatRunFileText(textBuffer, records + i, n, chargeMask, RUN_FILE_TEXT_LEGACY);
+        else{
+          for (ev = records + i, p = textBuffer; ev < records + i + n; ev++){
+            if (method == 0)
+              fprintf(fnull, RUN_FILE_TEXT_LINE, RUN_FILE_TEXT_CHANNEL(ev->board, ev->channel), (unsigned long)(ev->timestamp & PSD_TIMETAG_MASK),
+                      (int)(ev->qshort & chargeMask), (int)(ev->qlong & chargeMask), (unsigned long)(ev->timestamp >> PSD_TIMETAG_BITS));
+            else
+              p += sprintf(p, RUN_FILE_TEXT_LINE, RUN_FILE_TEXT_CHANNEL(ev->board, ev->channel), (unsigned long)(ev->timestamp & PSD_TIMETAG_MASK),
+                           (int)(ev->qshort & chargeMask), (int)(ev->qlong & chargeMask), (unsigned long)(ev->timestamp >> PSD_TIMETAG_BITS));
+          }
+        }
+      }
+      events += numRecords;
+    } while(  (elapsed = monotonicSeconds() - start) < BENCH_MIN_TIME  );
+  return (double)events / elapsed;
+}
+
+/* @return the CLOCK_MONOTONIC time in seconds */
+static double monotonicSeconds(void){
+  struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}